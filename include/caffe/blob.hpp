@@ -24,7 +24,8 @@ template <typename Dtype>
 class Blob {
  public:
   Blob()
-       : data_(), diff_(), count_(0), capacity_(0) {}
+       : data_(), diff_(), count_(0), capacity_(0), data_offset_(0),
+         diff_offset_(0) {}
 
   /// @brief Deprecated; use <code>Blob(const vector<int>& shape)</code>.
   explicit Blob(const int num, const int channels, const int height,
@@ -263,6 +264,28 @@ class Blob {
    * shared_ptr calls its destructor when reset with the "=" operator.
    */
   void ShareDiff(const Blob& other);
+  /**
+   * @brief Make this Blob a view of the count() elements of Blob other that
+   *        start at offset, for both data and diff -- useful in Layer%s such
+   *        as Concat and Slice whose outputs are contiguous pieces of their
+   *        inputs or the other way around.
+   *
+   * Views of views refer to the memory of the outermost Blob. The view lasts
+   * until the Blob is reshaped beyond its count, is given new data, or
+   * ReleaseView is called.
+   */
+  void ShareView(const Blob& other, const int offset);
+  /// @brief Whether this Blob is the view ShareView(other, offset) set up.
+  bool IsViewOf(const Blob& other, const int offset) const;
+  /// @brief Whether this Blob's data is (part of) the memory of other's.
+  inline bool SharesDataWith(const Blob& other) const {
+    return data_ && data_ == other.data_;
+  }
+  /**
+   * @brief Give this Blob memory of its own again, keeping the data (but not
+   *        the diff) it currently sees.
+   */
+  void ReleaseView();
 
   bool ShapeEquals(const BlobProto& other);
 
@@ -273,6 +296,10 @@ class Blob {
   vector<int> shape_;
   int count_;
   int capacity_;
+  // Offsets, in elements, of this Blob's data and diff into data_ and diff_;
+  // nonzero only for views (see ShareView).
+  int data_offset_;
+  int diff_offset_;
 
   DISABLE_COPY_AND_ASSIGN(Blob);
 };  // class Blob
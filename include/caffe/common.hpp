@@ -109,6 +109,9 @@ class Caffe {
   static Caffe& Get();
 
   enum Brew { CPU, GPU };
+  // CPU matrix multiply engine: the linked BLAS library (ATLAS, OpenBLAS or
+  // MKL, chosen at build time) or Caffe's built-in cache-blocked GEMM.
+  enum GemmBackend { BLAS, BLOCKED };
 
   // This random number generator facade hides boost and CUDA rng
   // implementation from one another (for cross-platform compatibility).
@@ -146,6 +149,13 @@ class Caffe {
   // freed in a non-pinned way, which may cause problems - I haven't verified
   // it personally but better to note it here in the header file.
   inline static void set_mode(Brew mode) { Get().mode_ = mode; }
+  // Returns the engine used by caffe_cpu_gemm.
+  inline static GemmBackend gemm_backend() { return Get().gemm_backend_; }
+  // Sets the engine used by caffe_cpu_gemm. Operands already packed with
+  // PackedGemmMatrix are repacked on their next use.
+  inline static void set_gemm_backend(GemmBackend backend) {
+    Get().gemm_backend_ = backend;
+  }
   // Sets the random seed of both boost and curand
   static void set_random_seed(const unsigned int seed);
   // Sets the device. Since we have cublas and curand stuff, set device also
@@ -175,6 +185,7 @@ class Caffe {
   shared_ptr<RNG> random_generator_;
 
   Brew mode_;
+  GemmBackend gemm_backend_;
 
   // Parallel training
   int solver_count_;
@@ -6,6 +6,7 @@
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/rng.hpp"
 
 namespace caffe {
 
@@ -143,7 +144,9 @@ class DataTransformer {
   TransformationParameter param_;
 
 
-  shared_ptr<Caffe::RNG> rng_;
+  shared_ptr<PhiloxStream> rng_;
+  /// the number of rng_ that Rand draws next
+  uint64_t rand_offset_;
   Phase phase_;
   Blob<Dtype> data_mean_;
   vector<Dtype> mean_values_;
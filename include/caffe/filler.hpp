@@ -11,6 +11,7 @@
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/syncedmem.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/rng.hpp"
 
 namespace caffe {
 
@@ -53,8 +54,9 @@ class UniformFiller : public Filler<Dtype> {
       : Filler<Dtype>(param) {}
   virtual void Fill(Blob<Dtype>* blob) {
     CHECK(blob->count());
-    caffe_rng_uniform<Dtype>(blob->count(), Dtype(this->filler_param_.min()),
-        Dtype(this->filler_param_.max()), blob->mutable_cpu_data());
+    PhiloxStream(caffe_rng_seed(), 0).Uniform<Dtype>(blob->count(), 0,
+        Dtype(this->filler_param_.min()), Dtype(this->filler_param_.max()),
+        blob->mutable_cpu_data());
     CHECK_EQ(this->filler_param_.sparse(), -1)
          << "Sparsity not supported by this Filler.";
   }
@@ -69,8 +71,10 @@ class GaussianFiller : public Filler<Dtype> {
   virtual void Fill(Blob<Dtype>* blob) {
     Dtype* data = blob->mutable_cpu_data();
     CHECK(blob->count());
-    caffe_rng_gaussian<Dtype>(blob->count(), Dtype(this->filler_param_.mean()),
-        Dtype(this->filler_param_.std()), blob->mutable_cpu_data());
+    const uint64_t seed = caffe_rng_seed();
+    PhiloxStream(seed, 0).Gaussian<Dtype>(blob->count(), 0,
+        Dtype(this->filler_param_.mean()), Dtype(this->filler_param_.std()),
+        blob->mutable_cpu_data());
     int sparse = this->filler_param_.sparse();
     CHECK_GE(sparse, -1);
     if (sparse >= 0) {
@@ -83,7 +87,8 @@ class GaussianFiller : public Filler<Dtype> {
       Dtype non_zero_probability = Dtype(sparse) / Dtype(num_outputs);
       rand_vec_.reset(new SyncedMemory(blob->count() * sizeof(int)));
       int* mask = reinterpret_cast<int*>(rand_vec_->mutable_cpu_data());
-      caffe_rng_bernoulli(blob->count(), non_zero_probability, mask);
+      PhiloxStream(seed, 1).Bernoulli(blob->count(), 0, non_zero_probability,
+          mask);
       for (int i = 0; i < blob->count(); ++i) {
         data[i] *= mask[i];
       }
@@ -105,7 +110,8 @@ class PositiveUnitballFiller : public Filler<Dtype> {
   virtual void Fill(Blob<Dtype>* blob) {
     Dtype* data = blob->mutable_cpu_data();
     DCHECK(blob->count());
-    caffe_rng_uniform<Dtype>(blob->count(), 0, 1, blob->mutable_cpu_data());
+    PhiloxStream(caffe_rng_seed(), 0).Uniform<Dtype>(blob->count(), 0, 0, 1,
+        blob->mutable_cpu_data());
     // We expect the filler to not be called very frequently, so we will
     // just use a simple implementation
     int dim = blob->count() / blob->shape(0);
@@ -161,8 +167,8 @@ class XavierFiller : public Filler<Dtype> {
       n = fan_out;
     }
     Dtype scale = sqrt(Dtype(3) / n);
-    caffe_rng_uniform<Dtype>(blob->count(), -scale, scale,
-        blob->mutable_cpu_data());
+    PhiloxStream(caffe_rng_seed(), 0).Uniform<Dtype>(blob->count(), 0,
+        -scale, scale, blob->mutable_cpu_data());
     CHECK_EQ(this->filler_param_.sparse(), -1)
          << "Sparsity not supported by this Filler.";
   }
@@ -206,8 +212,8 @@ class MSRAFiller : public Filler<Dtype> {
       n = fan_out;
     }
     Dtype std = sqrt(Dtype(2) / n);
-    caffe_rng_gaussian<Dtype>(blob->count(), Dtype(0), std,
-        blob->mutable_cpu_data());
+    PhiloxStream(caffe_rng_seed(), 0).Gaussian<Dtype>(blob->count(), 0,
+        Dtype(0), std, blob->mutable_cpu_data());
     CHECK_EQ(this->filler_param_.sparse(), -1)
          << "Sparsity not supported by this Filler.";
   }
@@ -269,6 +269,25 @@ class Layer {
     return true;
   }
 
+  /**
+   * @brief Return whether Forward may be run again on the same bottoms to
+   *        recompute the tops, as Net does for gradient checkpointing.
+   *
+   * Layers with side effects (such as writing files) or with state carried
+   * from one Forward to the next should return false; the net then never
+   * frees and recomputes the segment holding them.
+   */
+  virtual inline bool CanRecomputeForward() const { return true; }
+
+  /**
+   * @brief Return whether Forward draws random numbers on the GPU in the
+   *        current phase.
+   *
+   * Unlike the CPU draws these are not replayed when the net recomputes a
+   * segment for gradient checkpointing, so doing so in GPU mode is an error.
+   */
+  virtual inline bool UsesGPURandomNumbers() const { return false; }
+
   /**
    * @brief Specifies whether the layer should compute gradients w.r.t. a
    *        parameter at a particular index given by param_id.
@@ -291,6 +310,23 @@ class Layer {
     param_propagate_down_[param_id] = value;
   }
 
+  /**
+   * @brief Returns the rows (indices along the first axis) of the parameter
+   *        blob param_id whose diff Backward has written since the last
+   *        ClearParamDiffRows, or NULL if any of the diff may be nonzero.
+   *
+   * Layers whose parameter gradients are row-sparse, like EmbedLayer, list
+   * the rows so that the solver can skip the others.
+   */
+  virtual const vector<int>* param_diff_rows(const int param_id) const {
+    return NULL;
+  }
+  /**
+   * @brief Forgets the rows listed by param_diff_rows, once the net has
+   *        zeroed their diff.
+   */
+  virtual void ClearParamDiffRows(const int param_id) {}
+
 
  protected:
   /** The protobuf that stores the layer parameters */
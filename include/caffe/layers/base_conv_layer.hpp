@@ -6,7 +6,10 @@
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/gemm.hpp"
 #include "caffe/util/im2col.hpp"
+#include "caffe/util/quantize.hpp"
+#include "caffe/util/sparse.hpp"
 
 namespace caffe {
 
@@ -18,7 +21,7 @@ template <typename Dtype>
 class BaseConvolutionLayer : public Layer<Dtype> {
  public:
   explicit BaseConvolutionLayer(const LayerParameter& param)
-      : Layer<Dtype>(param) {}
+      : Layer<Dtype>(param), cpu_engine_(CPU_GEMM) {}
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
@@ -40,6 +43,35 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   void weight_cpu_gemm(const Dtype* input, const Dtype* output, Dtype*
       weights);
   void backward_cpu_bias(Dtype* bias, const Dtype* input);
+  // Int8 counterpart of forward_cpu_gemm with the layer's own weights, for
+  // TEST phase forward passes of a layer whose quantization_param asks for
+  // INT8 precision. Deconvolution has no int8 forward pass.
+  void forward_cpu_int8_gemm(const Dtype* input, Dtype* output);
+  inline bool use_int8_cpu() {
+    return !reverse_dimensions() && this->phase_ == TEST &&
+        this->layer_param_.quantization_param().precision() ==
+        QuantizationParameter_Precision_INT8;
+  }
+
+  // The CPU engines: im2col and a GEMM with the process-wide backend or with
+  // a given one, or a direct forward where the layer has one for its
+  // geometry. With an EngineTuner database the fastest for each input shape
+  // is chosen at Reshape; otherwise the direct forward is used where there
+  // is one, and the GEMM elsewhere.
+  enum CPUEngine { CPU_GEMM, CPU_GEMM_BLAS, CPU_GEMM_BLOCKED, CPU_DIRECT };
+  virtual bool has_direct_cpu() { return false; }
+  // The backend of caffe_cpu_gemm for the CPU passes, which set it with a
+  // GemmBackendScope.
+  inline Caffe::GemmBackend cpu_gemm_backend() const {
+    switch (cpu_engine_) {
+    case CPU_GEMM_BLAS:
+      return Caffe::BLAS;
+    case CPU_GEMM_BLOCKED:
+      return Caffe::BLOCKED;
+    default:
+      return Caffe::gemm_backend();
+    }
+  }
 
 #ifndef CPU_ONLY
   void forward_gpu_gemm(const Dtype* col_input, const Dtype* weights,
@@ -92,6 +124,7 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   bool bias_term_;
   bool is_1x1_;
   bool force_nd_im2col_;
+  CPUEngine cpu_engine_;
 
  private:
   // wrap im2col/col2im so we don't have to remember the (long) argument lists
@@ -155,6 +188,19 @@ class BaseConvolutionLayer : public Layer<Dtype> {
     }
   }
 #endif
+  // Packs the per-group weight matrices for forward_cpu_gemm unless the
+  // packed copies still match blobs_[0].
+  void pack_weights_cpu();
+  // Converts the weights to sparse format for forward_cpu_gemm unless
+  // already tried for the current blobs_[0], and returns whether they were
+  // sparse enough to convert.
+  bool sparse_weights_cpu();
+  // Chooses cpu_engine_ for the input shape, timing the candidates when the
+  // tuning database has no entry for the geometry.
+  void select_cpu_engine(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  // The geometry the tuning database is keyed by.
+  string cpu_engine_key(const Blob<Dtype>& bottom);
 
   int num_kernels_im2col_;
   int num_kernels_col2im_;
@@ -164,9 +210,19 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   int kernel_dim_;
   int col_offset_;
   int output_offset_;
+  /// @brief The input shape cpu_engine_ was chosen for.
+  vector<int> cpu_engine_shape_;
 
   Blob<Dtype> col_buffer_;
   Blob<Dtype> bias_multiplier_;
+  /// @brief Per-group weights packed once for TEST phase forward passes.
+  vector<shared_ptr<PackedGemmMatrix<Dtype> > > packed_weights_;
+  /// @brief The weights in sparse format for pruned models.
+  SparseWeightMatrix<Dtype> sparse_weights_;
+  /// @brief The weights quantized once for int8 forward passes.
+  Int8WeightMatrix<Dtype> int8_weights_;
+  vector<uint8_t> int8_col_buffer_;
+  vector<int32_t> int8_output_;
 };
 
 }  // namespace caffe
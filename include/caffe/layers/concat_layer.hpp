@@ -80,6 +80,8 @@ class ConcatLayer : public Layer<Dtype> {
   int num_concats_;
   int concat_input_size_;
   int concat_axis_;
+  /// Whether the bottoms are views of the top, so there is nothing to copy.
+  bool share_bottoms_;
 };
 
 }  // namespace caffe
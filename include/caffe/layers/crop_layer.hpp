@@ -44,14 +44,18 @@ class CropLayer : public Layer<Dtype> {
   Blob<int> offsets;
   Blob<int> src_strides_;
   Blob<int> dest_strides_;
+  // The first axis of the chunks in which the crop is copied, their size, and
+  // the offset of the crop into the bottom.
+  int copy_axis_;
+  int copy_size_;
+  int crop_offset_;
+  // Whether the top is a view of the bottom, so there is nothing to copy.
+  bool share_top_;
 
  private:
-  // Recursive copy function.
+  // Copy function; the chunks are copied in parallel.
   void crop_copy(const vector<Blob<Dtype>*>& bottom,
                const vector<Blob<Dtype>*>& top,
-               const int* offsets,
-               vector<int> indices,
-               int cur_dim,
                const Dtype* src_data,
                Dtype* dest_data,
                bool is_forward);
@@ -29,7 +29,8 @@ template <typename Dtype>
 class DeconvolutionLayer : public BaseConvolutionLayer<Dtype> {
  public:
   explicit DeconvolutionLayer(const LayerParameter& param)
-      : BaseConvolutionLayer<Dtype>(param) {}
+      : BaseConvolutionLayer<Dtype>(param), bilinear_memory_(NULL),
+        bilinear_version_(-1), is_bilinear_(false) {}
 
   virtual inline const char* type() const { return "Deconvolution"; }
 
@@ -44,6 +45,30 @@ class DeconvolutionLayer : public BaseConvolutionLayer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual inline bool reverse_dimensions() { return true; }
   virtual void compute_output_shape();
+  // Whether forward_cpu_direct applies: 2D deconvolution with stride 2, the
+  // common learned upsampling geometry.
+  virtual bool has_direct_cpu();
+
+ private:
+  // Transposed convolution of one image that multiplies every input value
+  // into its output window in place. Each output channel is written by one
+  // thread, so neither the column buffer nor the col2im scatter is needed.
+  void forward_cpu_direct(const Dtype* input, const Dtype* weights,
+      Dtype* output);
+  // Returns whether the weights are still the per-channel interpolation
+  // kernels of the "bilinear" filler (they are kept frozen for upsampling),
+  // checking once per version of the weights.
+  bool bilinear_weights_cpu();
+  // Bilinear upsampling of one image as two separable 1D passes.
+  void forward_cpu_bilinear(const Dtype* input, Dtype* output);
+
+  /// @brief The 1D bilinear kernel whose outer product is the filter.
+  vector<Dtype> bilinear_kernel_;
+  /// @brief The rows upsampled horizontally, per channel.
+  Blob<Dtype> bilinear_buffer_;
+  const SyncedMemory* bilinear_memory_;
+  int bilinear_version_;
+  bool is_bilinear_;
 };
 
 }  // namespace caffe
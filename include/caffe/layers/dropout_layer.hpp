@@ -39,6 +39,10 @@ class DropoutLayer : public NeuronLayer<Dtype> {
       const vector<Blob<Dtype>*>& top);
 
   virtual inline const char* type() const { return "Dropout"; }
+  // The GPU masks come from cuRAND.
+  virtual inline bool UsesGPURandomNumbers() const {
+    return this->phase_ == TRAIN;
+  }
 
  protected:
   /**
@@ -67,7 +71,11 @@ class DropoutLayer : public NeuronLayer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
 
   /// when divided by UINT_MAX, the randomly generated values @f$u\sim U(0,1)@f$
+  /// (GPU)
   Blob<unsigned int> rand_vec_;
+  /// the mask, packed 32 inputs to a word: input i is kept if bit i % 32 of
+  /// word i / 32 is set (CPU)
+  Blob<unsigned int> mask_bits_;
   /// the probability @f$ p @f$ of dropping any input
   Dtype threshold_;
   /// the scale for undropped inputs at train time @f$ 1 / (1 - p) @f$
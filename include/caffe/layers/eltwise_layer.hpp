@@ -44,6 +44,8 @@ class EltwiseLayer : public Layer<Dtype> {
   Blob<int> max_idx_;
 
   bool stable_prod_grad_;
+  /// Whether a ReLU is fused into the output (see EltwiseParameter.relu).
+  bool relu_;
 };
 
 }  // namespace caffe
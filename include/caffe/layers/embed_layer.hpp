@@ -30,6 +30,9 @@ class EmbedLayer : public Layer<Dtype> {
   virtual inline int ExactNumBottomBlobs() const { return 1; }
   virtual inline int ExactNumTopBlobs() const { return 1; }
 
+  virtual const vector<int>* param_diff_rows(const int param_id) const;
+  virtual void ClearParamDiffRows(const int param_id);
+
  protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
@@ -45,6 +48,10 @@ class EmbedLayer : public Layer<Dtype> {
   int N_;
   bool bias_term_;
   Blob<Dtype> bias_multiplier_;
+  bool sparse_gradient_;
+  /// The weight rows that Backward_cpu wrote, once each, and their marks.
+  vector<int> diff_rows_;
+  vector<bool> diff_row_listed_;
 };
 
 }  // namespace caffe
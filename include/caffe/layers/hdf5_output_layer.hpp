@@ -36,6 +36,8 @@ class HDF5OutputLayer : public Layer<Dtype> {
   // TODO: no limit on the number of blobs
   virtual inline int ExactNumBottomBlobs() const { return 2; }
   virtual inline int ExactNumTopBlobs() const { return 0; }
+  // Each Forward writes the bottoms to the file.
+  virtual inline bool CanRecomputeForward() const { return false; }
 
   inline std::string file_name() const { return file_name_; }
 
@@ -8,7 +8,6 @@
 #include "caffe/proto/caffe.pb.h"
 
 #include "caffe/layers/loss_layer.hpp"
-#include "caffe/layers/softmax_layer.hpp"
 
 namespace caffe {
 
@@ -37,13 +36,18 @@ namespace caffe {
  *      the third bottom blob input if not provided as the infogain_mat in the
  *      InfogainLossParameter. If @f$ H = I @f$, this layer is equivalent to the
  *      SoftmaxWithLossLayer.
- * @param top output Blob vector (length 1)
+ * @param top output Blob vector (length 1 to 3)
  *   -# @f$ (1 \times 1 \times 1 \times 1) @f$
  *      the computed infogain multinomial logistic loss: @f$ E =
  *        \frac{-1}{N} \sum\limits_{n=1}^N H_{l_n} \log(\hat{p}_n) =
  *        \frac{-1}{N} \sum\limits_{n=1}^N \sum\limits_{k=1}^{K} H_{l_n,k}
  *        \log(\hat{p}_{n,k})
  *      @f$, where @f$ H_{l_n} @f$ denotes row @f$l_n@f$ of @f$H@f$.
+ *   -# @f$ (N \times C \times H \times W) @f$
+ *      optionally, the probabilities @f$ \hat{p} @f$
+ *   -# @f$ (N) @f$
+ *      with LossParameter.per_sample_loss, the loss of each sample, summed
+ *      over its labels that are not ignored, before normalization
  */
 template <typename Dtype>
 class InfogainLossLayer : public LossLayer<Dtype> {
@@ -66,7 +70,7 @@ class InfogainLossLayer : public LossLayer<Dtype> {
   // optional second "top" outputs the softmax prob
   virtual inline int ExactNumTopBlobs() const { return -1; }
   virtual inline int MinTopBlobs() const { return 1; }
-  virtual inline int MaxTopBlobs() const { return 2; }
+  virtual inline int MaxTopBlobs() const { return 3; }
 
   virtual inline const char* type() const { return "InfogainLoss"; }
 
@@ -119,14 +123,15 @@ class InfogainLossLayer : public LossLayer<Dtype> {
   /// fill sum_rows_H_ according to matrix H
   virtual void sum_rows_of_H(const Blob<Dtype>* H);
 
-  /// The internal SoftmaxLayer used to map predictions to a distribution.
-  shared_ptr<Layer<Dtype> > softmax_layer_;
-  /// prob stores the output probability predictions from the SoftmaxLayer.
-  Blob<Dtype> prob_;
-  /// bottom vector holder used in call to the underlying SoftmaxLayer::Forward
-  vector<Blob<Dtype>*> softmax_bottom_vec_;
-  /// top vector holder used in call to the underlying SoftmaxLayer::Forward
-  vector<Blob<Dtype>*> softmax_top_vec_;
+  /// log_norm stores log(sum_c exp(x_c)) of each position from the forward
+  /// pass, from which Backward recomputes the probabilities.
+  Blob<Dtype> log_norm_;
+  /// The runs of positions that are not ignored (see
+  /// LossLayer::FindLabelRuns), the loss of each from the forward pass, and
+  /// the number of positions in them.
+  vector<int> valid_runs_;
+  vector<Dtype> run_loss_;
+  int valid_count_;
 
   Blob<Dtype> infogain_;
   Blob<Dtype> sum_rows_H_;  // cache the row sums of H.
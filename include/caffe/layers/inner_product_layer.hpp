@@ -6,6 +6,9 @@
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/gemm.hpp"
+#include "caffe/util/quantize.hpp"
+#include "caffe/util/sparse.hpp"
 
 namespace caffe {
 
@@ -38,6 +41,21 @@ class InnerProductLayer : public Layer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+  /// @brief TEST phase forward pass in int8, see QuantizationParameter.
+  void forward_cpu_int8(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  // Converts the weights to sparse format unless already tried for the
+  // current blobs_[0], and returns whether they were sparse enough.
+  bool sparse_weight_cpu();
+  // The fused activation and its gradient, applied in place.
+  void activation_forward_cpu(const int count, Dtype* data);
+  void activation_backward_cpu(const int count, const Dtype* data,
+      Dtype* diff);
+#ifndef CPU_ONLY
+  void activation_forward_gpu(const int count, Dtype* data);
+  void activation_backward_gpu(const int count, const Dtype* data,
+      Dtype* diff);
+#endif
 
   int M_;
   int K_;
@@ -45,6 +63,15 @@ class InnerProductLayer : public Layer<Dtype> {
   bool bias_term_;
   Blob<Dtype> bias_multiplier_;
   bool transpose_;  ///< if true, assume transposed weights
+  InnerProductParameter_Activation activation_;  ///< fused activation
+  /// @brief The weights packed once for TEST phase forward passes.
+  PackedGemmMatrix<Dtype> packed_weight_;
+  /// @brief The weights in sparse format for pruned models.
+  SparseWeightMatrix<Dtype> sparse_weight_;
+  /// @brief The weights quantized once for int8 forward passes.
+  Int8WeightMatrix<Dtype> int8_weight_;
+  vector<uint8_t> int8_input_;
+  vector<int32_t> int8_output_;
 };
 
 }  // namespace caffe
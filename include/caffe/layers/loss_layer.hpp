@@ -23,7 +23,7 @@ template <typename Dtype>
 class LossLayer : public Layer<Dtype> {
  public:
   explicit LossLayer(const LayerParameter& param)
-     : Layer<Dtype>(param) {}
+     : Layer<Dtype>(param), per_sample_loss_(false) {}
   virtual void LayerSetUp(
       const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top);
   virtual void Reshape(
@@ -46,6 +46,23 @@ class LossLayer : public Layer<Dtype> {
   virtual inline bool AllowForceBackward(const int bottom_index) const {
     return bottom_index != 1;
   }
+
+ protected:
+  /**
+   * @brief Find the runs of consecutive positions i < count whose label is
+   *        not ignore_label, so that the loss can skip the ignored ones.
+   *
+   * The runs do not cross samples of sample_size positions and are at most
+   * max_len long. runs receives the begin and end of each run in turn; the
+   * number of positions in them is returned.
+   */
+  static int FindLabelRuns(const Dtype* label, const int count,
+      const int sample_size, const int max_len, const bool has_ignore_label,
+      const int ignore_label, vector<int>* runs);
+
+  /// Whether the last top receives the loss of each sample
+  /// (LossParameter.per_sample_loss).
+  bool per_sample_loss_;
 };
 
 }  // namespace caffe
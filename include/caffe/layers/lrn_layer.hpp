@@ -47,14 +47,22 @@ class LRNLayer : public Layer<Dtype> {
       const vector<Blob<Dtype>*>& top);
   virtual void CrossChannelForward_gpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
+  virtual void WithinChannelForward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
   virtual void WithinChannelForward(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   virtual void CrossChannelBackward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual void CrossChannelBackward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+  virtual void WithinChannelBackward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual void WithinChannelBackward(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+  // Sets up the chain of sub-layers computing WITHIN_CHANNEL normalization on
+  // the GPU; the CPU kernels compute it in a single pass without them.
+  void WithinChannelSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
 
   int size_;
   int pre_pad_;
@@ -66,11 +74,11 @@ class LRNLayer : public Layer<Dtype> {
   int height_;
   int width_;
 
-  // Fields used for normalization ACROSS_CHANNELS
-  // scale_ stores the intermediate summing results
+  // scale_ stores the intermediate summing results (the denominators before
+  // the power) of the CPU kernels and of ACROSS_CHANNELS on the GPU
   Blob<Dtype> scale_;
 
-  // Fields used for normalization WITHIN_CHANNEL
+  // Fields used for normalization WITHIN_CHANNEL on the GPU
   shared_ptr<SplitLayer<Dtype> > split_layer_;
   vector<Blob<Dtype>*> split_top_vec_;
   shared_ptr<PowerLayer<Dtype> > square_layer_;
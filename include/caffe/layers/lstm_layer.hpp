@@ -58,6 +58,25 @@ class LSTMLayer : public RecurrentLayer<Dtype> {
   virtual void RecurrentOutputBlobNames(vector<string>* names) const;
   virtual void RecurrentInputShapes(vector<BlobShape>* shapes) const;
   virtual void OutputBlobNames(vector<string>* names) const;
+
+  virtual inline bool HasFusedEngine() const { return true; }
+  virtual void FusedReshape(const int T, const int N);
+  virtual void FusedForward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top, const vector<Blob<Dtype>*>& state_in,
+      const vector<Blob<Dtype>*>& state_out);
+  virtual void FusedBackward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  // Buffers of the fused engine, for all timesteps:
+  /// the gate activations [i_t, f_t, o_t, g_t] (T x N x 4D), with the
+  /// gradients w.r.t. the gate inputs in the diff
+  Blob<Dtype> gates_;
+  /// c_t and \tanh[c_t] (T x N x D)
+  Blob<Dtype> cell_, tanh_cell_;
+  /// cont_t * h_{t-1} (T x N x D)
+  Blob<Dtype> h_conted_;
+  /// the gradients w.r.t. h_{t-1} and c_{t-1} of the current timestep (N x D)
+  Blob<Dtype> h_prev_diff_, c_prev_diff_;
 };
 
 /**
@@ -9,6 +9,8 @@
 
 namespace caffe {
 
+struct PoolingShape;
+
 /**
  * @brief Pools the input image by taking the max, average, etc. within regions.
  *
@@ -18,7 +20,7 @@ template <typename Dtype>
 class PoolingLayer : public Layer<Dtype> {
  public:
   explicit PoolingLayer(const LayerParameter& param)
-      : Layer<Dtype>(param) {}
+      : Layer<Dtype>(param), max_idx_stale_(false) {}
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
@@ -33,6 +35,11 @@ class PoolingLayer : public Layer<Dtype> {
     return (this->layer_param_.pooling_param().pool() ==
             PoolingParameter_PoolMethod_MAX) ? 2 : 1;
   }
+  // Stochastic pooling samples its inputs with cuRAND when training.
+  virtual inline bool UsesGPURandomNumbers() const {
+    return this->phase_ == TRAIN && this->layer_param_.pooling_param().pool()
+        == PoolingParameter_PoolMethod_STOCHASTIC;
+  }
 
  protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
@@ -44,6 +51,8 @@ class PoolingLayer : public Layer<Dtype> {
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
 
+  PoolingShape pooling_shape() const;
+
   int kernel_h_, kernel_w_;
   int stride_h_, stride_w_;
   int pad_h_, pad_w_;
@@ -53,6 +62,8 @@ class PoolingLayer : public Layer<Dtype> {
   bool global_pooling_;
   Blob<Dtype> rand_idx_;
   Blob<int> max_idx_;
+  // Set when a TEST phase forward pass of max pooling skipped max_idx_.
+  bool max_idx_stale_;
 };
 
 }  // namespace caffe
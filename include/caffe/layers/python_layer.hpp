@@ -35,6 +35,8 @@ class PythonLayer : public Layer<Dtype> {
   }
 
   virtual inline const char* type() const { return "Python"; }
+  // The Python code may keep state or have side effects of its own.
+  virtual inline bool CanRecomputeForward() const { return false; }
 
  protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
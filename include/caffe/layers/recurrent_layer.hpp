@@ -11,11 +11,36 @@
 #include "caffe/net.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/format.hpp"
+#include "caffe/util/math_functions.hpp"
 
 namespace caffe {
 
 template <typename Dtype> class RecurrentLayer;
 
+/**
+ * @brief The hidden state of a single stream for RecurrentLayer::Step, such as
+ *        one session of online decoding.
+ */
+template <typename Dtype>
+class RecurrentState {
+ public:
+  RecurrentState() {}
+
+  /// @brief Zeroes the state, so that the next Step begins a new sequence.
+  void Reset() {
+    for (int i = 0; i < blobs_.size(); ++i) {
+      caffe_set(blobs_[i]->count(), Dtype(0), blobs_[i]->mutable_cpu_data());
+    }
+  }
+  /// @brief The state blobs, set up by RecurrentLayer::InitState.
+  inline vector<shared_ptr<Blob<Dtype> > >& blobs() { return blobs_; }
+
+ protected:
+  vector<shared_ptr<Blob<Dtype> > > blobs_;
+
+  DISABLE_COPY_AND_ASSIGN(RecurrentState);
+};
+
 /**
  * @brief An abstract class for implementing recurrent behavior inside of an
  *        unrolled network.  This Layer type cannot be instantiated -- instead,
@@ -58,6 +83,31 @@ class RecurrentLayer : public Layer<Dtype> {
     // Can't propagate to sequence continuation indicators.
     return bottom_index != 1;
   }
+  // Unless exposed, the hidden state is carried over from the previous
+  // Forward, which running Forward again would advance once more.
+  virtual inline bool CanRecomputeForward() const { return expose_hidden_; }
+
+  /// @brief Shapes state for a single stream of this layer, and zeroes it.
+  void InitState(RecurrentState<Dtype>* state) const;
+
+  /**
+   * @brief Streaming inference: runs a single timestep for a batch of
+   *        independent streams that each carry their own state, with the
+   *        fused CPU engine (whatever RecurrentParameter.engine says).
+   *
+   * Neither the unrolled net nor the layer's own hidden state is used, so
+   * streams can join and leave the batch from one step to the next.
+   * Backward is not supported after Step.
+   *
+   * @param bottom the input @f$ (1 \times N \times ...) @f$, followed by the
+   *        static input @f$ (N \times ...) @f$ if the layer has one
+   * @param states the state of each of the @f$ N @f$ streams, from InitState;
+   *        updated in place
+   * @param top the output @f$ (1 \times N \times D) @f$
+   */
+  void Step(const vector<Blob<Dtype>*>& bottom,
+      const vector<RecurrentState<Dtype>*>& states,
+      const vector<Blob<Dtype>*>& top);
 
  protected:
   /**
@@ -147,6 +197,50 @@ class RecurrentLayer : public Layer<Dtype> {
   virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
 
+  /// @brief Whether the subclass implements the fused CPU engine.
+  virtual inline bool HasFusedEngine() const { return false; }
+
+  /**
+   * @brief Shapes the buffers of the fused engine for T timesteps of N
+   *        streams. Subclasses with buffers of their own extend it.
+   */
+  virtual void FusedReshape(const int T, const int N);
+
+  /**
+   * @brief Computes the outputs with the fused CPU engine instead of the
+   *        unrolled net, for the T timesteps and N streams of bottom. Like the
+   *        unrolled net, it starts from the state state_in (shaped like the
+   *        recurrent inputs) and leaves the final state in state_out, which
+   *        may be the same blobs. Subclasses with HasFusedEngine() define it.
+   */
+  virtual void FusedForward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top, const vector<Blob<Dtype>*>& state_in,
+      const vector<Blob<Dtype>*>& state_out) { NOT_IMPLEMENTED; }
+  /// @brief Backpropagates through time for FusedForward_cpu from the
+  ///        recurrent inputs.
+  virtual void FusedBackward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down,
+      const vector<Blob<Dtype>*>& bottom) { NOT_IMPLEMENTED; }
+
+  /// @brief Returns the unrolled net parameter named name.
+  Blob<Dtype>* unrolled_param(const string& name) const;
+
+  /**
+   * @brief For the fused engine: computes the input transform of every
+   *        timestep, y_t = W x_t + b (+ W_static x_static), into
+   *        y (@f$ T \times N \times @f$ W.shape(0)).
+   */
+  void FusedInputForward(const vector<Blob<Dtype>*>& bottom,
+      const Blob<Dtype>& W, const Blob<Dtype>& b, const Blob<Dtype>* W_static,
+      Dtype* y);
+  /**
+   * @brief Accumulates the gradients of FusedInputForward w.r.t. its
+   *        parameters, and computes those w.r.t. its inputs, given y_diff.
+   */
+  void FusedInputBackward(const vector<bool>& propagate_down,
+      const vector<Blob<Dtype>*>& bottom, const Dtype* y_diff, Blob<Dtype>* W,
+      Blob<Dtype>* b, Blob<Dtype>* W_static);
+
   /// @brief A Net to implement the Recurrent functionality.
   shared_ptr<Net<Dtype> > unrolled_net_;
 
@@ -174,6 +268,16 @@ class RecurrentLayer : public Layer<Dtype> {
    */
   bool expose_hidden_;
 
+  /// @brief Whether Forward_cpu and Backward_cpu use the fused engine.
+  bool fused_;
+  /// @brief Ones to add the biases of all timesteps with (fused engine).
+  Blob<Dtype> bias_multiplier_;
+  /// @brief The static input transform (fused engine).
+  Blob<Dtype> static_transform_;
+  /// @brief The sequence indicators and the batched states for Step.
+  Blob<Dtype> step_cont_;
+  vector<shared_ptr<Blob<Dtype> > > step_state_;
+
   vector<Blob<Dtype>* > recur_input_blobs_;
   vector<Blob<Dtype>* > recur_output_blobs_;
   vector<Blob<Dtype>* > output_blobs_;
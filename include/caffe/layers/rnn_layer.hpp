@@ -40,6 +40,24 @@ class RNNLayer : public RecurrentLayer<Dtype> {
   virtual void RecurrentOutputBlobNames(vector<string>* names) const;
   virtual void RecurrentInputShapes(vector<BlobShape>* shapes) const;
   virtual void OutputBlobNames(vector<string>* names) const;
+
+  virtual inline bool HasFusedEngine() const { return true; }
+  virtual void FusedReshape(const int T, const int N);
+  virtual void FusedForward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top, const vector<Blob<Dtype>*>& state_in,
+      const vector<Blob<Dtype>*>& state_out);
+  virtual void FusedBackward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  // Buffers of the fused engine, for all timesteps:
+  /// h_t (T x N x D), with the gradients w.r.t. its input in the diff
+  Blob<Dtype> hidden_;
+  /// cont_t * h_{t-1} (T x N x D)
+  Blob<Dtype> h_conted_;
+  /// the gradient w.r.t. the input of o_t (T x N x D)
+  Blob<Dtype> output_input_diff_;
+  /// the gradient w.r.t. h_{t-1} of the current timestep (N x D)
+  Blob<Dtype> h_prev_diff_;
 };
 
 }  // namespace caffe
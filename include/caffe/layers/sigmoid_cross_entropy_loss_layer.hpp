@@ -33,13 +33,16 @@ namespace caffe {
  *      using the sigmoid function @f$ \sigma(.) @f$ (see SigmoidLayer).
  *   -# @f$ (N \times C \times H \times W) @f$
  *      the targets @f$ y \in [0, 1] @f$
- * @param top output Blob vector (length 1)
+ * @param top output Blob vector (length 1, or 2 with per_sample_loss)
  *   -# @f$ (1 \times 1 \times 1 \times 1) @f$
  *      the computed cross-entropy loss: @f$
  *          E = \frac{-1}{n} \sum\limits_{n=1}^N \left[
  *                  p_n \log \hat{p}_n + (1 - p_n) \log(1 - \hat{p}_n)
  *              \right]
  *      @f$
+ *   -# @f$ (N) @f$
+ *      with LossParameter.per_sample_loss, the loss of each sample, summed
+ *      over its targets that are not ignored, before normalization
  */
 template <typename Dtype>
 class SigmoidCrossEntropyLossLayer : public LossLayer<Dtype> {
@@ -54,6 +57,9 @@ class SigmoidCrossEntropyLossLayer : public LossLayer<Dtype> {
       const vector<Blob<Dtype>*>& top);
 
   virtual inline const char* type() const { return "SigmoidCrossEntropyLoss"; }
+  virtual inline int ExactNumTopBlobs() const { return -1; }
+  virtual inline int MinTopBlobs() const { return 1; }
+  virtual inline int MaxTopBlobs() const { return 2; }
 
  protected:
   /// @copydoc SigmoidCrossEntropyLossLayer
@@ -104,7 +110,8 @@ class SigmoidCrossEntropyLossLayer : public LossLayer<Dtype> {
   virtual Dtype get_normalizer(
       LossParameter_NormalizationMode normalization_mode, int valid_count);
 
-  /// The internal SigmoidLayer used to map predictions to probabilities.
+  /// The internal SigmoidLayer used by the GPU path to map predictions to
+  /// probabilities.
   shared_ptr<SigmoidLayer<Dtype> > sigmoid_layer_;
   /// sigmoid_output stores the output of the SigmoidLayer.
   shared_ptr<Blob<Dtype> > sigmoid_output_;
@@ -121,6 +128,12 @@ class SigmoidCrossEntropyLossLayer : public LossLayer<Dtype> {
   LossParameter_NormalizationMode normalization_;
   Dtype normalizer_;
   int outer_num_, inner_num_;
+  /// The runs of inputs whose target is not ignored (see
+  /// LossLayer::FindLabelRuns), the loss of each from the CPU forward pass,
+  /// and the number of inputs in them.
+  vector<int> valid_runs_;
+  vector<Dtype> run_loss_;
+  int valid_count_;
 };
 
 }  // namespace caffe
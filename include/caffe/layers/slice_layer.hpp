@@ -44,6 +44,8 @@ class SliceLayer : public Layer<Dtype> {
   int slice_size_;
   int slice_axis_;
   vector<int> slice_point_;
+  /// Whether the tops are views of the bottom, so there is nothing to copy.
+  bool share_tops_;
 };
 
 }  // namespace caffe
@@ -34,11 +34,16 @@ namespace caffe {
  *      the labels @f$ l @f$, an integer-valued Blob with values
  *      @f$ l_n \in [0, 1, 2, ..., K - 1] @f$
  *      indicating the correct class label among the @f$ K @f$ classes
- * @param top output Blob vector (length 1)
+ * @param top output Blob vector (length 1 to 3)
  *   -# @f$ (1 \times 1 \times 1 \times 1) @f$
  *      the computed cross-entropy classification loss: @f$ E =
  *        \frac{-1}{N} \sum\limits_{n=1}^N \log(\hat{p}_{n,l_n})
  *      @f$, for softmax output class probabilites @f$ \hat{p} @f$
+ *   -# @f$ (N \times C \times H \times W) @f$
+ *      optionally, the probabilities @f$ \hat{p} @f$
+ *   -# @f$ (N) @f$
+ *      with LossParameter.per_sample_loss, the loss of each sample, summed
+ *      over its labels that are not ignored, before normalization
  */
 template <typename Dtype>
 class SoftmaxWithLossLayer : public LossLayer<Dtype> {
@@ -50,6 +55,8 @@ class SoftmaxWithLossLayer : public LossLayer<Dtype> {
     *  - normalize (optional, default true)
     *    If true, the loss is normalized by the number of (nonignored) labels
     *    present; otherwise the loss is simply summed over spatial locations.
+    *  - per_sample_loss (optional, default false)
+    *    If true, the last top receives the loss of each sample.
     */
   explicit SoftmaxWithLossLayer(const LayerParameter& param)
       : LossLayer<Dtype>(param) {}
@@ -61,7 +68,7 @@ class SoftmaxWithLossLayer : public LossLayer<Dtype> {
   virtual inline const char* type() const { return "SoftmaxWithLoss"; }
   virtual inline int ExactNumTopBlobs() const { return -1; }
   virtual inline int MinTopBlobs() const { return 1; }
-  virtual inline int MaxTopBlobs() const { return 2; }
+  virtual inline int MaxTopBlobs() const { return 3; }
 
  protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
@@ -107,10 +114,14 @@ class SoftmaxWithLossLayer : public LossLayer<Dtype> {
   virtual Dtype get_normalizer(
       LossParameter_NormalizationMode normalization_mode, int valid_count);
 
-  /// The internal SoftmaxLayer used to map predictions to a distribution.
+  /// The internal SoftmaxLayer used by the GPU path to map predictions to a
+  /// distribution.
   shared_ptr<Layer<Dtype> > softmax_layer_;
   /// prob stores the output probability predictions from the SoftmaxLayer.
   Blob<Dtype> prob_;
+  /// log_norm stores log(sum_c exp(x_c)) of each position from the CPU
+  /// forward pass, from which Backward recomputes the probabilities.
+  Blob<Dtype> log_norm_;
   /// bottom vector holder used in call to the underlying SoftmaxLayer::Forward
   vector<Blob<Dtype>*> softmax_bottom_vec_;
   /// top vector holder used in call to the underlying SoftmaxLayer::Forward
@@ -121,6 +132,12 @@ class SoftmaxWithLossLayer : public LossLayer<Dtype> {
   int ignore_label_;
   /// How to normalize the output loss.
   LossParameter_NormalizationMode normalization_;
+  /// The runs of positions that are not ignored (see
+  /// LossLayer::FindLabelRuns), the loss of each from the CPU forward pass,
+  /// and the number of positions in them.
+  vector<int> valid_runs_;
+  vector<Dtype> run_loss_;
+  int valid_count_;
 
   int softmax_axis_, outer_num_, inner_num_;
 };
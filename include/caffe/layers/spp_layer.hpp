@@ -34,6 +34,12 @@ class SPPLayer : public Layer<Dtype> {
       const vector<Blob<Dtype>*>& top);
   virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+  /// @brief Pools every level of each input channel straight into its bins
+  ///        of the output, and the reverse.
+  void FusedForward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  void FusedBackward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<Blob<Dtype>*>& bottom);
   // calculates the kernel and stride dimensions for the pooling layer,
   // returns a correctly configured LayerParameter for a PoolingLayer
   virtual LayerParameter GetPoolingParam(const int pyramid_level,
@@ -47,6 +53,18 @@ class SPPLayer : public Layer<Dtype> {
   int pad_h_, pad_w_;
   bool reshaped_first_time_;
 
+  /// whether the fused engine replaces the internal layers
+  bool fused_;
+  /// @brief The pooling windows of a pyramid level (fused engine).
+  struct Level {
+    int kernel_h, kernel_w, pad_h, pad_w, pooled_h, pooled_w;
+    /// where the bins of the level begin in the output of an image
+    int offset;
+  };
+  vector<Level> levels_;
+  /// the argmax of every bin of MAX pooling (fused engine)
+  Blob<int> max_idx_;
+
   /// the internal Split layer that feeds the pooling layers
   shared_ptr<SplitLayer<Dtype> > split_layer_;
   /// top vector holder used in call to the underlying SplitLayer::Forward
@@ -8,7 +8,6 @@
 #include "caffe/proto/caffe.pb.h"
 
 #include "caffe/layers/neuron_layer.hpp"
-#include "caffe/layers/sigmoid_layer.hpp"
 
 namespace caffe {
 
@@ -18,6 +17,11 @@ namespace caffe {
  *
  * [1] Prajit Ramachandran, Barret Zoph, Quoc V. Le. "Searching for
  *     Activation Functions". arXiv preprint arXiv:1710.05941v2 (2017).
+ *
+ * Forward is a single fused pass. The @f$ \sigma (\beta x) @f$ the gradient
+ * needs is kept from Forward only in the TRAIN phase or when the layer runs in
+ * place; otherwise Backward recomputes it from the inputs, so at inference the
+ * layer needs no memory besides its top.
  */
 template <typename Dtype>
 class SwishLayer : public NeuronLayer<Dtype> {
@@ -29,12 +33,7 @@ class SwishLayer : public NeuronLayer<Dtype> {
    *     the value @f$ \beta @f$ in the @f$ y = x \sigma (\beta x) @f$.
    */
   explicit SwishLayer(const LayerParameter& param)
-      : NeuronLayer<Dtype>(param),
-        sigmoid_layer_(new SigmoidLayer<Dtype>(param)),
-        sigmoid_input_(new Blob<Dtype>()),
-        sigmoid_output_(new Blob<Dtype>()) {}
-  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
-      const vector<Blob<Dtype>*>& top);
+      : NeuronLayer<Dtype>(param), keep_sigmoid_output_(false) {}
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
 
@@ -79,16 +78,10 @@ class SwishLayer : public NeuronLayer<Dtype> {
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
 
-  /// The internal SigmoidLayer
-  shared_ptr<SigmoidLayer<Dtype> > sigmoid_layer_;
-  /// sigmoid_input_ stores the input of the SigmoidLayer.
-  shared_ptr<Blob<Dtype> > sigmoid_input_;
-  /// sigmoid_output_ stores the output of the SigmoidLayer.
-  shared_ptr<Blob<Dtype> > sigmoid_output_;
-  /// bottom vector holder to call the underlying SigmoidLayer::Forward
-  vector<Blob<Dtype>*> sigmoid_bottom_vec_;
-  /// top vector holder to call the underlying SigmoidLayer::Forward
-  vector<Blob<Dtype>*> sigmoid_top_vec_;
+  /// Whether Forward stores @f$ \sigma (\beta x) @f$ in sigmoid_output_.
+  bool keep_sigmoid_output_;
+  /// sigmoid_output_ stores @f$ \sigma (\beta x) @f$ for Backward.
+  Blob<Dtype> sigmoid_output_;
 };
 
 }  // namespace caffe
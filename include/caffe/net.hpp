@@ -11,6 +11,7 @@
 #include "caffe/common.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/rng.hpp"
 
 namespace caffe {
 
@@ -177,6 +178,15 @@ class Net {
   inline const vector<Blob<Dtype>*>& learnable_params() const {
     return learnable_params_;
   }
+  /**
+   * @brief returns the rows (along the first axis) of learnable_params()[i]
+   *        whose diff may be nonzero, or NULL if the diff is dense.
+   *
+   * Only unshared params of layers that list their diff rows (see
+   * Layer::param_diff_rows) have a row-sparse diff. ClearParamDiffs and
+   * Update then touch only those rows.
+   */
+  const vector<int>* learnable_param_diff_rows(const int param_id) const;
   /// @brief returns the learnable parameter learning rate multipliers
   inline const vector<float>& params_lr() const { return params_lr_; }
   inline const vector<bool>& has_params_lr() const { return has_params_lr_; }
@@ -265,6 +275,13 @@ class Net {
   /// @brief Append a new parameter blob to the net.
   void AppendParam(const NetParameter& param, const int layer_id,
                    const int param_id);
+  /// @brief Split the layers into the segments of gradient checkpointing.
+  void InitCheckpointing(const NetParameter& param);
+
+  /// @brief Free the data of the blobs used only inside segment seg.
+  void FreeSegment(const int seg);
+  /// @brief Run the forward pass of segment seg again to restore its blobs.
+  void RecomputeSegment(const int seg);
 
   /// @brief Helper for displaying debug info in Forward.
   void ForwardDebugInfo(const int layer_id);
@@ -320,6 +337,9 @@ class Net {
    * and learnable_params_[learnable_param_ids_[i]] gives its owner.
    */
   vector<int> learnable_param_ids_;
+  /// the (layer id, param id) owning each of learnable_params_, or (-1, -1)
+  /// if it is shared
+  vector<pair<int, int> > learnable_param_layer_indices_;
   /// the learning rate multipliers for learnable_params_
   vector<float> params_lr_;
   vector<bool> has_params_lr_;
@@ -330,6 +350,17 @@ class Net {
   size_t memory_used_;
   /// Whether to compute and display debug info for the net.
   bool debug_info_;
+  /// Gradient checkpointing (see NetParameter.gradient_checkpointing): the
+  /// segment of each layer, the first and last layer of each segment, the
+  /// blobs used only inside each segment, whether those are freed, and the
+  /// state of the random number generator when each layer was last run.
+  /// All empty if checkpointing is off.
+  vector<int> layer_segment_;
+  vector<int> segment_start_;
+  vector<int> segment_end_;
+  vector<vector<int> > segment_blob_ids_;
+  vector<bool> segment_freed_;
+  vector<rng_t> layer_rng_;
   // Callbacks
   vector<Callback*> before_forward_;
   vector<Callback*> after_forward_;
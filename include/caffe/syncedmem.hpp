@@ -68,6 +68,14 @@ class SyncedMemory {
   enum SyncedHead { UNINITIALIZED, HEAD_AT_CPU, HEAD_AT_GPU, SYNCED };
   SyncedHead head() const { return head_; }
   size_t size() const { return size_; }
+  // Incremented whenever the contents may have been written, i.e. on every
+  // mutable_*_data() and set_*_data() call, so that caches derived from the
+  // data can tell they are stale.
+  int version() const { return version_; }
+  // Free the memory and go back to UNINITIALIZED, so that it is allocated
+  // (and zeroed) again on the next access. Memory given with set_*_data is
+  // not ours to free and is left alone.
+  void Release();
 
 #ifndef CPU_ONLY
   void async_gpu_push(const cudaStream_t& stream);
@@ -86,6 +94,7 @@ class SyncedMemory {
   bool cpu_malloc_use_cuda_;
   bool own_gpu_data_;
   int device_;
+  int version_;
 
   DISABLE_COPY_AND_ASSIGN(SyncedMemory);
 };  // class SyncedMemory
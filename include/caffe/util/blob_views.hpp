@@ -0,0 +1,17 @@
+#ifndef _CAFFE_UTIL_BLOB_VIEWS_HPP_
+#define _CAFFE_UTIL_BLOB_VIEWS_HPP_
+
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+// Copy NetParameters with share_bottoms set for the Concat layers, and
+// share_tops or share_top set for the Slice and Crop layers, whose blobs can
+// be views of each other (see Blob::ShareView) instead of copies: no layer may
+// depend on those blobs having their own memory, e.g. by writing them in
+// place. Expects the splits to be inserted already.
+void PlanBlobViews(const NetParameter& param, NetParameter* param_planned);
+
+}  // namespace caffe
+
+#endif  // _CAFFE_UTIL_BLOB_VIEWS_HPP_
@@ -0,0 +1,40 @@
+#ifndef CAFFE_UTIL_ENGINE_TUNER_HPP_
+#define CAFFE_UTIL_ENGINE_TUNER_HPP_
+
+#include <string>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A persistent record of the fastest CPU engine for each layer
+ *        geometry, for layers with more than one CPU implementation.
+ *
+ * Tuning is off until Open() is given a database file. A layer then looks up
+ * its geometry at Reshape. On a miss it times its candidate engines on the
+ * actual shapes, keeps the fastest and Record()s it. Entries are keyed by the
+ * machine as well: the CPU model and the number of threads. Each entry is
+ * appended to the file when it is recorded, so a later start on the same
+ * machine reuses it without timing anything. The file is plain text with one
+ * "machine<TAB>geometry<TAB>engine" entry per line. When a key appears more
+ * than once the last entry wins, so deleting the file re-tunes everything.
+ */
+class EngineTuner {
+ public:
+  /// @brief Enables tuning with the database at path and loads its entries
+  ///        if the file exists. An empty path disables tuning.
+  static void Open(const string& path);
+  static bool enabled();
+  /// @brief The engine recorded for key on this machine, or "" if none.
+  static string Lookup(const string& key);
+  /// @brief Records engine as the fastest for key on this machine, and
+  ///        appends the entry to the database file.
+  static void Record(const string& key, const string& engine);
+  /// @brief Describes this machine: the CPU model and the thread count.
+  static string machine();
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_ENGINE_TUNER_HPP_
@@ -0,0 +1,17 @@
+#ifndef _CAFFE_UTIL_FUSE_LAYERS_HPP_
+#define _CAFFE_UTIL_FUSE_LAYERS_HPP_
+
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+// Copy NetParameters with every in-place ReLU or Sigmoid layer that directly
+// follows an InnerProduct layer, and every in-place ReLU layer that directly
+// follows an Eltwise layer, folded into that layer, so that the activation
+// runs on the freshly computed output. Used for TEST phase nets with
+// NetParameter.fuse_layers set.
+void FuseLayers(const NetParameter& param, NetParameter* param_fused);
+
+}  // namespace caffe
+
+#endif  // _CAFFE_UTIL_FUSE_LAYERS_HPP_
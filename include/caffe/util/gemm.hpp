@@ -0,0 +1,115 @@
+#ifndef CAFFE_UTIL_GEMM_HPP_
+#define CAFFE_UTIL_GEMM_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/util/mkl_alternate.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A constant GEMM operand prepared once for repeated products.
+ *
+ * With the Caffe::BLOCKED GEMM backend the matrix is copied into the panel
+ * layout consumed by the built-in micro-kernel, so later products skip the
+ * packing step entirely. With the Caffe::BLAS backend the BLAS library packs
+ * internally on every call, and the operand just remembers where the source
+ * matrix lives.
+ *
+ * When packed from a Blob the operand also records the version of the
+ * Blob's data, so IsPackedFrom() turns false as soon as the weights are
+ * written again (e.g. by Blob::Update or when loading a model).
+ */
+template <typename Dtype>
+class PackedGemmMatrix {
+ public:
+  PackedGemmMatrix();
+
+  /// @brief Prepares op(A), the M x K left-hand operand of a product.
+  void PackA(const CBLAS_TRANSPOSE TransA, const int M, const int K,
+      const Dtype* A);
+  void PackA(const CBLAS_TRANSPOSE TransA, const int M, const int K,
+      const Blob<Dtype>& A, const int offset = 0);
+  /// @brief Prepares op(B), the K x N right-hand operand of a product.
+  void PackB(const CBLAS_TRANSPOSE TransB, const int K, const int N,
+      const Dtype* B);
+  void PackB(const CBLAS_TRANSPOSE TransB, const int K, const int N,
+      const Blob<Dtype>& B, const int offset = 0);
+  /// @brief Drops the packed data; the operand must be packed again.
+  void Clear();
+
+  /// @brief Whether the operand holds the current contents of blob.
+  bool IsPackedFrom(const Blob<Dtype>& blob) const;
+
+  inline bool empty() const { return rows_ == 0; }
+  inline bool is_a() const { return is_a_; }
+  inline int rows() const { return rows_; }
+  inline int cols() const { return cols_; }
+  /// @brief Whether the operand is in the built-in panel layout.
+  inline bool blocked() const { return !packed_.empty(); }
+  inline const Dtype* packed_data() const { return &packed_[0]; }
+  inline CBLAS_TRANSPOSE trans() const { return trans_; }
+  inline const Dtype* source() const { return source_; }
+
+ protected:
+  void Pack(const bool is_a, const CBLAS_TRANSPOSE trans, const int rows,
+      const int cols, const Dtype* data);
+
+  bool is_a_;
+  int rows_;
+  int cols_;
+  CBLAS_TRANSPOSE trans_;
+  const Dtype* source_;
+  vector<Dtype> packed_;
+  const SyncedMemory* source_memory_;
+  int source_offset_;
+  int source_version_;
+
+  DISABLE_COPY_AND_ASSIGN(PackedGemmMatrix);
+};
+
+/**
+ * @brief Sets the backend of caffe_cpu_gemm (for the calling thread) for the
+ *        lifetime of the scope, so that a layer can use its own.
+ */
+class GemmBackendScope {
+ public:
+  explicit GemmBackendScope(const Caffe::GemmBackend backend)
+      : saved_(Caffe::gemm_backend()) {
+    Caffe::set_gemm_backend(backend);
+  }
+  ~GemmBackendScope() { Caffe::set_gemm_backend(saved_); }
+
+ private:
+  const Caffe::GemmBackend saved_;
+
+  DISABLE_COPY_AND_ASSIGN(GemmBackendScope);
+};
+
+/**
+ * @brief The built-in cache-blocked GEMM, C = alpha * op(A) op(B) + beta * C,
+ *        used by caffe_cpu_gemm when the backend is Caffe::BLOCKED.
+ */
+template <typename Dtype>
+void caffe_cpu_blocked_gemm(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const Dtype alpha, const Dtype* A, const Dtype* B, const Dtype beta,
+    Dtype* C);
+
+/// @brief caffe_cpu_gemm with a prepacked left-hand operand op(A).
+template <typename Dtype>
+void caffe_cpu_gemm_packed_a(const PackedGemmMatrix<Dtype>& A,
+    const CBLAS_TRANSPOSE TransB, const int N, const Dtype alpha,
+    const Dtype* B, const Dtype beta, Dtype* C);
+
+/// @brief caffe_cpu_gemm with a prepacked right-hand operand op(B).
+template <typename Dtype>
+void caffe_cpu_gemm_packed_b(const CBLAS_TRANSPOSE TransA, const int M,
+    const Dtype alpha, const Dtype* A, const PackedGemmMatrix<Dtype>& B,
+    const Dtype beta, Dtype* C);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_GEMM_HPP_
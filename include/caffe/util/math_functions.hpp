@@ -145,6 +145,14 @@ DEFINE_CAFFE_CPU_UNARY_FUNC(fabs, y[i] = std::fabs(x[i]))
 template <typename Dtype>
 void caffe_cpu_scale(const int n, const Dtype alpha, const Dtype *x, Dtype* y);
 
+// Adds the n values of x to running statistics over *count values: their
+// *mean and *m2, the sum of squared deviations from the mean. x is read once,
+// in chunks whose statistics are merged with the pairwise update of Chan et
+// al., which is as stable as Welford's algorithm but vectorizes.
+template <typename Dtype>
+void caffe_cpu_mean_m2(const int n, const Dtype* x, int* count, Dtype* mean,
+    Dtype* m2);
+
 #ifndef CPU_ONLY  // GPU
 
 // Decaf gpu gemm provides an interface that is almost the same as the cpu
@@ -0,0 +1,84 @@
+#ifndef CAFFE_UTIL_QUANTIZE_HPP_
+#define CAFFE_UTIL_QUANTIZE_HPP_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+// Quantizes x to uint8: q = clamp(round(x / scale) + zero_point, 0, 255).
+template <typename Dtype>
+void caffe_cpu_quantize_u8(const int n, const Dtype* x, const float scale,
+    const int zero_point, uint8_t* q);
+
+// Chooses the uint8 scale and zero point covering [min_value, max_value].
+// The range is widened to contain 0 so that zero (e.g. convolution padding)
+// is represented exactly.
+void caffe_choose_u8_quantization(float min_value, float max_value,
+    float* scale, int* zero_point);
+
+// Per-row int8 scales max_j |W(i, j)| / 127 of op(W), where op(W) is the
+// rows x cols matrix W or, when transpose is set, the transpose of the
+// cols x rows matrix W.
+template <typename Dtype>
+void caffe_cpu_int8_row_scales(const int rows, const int cols,
+    const Dtype* W, const bool transpose, float* scales);
+
+// The largest K for which the int32 accumulators of caffe_cpu_gemm_s8u8s32
+// cannot overflow: 127 * 255 * K <= 2^31 - 1.
+const int kInt8GemmMaxK = 2147483647 / (127 * 255);
+
+// C = A * B for row-major int8 A (M x K), uint8 B (K x N) and int32 C
+// (M x N). K must not exceed kInt8GemmMaxK.
+void caffe_cpu_gemm_s8u8s32(const int M, const int N, const int K,
+    const int8_t* A, const uint8_t* B, int32_t* C);
+
+/**
+ * @brief A weight matrix quantized to int8 with one scale per row (output
+ *        channel), used by the int8 inference path of ConvolutionLayer and
+ *        InnerProductLayer.
+ *
+ * Along with the int8 values it keeps the row sums needed to correct for the
+ * zero point of uint8 inputs:
+ * sum_j W(i, j) x_j ~= input_scale * scales[i] *
+ *     (sum_j Wq(i, j) xq_j - zero_point * row_sums[i]).
+ * Like PackedGemmMatrix, it records the version of the weight blob it was
+ * made from so that it can be refreshed after the weights change.
+ */
+template <typename Dtype>
+class Int8WeightMatrix {
+ public:
+  Int8WeightMatrix();
+
+  // Quantizes op(W) (rows x cols) from weights; see caffe_cpu_int8_row_scales
+  // for transpose. The scales are computed from the weights if none are
+  // given.
+  void Quantize(const Blob<Dtype>& weights, const bool transpose,
+      const int rows, const int cols, const vector<float>& scales);
+  bool IsQuantizedFrom(const Blob<Dtype>& weights) const;
+
+  inline int rows() const { return rows_; }
+  inline int cols() const { return cols_; }
+  inline const int8_t* data() const { return &data_[0]; }
+  inline const int32_t* row_sums() const { return &row_sums_[0]; }
+  inline const float* scales() const { return &scales_[0]; }
+
+ protected:
+  int rows_;
+  int cols_;
+  vector<int8_t> data_;
+  vector<int32_t> row_sums_;
+  vector<float> scales_;
+  const SyncedMemory* source_memory_;
+  int source_version_;
+
+  DISABLE_COPY_AND_ASSIGN(Int8WeightMatrix);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_QUANTIZE_HPP_
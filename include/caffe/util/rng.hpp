@@ -1,6 +1,8 @@
 #ifndef CAFFE_RNG_CPP_HPP_
 #define CAFFE_RNG_CPP_HPP_
 
+#include <stdint.h>
+
 #include <algorithm>
 #include <iterator>
 
@@ -38,6 +40,85 @@ template <class RandomAccessIterator>
 inline void shuffle(RandomAccessIterator begin, RandomAccessIterator end) {
   shuffle(begin, end, caffe_rng());
 }
+
+// A 64-bit seed drawn from the Caffe RNG, so that Caffe::set_random_seed makes
+// the counter-based streams seeded with it reproducible too.
+inline uint64_t caffe_rng_seed() {
+  const uint64_t hi = (*caffe_rng())();
+  return (hi << 32) | static_cast<uint32_t>((*caffe_rng())());
+}
+
+/**
+ * @brief A counter-based random number stream: the Philox4x32-10 generator of
+ *        [Salmon et al., "Parallel random numbers: as easy as 1, 2, 3", SC11].
+ *
+ * Number i of the stream is a pure function of (seed, stream, i) -- the 128-bit
+ * counter (i / 4, stream) encrypted with the seed -- rather than of the numbers
+ * drawn before it. So any range of the stream can be generated on its own:
+ * the fills below split it among OpenMP threads, with the same result for any
+ * number of them. Callers typically take the seed from caffe_rng_seed() once
+ * per fill or forward pass, use the stream to tell apart what they draw for,
+ * and index the numbers by element.
+ */
+class PhiloxStream {
+ public:
+  PhiloxStream(const uint64_t seed, const uint64_t stream) {
+    key_[0] = static_cast<uint32_t>(seed);
+    key_[1] = static_cast<uint32_t>(seed >> 32);
+    stream_[0] = static_cast<uint32_t>(stream);
+    stream_[1] = static_cast<uint32_t>(stream >> 32);
+  }
+
+  /// @brief The 4 32-bit numbers 4 * block, ..., 4 * block + 3.
+  inline void Block(const uint64_t block, uint32_t r[4]) const {
+    uint32_t counter[4] = {static_cast<uint32_t>(block),
+        static_cast<uint32_t>(block >> 32), stream_[0], stream_[1]};
+    Philox(counter, key_, r);
+  }
+  /// @brief Philox4x32-10 itself: encrypts counter with key.
+  static inline void Philox(const uint32_t counter[4], const uint32_t key[2],
+      uint32_t r[4]) {
+    uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2],
+        c3 = counter[3], k0 = key[0], k1 = key[1];
+    for (int round = 0; round < 10; ++round) {
+      if (round > 0) {
+        k0 += 0x9E3779B9;
+        k1 += 0xBB67AE85;
+      }
+      const uint64_t p0 = static_cast<uint64_t>(0xD2511F53) * c0;
+      const uint64_t p1 = static_cast<uint64_t>(0xCD9E8D57) * c2;
+      c0 = static_cast<uint32_t>(p1 >> 32) ^ c1 ^ k0;
+      c1 = static_cast<uint32_t>(p1);
+      c2 = static_cast<uint32_t>(p0 >> 32) ^ c3 ^ k1;
+      c3 = static_cast<uint32_t>(p0);
+    }
+    r[0] = c0;
+    r[1] = c1;
+    r[2] = c2;
+    r[3] = c3;
+  }
+
+  // The fills set r[i] from number offset + i of the stream, for i < n.
+  /// @brief Uniform 32-bit integers.
+  void Bits(const int n, const uint64_t offset, uint32_t* r) const;
+  /// @brief Uniform values in [a, b).
+  template <typename Dtype>
+  void Uniform(const int n, const uint64_t offset, const Dtype a,
+      const Dtype b, Dtype* r) const;
+  /// @brief Gaussian values with mean mu and standard deviation sigma, each
+  ///        from the 32-bit numbers 2 * (offset + i) and 2 * (offset + i) + 1.
+  template <typename Dtype>
+  void Gaussian(const int n, const uint64_t offset, const Dtype mu,
+      const Dtype sigma, Dtype* r) const;
+  /// @brief 1 with probability p, 0 otherwise.
+  template <typename Dtype>
+  void Bernoulli(const int n, const uint64_t offset, const Dtype p,
+      int* r) const;
+
+ private:
+  uint32_t key_[2];
+  uint32_t stream_[2];
+};
 }  // namespace caffe
 
 #endif  // CAFFE_RNG_HPP_
@@ -0,0 +1,77 @@
+#ifndef CAFFE_UTIL_SPARSE_HPP_
+#define CAFFE_UTIL_SPARSE_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A weight matrix of a pruned model stored in compressed sparse row
+ *        (CSR) format, used by the TEST phase forward passes of
+ *        InnerProductLayer and ConvolutionLayer.
+ *
+ * The matrix is converted from a dense Blob only when the fraction of zero
+ * weights reaches a threshold; below it the conversion is declined, no copy
+ * is kept and is_sparse() is false, so that the dense GEMM is used instead.
+ * Either way the version of the source blob is recorded, as in
+ * PackedGemmMatrix, so the decision is made once per set of weights (in
+ * practice once, after the weights are loaded).
+ */
+template <typename Dtype>
+class SparseWeightMatrix {
+ public:
+  SparseWeightMatrix();
+
+  // Converts op(W), the rows x cols matrix starting at offset in weights (or
+  // its transpose when transpose is set, for a cols x rows W), if at least
+  // min_sparsity of its entries are zero.
+  void Convert(const Blob<Dtype>& weights, const bool transpose,
+      const int rows, const int cols, const float min_sparsity,
+      const int offset = 0);
+  bool IsConvertedFrom(const Blob<Dtype>& weights) const;
+  void Clear();
+
+  inline bool is_sparse() const { return is_sparse_; }
+  inline int rows() const { return rows_; }
+  inline int cols() const { return cols_; }
+  inline int nnz() const { return values_.size(); }
+  inline const int* row_ptr() const { return &row_ptr_[0]; }
+  inline const int* col_idx() const { return &col_idx_[0]; }
+  inline const Dtype* values() const { return &values_[0]; }
+
+ protected:
+  bool is_sparse_;
+  int rows_;
+  int cols_;
+  vector<int> row_ptr_;
+  vector<int> col_idx_;
+  vector<Dtype> values_;
+  const SyncedMemory* source_memory_;
+  int source_offset_;
+  int source_version_;
+
+  DISABLE_COPY_AND_ASSIGN(SparseWeightMatrix);
+};
+
+// Returns the fraction of the n entries of x that are zero.
+template <typename Dtype>
+float caffe_cpu_sparsity(const int n, const Dtype* x);
+
+// C = A(row_begin:row_end, :) * B for sparse A (M x K), row-major B (K x N)
+// and C ((row_end - row_begin) x N); the row range selects one group of a
+// grouped convolution.
+template <typename Dtype>
+void caffe_cpu_csrmm(const SparseWeightMatrix<Dtype>& A, const int row_begin,
+    const int row_end, const int N, const Dtype* B, Dtype* C);
+
+// C = A * B^T for row-major A (M x K), sparse B (N x K) and C (M x N).
+template <typename Dtype>
+void caffe_cpu_gemm_csr_t(const int M, const Dtype* A,
+    const SparseWeightMatrix<Dtype>& B, Dtype* C);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_SPARSE_HPP_
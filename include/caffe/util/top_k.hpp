@@ -0,0 +1,22 @@
+#ifndef CAFFE_UTIL_TOP_K_HPP_
+#define CAFFE_UTIL_TOP_K_HPP_
+
+namespace caffe {
+
+// Selects the k largest of the n values x[0], x[stride], ...,
+// x[(n - 1) * stride] and writes their indices in [0, n) to indices and, if
+// values is not NULL, the values themselves, both in descending order. Equal
+// values are ordered by descending index, which is the order that sorting
+// (value, index) pairs with std::greater gives.
+//
+// The values are scanned once, keeping the k best so far in a min-heap:
+// blocks of values that are all below the smallest of them are skipped with
+// a vectorized compare, so after the first few blocks almost every value
+// costs a single comparison, rather than the O(n log k) of std::partial_sort.
+template <typename Dtype>
+void caffe_cpu_top_k(const int n, const Dtype* x, const int stride,
+    const int k, int* indices, Dtype* values);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_TOP_K_HPP_
@@ -0,0 +1,69 @@
+#ifndef CAFFE_UTIL_VECTOR_MATH_HPP_
+#define CAFFE_UTIL_VECTOR_MATH_HPP_
+
+namespace caffe {
+
+// Vectorized elementwise transcendental functions for the CPU: y[i] = f(x[i])
+// for i < n, where x and y may be the same array.
+//
+// The kernels evaluate polynomial (or rational) approximations with Cody-Waite
+// range reduction as branch-free loops that the compiler vectorizes; with GCC
+// on x86-64 Linux they are also built for AVX2 + FMA and AVX-512 and the best
+// version for the CPU is selected at load time. Inputs outside the range of
+// the approximation (overflow, denormal results, NaN, ...) fall back to the
+// C library, so the special values match it. The error is at most 2 ulp for
+// exp, log and powx, 3 ulp for tanh and sigmoid and 4 ulp for softplus (see
+// test_vector_math.cpp), except where the function itself cancels: elu is
+// evaluated as alpha * (exp(x) - 1), as ELULayer always has.
+
+template <typename Dtype>
+void caffe_cpu_vexp(const int n, const Dtype* x, Dtype* y);
+
+// y[i] = exp(x[i] - shift), returning the sum of the y[i]. If y is NULL only
+// the sum is computed; x and y may be the same.
+template <typename Dtype>
+Dtype caffe_cpu_vexp_sum(const int n, const Dtype* x, const Dtype shift,
+    Dtype* y);
+
+template <typename Dtype>
+void caffe_cpu_vlog(const int n, const Dtype* x, Dtype* y);
+
+// y[i] = pow(x[i], b). The double version evaluates pow with the C library
+// for b other than 0, 0.5, 1, 2 and -1, as a vectorized pow that is accurate
+// to a few ulp needs more than double precision internally.
+template <typename Dtype>
+void caffe_cpu_vpowx(const int n, const Dtype* x, const Dtype b, Dtype* y);
+
+template <typename Dtype>
+void caffe_cpu_vtanh(const int n, const Dtype* x, Dtype* y);
+
+// y[i] = 1 / (1 + exp(-x[i]))
+template <typename Dtype>
+void caffe_cpu_vsigmoid(const int n, const Dtype* x, Dtype* y);
+
+// y[i] = x[i] * sigmoid(beta * x[i]). If sigmoid is not NULL it also
+// receives sigmoid(beta * x[i]), which the gradient needs; x and y may be the
+// same, but not sigmoid.
+template <typename Dtype>
+void caffe_cpu_vswish(const int n, const Dtype* x, const Dtype beta, Dtype* y,
+    Dtype* sigmoid);
+
+// y[i] = log(1 + exp(x[i])), computed without overflow or cancellation.
+template <typename Dtype>
+void caffe_cpu_vsoftplus(const int n, const Dtype* x, Dtype* y);
+
+// y[i] = x[i] > 0 ? x[i] : alpha * (exp(x[i]) - 1)
+template <typename Dtype>
+void caffe_cpu_velu(const int n, const Dtype* x, const Dtype alpha,
+    Dtype* y);
+
+// y[i] = log(sum_c exp(x[c * stride + i])) for i < n: the log of the softmax
+// normalizer of n positions with channels values each, stride apart. A stride
+// of 1 means a single position (n is 1) with contiguous channels.
+template <typename Dtype>
+void caffe_cpu_log_sum_exp(const int channels, const int n, const int stride,
+    const Dtype* x, Dtype* y);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_VECTOR_MATH_HPP_
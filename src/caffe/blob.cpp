@@ -41,6 +41,8 @@ void Blob<Dtype>::Reshape(const vector<int>& shape) {
     capacity_ = count_;
     data_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
     diff_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
+    data_offset_ = 0;
+    diff_offset_ = 0;
   }
 }
 
@@ -63,14 +65,14 @@ template <typename Dtype>
 Blob<Dtype>::Blob(const int num, const int channels, const int height,
     const int width)
   // capacity_ must be initialized before calling Reshape
-  : capacity_(0) {
+  : count_(0), capacity_(0), data_offset_(0), diff_offset_(0) {
   Reshape(num, channels, height, width);
 }
 
 template <typename Dtype>
 Blob<Dtype>::Blob(const vector<int>& shape)
   // capacity_ must be initialized before calling Reshape
-  : capacity_(0) {
+  : count_(0), capacity_(0), data_offset_(0), diff_offset_(0) {
   Reshape(shape);
 }
 
@@ -83,7 +85,7 @@ const int* Blob<Dtype>::gpu_shape() const {
 template <typename Dtype>
 const Dtype* Blob<Dtype>::cpu_data() const {
   CHECK(data_);
-  return (const Dtype*)data_->cpu_data();
+  return (const Dtype*)data_->cpu_data() + data_offset_;
 }
 
 template <typename Dtype>
@@ -91,9 +93,11 @@ void Blob<Dtype>::set_cpu_data(Dtype* data) {
   CHECK(data);
   // Make sure CPU and GPU sizes remain equal
   size_t size = count_ * sizeof(Dtype);
-  if (data_->size() != size) {
+  if (data_->size() != size || data_offset_ != 0) {
     data_.reset(new SyncedMemory(size));
     diff_.reset(new SyncedMemory(size));
+    data_offset_ = 0;
+    diff_offset_ = 0;
   }
   data_->set_cpu_data(data);
 }
@@ -101,7 +105,7 @@ void Blob<Dtype>::set_cpu_data(Dtype* data) {
 template <typename Dtype>
 const Dtype* Blob<Dtype>::gpu_data() const {
   CHECK(data_);
-  return (const Dtype*)data_->gpu_data();
+  return (const Dtype*)data_->gpu_data() + data_offset_;
 }
 
 template <typename Dtype>
@@ -109,9 +113,11 @@ void Blob<Dtype>::set_gpu_data(Dtype* data) {
   CHECK(data);
   // Make sure CPU and GPU sizes remain equal
   size_t size = count_ * sizeof(Dtype);
-  if (data_->size() != size) {
+  if (data_->size() != size || data_offset_ != 0) {
     data_.reset(new SyncedMemory(size));
     diff_.reset(new SyncedMemory(size));
+    data_offset_ = 0;
+    diff_offset_ = 0;
   }
   data_->set_gpu_data(data);
 }
@@ -119,49 +125,84 @@ void Blob<Dtype>::set_gpu_data(Dtype* data) {
 template <typename Dtype>
 const Dtype* Blob<Dtype>::cpu_diff() const {
   CHECK(diff_);
-  return (const Dtype*)diff_->cpu_data();
+  return (const Dtype*)diff_->cpu_data() + diff_offset_;
 }
 
 template <typename Dtype>
 const Dtype* Blob<Dtype>::gpu_diff() const {
   CHECK(diff_);
-  return (const Dtype*)diff_->gpu_data();
+  return (const Dtype*)diff_->gpu_data() + diff_offset_;
 }
 
 template <typename Dtype>
 Dtype* Blob<Dtype>::mutable_cpu_data() {
   CHECK(data_);
-  return static_cast<Dtype*>(data_->mutable_cpu_data());
+  return static_cast<Dtype*>(data_->mutable_cpu_data()) + data_offset_;
 }
 
 template <typename Dtype>
 Dtype* Blob<Dtype>::mutable_gpu_data() {
   CHECK(data_);
-  return static_cast<Dtype*>(data_->mutable_gpu_data());
+  return static_cast<Dtype*>(data_->mutable_gpu_data()) + data_offset_;
 }
 
 template <typename Dtype>
 Dtype* Blob<Dtype>::mutable_cpu_diff() {
   CHECK(diff_);
-  return static_cast<Dtype*>(diff_->mutable_cpu_data());
+  return static_cast<Dtype*>(diff_->mutable_cpu_data()) + diff_offset_;
 }
 
 template <typename Dtype>
 Dtype* Blob<Dtype>::mutable_gpu_diff() {
   CHECK(diff_);
-  return static_cast<Dtype*>(diff_->mutable_gpu_data());
+  return static_cast<Dtype*>(diff_->mutable_gpu_data()) + diff_offset_;
 }
 
 template <typename Dtype>
 void Blob<Dtype>::ShareData(const Blob& other) {
   CHECK_EQ(count_, other.count());
   data_ = other.data();
+  data_offset_ = other.data_offset_;
 }
 
 template <typename Dtype>
 void Blob<Dtype>::ShareDiff(const Blob& other) {
   CHECK_EQ(count_, other.count());
   diff_ = other.diff();
+  diff_offset_ = other.diff_offset_;
+}
+
+template <typename Dtype>
+void Blob<Dtype>::ShareView(const Blob& other, const int offset) {
+  CHECK_GE(offset, 0);
+  CHECK_LE(offset + count_, other.count());
+  data_ = other.data();
+  diff_ = other.diff();
+  data_offset_ = other.data_offset_ + offset;
+  diff_offset_ = other.diff_offset_ + offset;
+  capacity_ = count_;
+}
+
+template <typename Dtype>
+bool Blob<Dtype>::IsViewOf(const Blob& other, const int offset) const {
+  return data_ && data_ == other.data_ && diff_ == other.diff_ &&
+      data_offset_ == other.data_offset_ + offset &&
+      diff_offset_ == other.diff_offset_ + offset;
+}
+
+template <typename Dtype>
+void Blob<Dtype>::ReleaseView() {
+  shared_ptr<SyncedMemory> data = data_;
+  const int data_offset = data_offset_;
+  capacity_ = count_;
+  data_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
+  diff_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
+  data_offset_ = 0;
+  diff_offset_ = 0;
+  if (data && data->head() != SyncedMemory::UNINITIALIZED) {
+    caffe_copy(count_, static_cast<const Dtype*>(data->cpu_data()) +
+        data_offset, mutable_cpu_data());
+  }
 }
 
 // The "update" method is used for parameter blobs in a Net, which are stored
@@ -176,17 +217,13 @@ void Blob<Dtype>::Update() {
   switch (data_->head()) {
   case SyncedMemory::HEAD_AT_CPU:
     // perform computation on CPU
-    caffe_axpy<Dtype>(count_, Dtype(-1),
-        static_cast<const Dtype*>(diff_->cpu_data()),
-        static_cast<Dtype*>(data_->mutable_cpu_data()));
+    caffe_axpy<Dtype>(count_, Dtype(-1), cpu_diff(), mutable_cpu_data());
     break;
   case SyncedMemory::HEAD_AT_GPU:
   case SyncedMemory::SYNCED:
 #ifndef CPU_ONLY
     // perform computation on GPU
-    caffe_gpu_axpy<Dtype>(count_, Dtype(-1),
-        static_cast<const Dtype*>(diff_->gpu_data()),
-        static_cast<Dtype*>(data_->mutable_gpu_data()));
+    caffe_gpu_axpy<Dtype>(count_, Dtype(-1), gpu_diff(), mutable_gpu_data());
 #else
     NO_GPU;
 #endif
@@ -441,20 +478,16 @@ void Blob<Dtype>::CopyFrom(const Blob& source, bool copy_diff, bool reshape) {
   switch (Caffe::mode()) {
   case Caffe::GPU:
     if (copy_diff) {
-      caffe_copy(count_, source.gpu_diff(),
-          static_cast<Dtype*>(diff_->mutable_gpu_data()));
+      caffe_copy(count_, source.gpu_diff(), mutable_gpu_diff());
     } else {
-      caffe_copy(count_, source.gpu_data(),
-          static_cast<Dtype*>(data_->mutable_gpu_data()));
+      caffe_copy(count_, source.gpu_data(), mutable_gpu_data());
     }
     break;
   case Caffe::CPU:
     if (copy_diff) {
-      caffe_copy(count_, source.cpu_diff(),
-          static_cast<Dtype*>(diff_->mutable_cpu_data()));
+      caffe_copy(count_, source.cpu_diff(), mutable_cpu_diff());
     } else {
-      caffe_copy(count_, source.cpu_data(),
-          static_cast<Dtype*>(data_->mutable_cpu_data()));
+      caffe_copy(count_, source.cpu_data(), mutable_cpu_data());
     }
     break;
   default:
@@ -15,7 +15,7 @@ namespace caffe {
 template<typename Dtype>
 DataTransformer<Dtype>::DataTransformer(const TransformationParameter& param,
     Phase phase)
-    : param_(param), phase_(phase) {
+    : param_(param), rand_offset_(0), phase_(phase) {
   // check if we want to use mean_file
   if (param_.has_mean_file()) {
     CHECK_EQ(param_.mean_value_size(), 0) <<
@@ -524,8 +524,8 @@ void DataTransformer<Dtype>::InitRand() {
   const bool needs_rand = param_.mirror() ||
       (phase_ == TRAIN && param_.crop_size());
   if (needs_rand) {
-    const unsigned int rng_seed = caffe_rng_rand();
-    rng_.reset(new Caffe::RNG(rng_seed));
+    rng_.reset(new PhiloxStream(caffe_rng_seed(), 0));
+    rand_offset_ = 0;
   } else {
     rng_.reset();
   }
@@ -535,9 +535,9 @@ template <typename Dtype>
 int DataTransformer<Dtype>::Rand(int n) {
   CHECK(rng_);
   CHECK_GT(n, 0);
-  caffe::rng_t* rng =
-      static_cast<caffe::rng_t*>(rng_->generator());
-  return ((*rng)() % n);
+  uint32_t r;
+  rng_->Bits(1, rand_offset_++, &r);
+  return (r % n);
 }
 
 INSTANTIATE_CLASS(DataTransformer);
@@ -1,5 +1,3 @@
-#include <functional>
-#include <utility>
 #include <vector>
 
 #include "caffe/layers/accuracy_layer.hpp"
@@ -52,11 +50,22 @@ void AccuracyLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* bottom_label = bottom[1]->cpu_data();
   const int dim = bottom[0]->count() / outer_num_;
   const int num_labels = bottom[0]->shape(label_axis_);
+  Dtype* nums_data = NULL;
+  Dtype* accuracy_per_class = NULL;
   if (top.size() > 1) {
-    caffe_set(nums_buffer_.count(), Dtype(0), nums_buffer_.mutable_cpu_data());
-    caffe_set(top[1]->count(), Dtype(0), top[1]->mutable_cpu_data());
+    nums_data = nums_buffer_.mutable_cpu_data();
+    accuracy_per_class = top[1]->mutable_cpu_data();
+    caffe_set(nums_buffer_.count(), Dtype(0), nums_data);
+    caffe_set(top[1]->count(), Dtype(0), accuracy_per_class);
   }
   int count = 0;
+  // The prediction is right if fewer than top_k_ other classes score at
+  // least as high as the true class; counting them needs no sort and stops
+  // as soon as top_k_ are found.
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+: accuracy, count) \
+    if (static_cast<int64_t>(bottom[0]->count()) > 32768)
+#endif
   for (int i = 0; i < outer_num_; ++i) {
     for (int j = 0; j < inner_num_; ++j) {
       const int label_value =
@@ -66,20 +75,30 @@ void AccuracyLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       }
       DCHECK_GE(label_value, 0);
       DCHECK_LT(label_value, num_labels);
-      if (top.size() > 1) ++nums_buffer_.mutable_cpu_data()[label_value];
-      const Dtype prob_of_true_class = bottom_data[i * dim
-                                                   + label_value * inner_num_
-                                                   + j];
+      const Dtype* scores = bottom_data + i * dim + j;
+      const Dtype prob_of_true_class = scores[label_value * inner_num_];
       int num_better_predictions = -1;  // true_class also counts as "better"
       // Top-k accuracy
       for (int k = 0; k < num_labels && num_better_predictions < top_k_; ++k) {
         num_better_predictions +=
-          (bottom_data[i * dim + k * inner_num_ + j] >= prob_of_true_class);
+          (scores[k * inner_num_] >= prob_of_true_class);
       }
       // check if there are less than top_k_ predictions
-      if (num_better_predictions < top_k_) {
+      const bool correct = (num_better_predictions < top_k_);
+      if (correct) {
         ++accuracy;
-        if (top.size() > 1) ++top[1]->mutable_cpu_data()[label_value];
+      }
+      if (top.size() > 1) {
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+        ++nums_data[label_value];
+        if (correct) {
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+          ++accuracy_per_class[label_value];
+        }
       }
       ++count;
     }
@@ -1,12 +1,14 @@
 #include <algorithm>
-#include <functional>
-#include <utility>
 #include <vector>
 
 #include "caffe/layers/argmax_layer.hpp"
+#include "caffe/util/top_k.hpp"
 
 namespace caffe {
 
+// Positions per tile of the argmax along a strided axis.
+static const int kArgMaxTileSize = 256;
+
 template <typename Dtype>
 void ArgMaxLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -65,31 +67,69 @@ void ArgMaxLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     dim = bottom[0]->count(1);
     axis_dist = 1;
   }
-  int num = bottom[0]->count() / dim;
-  std::vector<std::pair<Dtype, int> > bottom_data_vector(dim);
-  for (int i = 0; i < num; ++i) {
-    for (int j = 0; j < dim; ++j) {
-      bottom_data_vector[j] = std::make_pair(
-        bottom_data[(i / axis_dist * dim + j) * axis_dist + i % axis_dist], j);
+  const int num = bottom[0]->count() / dim;
+  const int top_k = top_k_;
+  if (top_k == 1 && axis_dist > 1) {
+    // The argmax along an axis with a stride, such as over the channels of
+    // every pixel: scan the axis for a tile of neighbouring positions at
+    // once, so that the inner loops run over contiguous memory.
+    const int num_tiles = (axis_dist + kArgMaxTileSize - 1) / kArgMaxTileSize;
+#ifdef _OPENMP
+#pragma omp parallel for if (static_cast<int64_t>(bottom[0]->count()) > 32768)
+#endif
+    for (int t = 0; t < num / axis_dist * num_tiles; ++t) {
+      const int begin = (t % num_tiles) * kArgMaxTileSize;
+      const int len = std::min(kArgMaxTileSize, axis_dist - begin);
+      const int offset = t / num_tiles * axis_dist;
+      const Dtype* x = bottom_data + offset * dim + begin;
+      Dtype max_val[kArgMaxTileSize];
+      int max_ind[kArgMaxTileSize];
+      std::copy(x, x + len, max_val);
+      std::fill(max_ind, max_ind + len, 0);
+      for (int j = 1; j < dim; ++j) {
+        const Dtype* x_j = x + j * axis_dist;
+        for (int p = 0; p < len; ++p) {
+          const bool better = (x_j[p] >= max_val[p]);
+          max_val[p] = better ? x_j[p] : max_val[p];
+          max_ind[p] = better ? j : max_ind[p];
+        }
+      }
+      Dtype* y = top_data + offset + begin;
+      for (int p = 0; p < len; ++p) {
+        y[p] = out_max_val_ ? max_val[p] : Dtype(max_ind[p]);
+      }
     }
-    std::partial_sort(
-        bottom_data_vector.begin(), bottom_data_vector.begin() + top_k_,
-        bottom_data_vector.end(), std::greater<std::pair<Dtype, int> >());
-    for (int j = 0; j < top_k_; ++j) {
-      if (out_max_val_) {
-        if (has_axis_) {
-          // Produces max_val per axis
-          top_data[(i / axis_dist * top_k_ + j) * axis_dist + i % axis_dist]
-            = bottom_data_vector[j].first;
+    return;
+  }
+#ifdef _OPENMP
+#pragma omp parallel if (static_cast<int64_t>(bottom[0]->count()) > 32768)
+#endif
+  {
+    vector<int> max_ind(top_k);
+    vector<Dtype> max_val(top_k);
+#ifdef _OPENMP
+#pragma omp for
+#endif
+    for (int i = 0; i < num; ++i) {
+      caffe_cpu_top_k(dim,
+          bottom_data + (i / axis_dist * dim) * axis_dist + i % axis_dist,
+          axis_dist, top_k, &max_ind[0], &max_val[0]);
+      for (int j = 0; j < top_k; ++j) {
+        if (out_max_val_) {
+          if (has_axis_) {
+            // Produces max_val per axis
+            top_data[(i / axis_dist * top_k + j) * axis_dist + i % axis_dist]
+              = max_val[j];
+          } else {
+            // Produces max_ind and max_val
+            top_data[2 * i * top_k + j] = max_ind[j];
+            top_data[2 * i * top_k + top_k + j] = max_val[j];
+          }
         } else {
-          // Produces max_ind and max_val
-          top_data[2 * i * top_k_ + j] = bottom_data_vector[j].second;
-          top_data[2 * i * top_k_ + top_k_ + j] = bottom_data_vector[j].first;
+          // Produces max_ind per axis
+          top_data[(i / axis_dist * top_k + j) * axis_dist + i % axis_dist]
+            = max_ind[j];
         }
-      } else {
-        // Produces max_ind per axis
-        top_data[(i / axis_dist * top_k_ + j) * axis_dist + i % axis_dist]
-          = bottom_data_vector[j].second;
       }
     }
   }
@@ -1,13 +1,24 @@
 #include <algorithm>
+#include <sstream>
+#include <string>
 #include <vector>
 
 #include "caffe/filler.hpp"
 #include "caffe/layers/base_conv_layer.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/engine_tuner.hpp"
 #include "caffe/util/im2col.hpp"
 #include "caffe/util/math_functions.hpp"
 
 namespace caffe {
 
+// The names of BaseConvolutionLayer::CPUEngine in the tuning database.
+static const char* const kCPUEngineNames[] =
+    { "gemm", "gemm_blas", "gemm_blocked", "direct" };
+static const int kNumCPUEngines = 4;
+// The number of timed forward passes per candidate engine, after a warm-up.
+static const int kCPUEngineTimingRuns = 3;
+
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -177,6 +188,15 @@ void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   }
   kernel_dim_ = this->blobs_[0]->count(1);
   weight_offset_ = conv_out_channels_ * kernel_dim_ / group_;
+  if (use_int8_cpu()) {
+    CHECK_LE(kernel_dim_, kInt8GemmMaxK) << "Too many inputs per output for "
+        << "the int32 accumulators of INT8 precision.";
+  } else if (reverse_dimensions() && this->layer_param_.quantization_param()
+             .precision() == QuantizationParameter_Precision_INT8) {
+    LOG(WARNING) << "Ignoring INT8 precision of layer "
+        << this->layer_param_.name() << ": " << this->type()
+        << " layers always run in floating point.";
+  }
   // Propagate gradients to the parameters (as directed by backward pass).
   this->param_propagate_down_.resize(this->blobs_.size(), true);
 }
@@ -252,6 +272,101 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     caffe_set(bias_multiplier_.count(), Dtype(1),
         bias_multiplier_.mutable_cpu_data());
   }
+  if (bottom[0]->shape() != cpu_engine_shape_) {
+    select_cpu_engine(bottom, top);
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::select_cpu_engine(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  cpu_engine_ = has_direct_cpu() ? CPU_DIRECT : CPU_GEMM;
+  // Only a CPU mode Reshape can time the CPU engines, so check again later
+  // after one in GPU mode.
+  if (Caffe::mode() != Caffe::CPU) {
+    cpu_engine_shape_.clear();
+    return;
+  }
+  cpu_engine_shape_ = bottom[0]->shape();
+  // The int8 forward pass has no GEMM backend to choose.
+  if (!EngineTuner::enabled() || use_int8_cpu()) {
+    return;
+  }
+  const string key = cpu_engine_key(*bottom[0]);
+  const string name = EngineTuner::Lookup(key);
+  for (int i = 0; i < kNumCPUEngines; ++i) {
+    if (name == kCPUEngineNames[i]) {
+      cpu_engine_ = static_cast<CPUEngine>(i);
+      return;
+    }
+  }
+  LOG_IF(WARNING, !name.empty()) << "Unknown CPU engine " << name
+      << " in the tuning database for " << key << "; timing it again.";
+  vector<CPUEngine> candidates;
+  candidates.push_back(CPU_GEMM_BLAS);
+  candidates.push_back(CPU_GEMM_BLOCKED);
+  if (has_direct_cpu()) {
+    candidates.push_back(CPU_DIRECT);
+  }
+  // Time the candidates on scratch blobs of the same shapes, so that the
+  // data of the net is left alone.
+  Blob<Dtype> input(bottom[0]->shape());
+  Blob<Dtype> output(top[0]->shape());
+  const vector<Blob<Dtype>*> input_vec(1, &input);
+  const vector<Blob<Dtype>*> output_vec(1, &output);
+  CPUTimer timer;
+  CPUEngine fastest = candidates[0];
+  float fastest_time = 0;
+  for (int c = 0; c < candidates.size(); ++c) {
+    cpu_engine_ = candidates[c];
+    // The first pass packs the weights and touches the buffers.
+    this->Forward_cpu(input_vec, output_vec);
+    float time = 0;
+    for (int run = 0; run < kCPUEngineTimingRuns; ++run) {
+      timer.Start();
+      this->Forward_cpu(input_vec, output_vec);
+      timer.Stop();
+      time = run == 0 ? timer.MicroSeconds() :
+          std::min(time, timer.MicroSeconds());
+    }
+    if (c == 0 || time < fastest_time) {
+      fastest = candidates[c];
+      fastest_time = time;
+    }
+  }
+  cpu_engine_ = fastest;
+  LOG(INFO) << this->layer_param_.name() << " uses CPU engine "
+      << kCPUEngineNames[fastest] << " (" << fastest_time << " us) for "
+      << key;
+  EngineTuner::Record(key, kCPUEngineNames[fastest]);
+}
+
+// Appends the first n values of dims to key as " name AxBxC".
+static void append_dims(const char* name, const int* dims, const int n,
+    std::ostringstream* key) {
+  *key << ' ' << name << ' ';
+  for (int i = 0; i < n; ++i) {
+    *key << (i ? "x" : "") << dims[i];
+  }
+}
+
+template <typename Dtype>
+string BaseConvolutionLayer<Dtype>::cpu_engine_key(const Blob<Dtype>& bottom) {
+  std::ostringstream key;
+  key << this->type() << (sizeof(Dtype) == sizeof(float) ? " float" : " double")
+      << (this->phase_ == TRAIN ? " TRAIN" : " TEST") << ' '
+      << QuantizationParameter_Precision_Name(
+          this->layer_param_.quantization_param().precision());
+  append_dims("input", bottom.shape().data(), bottom.num_axes(), &key);
+  key << " output " << num_output_ << " group " << group_;
+  append_dims("kernel", kernel_shape_.cpu_data(), num_spatial_axes_, &key);
+  append_dims("stride", stride_.cpu_data(), num_spatial_axes_, &key);
+  append_dims("pad", pad_.cpu_data(), num_spatial_axes_, &key);
+  append_dims("dilation", dilation_.cpu_data(), num_spatial_axes_, &key);
+  if (force_nd_im2col_) {
+    key << " nd";
+  }
+  return key.str();
 }
 
 template <typename Dtype>
@@ -264,6 +379,27 @@ void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
     }
     col_buff = col_buffer_.cpu_data();
   }
+  // The weights are constant at inference, so convert them to sparse format
+  // (for pruned models) or pack them once, and reuse that copy until the
+  // weight blob is written again.
+  if (this->phase_ == TEST && weights == this->blobs_[0]->cpu_data()) {
+    if (sparse_weights_cpu()) {
+      const int out_channels_per_group = conv_out_channels_ / group_;
+      for (int g = 0; g < group_; ++g) {
+        caffe_cpu_csrmm(sparse_weights_, out_channels_per_group * g,
+            out_channels_per_group * (g + 1), conv_out_spatial_dim_,
+            col_buff + col_offset_ * g, output + output_offset_ * g);
+      }
+      return;
+    }
+    pack_weights_cpu();
+    for (int g = 0; g < group_; ++g) {
+      caffe_cpu_gemm_packed_a<Dtype>(*packed_weights_[g], CblasNoTrans,
+          conv_out_spatial_dim_, (Dtype)1., col_buff + col_offset_ * g,
+          (Dtype)0., output + output_offset_ * g);
+    }
+    return;
+  }
   for (int g = 0; g < group_; ++g) {
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels_ /
         group_, conv_out_spatial_dim_, kernel_dim_,
@@ -272,6 +408,75 @@ void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
   }
 }
 
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::pack_weights_cpu() {
+  if (packed_weights_.size() == group_ &&
+      packed_weights_[0]->IsPackedFrom(*this->blobs_[0])) {
+    return;
+  }
+  packed_weights_.resize(group_);
+  for (int g = 0; g < group_; ++g) {
+    if (!packed_weights_[g]) {
+      packed_weights_[g].reset(new PackedGemmMatrix<Dtype>());
+    }
+    packed_weights_[g]->PackA(CblasNoTrans, conv_out_channels_ / group_,
+        kernel_dim_, *this->blobs_[0], weight_offset_ * g);
+  }
+}
+
+template <typename Dtype>
+bool BaseConvolutionLayer<Dtype>::sparse_weights_cpu() {
+  if (!sparse_weights_.IsConvertedFrom(*this->blobs_[0])) {
+    sparse_weights_.Convert(*this->blobs_[0], false, conv_out_channels_,
+        kernel_dim_,
+        this->layer_param_.convolution_param().sparsity_threshold());
+  }
+  return sparse_weights_.is_sparse();
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_int8_gemm(const Dtype* input,
+    Dtype* output) {
+  const QuantizationParameter& quant_param =
+      this->layer_param_.quantization_param();
+  if (!int8_weights_.IsQuantizedFrom(*this->blobs_[0])) {
+    const vector<float> weight_scale(quant_param.weight_scale().begin(),
+        quant_param.weight_scale().end());
+    int8_weights_.Quantize(*this->blobs_[0], false, conv_out_channels_,
+        kernel_dim_, weight_scale);
+  }
+  const Dtype* col_buff = input;
+  if (!is_1x1_) {
+    conv_im2col_cpu(input, col_buffer_.mutable_cpu_data());
+    col_buff = col_buffer_.cpu_data();
+  }
+  const float input_scale = quant_param.input_scale();
+  const int zero_point = quant_param.input_zero_point();
+  const int col_count = col_offset_ * group_;
+  int8_col_buffer_.resize(col_count);
+  int8_output_.resize(output_offset_ * group_);
+  caffe_cpu_quantize_u8(col_count, col_buff, input_scale, zero_point,
+      &int8_col_buffer_[0]);
+  const int out_channels_per_group = conv_out_channels_ / group_;
+  for (int g = 0; g < group_; ++g) {
+    caffe_cpu_gemm_s8u8s32(out_channels_per_group, conv_out_spatial_dim_,
+        kernel_dim_, int8_weights_.data() + weight_offset_ * g,
+        &int8_col_buffer_[col_offset_ * g], &int8_output_[output_offset_ * g]);
+  }
+  // Requantize the int32 accumulators back to Dtype.
+  const float* weight_scale = int8_weights_.scales();
+  const int32_t* row_sums = int8_weights_.row_sums();
+  for (int c = 0; c < conv_out_channels_; ++c) {
+    const Dtype scale = input_scale * weight_scale[c];
+    const int32_t offset = zero_point * row_sums[c];
+    const int32_t* acc = &int8_output_[c * conv_out_spatial_dim_];
+    Dtype* out = output + c * conv_out_spatial_dim_;
+    for (int j = 0; j < conv_out_spatial_dim_; ++j) {
+      out[j] = scale * (acc[j] - offset);
+    }
+  }
+}
+
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_cpu_bias(Dtype* output,
     const Dtype* bias) {
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "caffe/layers/batch_norm_layer.hpp"
@@ -88,81 +89,91 @@ void BatchNormLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  int num = bottom[0]->shape(0);
-  int spatial_dim = bottom[0]->count()/(bottom[0]->shape(0)*channels_);
-
-  if (bottom[0] != top[0]) {
-    caffe_copy(bottom[0]->count(), bottom_data, top_data);
-  }
+  const int num = bottom[0]->shape(0);
+  const int spatial_dim = bottom[0]->count()/(bottom[0]->shape(0)*channels_);
+  const bool parallel = bottom[0]->count() > 32768;
+  Dtype* mean_data = mean_.mutable_cpu_data();
+  // variance_ ends up holding sqrt(var(X) + eps), as on the GPU.
+  Dtype* std_data = variance_.mutable_cpu_data();
 
   if (use_global_stats_) {
-    // use the stored mean/variance estimates.
+    // use the stored mean/variance estimates, which makes the layer an affine
+    // map per channel: y = x / std - mean / std.
     const Dtype scale_factor = this->blobs_[2]->cpu_data()[0] == 0 ?
         0 : 1 / this->blobs_[2]->cpu_data()[0];
-    caffe_cpu_scale(variance_.count(), scale_factor,
-        this->blobs_[0]->cpu_data(), mean_.mutable_cpu_data());
-    caffe_cpu_scale(variance_.count(), scale_factor,
-        this->blobs_[1]->cpu_data(), variance_.mutable_cpu_data());
-  } else {
-    // compute mean
-    caffe_cpu_gemv<Dtype>(CblasNoTrans, channels_ * num, spatial_dim,
-        1. / (num * spatial_dim), bottom_data,
-        spatial_sum_multiplier_.cpu_data(), 0.,
-        num_by_chans_.mutable_cpu_data());
-    caffe_cpu_gemv<Dtype>(CblasTrans, num, channels_, 1.,
-        num_by_chans_.cpu_data(), batch_sum_multiplier_.cpu_data(), 0.,
-        mean_.mutable_cpu_data());
+    const Dtype* global_mean = this->blobs_[0]->cpu_data();
+    const Dtype* global_var = this->blobs_[1]->cpu_data();
+    for (int c = 0; c < channels_; ++c) {
+      mean_data[c] = scale_factor * global_mean[c];
+      std_data[c] = std::sqrt(scale_factor * global_var[c] + eps_);
+    }
+#ifdef _OPENMP
+#pragma omp parallel for if (parallel)
+#endif
+    for (int p = 0; p < num * channels_; ++p) {
+      const int c = p % channels_;
+      const Dtype scale = 1 / std_data[c];
+      const Dtype shift = -mean_data[c] * scale;
+      const Dtype* x = bottom_data + p * spatial_dim;
+      Dtype* y = top_data + p * spatial_dim;
+      for (int i = 0; i < spatial_dim; ++i) {
+        y[i] = x[i] * scale + shift;
+      }
+    }
+    return;
   }
 
-  // subtract mean
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, channels_, 1, 1,
-      batch_sum_multiplier_.cpu_data(), mean_.cpu_data(), 0.,
-      num_by_chans_.mutable_cpu_data());
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels_ * num,
-      spatial_dim, 1, -1, num_by_chans_.cpu_data(),
-      spatial_sum_multiplier_.cpu_data(), 1., top_data);
-
-  if (!use_global_stats_) {
-    // compute variance using var(X) = E((X-EX)^2)
-    caffe_sqr<Dtype>(top[0]->count(), top_data,
-                     temp_.mutable_cpu_data());  // (X-EX)^2
-    caffe_cpu_gemv<Dtype>(CblasNoTrans, channels_ * num, spatial_dim,
-        1. / (num * spatial_dim), temp_.cpu_data(),
-        spatial_sum_multiplier_.cpu_data(), 0.,
-        num_by_chans_.mutable_cpu_data());
-    caffe_cpu_gemv<Dtype>(CblasTrans, num, channels_, 1.,
-        num_by_chans_.cpu_data(), batch_sum_multiplier_.cpu_data(), 0.,
-        variance_.mutable_cpu_data());  // E((X_EX)^2)
-
-    // compute and save moving average
-    this->blobs_[2]->mutable_cpu_data()[0] *= moving_average_fraction_;
-    this->blobs_[2]->mutable_cpu_data()[0] += 1;
-    caffe_cpu_axpby(mean_.count(), Dtype(1), mean_.cpu_data(),
-        moving_average_fraction_, this->blobs_[0]->mutable_cpu_data());
-    int m = bottom[0]->count()/channels_;
-    Dtype bias_correction_factor = m > 1 ? Dtype(m)/(m-1) : 1;
-    caffe_cpu_axpby(variance_.count(), bias_correction_factor,
-        variance_.cpu_data(), moving_average_fraction_,
-        this->blobs_[1]->mutable_cpu_data());
+  // compute mean and variance of each channel in one read of its planes
+#ifdef _OPENMP
+#pragma omp parallel for if (parallel)
+#endif
+  for (int c = 0; c < channels_; ++c) {
+    int count = 0;
+    Dtype mean = 0;
+    Dtype m2 = 0;
+    for (int n = 0; n < num; ++n) {
+      caffe_cpu_mean_m2(spatial_dim,
+          bottom_data + (n * channels_ + c) * spatial_dim, &count, &mean, &m2);
+    }
+    mean_data[c] = mean;
+    std_data[c] = count > 0 ? m2 / count : 0;  // E((X-EX)^2)
   }
 
+  // compute and save moving average
+  this->blobs_[2]->mutable_cpu_data()[0] *= moving_average_fraction_;
+  this->blobs_[2]->mutable_cpu_data()[0] += 1;
+  caffe_cpu_axpby(mean_.count(), Dtype(1), mean_.cpu_data(),
+      moving_average_fraction_, this->blobs_[0]->mutable_cpu_data());
+  int m = bottom[0]->count()/channels_;
+  Dtype bias_correction_factor = m > 1 ? Dtype(m)/(m-1) : 1;
+  caffe_cpu_axpby(variance_.count(), bias_correction_factor,
+      variance_.cpu_data(), moving_average_fraction_,
+      this->blobs_[1]->mutable_cpu_data());
+
   // normalize variance
-  caffe_add_scalar(variance_.count(), eps_, variance_.mutable_cpu_data());
-  caffe_sqrt(variance_.count(), variance_.cpu_data(),
-             variance_.mutable_cpu_data());
-
-  // replicate variance to input size
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, channels_, 1, 1,
-      batch_sum_multiplier_.cpu_data(), variance_.cpu_data(), 0.,
-      num_by_chans_.mutable_cpu_data());
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels_ * num,
-      spatial_dim, 1, 1., num_by_chans_.cpu_data(),
-      spatial_sum_multiplier_.cpu_data(), 0., temp_.mutable_cpu_data());
-  caffe_div(temp_.count(), top_data, temp_.cpu_data(), top_data);
+  for (int c = 0; c < channels_; ++c) {
+    std_data[c] = std::sqrt(std_data[c] + eps_);
+  }
+
+  // normalize, keeping a copy of the output for Backward
   // TODO(cdoersch): The caching is only needed because later in-place layers
   //                 might clobber the data.  Can we skip this if they won't?
-  caffe_copy(x_norm_.count(), top_data,
-      x_norm_.mutable_cpu_data());
+  Dtype* x_norm_data = x_norm_.mutable_cpu_data();
+#ifdef _OPENMP
+#pragma omp parallel for if (parallel)
+#endif
+  for (int p = 0; p < num * channels_; ++p) {
+    const int c = p % channels_;
+    const Dtype mean = mean_data[c];
+    const Dtype inv_std = 1 / std_data[c];
+    const Dtype* x = bottom_data + p * spatial_dim;
+    Dtype* y = top_data + p * spatial_dim;
+    Dtype* x_norm = x_norm_data + p * spatial_dim;
+    for (int i = 0; i < spatial_dim; ++i) {
+      y[i] = (x[i] - mean) * inv_std;
+      x_norm[i] = y[i];
+    }
+  }
 }
 
 template <typename Dtype>
@@ -177,13 +188,27 @@ void BatchNormLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     top_diff = x_norm_.cpu_diff();
   }
   Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
+  const int num = bottom[0]->shape(0);
+  const int spatial_dim = bottom[0]->count()/(bottom[0]->shape(0)*channels_);
+  const bool parallel = bottom[0]->count() > 32768;
+  // variance_ still contains sqrt(var(X)+eps), computed during the forward
+  // pass.
+  const Dtype* std_data = variance_.cpu_data();
   if (use_global_stats_) {
-    caffe_div(temp_.count(), top_diff, temp_.cpu_data(), bottom_diff);
+#ifdef _OPENMP
+#pragma omp parallel for if (parallel)
+#endif
+    for (int p = 0; p < num * channels_; ++p) {
+      const Dtype inv_std = 1 / std_data[p % channels_];
+      const Dtype* dy = top_diff + p * spatial_dim;
+      Dtype* dx = bottom_diff + p * spatial_dim;
+      for (int i = 0; i < spatial_dim; ++i) {
+        dx[i] = dy[i] * inv_std;
+      }
+    }
     return;
   }
   const Dtype* top_data = x_norm_.cpu_data();
-  int num = bottom[0]->shape()[0];
-  int spatial_dim = bottom[0]->count()/(bottom[0]->shape(0)*channels_);
   // if Y = (X-mean(X))/(sqrt(var(X)+eps)), then
   //
   // dE(Y)/dX =
@@ -196,49 +221,44 @@ void BatchNormLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   // equation, the operations allow for expansion (i.e. broadcast) along all
   // dimensions except the channels dimension where required.
 
-  // sum(dE/dY \cdot Y)
-  caffe_mul(temp_.count(), top_data, top_diff, bottom_diff);
-  caffe_cpu_gemv<Dtype>(CblasNoTrans, channels_ * num, spatial_dim, 1.,
-      bottom_diff, spatial_sum_multiplier_.cpu_data(), 0.,
-      num_by_chans_.mutable_cpu_data());
-  caffe_cpu_gemv<Dtype>(CblasTrans, num, channels_, 1.,
-      num_by_chans_.cpu_data(), batch_sum_multiplier_.cpu_data(), 0.,
-      mean_.mutable_cpu_data());
-
-  // reshape (broadcast) the above
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, channels_, 1, 1,
-      batch_sum_multiplier_.cpu_data(), mean_.cpu_data(), 0.,
-      num_by_chans_.mutable_cpu_data());
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels_ * num,
-      spatial_dim, 1, 1., num_by_chans_.cpu_data(),
-      spatial_sum_multiplier_.cpu_data(), 0., bottom_diff);
-
-  // sum(dE/dY \cdot Y) \cdot Y
-  caffe_mul(temp_.count(), top_data, bottom_diff, bottom_diff);
-
-  // sum(dE/dY)-sum(dE/dY \cdot Y) \cdot Y
-  caffe_cpu_gemv<Dtype>(CblasNoTrans, channels_ * num, spatial_dim, 1.,
-      top_diff, spatial_sum_multiplier_.cpu_data(), 0.,
-      num_by_chans_.mutable_cpu_data());
-  caffe_cpu_gemv<Dtype>(CblasTrans, num, channels_, 1.,
-      num_by_chans_.cpu_data(), batch_sum_multiplier_.cpu_data(), 0.,
-      mean_.mutable_cpu_data());
-  // reshape (broadcast) the above to make
-  // sum(dE/dY)-sum(dE/dY \cdot Y) \cdot Y
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, channels_, 1, 1,
-      batch_sum_multiplier_.cpu_data(), mean_.cpu_data(), 0.,
-      num_by_chans_.mutable_cpu_data());
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num * channels_,
-      spatial_dim, 1, 1., num_by_chans_.cpu_data(),
-      spatial_sum_multiplier_.cpu_data(), 1., bottom_diff);
-
-  // dE/dY - mean(dE/dY)-mean(dE/dY \cdot Y) \cdot Y
-  caffe_cpu_axpby(temp_.count(), Dtype(1), top_diff,
-      Dtype(-1. / (num * spatial_dim)), bottom_diff);
-
-  // note: temp_ still contains sqrt(var(X)+eps), computed during the forward
-  // pass.
-  caffe_div(temp_.count(), bottom_diff, temp_.cpu_data(), bottom_diff);
+  // mean(dE/dY) and mean(dE/dY \cdot Y) of each channel, in one pass
+  vector<Dtype> mean_dy(channels_);
+  vector<Dtype> mean_dy_y(channels_);
+  const Dtype inv_m = Dtype(1) / (num * spatial_dim);
+#ifdef _OPENMP
+#pragma omp parallel for if (parallel)
+#endif
+  for (int c = 0; c < channels_; ++c) {
+    Dtype sum_dy = 0;
+    Dtype sum_dy_y = 0;
+    for (int n = 0; n < num; ++n) {
+      const int offset = (n * channels_ + c) * spatial_dim;
+      const Dtype* dy = top_diff + offset;
+      const Dtype* y = top_data + offset;
+      for (int i = 0; i < spatial_dim; ++i) {
+        sum_dy += dy[i];
+        sum_dy_y += dy[i] * y[i];
+      }
+    }
+    mean_dy[c] = sum_dy * inv_m;
+    mean_dy_y[c] = sum_dy_y * inv_m;
+  }
+
+#ifdef _OPENMP
+#pragma omp parallel for if (parallel)
+#endif
+  for (int p = 0; p < num * channels_; ++p) {
+    const int c = p % channels_;
+    const Dtype inv_std = 1 / std_data[c];
+    const Dtype shift = mean_dy[c];
+    const Dtype slope = mean_dy_y[c];
+    const Dtype* dy = top_diff + p * spatial_dim;
+    const Dtype* y = top_data + p * spatial_dim;
+    Dtype* dx = bottom_diff + p * spatial_dim;
+    for (int i = 0; i < spatial_dim; ++i) {
+      dx[i] = (dy[i] - shift - slope * y[i]) * inv_std;
+    }
+  }
 }
 
 
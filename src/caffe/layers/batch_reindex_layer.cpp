@@ -41,10 +41,16 @@ void BatchReindexLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* in = bottom[0]->cpu_data();
   const Dtype* permut = bottom[1]->cpu_data();
   Dtype* out = top[0]->mutable_cpu_data();
-  for (int index = 0; index < top[0]->count(); ++index) {
-    int n = index / (inner_dim);
-    int in_n = static_cast<int>(permut[n]);
-    out[index] = in[in_n * (inner_dim) + index % (inner_dim)];
+  // Copy whole items, each run of consecutive indices at once.
+  const int num = top[0]->shape(0);
+  for (int n = 0; n < num;) {
+    const int in_n = static_cast<int>(permut[n]);
+    int run = 1;
+    while (n + run < num && static_cast<int>(permut[n + run]) == in_n + run) {
+      ++run;
+    }
+    caffe_copy(run * inner_dim, in + in_n * inner_dim, out + n * inner_dim);
+    n += run;
   }
 }
 
@@ -61,10 +67,10 @@ void BatchReindexLayer<Dtype>::Backward_cpu(
   const Dtype* permut = bottom[1]->cpu_data();
   const Dtype* top_diff = top[0]->cpu_diff();
   caffe_set(bottom[0]->count(), Dtype(0), bot_diff);
-  for (int index = 0; index < top[0]->count(); ++index) {
-    int n = index / (inner_dim);
+  for (int n = 0; n < top[0]->shape(0); ++n) {
     int in_n = static_cast<int>(permut[n]);
-    bot_diff[in_n * (inner_dim) + index % (inner_dim)] += top_diff[index];
+    caffe_axpy(inner_dim, Dtype(1), top_diff + n * inner_dim,
+        bot_diff + in_n * inner_dim);
   }
 }
 
@@ -1,23 +1,18 @@
-#include <algorithm>
 #include <vector>
 
 #include "caffe/layers/bnll_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/vector_math.hpp"
 
 namespace caffe {
 
-const float kBNLL_THRESHOLD = 50.;
-
 template <typename Dtype>
 void BNLLLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
-  for (int i = 0; i < count; ++i) {
-    top_data[i] = bottom_data[i] > 0 ?
-        bottom_data[i] + log(1. + exp(-bottom_data[i])) :
-        log(1. + exp(bottom_data[i]));
-  }
+  caffe_cpu_vsoftplus(count, bottom_data, top_data);
 }
 
 template <typename Dtype>
@@ -29,11 +24,9 @@ void BNLLLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const Dtype* top_diff = top[0]->cpu_diff();
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
     const int count = bottom[0]->count();
-    Dtype expval;
-    for (int i = 0; i < count; ++i) {
-      expval = exp(std::min(bottom_data[i], Dtype(kBNLL_THRESHOLD)));
-      bottom_diff[i] = top_diff[i] * expval / (expval + 1.);
-    }
+    // The derivative of log(1 + exp(x)) is sigmoid(x).
+    caffe_cpu_vsigmoid(count, bottom_data, bottom_diff);
+    caffe_mul(count, top_diff, bottom_diff, bottom_diff);
   }
 }
 
@@ -50,13 +50,52 @@ void ConcatLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   if (bottom.size() == 1) {
     top[0]->ShareData(*bottom[0]);
     top[0]->ShareDiff(*bottom[0]);
+    return;
+  }
+  // When nothing precedes the concatenation axis each bottom is a single
+  // contiguous piece of the top, and the net may let the bottoms be views of
+  // it so that their producers write the top directly.
+  share_bottoms_ = concat_param.share_bottoms() && num_concats_ == 1;
+  // A bottom that is still a view of the top at its old offset (Reshape does
+  // not move views, e.g. when the batch shrinks) may overlap its own new
+  // place or that of another bottom, so stage such bottoms before writing.
+  vector<Dtype> staged;
+  vector<int> staged_offset(bottom.size(), -1);
+  if (share_bottoms_) {
+    int offset = 0;
+    for (int i = 0; i < bottom.size(); ++i) {
+      if (bottom[i]->count() > 0 && bottom[i]->SharesDataWith(*top[0]) &&
+          !bottom[i]->IsViewOf(*top[0], offset)) {
+        staged_offset[i] = staged.size();
+        staged.insert(staged.end(), bottom[i]->cpu_data(),
+            bottom[i]->cpu_data() + bottom[i]->count());
+      }
+      offset += bottom[i]->count();
+    }
+  }
+  int offset = 0;
+  for (int i = 0; i < bottom.size(); ++i) {
+    if (share_bottoms_) {
+      if (!bottom[i]->IsViewOf(*top[0], offset)) {
+        // The producer of the bottom may already have run.
+        if (bottom[i]->count() > 0) {
+          caffe_copy(bottom[i]->count(), staged_offset[i] >= 0 ?
+              &staged[staged_offset[i]] : bottom[i]->cpu_data(),
+              top[0]->mutable_cpu_data() + offset);
+        }
+        bottom[i]->ShareView(*top[0], offset);
+      }
+    } else if (bottom[i]->SharesDataWith(*top[0])) {
+      bottom[i]->ReleaseView();
+    }
+    offset += bottom[i]->count();
   }
 }
 
 template <typename Dtype>
 void ConcatLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
-  if (bottom.size() == 1) { return; }
+  if (bottom.size() == 1 || share_bottoms_) { return; }
   Dtype* top_data = top[0]->mutable_cpu_data();
   int offset_concat_axis = 0;
   const int top_concat_axis = top[0]->shape(concat_axis_);
@@ -76,7 +115,7 @@ void ConcatLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void ConcatLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
-  if (bottom.size() == 1) { return; }
+  if (bottom.size() == 1 || share_bottoms_) { return; }
   const Dtype* top_diff = top[0]->cpu_diff();
   int offset_concat_axis = 0;
   const int top_concat_axis = top[0]->shape(concat_axis_);
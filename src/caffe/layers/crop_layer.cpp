@@ -8,6 +8,7 @@
 #include "caffe/layer.hpp"
 #include "caffe/layers/crop_layer.hpp"
 #include "caffe/net.hpp"
+#include "caffe/util/math_functions.hpp"
 
 
 namespace caffe {
@@ -75,45 +76,55 @@ void CropLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     src_strides_.mutable_cpu_data()[i] = bottom[0]->count(i + 1, input_dim);
     dest_strides_.mutable_cpu_data()[i] = top[0]->count(i + 1, input_dim);
   }
+  // From the last cropped axis on, the crop is made of contiguous chunks.
+  copy_axis_ = 0;
+  crop_offset_ = 0;
+  for (int i = 0; i < input_dim; ++i) {
+    if (new_shape[i] != bottom[0]->shape(i) || offset_data[i] != 0) {
+      copy_axis_ = i;
+    }
+    crop_offset_ += offset_data[i] * src_strides_.cpu_data()[i];
+  }
+  copy_size_ = top[0]->count(copy_axis_);
+  // A crop of a single chunk can be a view of the bottom if the net allows.
+  share_top_ = param.share_top() && top[0]->count(0, copy_axis_) == 1;
+  if (share_top_) {
+    if (!top[0]->IsViewOf(*bottom[0], crop_offset_)) {
+      top[0]->ShareView(*bottom[0], crop_offset_);
+    }
+  } else if (top[0]->SharesDataWith(*bottom[0])) {
+    top[0]->ReleaseView();
+  }
 }
 
 template <typename Dtype>
 void CropLayer<Dtype>::crop_copy(const vector<Blob<Dtype>*>& bottom,
              const vector<Blob<Dtype>*>& top,
-             const int* offsets,
-             vector<int> indices,
-             int cur_dim,
              const Dtype* src_data,
              Dtype* dest_data,
              bool is_forward) {
-  if (cur_dim + 1 < top[0]->num_axes()) {
-    // We are not yet at the final dimension, call copy recursively
-    for (int i = 0; i < top[0]->shape(cur_dim); ++i) {
-      indices[cur_dim] = i;
-      crop_copy(bottom, top, offsets, indices, cur_dim+1,
-                src_data, dest_data, is_forward);
-    }
-  } else {
-    // We are at the last dimensions, which is stored continuously in memory
-    // prepare index vector reduced(red) and with offsets(off)
-    std::vector<int> ind_red(cur_dim, 0);
-    std::vector<int> ind_off(cur_dim+1, 0);
-    for (int j = 0; j < cur_dim; ++j) {
-      ind_red[j] = indices[j];
-      ind_off[j] = indices[j] + offsets[j];
+  const vector<int>& top_shape = top[0]->shape();
+  const int* src_strides = src_strides_.cpu_data();
+  const int num_copies = top[0]->count(0, copy_axis_);
+#ifdef _OPENMP
+#pragma omp parallel for if (static_cast<int64_t>(top[0]->count()) > 32768)
+#endif
+  for (int n = 0; n < num_copies; ++n) {
+    // Find the bottom offset of the n-th chunk of the top.
+    int bottom_offset = crop_offset_;
+    int index = n;
+    for (int i = copy_axis_ - 1; i >= 0; --i) {
+      bottom_offset += (index % top_shape[i]) * src_strides[i];
+      index /= top_shape[i];
     }
-    ind_off[cur_dim] = offsets[cur_dim];
-    // do the copy
     if (is_forward) {
-      caffe_copy(top[0]->shape(cur_dim),
-          src_data + bottom[0]->offset(ind_off),
-          dest_data + top[0]->offset(ind_red));
+      caffe_copy(copy_size_, src_data + bottom_offset,
+          dest_data + n * copy_size_);
     } else {
       // in the backwards pass the src_data is top_diff
       // and the dest_data is bottom_diff
-      caffe_copy(top[0]->shape(cur_dim),
-          src_data + top[0]->offset(ind_red),
-          dest_data + bottom[0]->offset(ind_off));
+      caffe_copy(copy_size_, src_data + n * copy_size_,
+          dest_data + bottom_offset);
     }
   }
 }
@@ -121,25 +132,26 @@ void CropLayer<Dtype>::crop_copy(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void CropLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
-  std::vector<int> indices(top[0]->num_axes(), 0);
-  const Dtype* bottom_data = bottom[0]->cpu_data();
-  Dtype* top_data = top[0]->mutable_cpu_data();
-  crop_copy(bottom, top, offsets.cpu_data(), indices, 0, bottom_data, top_data,
+  if (share_top_) { return; }
+  crop_copy(bottom, top, bottom[0]->cpu_data(), top[0]->mutable_cpu_data(),
       true);
 }
 
 template <typename Dtype>
 void CropLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
-  const Dtype* top_diff = top[0]->cpu_diff();
+  if (!propagate_down[0]) { return; }
   Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-
-  if (propagate_down[0]) {
-    caffe_set(bottom[0]->count(), static_cast<Dtype>(0), bottom_diff);
-    std::vector<int> indices(top[0]->num_axes(), 0);
-    crop_copy(bottom, top, offsets.cpu_data(), indices, 0, top_diff,
-        bottom_diff, false);
+  if (share_top_) {
+    // The top diff is in place already; clear the rest of the bottom diff.
+    const int end = crop_offset_ + top[0]->count();
+    caffe_set(crop_offset_, static_cast<Dtype>(0), bottom_diff);
+    caffe_set(bottom[0]->count() - end, static_cast<Dtype>(0),
+        bottom_diff + end);
+    return;
   }
+  caffe_set(bottom[0]->count(), static_cast<Dtype>(0), bottom_diff);
+  crop_copy(bottom, top, top[0]->cpu_diff(), bottom_diff, false);
 }
 
 #ifdef CPU_ONLY
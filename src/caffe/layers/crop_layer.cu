@@ -51,6 +51,7 @@ __global__ void crop_kernel_backward(const int nthreads,
 template <typename Dtype>
 void CropLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
+  if (share_top_) { return; }
   const Dtype* bottom_data = bottom[0]->gpu_data();
   Dtype* top_data = top[0]->mutable_gpu_data();
   int n = top[0]->count();
@@ -66,6 +67,15 @@ void CropLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void CropLayer<Dtype>::Backward_gpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+  if (propagate_down[0] && share_top_) {
+    // The top diff is in place already; clear the rest of the bottom diff.
+    Dtype* bottom_diff = bottom[0]->mutable_gpu_diff();
+    const int end = crop_offset_ + top[0]->count();
+    caffe_gpu_set(crop_offset_, static_cast<Dtype>(0), bottom_diff);
+    caffe_gpu_set(bottom[0]->count() - end, static_cast<Dtype>(0),
+        bottom_diff + end);
+    return;
+  }
   const Dtype* top_diff = top[0]->gpu_diff();
   Dtype* bottom_diff = bottom[0]->mutable_gpu_diff();
   int n = top[0]->count();
@@ -1,9 +1,22 @@
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "caffe/layers/deconv_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 namespace caffe {
 
+// Computes the range [*lo, *hi) of input indices i in [0, in_size) whose
+// output index i * stride + offset falls in [0, out_size).
+static inline void valid_input_range(const int offset, const int stride,
+    const int in_size, const int out_size, int* lo, int* hi) {
+  *lo = offset >= 0 ? 0 : (-offset + stride - 1) / stride;
+  const int last = out_size - 1 - offset;
+  *hi = last < 0 ? 0 : std::min(in_size, last / stride + 1);
+  *hi = std::max(*hi, *lo);
+}
+
 template <typename Dtype>
 void DeconvolutionLayer<Dtype>::compute_output_shape() {
   const int* kernel_shape_data = this->kernel_shape_.cpu_data();
@@ -24,13 +37,24 @@ void DeconvolutionLayer<Dtype>::compute_output_shape() {
 template <typename Dtype>
 void DeconvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+  GemmBackendScope gemm_scope(this->cpu_gemm_backend());
   const Dtype* weight = this->blobs_[0]->cpu_data();
+  const bool bilinear = bilinear_weights_cpu();
+  const bool direct = !bilinear && this->cpu_engine_ == this->CPU_DIRECT;
   for (int i = 0; i < bottom.size(); ++i) {
     const Dtype* bottom_data = bottom[i]->cpu_data();
     Dtype* top_data = top[i]->mutable_cpu_data();
     for (int n = 0; n < this->num_; ++n) {
-      this->backward_cpu_gemm(bottom_data + n * this->bottom_dim_, weight,
-          top_data + n * this->top_dim_);
+      if (bilinear) {
+        forward_cpu_bilinear(bottom_data + n * this->bottom_dim_,
+            top_data + n * this->top_dim_);
+      } else if (direct) {
+        forward_cpu_direct(bottom_data + n * this->bottom_dim_, weight,
+            top_data + n * this->top_dim_);
+      } else {
+        this->backward_cpu_gemm(bottom_data + n * this->bottom_dim_, weight,
+            top_data + n * this->top_dim_);
+      }
       if (this->bias_term_) {
         const Dtype* bias = this->blobs_[1]->cpu_data();
         this->forward_cpu_bias(top_data + n * this->top_dim_, bias);
@@ -42,6 +66,7 @@ void DeconvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void DeconvolutionLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+  GemmBackendScope gemm_scope(this->cpu_gemm_backend());
   const Dtype* weight = this->blobs_[0]->cpu_data();
   Dtype* weight_diff = this->blobs_[0]->mutable_cpu_diff();
   for (int i = 0; i < top.size(); ++i) {
@@ -74,6 +99,168 @@ void DeconvolutionLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   }
 }
 
+template <typename Dtype>
+bool DeconvolutionLayer<Dtype>::has_direct_cpu() {
+  return this->num_spatial_axes_ == 2 && !this->force_nd_im2col_ &&
+      this->stride_.cpu_data()[0] == 2 && this->stride_.cpu_data()[1] == 2;
+}
+
+template <typename Dtype>
+void DeconvolutionLayer<Dtype>::forward_cpu_direct(const Dtype* input,
+    const Dtype* weights, Dtype* output) {
+  const int height = this->input_shape(1);
+  const int width = this->input_shape(2);
+  const int output_h = this->output_shape_[0];
+  const int output_w = this->output_shape_[1];
+  const int kernel_h = this->kernel_shape_.cpu_data()[0];
+  const int kernel_w = this->kernel_shape_.cpu_data()[1];
+  const int stride_h = this->stride_.cpu_data()[0];
+  const int stride_w = this->stride_.cpu_data()[1];
+  const int pad_h = this->pad_.cpu_data()[0];
+  const int pad_w = this->pad_.cpu_data()[1];
+  const int dilation_h = this->dilation_.cpu_data()[0];
+  const int dilation_w = this->dilation_.cpu_data()[1];
+  const int input_channels_per_group = this->channels_ / this->group_;
+  const int output_channels_per_group = this->num_output_ / this->group_;
+  const int kernel_size = kernel_h * kernel_w;
+  const int input_spatial_dim = height * width;
+  const int output_spatial_dim = output_h * output_w;
+#ifdef _OPENMP
+#pragma omp parallel for if (this->num_output_ > 1 && \
+    static_cast<int64_t>(this->channels_) * output_spatial_dim > 65536)
+#endif
+  for (int c_out = 0; c_out < this->num_output_; ++c_out) {
+    const int g = c_out / output_channels_per_group;
+    const int c_out_in_group = c_out % output_channels_per_group;
+    Dtype* out = output + c_out * output_spatial_dim;
+    caffe_set(output_spatial_dim, Dtype(0), out);
+    for (int c_in = g * input_channels_per_group;
+         c_in < (g + 1) * input_channels_per_group; ++c_in) {
+      const Dtype* in = input + c_in * input_spatial_dim;
+      const Dtype* w = weights +
+          (c_in * output_channels_per_group + c_out_in_group) * kernel_size;
+      for (int kh = 0; kh < kernel_h; ++kh) {
+        const int offset_h = kh * dilation_h - pad_h;
+        int h_lo, h_hi;
+        valid_input_range(offset_h, stride_h, height, output_h, &h_lo, &h_hi);
+        for (int kw = 0; kw < kernel_w; ++kw) {
+          const Dtype w_value = w[kh * kernel_w + kw];
+          if (w_value == 0) {
+            continue;
+          }
+          const int offset_w = kw * dilation_w - pad_w;
+          int w_lo, w_hi;
+          valid_input_range(offset_w, stride_w, width, output_w, &w_lo,
+              &w_hi);
+          for (int h = h_lo; h < h_hi; ++h) {
+            const Dtype* in_row = in + h * width;
+            Dtype* out_row = out + (h * stride_h + offset_h) * output_w;
+            for (int x = w_lo; x < w_hi; ++x) {
+              out_row[x * stride_w + offset_w] += w_value * in_row[x];
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+bool DeconvolutionLayer<Dtype>::bilinear_weights_cpu() {
+  const Blob<Dtype>& weights = *this->blobs_[0];
+  if (bilinear_memory_ == weights.data().get() &&
+      bilinear_version_ == weights.data()->version()) {
+    return is_bilinear_;
+  }
+  bilinear_memory_ = weights.data().get();
+  bilinear_version_ = weights.data()->version();
+  is_bilinear_ = false;
+  // Only the channel-wise upsampling set up as documented for BilinearFiller
+  // qualifies.
+  if (this->layer_param_.convolution_param().weight_filler().type() !=
+      "bilinear" || this->num_spatial_axes_ != 2 || this->force_nd_im2col_ ||
+      this->group_ != this->channels_ || this->num_output_ != this->channels_) {
+    return false;
+  }
+  const int kernel_size = this->kernel_shape_.cpu_data()[0];
+  if (this->kernel_shape_.cpu_data()[1] != kernel_size ||
+      this->stride_.cpu_data()[0] != this->stride_.cpu_data()[1] ||
+      this->pad_.cpu_data()[0] != this->pad_.cpu_data()[1] ||
+      this->dilation_.cpu_data()[0] != 1 ||
+      this->dilation_.cpu_data()[1] != 1) {
+    return false;
+  }
+  // The same kernel as BilinearFiller, factored into its 1D halves.
+  const int f = std::ceil(kernel_size / 2.);
+  const Dtype c = (kernel_size - 1) / (2. * f);
+  bilinear_kernel_.resize(kernel_size);
+  for (int k = 0; k < kernel_size; ++k) {
+    bilinear_kernel_[k] = 1 - std::fabs(k / static_cast<Dtype>(f) - c);
+  }
+  const Dtype* w = weights.cpu_data();
+  for (int i = 0; i < weights.count(); ++i) {
+    const int x = i % kernel_size;
+    const int y = (i / kernel_size) % kernel_size;
+    if (std::fabs(w[i] - bilinear_kernel_[y] * bilinear_kernel_[x]) > 1e-6) {
+      return false;
+    }
+  }
+  is_bilinear_ = true;
+  return true;
+}
+
+template <typename Dtype>
+void DeconvolutionLayer<Dtype>::forward_cpu_bilinear(const Dtype* input,
+    Dtype* output) {
+  const int height = this->input_shape(1);
+  const int width = this->input_shape(2);
+  const int output_h = this->output_shape_[0];
+  const int output_w = this->output_shape_[1];
+  const int kernel_size = bilinear_kernel_.size();
+  const int stride = this->stride_.cpu_data()[0];
+  const int pad = this->pad_.cpu_data()[0];
+  const Dtype* kernel = &bilinear_kernel_[0];
+  bilinear_buffer_.Reshape(1, this->channels_, height, output_w);
+  Dtype* buffer = bilinear_buffer_.mutable_cpu_data();
+#ifdef _OPENMP
+#pragma omp parallel for if (this->channels_ > 1 && \
+    static_cast<int64_t>(this->channels_) * output_h * output_w > 65536)
+#endif
+  for (int c = 0; c < this->channels_; ++c) {
+    const Dtype* in = input + c * height * width;
+    Dtype* rows = buffer + c * height * output_w;
+    Dtype* out = output + c * output_h * output_w;
+    // Horizontal pass: upsample every input row to output_w.
+    caffe_set(height * output_w, Dtype(0), rows);
+    for (int k = 0; k < kernel_size; ++k) {
+      const int offset = k - pad;
+      int lo, hi;
+      valid_input_range(offset, stride, width, output_w, &lo, &hi);
+      for (int h = 0; h < height; ++h) {
+        const Dtype* in_row = in + h * width;
+        Dtype* row = rows + h * output_w;
+        for (int x = lo; x < hi; ++x) {
+          row[x * stride + offset] += kernel[k] * in_row[x];
+        }
+      }
+    }
+    // Vertical pass: blend the upsampled rows into the output rows.
+    caffe_set(output_h * output_w, Dtype(0), out);
+    for (int k = 0; k < kernel_size; ++k) {
+      const int offset = k - pad;
+      int lo, hi;
+      valid_input_range(offset, stride, height, output_h, &lo, &hi);
+      for (int h = lo; h < hi; ++h) {
+        const Dtype* row = rows + h * output_w;
+        Dtype* out_row = out + (h * stride + offset) * output_w;
+        for (int x = 0; x < output_w; ++x) {
+          out_row[x] += kernel[k] * row[x];
+        }
+      }
+    }
+  }
+}
+
 #ifdef CPU_ONLY
 STUB_GPU(DeconvolutionLayer);
 #endif
@@ -1,9 +1,11 @@
 // TODO (sergeyk): effect should not be dependent on phase. wasted memcpy.
 
+#include <algorithm>
 #include <vector>
 
 #include "caffe/layers/dropout_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/rng.hpp"
 
 namespace caffe {
 
@@ -24,7 +26,10 @@ void DropoutLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   NeuronLayer<Dtype>::Reshape(bottom, top);
   // Set up the cache for random number generation
   // ReshapeLike does not work because rand_vec_ is of Dtype uint
+  // (Only the mode in use allocates its mask, on first access.)
   rand_vec_.Reshape(bottom[0]->shape());
+  vector<int> mask_shape(1, (bottom[0]->count() + 31) / 32);
+  mask_bits_.Reshape(mask_shape);
 }
 
 template <typename Dtype>
@@ -32,13 +37,32 @@ void DropoutLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  unsigned int* mask = rand_vec_.mutable_cpu_data();
   const int count = bottom[0]->count();
   if (this->phase_ == TRAIN) {
-    // Create random numbers
-    caffe_rng_bernoulli(count, 1. - threshold_, mask);
-    for (int i = 0; i < count; ++i) {
-      top_data[i] = bottom_data[i] * mask[i] * scale_;
+    // Create random numbers, from a counter-based stream keyed by the Caffe
+    // RNG so that the threads can split them, and keep the inputs above the
+    // threshold as Forward_gpu does. Each word of the mask takes 8 blocks of
+    // 4 numbers.
+    const PhiloxStream stream(caffe_rng_seed(), 0);
+    unsigned int* mask = mask_bits_.mutable_cpu_data();
+    const int num_words = mask_bits_.count();
+#ifdef _OPENMP
+#pragma omp parallel for if (static_cast<int64_t>(count) > 32768)
+#endif
+    for (int w = 0; w < num_words; ++w) {
+      uint32_t r[32];
+      for (int j = 0; j < 8; ++j) {
+        stream.Block(8 * w + j, r + 4 * j);
+      }
+      const int offset = 32 * w;
+      const int n = std::min(32, count - offset);
+      unsigned int bits = 0;
+      for (int j = 0; j < n; ++j) {
+        const unsigned int keep = r[j] > uint_thres_;
+        bits |= keep << j;
+        top_data[offset + j] = bottom_data[offset + j] * keep * scale_;
+      }
+      mask[w] = bits;
     }
   } else {
     caffe_copy(bottom[0]->count(), bottom_data, top_data);
@@ -53,10 +77,14 @@ void DropoutLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const Dtype* top_diff = top[0]->cpu_diff();
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
     if (this->phase_ == TRAIN) {
-      const unsigned int* mask = rand_vec_.cpu_data();
+      const unsigned int* mask = mask_bits_.cpu_data();
       const int count = bottom[0]->count();
+#ifdef _OPENMP
+#pragma omp parallel for if (static_cast<int64_t>(count) > 32768)
+#endif
       for (int i = 0; i < count; ++i) {
-        bottom_diff[i] = top_diff[i] * mask[i] * scale_;
+        bottom_diff[i] =
+            top_diff[i] * ((mask[i / 32] >> (i % 32)) & 1) * scale_;
       }
     } else {
       caffe_copy(top[0]->count(), top_diff, bottom_diff);
@@ -1,4 +1,4 @@
-#include <cfloat>
+#include <algorithm>
 #include <vector>
 
 #include "caffe/layers/eltwise_layer.hpp"
@@ -6,6 +6,9 @@
 
 namespace caffe {
 
+// Number of elements per tile in the CPU kernels.
+static const int kEltwiseTileSize = 1024;
+
 template <typename Dtype>
 void EltwiseLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -25,6 +28,7 @@ void EltwiseLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     }
   }
   stable_prod_grad_ = this->layer_param_.eltwise_param().stable_prod_grad();
+  relu_ = this->layer_param_.eltwise_param().relu();
 }
 
 template <typename Dtype>
@@ -46,107 +50,203 @@ void EltwiseLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void EltwiseLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-  int* mask = NULL;
-  const Dtype* bottom_data_a = NULL;
-  const Dtype* bottom_data_b = NULL;
   const int count = top[0]->count();
+  const int num_bottoms = bottom.size();
+  vector<const Dtype*> bottom_data(num_bottoms);
+  bool in_place = false;
+  for (int i = 0; i < num_bottoms; ++i) {
+    bottom_data[i] = bottom[i]->cpu_data();
+    in_place |= (bottom[i] == top[0]);
+  }
   Dtype* top_data = top[0]->mutable_cpu_data();
-  switch (op_) {
-  case EltwiseParameter_EltwiseOp_PROD:
-    caffe_mul(count, bottom[0]->cpu_data(), bottom[1]->cpu_data(), top_data);
-    for (int i = 2; i < bottom.size(); ++i) {
-      caffe_mul(count, top_data, bottom[i]->cpu_data(), top_data);
-    }
-    break;
-  case EltwiseParameter_EltwiseOp_SUM:
-    caffe_set(count, Dtype(0), top_data);
-    // TODO(shelhamer) does BLAS optimize to sum for coeff = 1?
-    for (int i = 0; i < bottom.size(); ++i) {
-      caffe_axpy(count, coeffs_[i], bottom[i]->cpu_data(), top_data);
-    }
-    break;
-  case EltwiseParameter_EltwiseOp_MAX:
-    // Initialize
-    mask = max_idx_.mutable_cpu_data();
-    caffe_set(count, -1, mask);
-    caffe_set(count, Dtype(-FLT_MAX), top_data);
-    // bottom 0 & 1
-    bottom_data_a = bottom[0]->cpu_data();
-    bottom_data_b = bottom[1]->cpu_data();
-    for (int idx = 0; idx < count; ++idx) {
-      if (bottom_data_a[idx] > bottom_data_b[idx]) {
-        top_data[idx] = bottom_data_a[idx];  // maxval
-        mask[idx] = 0;  // maxid
-      } else {
-        top_data[idx] = bottom_data_b[idx];  // maxval
-        mask[idx] = 1;  // maxid
+  // MAX finds the gradient again from the bottoms in Backward, unless the
+  // top overwrites one of them.
+  int* mask = (op_ == EltwiseParameter_EltwiseOp_MAX && in_place) ?
+      max_idx_.mutable_cpu_data() : NULL;
+  // Each tile of the top is combined from all the bottoms (and rectified)
+  // while it stays in cache, so that the top is written to memory once.
+  const int num_tiles = (count + kEltwiseTileSize - 1) / kEltwiseTileSize;
+#ifdef _OPENMP
+#pragma omp parallel for \
+    if (static_cast<int64_t>(count) * num_bottoms > 65536)
+#endif
+  for (int t = 0; t < num_tiles; ++t) {
+    const int offset = t * kEltwiseTileSize;
+    const int n = std::min(kEltwiseTileSize, count - offset);
+    const Dtype* a = bottom_data[0] + offset;
+    const Dtype* b = bottom_data[1] + offset;
+    Dtype* y = top_data + offset;
+    switch (op_) {
+    case EltwiseParameter_EltwiseOp_PROD:
+      for (int j = 0; j < n; ++j) {
+        y[j] = a[j] * b[j];
+      }
+      for (int i = 2; i < num_bottoms; ++i) {
+        const Dtype* x = bottom_data[i] + offset;
+        for (int j = 0; j < n; ++j) {
+          y[j] *= x[j];
+        }
+      }
+      break;
+    case EltwiseParameter_EltwiseOp_SUM: {
+      const Dtype coeff_a = coeffs_[0];
+      const Dtype coeff_b = coeffs_[1];
+      for (int j = 0; j < n; ++j) {
+        y[j] = coeff_a * a[j] + coeff_b * b[j];
+      }
+      for (int i = 2; i < num_bottoms; ++i) {
+        const Dtype* x = bottom_data[i] + offset;
+        const Dtype coeff = coeffs_[i];
+        for (int j = 0; j < n; ++j) {
+          y[j] += coeff * x[j];
+        }
       }
+      break;
     }
-    // bottom 2++
-    for (int blob_idx = 2; blob_idx < bottom.size(); ++blob_idx) {
-      bottom_data_b = bottom[blob_idx]->cpu_data();
-      for (int idx = 0; idx < count; ++idx) {
-        if (bottom_data_b[idx] > top_data[idx]) {
-          top_data[idx] = bottom_data_b[idx];  // maxval
-          mask[idx] = blob_idx;  // maxid
+    case EltwiseParameter_EltwiseOp_MAX:
+      if (mask) {
+        int* m = mask + offset;
+        for (int j = 0; j < n; ++j) {
+          m[j] = a[j] > b[j] ? 0 : 1;
+        }
+        for (int i = 2; i < num_bottoms; ++i) {
+          const Dtype* x = bottom_data[i] + offset;
+          for (int j = 0; j < n; ++j) {
+            const Dtype y_j = m[j] < 2 ? (m[j] ? b[j] : a[j]) :
+                bottom_data[m[j]][offset + j];
+            if (x[j] > y_j) { m[j] = i; }
+          }
         }
+        for (int j = 0; j < n; ++j) {
+          y[j] = bottom_data[m[j]][offset + j];
+        }
+        break;
+      }
+      for (int j = 0; j < n; ++j) {
+        y[j] = a[j] > b[j] ? a[j] : b[j];
+      }
+      for (int i = 2; i < num_bottoms; ++i) {
+        const Dtype* x = bottom_data[i] + offset;
+        for (int j = 0; j < n; ++j) {
+          y[j] = x[j] > y[j] ? x[j] : y[j];
+        }
+      }
+      break;
+    default:
+      LOG(FATAL) << "Unknown elementwise operation.";
+    }
+    if (relu_) {
+      for (int j = 0; j < n; ++j) {
+        y[j] = std::max(y[j], Dtype(0));
       }
     }
-    break;
-  default:
-    LOG(FATAL) << "Unknown elementwise operation.";
   }
 }
 
 template <typename Dtype>
 void EltwiseLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
-  const int* mask = NULL;
   const int count = top[0]->count();
+  const int num_bottoms = bottom.size();
   const Dtype* top_data = top[0]->cpu_data();
+  if (relu_) {
+    // Back through the fused ReLU in place, as the in-place ReLU layer it
+    // stands for would do.
+    Dtype* top_diff = top[0]->mutable_cpu_diff();
+    for (int j = 0; j < count; ++j) {
+      top_diff[j] *= (top_data[j] > 0);
+    }
+  }
   const Dtype* top_diff = top[0]->cpu_diff();
-  for (int i = 0; i < bottom.size(); ++i) {
-    if (propagate_down[i]) {
+  if (op_ == EltwiseParameter_EltwiseOp_PROD) {
+    for (int i = 0; i < num_bottoms; ++i) {
+      if (!propagate_down[i]) { continue; }
       const Dtype* bottom_data = bottom[i]->cpu_data();
       Dtype* bottom_diff = bottom[i]->mutable_cpu_diff();
-      switch (op_) {
-      case EltwiseParameter_EltwiseOp_PROD:
-        if (stable_prod_grad_) {
-          bool initialized = false;
-          for (int j = 0; j < bottom.size(); ++j) {
-            if (i == j) { continue; }
-            if (!initialized) {
-              caffe_copy(count, bottom[j]->cpu_data(), bottom_diff);
-              initialized = true;
-            } else {
-              caffe_mul(count, bottom[j]->cpu_data(), bottom_diff,
-                        bottom_diff);
-            }
+      if (stable_prod_grad_) {
+        bool initialized = false;
+        for (int j = 0; j < num_bottoms; ++j) {
+          if (i == j) { continue; }
+          if (!initialized) {
+            caffe_copy(count, bottom[j]->cpu_data(), bottom_diff);
+            initialized = true;
+          } else {
+            caffe_mul(count, bottom[j]->cpu_data(), bottom_diff,
+                      bottom_diff);
           }
-        } else {
-          caffe_div(count, top_data, bottom_data, bottom_diff);
         }
-        caffe_mul(count, bottom_diff, top_diff, bottom_diff);
-        break;
-      case EltwiseParameter_EltwiseOp_SUM:
-        if (coeffs_[i] == Dtype(1)) {
-          caffe_copy(count, top_diff, bottom_diff);
-        } else {
-          caffe_cpu_scale(count, coeffs_[i], top_diff, bottom_diff);
+      } else {
+        caffe_div(count, top_data, bottom_data, bottom_diff);
+      }
+      caffe_mul(count, bottom_diff, top_diff, bottom_diff);
+    }
+    return;
+  }
+  if (op_ != EltwiseParameter_EltwiseOp_SUM &&
+      op_ != EltwiseParameter_EltwiseOp_MAX) {
+    LOG(FATAL) << "Unknown elementwise operation.";
+  }
+  vector<const Dtype*> bottom_data(num_bottoms, NULL);
+  vector<Dtype*> bottom_diff(num_bottoms, NULL);
+  bool in_place = false;
+  for (int i = 0; i < num_bottoms; ++i) {
+    if (op_ == EltwiseParameter_EltwiseOp_MAX) {
+      bottom_data[i] = bottom[i]->cpu_data();
+      in_place |= (bottom[i] == top[0]);
+    }
+    if (propagate_down[i]) {
+      bottom_diff[i] = bottom[i]->mutable_cpu_diff();
+    }
+  }
+  const int* mask = in_place ? max_idx_.cpu_data() : NULL;
+  // All the bottom diffs are written from each tile of the top diff.
+  const int num_tiles = (count + kEltwiseTileSize - 1) / kEltwiseTileSize;
+#ifdef _OPENMP
+#pragma omp parallel for \
+    if (static_cast<int64_t>(count) * num_bottoms > 65536)
+#endif
+  for (int t = 0; t < num_tiles; ++t) {
+    const int offset = t * kEltwiseTileSize;
+    const int n = std::min(kEltwiseTileSize, count - offset);
+    const Dtype* dy = top_diff + offset;
+    if (op_ == EltwiseParameter_EltwiseOp_SUM) {
+      for (int i = 0; i < num_bottoms; ++i) {
+        if (!bottom_diff[i]) { continue; }
+        Dtype* dx = bottom_diff[i] + offset;
+        const Dtype coeff = coeffs_[i];
+        for (int j = 0; j < n; ++j) {
+          dx[j] = coeff * dy[j];
         }
-        break;
-      case EltwiseParameter_EltwiseOp_MAX:
-        mask = max_idx_.cpu_data();
-        for (int index = 0; index < count; ++index) {
-          Dtype gradient = 0;
-          if (mask[index] == i) {
-            gradient += top_diff[index];
+      }
+      continue;
+    }
+    // The index of the bottom each maximum came from, found as in Forward.
+    int argmax[kEltwiseTileSize];
+    if (mask) {
+      std::copy(mask + offset, mask + offset + n, argmax);
+    } else {
+      const Dtype* a = bottom_data[0] + offset;
+      const Dtype* b = bottom_data[1] + offset;
+      Dtype y[kEltwiseTileSize];
+      for (int j = 0; j < n; ++j) {
+        argmax[j] = a[j] > b[j] ? 0 : 1;
+        y[j] = a[j] > b[j] ? a[j] : b[j];
+      }
+      for (int i = 2; i < num_bottoms; ++i) {
+        const Dtype* x = bottom_data[i] + offset;
+        for (int j = 0; j < n; ++j) {
+          if (x[j] > y[j]) {
+            argmax[j] = i;
+            y[j] = x[j];
           }
-          bottom_diff[index] = gradient;
         }
-        break;
-      default:
-        LOG(FATAL) << "Unknown elementwise operation.";
+      }
+    }
+    for (int i = 0; i < num_bottoms; ++i) {
+      if (!bottom_diff[i]) { continue; }
+      Dtype* dx = bottom_diff[i] + offset;
+      for (int j = 0; j < n; ++j) {
+        dx[j] = argmax[j] == i ? dy[j] : Dtype(0);
       }
     }
   }
@@ -30,6 +30,21 @@ __global__ void MaxForward(const int nthreads, const Dtype* bottom_data_a,
   }
 }
 
+template <typename Dtype>
+__global__ void EltwiseReLUForward(const int n, Dtype* data) {
+  CUDA_KERNEL_LOOP(index, n) {
+    data[index] = data[index] > 0 ? data[index] : Dtype(0);
+  }
+}
+
+template <typename Dtype>
+__global__ void EltwiseReLUBackward(const int n, const Dtype* data,
+    Dtype* diff) {
+  CUDA_KERNEL_LOOP(index, n) {
+    diff[index] *= Dtype(data[index] > 0);
+  }
+}
+
 template <typename Dtype>
 void EltwiseLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
@@ -65,6 +80,12 @@ void EltwiseLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
   default:
     LOG(FATAL) << "Unknown elementwise operation.";
   }
+  if (relu_) {
+    // NOLINT_NEXT_LINE(whitespace/operators)
+    EltwiseReLUForward<Dtype><<<CAFFE_GET_BLOCKS(count),
+        CAFFE_CUDA_NUM_THREADS>>>(count, top_data);
+    CUDA_POST_KERNEL_CHECK;
+  }
 }
 
 template <typename Dtype>
@@ -85,6 +106,14 @@ void EltwiseLayer<Dtype>::Backward_gpu(const vector<Blob<Dtype>*>& top,
   const int* mask = NULL;
   const int count = top[0]->count();
   const Dtype* top_data = top[0]->gpu_data();
+  if (relu_) {
+    // Back through the fused ReLU in place, as the in-place ReLU layer it
+    // stands for would do.
+    // NOLINT_NEXT_LINE(whitespace/operators)
+    EltwiseReLUBackward<Dtype><<<CAFFE_GET_BLOCKS(count),
+        CAFFE_CUDA_NUM_THREADS>>>(count, top_data, top[0]->mutable_gpu_diff());
+    CUDA_POST_KERNEL_CHECK;
+  }
   const Dtype* top_diff = top[0]->gpu_diff();
   for (int i = 0; i < bottom.size(); ++i) {
     if (propagate_down[i]) {
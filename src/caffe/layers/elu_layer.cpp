@@ -1,7 +1,7 @@
-#include <algorithm>
 #include <vector>
 
 #include "caffe/layers/elu_layer.hpp"
+#include "caffe/util/vector_math.hpp"
 
 namespace caffe {
 
@@ -12,10 +12,7 @@ void ELULayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
   Dtype alpha = this->layer_param_.elu_param().alpha();
-  for (int i = 0; i < count; ++i) {
-    top_data[i] = std::max(bottom_data[i], Dtype(0))
-        + alpha * (exp(std::min(bottom_data[i], Dtype(0))) - Dtype(1));
-  }
+  caffe_cpu_velu(count, bottom_data, alpha, top_data);
 }
 
 template <typename Dtype>
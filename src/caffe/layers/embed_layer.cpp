@@ -14,6 +14,7 @@ void EmbedLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   K_ = this->layer_param_.embed_param().input_dim();
   CHECK_GT(K_, 0) << "EmbedLayer input_dim must be positive.";
   bias_term_ = this->layer_param_.embed_param().bias_term();
+  sparse_gradient_ = this->layer_param_.embed_param().sparse_gradient();
   // Check if we need to set up the weights
   if (this->blobs_.size() > 0) {
     LOG(INFO) << "Skipping parameter initialization";
@@ -43,6 +44,8 @@ void EmbedLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     }
   }  // parameter initialization
   this->param_propagate_down_.resize(this->blobs_.size(), true);
+  diff_rows_.clear();
+  diff_row_listed_.assign(sparse_gradient_ ? K_ : 0, false);
 }
 
 template <typename Dtype>
@@ -99,6 +102,10 @@ void EmbedLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       DCHECK_EQ(static_cast<Dtype>(index), bottom_data[n])
           << "non-integer input";
       caffe_axpy(N_, Dtype(1), top_diff + n * N_, weight_diff + index * N_);
+      if (sparse_gradient_ && !diff_row_listed_[index]) {
+        diff_row_listed_[index] = true;
+        diff_rows_.push_back(index);
+      }
     }
   }
   if (bias_term_ && this->param_propagate_down_[1]) {
@@ -109,6 +116,23 @@ void EmbedLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   }
 }
 
+template <typename Dtype>
+const vector<int>* EmbedLayer<Dtype>::param_diff_rows(
+    const int param_id) const {
+  // Backward_gpu keeps the whole weight diff.
+  return (sparse_gradient_ && param_id == 0 && Caffe::mode() == Caffe::CPU) ?
+      &diff_rows_ : NULL;
+}
+
+template <typename Dtype>
+void EmbedLayer<Dtype>::ClearParamDiffRows(const int param_id) {
+  if (param_id != 0) { return; }
+  for (int i = 0; i < diff_rows_.size(); ++i) {
+    diff_row_listed_[diff_rows_[i]] = false;
+  }
+  diff_rows_.clear();
+}
+
 #ifdef CPU_ONLY
 STUB_GPU(EmbedLayer);
 #endif
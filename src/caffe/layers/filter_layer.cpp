@@ -61,16 +61,21 @@ template <typename Dtype>
 void FilterLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   int new_tops_num = indices_to_forward_.size();
-  // forward all filtered items for all bottoms but the Selector (bottom[last])
+  // forward all filtered items for all bottoms but the Selector (bottom[last]),
+  // copying each run of consecutive items at once
   for (int t = 0; t < top.size(); ++t) {
     const Dtype* bottom_data = bottom[t]->cpu_data();
     Dtype* top_data = top[t]->mutable_cpu_data();
     int dim = bottom[t]->count() / bottom[t]->shape(0);
-    for (int n = 0; n < new_tops_num; ++n) {
-      int data_offset_top = n * dim;
-      int data_offset_bottom = indices_to_forward_[n] * bottom[t]->count(1);
-      caffe_copy(dim, bottom_data + data_offset_bottom,
-          top_data + data_offset_top);
+    for (int n = 0; n < new_tops_num;) {
+      int run = 1;
+      while (n + run < new_tops_num &&
+          indices_to_forward_[n + run] == indices_to_forward_[n] + run) {
+        ++run;
+      }
+      caffe_copy(run * dim, bottom_data + indices_to_forward_[n] * dim,
+          top_data + n * dim);
+      n += run;
     }
   }
 }
@@ -82,34 +87,30 @@ void FilterLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     LOG(FATAL) << this->type()
                << "Layer cannot backpropagate to filter index inputs";
   }
+  const int new_tops_num = indices_to_forward_.size();
   for (int i = 0; i < top.size(); i++) {
     // bottom[last] is the selector and never needs backpropagation
     // so we can iterate over top vector because top.size() == bottom.size() -1
     if (propagate_down[i]) {
       const int dim = top[i]->count() / top[i]->shape(0);
-      int next_to_backward_offset = 0;
-      int batch_offset = 0;
-      int data_offset_bottom = 0;
-      int data_offset_top = 0;
-      for (int n = 0; n < bottom[i]->shape(0); n++) {
-        data_offset_bottom = n * dim;
-        if (next_to_backward_offset >= indices_to_forward_.size()) {
-          // we already visited all items that were been forwarded, so
-          // just set to zero remaining ones
-          caffe_set(dim, Dtype(0),
-              bottom[i]->mutable_cpu_diff() + data_offset_bottom);
-        } else {
-          batch_offset = indices_to_forward_[next_to_backward_offset];
-          if (n != batch_offset) {  // this data was not been forwarded
-            caffe_set(dim, Dtype(0),
-                bottom[i]->mutable_cpu_diff() + data_offset_bottom);
-          } else {  // this data was been forwarded
-            data_offset_top = next_to_backward_offset * dim;
-            next_to_backward_offset++;  // point to next forwarded item index
-            caffe_copy(dim, top[i]->mutable_cpu_diff() + data_offset_top,
-                bottom[i]->mutable_cpu_diff() + data_offset_bottom);
-          }
+      const Dtype* top_diff = top[i]->cpu_diff();
+      Dtype* bottom_diff = bottom[i]->mutable_cpu_diff();
+      // Alternate between a run of items that were not forwarded, whose
+      // diff is zero, and a run of items that were.
+      int item = 0;
+      for (int n = 0; n <= new_tops_num;) {
+        const int next = n < new_tops_num ? indices_to_forward_[n] :
+            bottom[i]->shape(0);
+        caffe_set((next - item) * dim, Dtype(0), bottom_diff + item * dim);
+        if (n == new_tops_num) { break; }
+        int run = 1;
+        while (n + run < new_tops_num &&
+            indices_to_forward_[n + run] == next + run) {
+          ++run;
         }
+        caffe_copy(run * dim, top_diff + n * dim, bottom_diff + next * dim);
+        item = next + run;
+        n += run;
       }
     }
   }
@@ -5,27 +5,17 @@
 #include "caffe/layers/infogain_loss_layer.hpp"
 #include "caffe/util/io.hpp"  // for bolb reading of matrix H
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/vector_math.hpp"
 
 namespace caffe {
 
+// Maximum length of the runs of the CPU passes.
+static const int kInfogainRunSize = 256;
+
 template <typename Dtype>
 void InfogainLossLayer<Dtype>::LayerSetUp(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
   LossLayer<Dtype>::LayerSetUp(bottom, top);
-  // internal softmax layer
-  LayerParameter softmax_layer_param(this->layer_param_);
-  SoftmaxParameter* softmax_param = softmax_layer_param.mutable_softmax_param();
-  softmax_param->set_axis(this->layer_param_.infogain_loss_param().axis());
-  softmax_layer_param.set_type("Softmax");
-  softmax_layer_param.clear_loss_weight();
-  softmax_layer_param.add_loss_weight(1);
-  softmax_layer_ = LayerRegistry<Dtype>::CreateLayer(softmax_layer_param);
-  softmax_bottom_vec_.clear();
-  softmax_bottom_vec_.push_back(bottom[0]);
-  softmax_top_vec_.clear();
-  softmax_top_vec_.push_back(&prob_);
-  softmax_layer_->SetUp(softmax_bottom_vec_, softmax_top_vec_);
-
   // ignore label
   has_ignore_label_ =
     this->layer_param_.loss_param().has_ignore_label();
@@ -51,7 +41,6 @@ template <typename Dtype>
 void InfogainLossLayer<Dtype>::Reshape(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
   LossLayer<Dtype>::Reshape(bottom, top);
-  softmax_layer_->Reshape(softmax_bottom_vec_, softmax_top_vec_);
   infogain_axis_ =
     bottom[0]->CanonicalAxisIndex(
       this->layer_param_.infogain_loss_param().axis());
@@ -75,10 +64,17 @@ void InfogainLossLayer<Dtype>::Reshape(
     // H is provided as a parameter and will not change. sum rows once
     sum_rows_of_H(infogain);
   }
-  if (top.size() >= 2) {
+  if (top.size() >= 2 + this->per_sample_loss_) {
     // softmax output
     top[1]->ReshapeLike(*bottom[0]);
   }
+  if (this->per_sample_loss_) {
+    top.back()->Reshape(vector<int>(1, outer_num_));
+  }
+  vector<int> log_norm_shape(2);
+  log_norm_shape[0] = outer_num_;
+  log_norm_shape[1] = inner_num_;
+  log_norm_.Reshape(log_norm_shape);
 }
 
 template <typename Dtype>
@@ -128,9 +124,10 @@ void InfogainLossLayer<Dtype>::sum_rows_of_H(const Blob<Dtype>* H) {
 template <typename Dtype>
 void InfogainLossLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
-  // The forward pass computes the softmax prob values.
-  softmax_layer_->Forward(softmax_bottom_vec_, softmax_top_vec_);
-  const Dtype* prob_data = prob_.cpu_data();
+  // log(p_l) = x_l - log(sum_c exp(x_c)), so as in SoftmaxWithLossLayer only
+  // the normalizer of each position is computed, and only for the positions
+  // that are not ignored unless the probabilities are wanted.
+  const Dtype* bottom_data = bottom[0]->cpu_data();
   const Dtype* bottom_label = bottom[1]->cpu_data();
   const Dtype* infogain_mat = NULL;
   if (bottom.size() < 3) {
@@ -138,29 +135,69 @@ void InfogainLossLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   } else {
     infogain_mat = bottom[2]->cpu_data();
   }
-  int count = 0;
-  Dtype loss = 0;
-  for (int i = 0; i < outer_num_; ++i) {
-    for (int j = 0; j < inner_num_; j++) {
-      const int label_value =
-        static_cast<int>(bottom_label[i * inner_num_ + j]);
+  Dtype* log_norm = log_norm_.mutable_cpu_data();
+  Dtype* prob_data = top.size() >= 2 + this->per_sample_loss_ ?
+      top[1]->mutable_cpu_data() : NULL;
+  const int dim = num_labels_ * inner_num_;
+  const int num_positions = outer_num_ * inner_num_;
+  valid_count_ = this->FindLabelRuns(bottom_label, num_positions, inner_num_,
+      kInfogainRunSize, has_ignore_label_, ignore_label_, &valid_runs_);
+  vector<int> all_runs;
+  if (prob_data && valid_count_ < num_positions) {
+    this->FindLabelRuns(bottom_label, num_positions, inner_num_,
+        kInfogainRunSize, false, 0, &all_runs);
+  }
+  const vector<int>& runs = all_runs.empty() ? valid_runs_ : all_runs;
+  const int num_runs = runs.size() / 2;
+  run_loss_.resize(num_runs);
+  const Dtype log_threshold = log(Dtype(kLOG_THRESHOLD));
+#ifdef _OPENMP
+#pragma omp parallel for if (static_cast<int64_t>(bottom[0]->count()) > 32768)
+#endif
+  for (int r = 0; r < num_runs; ++r) {
+    const int begin = runs[2 * r];
+    const int len = runs[2 * r + 1] - begin;
+    const Dtype* x = bottom_data + (begin / inner_num_) * dim +
+        begin % inner_num_;
+    Dtype* norm = log_norm + begin;
+    caffe_cpu_log_sum_exp(num_labels_, len, inner_num_, x, norm);
+    Dtype loss = 0;
+    for (int k = 0; k < len; ++k) {
+      const int label_value = static_cast<int>(bottom_label[begin + k]);
       if (has_ignore_label_ && label_value == ignore_label_) {
         continue;
       }
       DCHECK_GE(label_value, 0);
       DCHECK_LT(label_value, num_labels_);
-      for (int l = 0; l < num_labels_; l++) {
-        loss -= infogain_mat[label_value * num_labels_ + l] *
-          log(std::max(
-                prob_data[i * inner_num_*num_labels_ + l * inner_num_ + j],
-                Dtype(kLOG_THRESHOLD)));
+      const Dtype* h = infogain_mat + label_value * num_labels_;
+      for (int l = 0; l < num_labels_; ++l) {
+        loss -= h[l] * std::max(x[l * inner_num_ + k] - norm[k],
+                                log_threshold);
+      }
+    }
+    run_loss_[r] = loss;
+    if (prob_data) {
+      Dtype* prob = prob_data + (x - bottom_data);
+      for (int l = 0; l < num_labels_; ++l) {
+        for (int k = 0; k < len; ++k) {
+          prob[l * inner_num_ + k] = x[l * inner_num_ + k] - norm[k];
+        }
+        caffe_cpu_vexp(len, prob + l * inner_num_, prob + l * inner_num_);
       }
-      ++count;
     }
   }
-  top[0]->mutable_cpu_data()[0] = loss / get_normalizer(normalization_, count);
-  if (top.size() == 2) {
-    top[1]->ShareData(prob_);
+  Dtype loss = 0;
+  for (int r = 0; r < num_runs; ++r) {
+    loss += run_loss_[r];
+  }
+  top[0]->mutable_cpu_data()[0] =
+      loss / get_normalizer(normalization_, valid_count_);
+  if (this->per_sample_loss_) {
+    Dtype* sample_loss = top.back()->mutable_cpu_data();
+    caffe_set(outer_num_, Dtype(0), sample_loss);
+    for (int r = 0; r < num_runs; ++r) {
+      sample_loss[runs[2 * r] / inner_num_] += run_loss_[r];
+    }
   }
 }
 
@@ -177,7 +214,7 @@ void InfogainLossLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
                << " Layer cannot backpropagate to infogain inputs.";
   }
   if (propagate_down[0]) {
-    const Dtype* prob_data = prob_.cpu_data();
+    const Dtype* bottom_data = bottom[0]->cpu_data();
     const Dtype* bottom_label = bottom[1]->cpu_data();
     const Dtype* infogain_mat = NULL;
     if (bottom.size() < 3) {
@@ -188,33 +225,45 @@ void InfogainLossLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       sum_rows_of_H(bottom[2]);
     }
     const Dtype* sum_rows_H = sum_rows_H_.cpu_data();
+    const Dtype* log_norm = log_norm_.cpu_data();
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-    const int dim = bottom[0]->count() / outer_num_;
-    int count = 0;
-    for (int i = 0; i < outer_num_; ++i) {
-      for (int j = 0; j < inner_num_; ++j) {
-        const int label_value =
-          static_cast<int>(bottom_label[i * inner_num_ + j]);
+    const int dim = num_labels_ * inner_num_;
+    const Dtype loss_weight = top[0]->cpu_diff()[0] /
+                              get_normalizer(normalization_, valid_count_);
+    // The gradient is loss_weight * (p_l * sum_k H_label,k - H_label,l), and
+    // 0 at the ignored positions, which the runs of the forward pass skip.
+    if (valid_count_ < outer_num_ * inner_num_) {
+      caffe_set(bottom[0]->count(), Dtype(0), bottom_diff);
+    }
+    const int num_runs = valid_runs_.size() / 2;
+#ifdef _OPENMP
+#pragma omp parallel for if (static_cast<int64_t>(bottom[0]->count()) > 32768)
+#endif
+    for (int r = 0; r < num_runs; ++r) {
+      const int begin = valid_runs_[2 * r];
+      const int len = valid_runs_[2 * r + 1] - begin;
+      const int offset = (begin / inner_num_) * dim + begin % inner_num_;
+      const Dtype* x = bottom_data + offset;
+      Dtype* dx = bottom_diff + offset;
+      const Dtype* norm = log_norm + begin;
+      for (int l = 0; l < num_labels_; ++l) {
+        for (int k = 0; k < len; ++k) {
+          dx[l * inner_num_ + k] = x[l * inner_num_ + k] - norm[k];
+        }
+        caffe_cpu_vexp(len, dx + l * inner_num_, dx + l * inner_num_);
+      }
+      for (int k = 0; k < len; ++k) {
+        const int label_value = static_cast<int>(bottom_label[begin + k]);
         DCHECK_GE(label_value, 0);
         DCHECK_LT(label_value, num_labels_);
-        if (has_ignore_label_ && label_value == ignore_label_) {
-          for (int l = 0; l < num_labels_; ++l) {
-            bottom_diff[i * dim + l * inner_num_ + j] = 0;
-          }
-        } else {
-          for (int l = 0; l < num_labels_; ++l) {
-            bottom_diff[i * dim + l * inner_num_ + j] =
-               prob_data[i*dim + l*inner_num_ + j]*sum_rows_H[label_value]
-               - infogain_mat[label_value * num_labels_ + l];
-          }
-          ++count;
+        const Dtype* h = infogain_mat + label_value * num_labels_;
+        const Dtype sum_h = sum_rows_H[label_value];
+        for (int l = 0; l < num_labels_; ++l) {
+          dx[l * inner_num_ + k] =
+              (dx[l * inner_num_ + k] * sum_h - h[l]) * loss_weight;
         }
       }
     }
-    // Scale gradient
-    Dtype loss_weight = top[0]->cpu_diff()[0] /
-                        get_normalizer(normalization_, count);
-    caffe_scal(bottom[0]->count(), loss_weight, bottom_diff);
   }
 }
 
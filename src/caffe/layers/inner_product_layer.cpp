@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "caffe/filler.hpp"
@@ -12,6 +14,7 @@ void InnerProductLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   const int num_output = this->layer_param_.inner_product_param().num_output();
   bias_term_ = this->layer_param_.inner_product_param().bias_term();
   transpose_ = this->layer_param_.inner_product_param().transpose();
+  activation_ = this->layer_param_.inner_product_param().activation();
   N_ = num_output;
   const int axis = bottom[0]->CanonicalAxisIndex(
       this->layer_param_.inner_product_param().axis());
@@ -19,6 +22,12 @@ void InnerProductLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   // length K_ vector. For example, if bottom[0]'s shape is (N, C, H, W),
   // and axis == 1, N inner products with dimension CHW are performed.
   K_ = bottom[0]->count(axis);
+  if (this->phase_ == TEST &&
+      this->layer_param_.quantization_param().precision() ==
+      QuantizationParameter_Precision_INT8) {
+    CHECK_LE(K_, kInt8GemmMaxK) << "Too many inputs per output for the "
+        << "int32 accumulators of INT8 precision.";
+  }
   // Check if we need to set up the weights
   if (this->blobs_.size() > 0) {
     LOG(INFO) << "Skipping parameter initialization";
@@ -86,20 +95,145 @@ void InnerProductLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const Dtype* weight = this->blobs_[0]->cpu_data();
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, transpose_ ? CblasNoTrans : CblasTrans,
-      M_, N_, K_, (Dtype)1.,
-      bottom_data, weight, (Dtype)0., top_data);
-  if (bias_term_) {
+  bool bias_added = false;
+  if (this->phase_ == TEST &&
+      this->layer_param_.quantization_param().precision() ==
+      QuantizationParameter_Precision_INT8) {
+    forward_cpu_int8(bottom, top);
+    bias_added = true;
+  } else if (this->phase_ == TEST && sparse_weight_cpu()) {
+    caffe_cpu_gemm_csr_t(M_, bottom_data, sparse_weight_, top_data);
+  } else if (M_ == 1) {
+    // A single input is a matrix-vector product; start from the bias so that
+    // it is added by the same pass.
+    if (bias_term_) {
+      caffe_copy(N_, this->blobs_[1]->cpu_data(), top_data);
+    }
+    caffe_cpu_gemv<Dtype>(transpose_ ? CblasTrans : CblasNoTrans,
+        transpose_ ? K_ : N_, transpose_ ? N_ : K_, (Dtype)1., weight,
+        bottom_data, (Dtype)(bias_term_ ? 1. : 0.), top_data);
+    bias_added = true;
+  } else if (this->phase_ == TEST) {
+    // The weights are constant at inference, so pack them once and reuse the
+    // packed copy until the weight blob is written again.
+    if (!packed_weight_.IsPackedFrom(*this->blobs_[0])) {
+      packed_weight_.PackB(transpose_ ? CblasNoTrans : CblasTrans, K_, N_,
+          *this->blobs_[0]);
+    }
+    caffe_cpu_gemm_packed_b<Dtype>(CblasNoTrans, M_, (Dtype)1., bottom_data,
+        packed_weight_, (Dtype)0., top_data);
+  } else {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, transpose_ ? CblasNoTrans : CblasTrans,
+        M_, N_, K_, (Dtype)1.,
+        bottom_data, weight, (Dtype)0., top_data);
+  }
+  if (bias_term_ && !bias_added) {
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M_, N_, 1, (Dtype)1.,
         bias_multiplier_.cpu_data(),
         this->blobs_[1]->cpu_data(), (Dtype)1., top_data);
   }
+  if (activation_ != InnerProductParameter_Activation_NONE) {
+    activation_forward_cpu(top[0]->count(), top_data);
+  }
+}
+
+template <typename Dtype>
+bool InnerProductLayer<Dtype>::sparse_weight_cpu() {
+  // The weights are constant at inference, so convert them to sparse format
+  // once (for pruned models) and reuse that copy until the weight blob is
+  // written again.
+  if (!sparse_weight_.IsConvertedFrom(*this->blobs_[0])) {
+    sparse_weight_.Convert(*this->blobs_[0], transpose_, N_, K_,
+        this->layer_param_.inner_product_param().sparsity_threshold());
+  }
+  return sparse_weight_.is_sparse();
+}
+
+template <typename Dtype>
+void InnerProductLayer<Dtype>::activation_forward_cpu(const int count,
+    Dtype* data) {
+  if (activation_ == InnerProductParameter_Activation_RELU) {
+    for (int i = 0; i < count; ++i) {
+      data[i] = std::max(data[i], Dtype(0));
+    }
+  } else if (activation_ == InnerProductParameter_Activation_SIGMOID) {
+    for (int i = 0; i < count; ++i) {
+      data[i] = 0.5 * tanh(0.5 * data[i]) + 0.5;
+    }
+  }
+}
+
+template <typename Dtype>
+void InnerProductLayer<Dtype>::activation_backward_cpu(const int count,
+    const Dtype* data, Dtype* diff) {
+  if (activation_ == InnerProductParameter_Activation_RELU) {
+    for (int i = 0; i < count; ++i) {
+      diff[i] *= (data[i] > 0);
+    }
+  } else if (activation_ == InnerProductParameter_Activation_SIGMOID) {
+    for (int i = 0; i < count; ++i) {
+      diff[i] *= data[i] * (1. - data[i]);
+    }
+  }
+}
+
+template <typename Dtype>
+void InnerProductLayer<Dtype>::forward_cpu_int8(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const QuantizationParameter& quant_param =
+      this->layer_param_.quantization_param();
+  if (!int8_weight_.IsQuantizedFrom(*this->blobs_[0])) {
+    const vector<float> weight_scale(quant_param.weight_scale().begin(),
+        quant_param.weight_scale().end());
+    int8_weight_.Quantize(*this->blobs_[0], transpose_, N_, K_, weight_scale);
+  }
+  // Quantize the input transposed to K_ x M_ so that the product with the
+  // N_ x K_ weights runs along contiguous rows.
+  const float input_scale = quant_param.input_scale();
+  const int zero_point = quant_param.input_zero_point();
+  int8_input_.resize(K_ * M_);
+  int8_output_.resize(N_ * M_);
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  for (int m = 0; m < M_; ++m) {
+    caffe_cpu_quantize_u8(K_, bottom_data + m * K_, input_scale, zero_point,
+        &int8_input_[m * K_]);
+  }
+  if (M_ > 1) {
+    vector<uint8_t> row_major(int8_input_);
+    for (int m = 0; m < M_; ++m) {
+      for (int k = 0; k < K_; ++k) {
+        int8_input_[k * M_ + m] = row_major[m * K_ + k];
+      }
+    }
+  }
+  caffe_cpu_gemm_s8u8s32(N_, M_, K_, int8_weight_.data(), &int8_input_[0],
+      &int8_output_[0]);
+  // Requantize the int32 accumulators back to Dtype and add the bias.
+  const float* weight_scale = int8_weight_.scales();
+  const int32_t* row_sums = int8_weight_.row_sums();
+  const Dtype* bias = bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  for (int n = 0; n < N_; ++n) {
+    const Dtype scale = input_scale * weight_scale[n];
+    const int32_t offset = zero_point * row_sums[n];
+    const Dtype b = bias ? bias[n] : Dtype(0);
+    const int32_t* acc = &int8_output_[n * M_];
+    for (int m = 0; m < M_; ++m) {
+      top_data[m * N_ + n] = scale * (acc[m] - offset) + b;
+    }
+  }
 }
 
 template <typename Dtype>
 void InnerProductLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down,
     const vector<Blob<Dtype>*>& bottom) {
+  if (activation_ != InnerProductParameter_Activation_NONE) {
+    // Back through the fused activation in place, as the in-place activation
+    // layer it stands for would do.
+    activation_backward_cpu(top[0]->count(), top[0]->cpu_data(),
+        top[0]->mutable_cpu_diff());
+  }
   if (this->param_propagate_down_[0]) {
     const Dtype* top_diff = top[0]->cpu_diff();
     const Dtype* bottom_data = bottom[0]->cpu_data();
@@ -6,6 +6,44 @@
 
 namespace caffe {
 
+template <typename Dtype>
+__global__ void IPActivationForward(const int n, const bool relu,
+    Dtype* data) {
+  CUDA_KERNEL_LOOP(index, n) {
+    data[index] = relu ? (data[index] > 0 ? data[index] : Dtype(0))
+        : Dtype(0.5) * tanh(Dtype(0.5) * data[index]) + Dtype(0.5);
+  }
+}
+
+template <typename Dtype>
+__global__ void IPActivationBackward(const int n, const bool relu,
+    const Dtype* data, Dtype* diff) {
+  CUDA_KERNEL_LOOP(index, n) {
+    diff[index] *= relu ? Dtype(data[index] > 0)
+        : data[index] * (Dtype(1) - data[index]);
+  }
+}
+
+template <typename Dtype>
+void InnerProductLayer<Dtype>::activation_forward_gpu(const int count,
+    Dtype* data) {
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  IPActivationForward<Dtype><<<CAFFE_GET_BLOCKS(count),
+      CAFFE_CUDA_NUM_THREADS>>>(count,
+      activation_ == InnerProductParameter_Activation_RELU, data);
+  CUDA_POST_KERNEL_CHECK;
+}
+
+template <typename Dtype>
+void InnerProductLayer<Dtype>::activation_backward_gpu(const int count,
+    const Dtype* data, Dtype* diff) {
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  IPActivationBackward<Dtype><<<CAFFE_GET_BLOCKS(count),
+      CAFFE_CUDA_NUM_THREADS>>>(count,
+      activation_ == InnerProductParameter_Activation_RELU, data, diff);
+  CUDA_POST_KERNEL_CHECK;
+}
+
 template <typename Dtype>
 void InnerProductLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
@@ -13,7 +51,8 @@ void InnerProductLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
   Dtype* top_data = top[0]->mutable_gpu_data();
   const Dtype* weight = this->blobs_[0]->gpu_data();
   if (M_ == 1) {
-    caffe_gpu_gemv<Dtype>(CblasNoTrans, N_, K_, (Dtype)1.,
+    caffe_gpu_gemv<Dtype>(transpose_ ? CblasTrans : CblasNoTrans,
+                         transpose_ ? K_ : N_, transpose_ ? N_ : K_, (Dtype)1.,
                          weight, bottom_data, (Dtype)0., top_data);
     if (bias_term_)
       caffe_gpu_axpy<Dtype>(N_, bias_multiplier_.cpu_data()[0],
@@ -28,12 +67,19 @@ void InnerProductLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
                             bias_multiplier_.gpu_data(),
                             this->blobs_[1]->gpu_data(), (Dtype)1., top_data);
   }
+  if (activation_ != InnerProductParameter_Activation_NONE) {
+    activation_forward_gpu(top[0]->count(), top_data);
+  }
 }
 
 template <typename Dtype>
 void InnerProductLayer<Dtype>::Backward_gpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down,
     const vector<Blob<Dtype>*>& bottom) {
+  if (activation_ != InnerProductParameter_Activation_NONE) {
+    activation_backward_gpu(top[0]->count(), top[0]->gpu_data(),
+        top[0]->mutable_gpu_diff());
+  }
   if (this->param_propagate_down_[0]) {
     const Dtype* top_diff = top[0]->gpu_diff();
     const Dtype* bottom_data = bottom[0]->gpu_data();
@@ -7,10 +7,17 @@ namespace caffe {
 template <typename Dtype>
 void LossLayer<Dtype>::LayerSetUp(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-  // LossLayers have a non-zero (1) loss by default.
+  // LossLayers have a non-zero (1) loss by default; any further tops (the
+  // probabilities, the per-sample losses) are outputs, not losses.
   if (this->layer_param_.loss_weight_size() == 0) {
     this->layer_param_.add_loss_weight(Dtype(1));
+    for (int i = 1; i < top.size(); ++i) {
+      this->layer_param_.add_loss_weight(Dtype(0));
+    }
   }
+  per_sample_loss_ = this->layer_param_.loss_param().per_sample_loss();
+  CHECK(!per_sample_loss_ || top.size() >= 2)
+      << "per_sample_loss needs a top for the losses of the samples.";
 }
 
 template <typename Dtype>
@@ -22,6 +29,35 @@ void LossLayer<Dtype>::Reshape(
   top[0]->Reshape(loss_shape);
 }
 
+template <typename Dtype>
+int LossLayer<Dtype>::FindLabelRuns(const Dtype* label, const int count,
+    const int sample_size, const int max_len, const bool has_ignore_label,
+    const int ignore_label, vector<int>* runs) {
+  runs->clear();
+  int num_valid = 0;
+  for (int sample = 0; sample < count; sample += sample_size) {
+    const int sample_end = sample + sample_size;
+    int begin = sample;
+    while (begin < sample_end) {
+      if (has_ignore_label && static_cast<int>(label[begin]) == ignore_label) {
+        ++begin;
+        continue;
+      }
+      int end = begin + 1;
+      while (end < sample_end && end - begin < max_len &&
+             !(has_ignore_label &&
+               static_cast<int>(label[end]) == ignore_label)) {
+        ++end;
+      }
+      runs->push_back(begin);
+      runs->push_back(end);
+      num_valid += end - begin;
+      begin = end;
+    }
+  }
+  return num_valid;
+}
+
 INSTANTIATE_CLASS(LossLayer);
 
 }  // namespace caffe
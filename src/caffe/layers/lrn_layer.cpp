@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "caffe/layers/lrn_layer.hpp"
@@ -5,6 +7,84 @@
 
 namespace caffe {
 
+// The number of spatial positions processed together by the CPU kernels of
+// ACROSS_CHANNELS normalization: the window sliding over the channels of one
+// tile stays in L1 cache.
+static const int kLRNTileSize = 256;
+
+// Returns pow(x, -beta), taking two square roots for the default beta = 0.75.
+template <typename Dtype>
+inline Dtype lrn_negative_pow(const Dtype x, const Dtype beta,
+    const bool three_quarters) {
+  if (three_quarters) {
+    const Dtype r = 1 / std::sqrt(x);
+    return r * std::sqrt(r);
+  }
+  return std::pow(x, -beta);
+}
+
+// The values summed over the window of WITHIN_CHANNEL normalization: the
+// squared inputs in forward and top_diff * top_data / scale in backward.
+template <typename Dtype>
+struct LRNSquareOp {
+  explicit LRNSquareOp(const Dtype* x) : x_(x) {}
+  inline Dtype operator()(const int i) const { return x_[i] * x_[i]; }
+  const Dtype* x_;
+};
+
+template <typename Dtype>
+struct LRNRatioOp {
+  LRNRatioOp(const Dtype* top_diff, const Dtype* top_data,
+      const Dtype* scale)
+      : top_diff_(top_diff), top_data_(top_data), scale_(scale) {}
+  inline Dtype operator()(const int i) const {
+    return top_diff_[i] * top_data_[i] / scale_[i];
+  }
+  const Dtype* top_diff_;
+  const Dtype* top_data_;
+  const Dtype* scale_;
+};
+
+// Sums op over the size x size window around every pixel of a height x width
+// plane, with zero padding, in one pass: a window slides down the columns,
+// accumulating in colsum (width entries), and along each row of colsum.
+template <typename Dtype, typename Op>
+static void lrn_window_sum(const int height, const int width, const int size,
+    const Op& op, Dtype* colsum, Dtype* out) {
+  const int pad = (size - 1) / 2;
+  std::fill(colsum, colsum + width, Dtype(0));
+  for (int h = 0; h < std::min(pad, height); ++h) {
+    for (int w = 0; w < width; ++w) {
+      colsum[w] += op(h * width + w);
+    }
+  }
+  for (int h = 0; h < height; ++h) {
+    if (h + pad < height) {
+      for (int w = 0; w < width; ++w) {
+        colsum[w] += op((h + pad) * width + w);
+      }
+    }
+    Dtype sum = 0;
+    for (int w = 0; w < std::min(pad, width); ++w) {
+      sum += colsum[w];
+    }
+    for (int w = 0; w < width; ++w) {
+      if (w + pad < width) {
+        sum += colsum[w + pad];
+      }
+      out[h * width + w] = sum;
+      if (w - pad >= 0) {
+        sum -= colsum[w - pad];
+      }
+    }
+    if (h - pad >= 0) {
+      for (int w = 0; w < width; ++w) {
+        colsum[w] -= op((h - pad) * width + w);
+      }
+    }
+  }
+}
+
 template <typename Dtype>
 void LRNLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -14,55 +94,6 @@ void LRNLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   alpha_ = this->layer_param_.lrn_param().alpha();
   beta_ = this->layer_param_.lrn_param().beta();
   k_ = this->layer_param_.lrn_param().k();
-  if (this->layer_param_.lrn_param().norm_region() ==
-      LRNParameter_NormRegion_WITHIN_CHANNEL) {
-    // Set up split_layer_ to use inputs in the numerator and denominator.
-    split_top_vec_.clear();
-    split_top_vec_.push_back(&product_input_);
-    split_top_vec_.push_back(&square_input_);
-    LayerParameter split_param;
-    split_layer_.reset(new SplitLayer<Dtype>(split_param));
-    split_layer_->SetUp(bottom, split_top_vec_);
-    // Set up square_layer_ to square the inputs.
-    square_bottom_vec_.clear();
-    square_top_vec_.clear();
-    square_bottom_vec_.push_back(&square_input_);
-    square_top_vec_.push_back(&square_output_);
-    LayerParameter square_param;
-    square_param.mutable_power_param()->set_power(Dtype(2));
-    square_layer_.reset(new PowerLayer<Dtype>(square_param));
-    square_layer_->SetUp(square_bottom_vec_, square_top_vec_);
-    // Set up pool_layer_ to sum over square neighborhoods of the input.
-    pool_top_vec_.clear();
-    pool_top_vec_.push_back(&pool_output_);
-    LayerParameter pool_param;
-    pool_param.mutable_pooling_param()->set_pool(
-        PoolingParameter_PoolMethod_AVE);
-    pool_param.mutable_pooling_param()->set_pad(pre_pad_);
-    pool_param.mutable_pooling_param()->set_kernel_size(size_);
-    pool_layer_.reset(new PoolingLayer<Dtype>(pool_param));
-    pool_layer_->SetUp(square_top_vec_, pool_top_vec_);
-    // Set up power_layer_ to compute (1 + alpha_/N^2 s)^-beta_, where s is
-    // the sum of a squared neighborhood (the output of pool_layer_).
-    power_top_vec_.clear();
-    power_top_vec_.push_back(&power_output_);
-    LayerParameter power_param;
-    power_param.mutable_power_param()->set_power(-beta_);
-    power_param.mutable_power_param()->set_scale(alpha_);
-    power_param.mutable_power_param()->set_shift(Dtype(1));
-    power_layer_.reset(new PowerLayer<Dtype>(power_param));
-    power_layer_->SetUp(pool_top_vec_, power_top_vec_);
-    // Set up a product_layer_ to compute outputs by multiplying inputs by the
-    // inverse demoninator computed by the power layer.
-    product_bottom_vec_.clear();
-    product_bottom_vec_.push_back(&product_input_);
-    product_bottom_vec_.push_back(&power_output_);
-    LayerParameter product_param;
-    EltwiseParameter* eltwise_param = product_param.mutable_eltwise_param();
-    eltwise_param->set_operation(EltwiseParameter_EltwiseOp_PROD);
-    product_layer_.reset(new EltwiseLayer<Dtype>(product_param));
-    product_layer_->SetUp(product_bottom_vec_, top);
-  }
 }
 
 template <typename Dtype>
@@ -74,21 +105,64 @@ void LRNLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   channels_ = bottom[0]->channels();
   height_ = bottom[0]->height();
   width_ = bottom[0]->width();
-  switch (this->layer_param_.lrn_param().norm_region()) {
-  case LRNParameter_NormRegion_ACROSS_CHANNELS:
-    top[0]->Reshape(num_, channels_, height_, width_);
-    scale_.Reshape(num_, channels_, height_, width_);
-    break;
-  case LRNParameter_NormRegion_WITHIN_CHANNEL:
-    split_layer_->Reshape(bottom, split_top_vec_);
-    square_layer_->Reshape(square_bottom_vec_, square_top_vec_);
-    pool_layer_->Reshape(square_top_vec_, pool_top_vec_);
-    power_layer_->Reshape(pool_top_vec_, power_top_vec_);
-    product_layer_->Reshape(product_bottom_vec_, top);
-    break;
-  }
+  top[0]->Reshape(num_, channels_, height_, width_);
+  // scale_ keeps the denominators of the CPU forward pass for backward; the
+  // WITHIN_CHANNEL sub-layers of the GPU path are reshaped as they run.
+  scale_.Reshape(num_, channels_, height_, width_);
+}
+
+template <typename Dtype>
+void LRNLayer<Dtype>::WithinChannelSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  // Set up split_layer_ to use inputs in the numerator and denominator.
+  split_top_vec_.clear();
+  split_top_vec_.push_back(&product_input_);
+  split_top_vec_.push_back(&square_input_);
+  LayerParameter split_param;
+  split_layer_.reset(new SplitLayer<Dtype>(split_param));
+  split_layer_->SetUp(bottom, split_top_vec_);
+  // Set up square_layer_ to square the inputs.
+  square_bottom_vec_.clear();
+  square_top_vec_.clear();
+  square_bottom_vec_.push_back(&square_input_);
+  square_top_vec_.push_back(&square_output_);
+  LayerParameter square_param;
+  square_param.mutable_power_param()->set_power(Dtype(2));
+  square_layer_.reset(new PowerLayer<Dtype>(square_param));
+  square_layer_->SetUp(square_bottom_vec_, square_top_vec_);
+  // Set up pool_layer_ to sum over square neighborhoods of the input.
+  pool_top_vec_.clear();
+  pool_top_vec_.push_back(&pool_output_);
+  LayerParameter pool_param;
+  pool_param.mutable_pooling_param()->set_pool(
+      PoolingParameter_PoolMethod_AVE);
+  pool_param.mutable_pooling_param()->set_pad(pre_pad_);
+  pool_param.mutable_pooling_param()->set_kernel_size(size_);
+  pool_layer_.reset(new PoolingLayer<Dtype>(pool_param));
+  pool_layer_->SetUp(square_top_vec_, pool_top_vec_);
+  // Set up power_layer_ to compute (1 + alpha_/N^2 s)^-beta_, where s is
+  // the sum of a squared neighborhood (the output of pool_layer_).
+  power_top_vec_.clear();
+  power_top_vec_.push_back(&power_output_);
+  LayerParameter power_param;
+  power_param.mutable_power_param()->set_power(-beta_);
+  power_param.mutable_power_param()->set_scale(alpha_);
+  power_param.mutable_power_param()->set_shift(Dtype(1));
+  power_layer_.reset(new PowerLayer<Dtype>(power_param));
+  power_layer_->SetUp(pool_top_vec_, power_top_vec_);
+  // Set up a product_layer_ to compute outputs by multiplying inputs by the
+  // inverse demoninator computed by the power layer.
+  product_bottom_vec_.clear();
+  product_bottom_vec_.push_back(&product_input_);
+  product_bottom_vec_.push_back(&power_output_);
+  LayerParameter product_param;
+  EltwiseParameter* eltwise_param = product_param.mutable_eltwise_param();
+  eltwise_param->set_operation(EltwiseParameter_EltwiseOp_PROD);
+  product_layer_.reset(new EltwiseLayer<Dtype>(product_param));
+  product_layer_->SetUp(product_bottom_vec_, top);
 }
 
+
 template <typename Dtype>
 void LRNLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
@@ -97,7 +171,7 @@ void LRNLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     CrossChannelForward_cpu(bottom, top);
     break;
   case LRNParameter_NormRegion_WITHIN_CHANNEL:
-    WithinChannelForward(bottom, top);
+    WithinChannelForward_cpu(bottom, top);
     break;
   default:
     LOG(FATAL) << "Unknown normalization region.";
@@ -110,50 +184,96 @@ void LRNLayer<Dtype>::CrossChannelForward_cpu(
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   Dtype* scale_data = scale_.mutable_cpu_data();
-  // start with the constant value
-  for (int i = 0; i < scale_.count(); ++i) {
-    scale_data[i] = k_;
-  }
-  Blob<Dtype> padded_square(1, channels_ + size_ - 1, height_, width_);
-  Dtype* padded_square_data = padded_square.mutable_cpu_data();
-  caffe_set(padded_square.count(), Dtype(0), padded_square_data);
-  Dtype alpha_over_size = alpha_ / size_;
-  // go through the images
-  for (int n = 0; n < num_; ++n) {
-    // compute the padded square
-    caffe_sqr(channels_ * height_ * width_,
-        bottom_data + bottom[0]->offset(n),
-        padded_square_data + padded_square.offset(0, pre_pad_));
-    // Create the first channel scale
-    for (int c = 0; c < size_; ++c) {
-      caffe_axpy<Dtype>(height_ * width_, alpha_over_size,
-          padded_square_data + padded_square.offset(0, c),
-          scale_data + scale_.offset(n, 0));
+  const int spatial_dim = height_ * width_;
+  const int num_tiles = (spatial_dim + kLRNTileSize - 1) / kLRNTileSize;
+  const Dtype alpha_over_size = alpha_ / size_;
+  const bool three_quarters = (beta_ == Dtype(0.75));
+  // Slide the window of squares over the channels of one tile of positions
+  // at a time, computing the scale and the output in the same pass.
+#ifdef _OPENMP
+#pragma omp parallel for if (static_cast<int64_t>(scale_.count()) > 32768)
+#endif
+  for (int t = 0; t < num_ * num_tiles; ++t) {
+    const int n = t / num_tiles;
+    const int begin = (t % num_tiles) * kLRNTileSize;
+    const int len = std::min(kLRNTileSize, spatial_dim - begin);
+    const int offset = scale_.offset(n) + begin;
+    const Dtype* x = bottom_data + offset;
+    Dtype* scale = scale_data + offset;
+    Dtype* y = top_data + offset;
+    Dtype sum[kLRNTileSize];
+    std::fill(sum, sum + len, Dtype(0));
+    for (int c = 0; c < std::min(pre_pad_, channels_); ++c) {
+      for (int j = 0; j < len; ++j) {
+        sum[j] += x[c * spatial_dim + j] * x[c * spatial_dim + j];
+      }
     }
-    for (int c = 1; c < channels_; ++c) {
-      // copy previous scale
-      caffe_copy<Dtype>(height_ * width_,
-          scale_data + scale_.offset(n, c - 1),
-          scale_data + scale_.offset(n, c));
-      // add head
-      caffe_axpy<Dtype>(height_ * width_, alpha_over_size,
-          padded_square_data + padded_square.offset(0, c + size_ - 1),
-          scale_data + scale_.offset(n, c));
-      // subtract tail
-      caffe_axpy<Dtype>(height_ * width_, -alpha_over_size,
-          padded_square_data + padded_square.offset(0, c - 1),
-          scale_data + scale_.offset(n, c));
+    for (int c = 0; c < channels_; ++c) {
+      if (c + pre_pad_ < channels_) {
+        const Dtype* head = x + (c + pre_pad_) * spatial_dim;
+        for (int j = 0; j < len; ++j) {
+          sum[j] += head[j] * head[j];
+        }
+      }
+      const int i = c * spatial_dim;
+      for (int j = 0; j < len; ++j) {
+        scale[i + j] = k_ + alpha_over_size * sum[j];
+        y[i + j] = x[i + j] *
+            lrn_negative_pow(scale[i + j], beta_, three_quarters);
+      }
+      if (c - pre_pad_ >= 0) {
+        const Dtype* tail = x + (c - pre_pad_) * spatial_dim;
+        for (int j = 0; j < len; ++j) {
+          sum[j] -= tail[j] * tail[j];
+        }
+      }
     }
   }
+}
 
-  // In the end, compute output
-  caffe_powx<Dtype>(scale_.count(), scale_data, -beta_, top_data);
-  caffe_mul<Dtype>(scale_.count(), top_data, bottom_data, top_data);
+template <typename Dtype>
+void LRNLayer<Dtype>::WithinChannelForward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  Dtype* scale_data = scale_.mutable_cpu_data();
+  const int spatial_dim = height_ * width_;
+  const Dtype alpha_over_area = alpha_ / (size_ * size_);
+  const bool three_quarters = (beta_ == Dtype(0.75));
+#ifdef _OPENMP
+#pragma omp parallel if (static_cast<int64_t>(scale_.count()) * size_ > 65536)
+#endif
+  {
+    vector<Dtype> colsum(width_);
+#ifdef _OPENMP
+#pragma omp for
+#endif
+    for (int p = 0; p < num_ * channels_; ++p) {
+      const int offset = p * spatial_dim;
+      const Dtype* x = bottom_data + offset;
+      Dtype* scale = scale_data + offset;
+      Dtype* y = top_data + offset;
+      lrn_window_sum(height_, width_, size_, LRNSquareOp<Dtype>(x),
+          &colsum[0], scale);
+      for (int i = 0; i < spatial_dim; ++i) {
+        scale[i] = 1 + alpha_over_area * scale[i];
+        y[i] = x[i] * lrn_negative_pow(scale[i], beta_, three_quarters);
+      }
+    }
+  }
 }
 
 template <typename Dtype>
 void LRNLayer<Dtype>::WithinChannelForward(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  if (!split_layer_) {
+    WithinChannelSetUp(bottom, top);
+  }
+  split_layer_->Reshape(bottom, split_top_vec_);
+  square_layer_->Reshape(square_bottom_vec_, square_top_vec_);
+  pool_layer_->Reshape(square_top_vec_, pool_top_vec_);
+  power_layer_->Reshape(pool_top_vec_, power_top_vec_);
+  product_layer_->Reshape(product_bottom_vec_, top);
   split_layer_->Forward(bottom, split_top_vec_);
   square_layer_->Forward(square_bottom_vec_, square_top_vec_);
   pool_layer_->Forward(square_top_vec_, pool_top_vec_);
@@ -169,7 +289,7 @@ void LRNLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     CrossChannelBackward_cpu(top, propagate_down, bottom);
     break;
   case LRNParameter_NormRegion_WITHIN_CHANNEL:
-    WithinChannelBackward(top, propagate_down, bottom);
+    WithinChannelBackward_cpu(top, propagate_down, bottom);
     break;
   default:
     LOG(FATAL) << "Unknown normalization region.";
@@ -185,48 +305,93 @@ void LRNLayer<Dtype>::CrossChannelBackward_cpu(
   const Dtype* bottom_data = bottom[0]->cpu_data();
   const Dtype* scale_data = scale_.cpu_data();
   Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-  Blob<Dtype> padded_ratio(1, channels_ + size_ - 1, height_, width_);
-  Blob<Dtype> accum_ratio(1, 1, height_, width_);
-  Dtype* padded_ratio_data = padded_ratio.mutable_cpu_data();
-  Dtype* accum_ratio_data = accum_ratio.mutable_cpu_data();
-  // We hack a little bit by using the diff() to store an additional result
-  Dtype* accum_ratio_times_bottom = accum_ratio.mutable_cpu_diff();
-  caffe_set(padded_ratio.count(), Dtype(0), padded_ratio_data);
-  Dtype cache_ratio_value = 2. * alpha_ * beta_ / size_;
-
-  caffe_powx<Dtype>(scale_.count(), scale_data, -beta_, bottom_diff);
-  caffe_mul<Dtype>(scale_.count(), top_diff, bottom_diff, bottom_diff);
-
-  // go through individual data
-  int inverse_pre_pad = size_ - (size_ + 1) / 2;
-  for (int n = 0; n < num_; ++n) {
-    int block_offset = scale_.offset(n);
-    // first, compute diff_i * y_i / s_i
-    caffe_mul<Dtype>(channels_ * height_ * width_,
-        top_diff + block_offset, top_data + block_offset,
-        padded_ratio_data + padded_ratio.offset(0, inverse_pre_pad));
-    caffe_div<Dtype>(channels_ * height_ * width_,
-        padded_ratio_data + padded_ratio.offset(0, inverse_pre_pad),
-        scale_data + block_offset,
-        padded_ratio_data + padded_ratio.offset(0, inverse_pre_pad));
-    // Now, compute the accumulated ratios and the bottom diff
-    caffe_set(accum_ratio.count(), Dtype(0), accum_ratio_data);
-    for (int c = 0; c < size_ - 1; ++c) {
-      caffe_axpy<Dtype>(height_ * width_, 1.,
-          padded_ratio_data + padded_ratio.offset(0, c), accum_ratio_data);
+  const int spatial_dim = height_ * width_;
+  const int num_tiles = (spatial_dim + kLRNTileSize - 1) / kLRNTileSize;
+  const Dtype cache_ratio_value = 2. * alpha_ * beta_ / size_;
+  const bool three_quarters = (beta_ == Dtype(0.75));
+  // bottom_diff = top_diff * scale^-beta - cache_ratio_value * bottom_data *
+  // (the sum of top_diff * top_data / scale over the window), with the window
+  // sliding over the channels of one tile of positions at a time.
+#ifdef _OPENMP
+#pragma omp parallel for if (static_cast<int64_t>(scale_.count()) > 32768)
+#endif
+  for (int t = 0; t < num_ * num_tiles; ++t) {
+    const int n = t / num_tiles;
+    const int begin = (t % num_tiles) * kLRNTileSize;
+    const int len = std::min(kLRNTileSize, spatial_dim - begin);
+    const int offset = scale_.offset(n) + begin;
+    const Dtype* dy = top_diff + offset;
+    const Dtype* y = top_data + offset;
+    const Dtype* x = bottom_data + offset;
+    const Dtype* scale = scale_data + offset;
+    Dtype* dx = bottom_diff + offset;
+    Dtype accum_ratio[kLRNTileSize];
+    std::fill(accum_ratio, accum_ratio + len, Dtype(0));
+    for (int c = 0; c < std::min(pre_pad_, channels_); ++c) {
+      const int i = c * spatial_dim;
+      for (int j = 0; j < len; ++j) {
+        accum_ratio[j] += dy[i + j] * y[i + j] / scale[i + j];
+      }
     }
     for (int c = 0; c < channels_; ++c) {
-      caffe_axpy<Dtype>(height_ * width_, 1.,
-          padded_ratio_data + padded_ratio.offset(0, c + size_ - 1),
-          accum_ratio_data);
-      // compute bottom diff
-      caffe_mul<Dtype>(height_ * width_,
-          bottom_data + top[0]->offset(n, c),
-          accum_ratio_data, accum_ratio_times_bottom);
-      caffe_axpy<Dtype>(height_ * width_, -cache_ratio_value,
-          accum_ratio_times_bottom, bottom_diff + top[0]->offset(n, c));
-      caffe_axpy<Dtype>(height_ * width_, -1.,
-          padded_ratio_data + padded_ratio.offset(0, c), accum_ratio_data);
+      if (c + pre_pad_ < channels_) {
+        const int i = (c + pre_pad_) * spatial_dim;
+        for (int j = 0; j < len; ++j) {
+          accum_ratio[j] += dy[i + j] * y[i + j] / scale[i + j];
+        }
+      }
+      const int i = c * spatial_dim;
+      for (int j = 0; j < len; ++j) {
+        dx[i + j] = dy[i + j] *
+            lrn_negative_pow(scale[i + j], beta_, three_quarters) -
+            cache_ratio_value * x[i + j] * accum_ratio[j];
+      }
+      if (c - pre_pad_ >= 0) {
+        const int i = (c - pre_pad_) * spatial_dim;
+        for (int j = 0; j < len; ++j) {
+          accum_ratio[j] -= dy[i + j] * y[i + j] / scale[i + j];
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void LRNLayer<Dtype>::WithinChannelBackward_cpu(
+    const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+    const vector<Blob<Dtype>*>& bottom) {
+  if (!propagate_down[0]) {
+    return;
+  }
+  const Dtype* top_diff = top[0]->cpu_diff();
+  const Dtype* top_data = top[0]->cpu_data();
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  const Dtype* scale_data = scale_.cpu_data();
+  Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
+  const int spatial_dim = height_ * width_;
+  const Dtype cache_ratio_value = 2. * alpha_ * beta_ / (size_ * size_);
+  const bool three_quarters = (beta_ == Dtype(0.75));
+#ifdef _OPENMP
+#pragma omp parallel if (static_cast<int64_t>(scale_.count()) * size_ > 65536)
+#endif
+  {
+    vector<Dtype> colsum(width_);
+#ifdef _OPENMP
+#pragma omp for
+#endif
+    for (int p = 0; p < num_ * channels_; ++p) {
+      const int offset = p * spatial_dim;
+      const Dtype* x = bottom_data + offset;
+      const Dtype* scale = scale_data + offset;
+      Dtype* dx = bottom_diff + offset;
+      lrn_window_sum(height_, width_, size_,
+          LRNRatioOp<Dtype>(top_diff + offset, top_data + offset, scale),
+          &colsum[0], dx);
+      for (int i = 0; i < spatial_dim; ++i) {
+        dx[i] = top_diff[offset + i] *
+            lrn_negative_pow(scale[i], beta_, three_quarters) -
+            cache_ratio_value * x[i] * dx[i];
+      }
     }
   }
 }
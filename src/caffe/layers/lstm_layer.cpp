@@ -7,6 +7,7 @@
 #include "caffe/layer.hpp"
 #include "caffe/layers/lstm_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/vector_math.hpp"
 
 namespace caffe {
 
@@ -238,6 +239,140 @@ void LSTMLayer<Dtype>::FillUnrolledNet(NetParameter* net_param) const {
   net_param->add_layer()->CopyFrom(output_concat_layer);
 }
 
+template <typename Dtype>
+void LSTMLayer<Dtype>::FusedReshape(const int T, const int N) {
+  RecurrentLayer<Dtype>::FusedReshape(T, N);
+  const int num_output = this->layer_param_.recurrent_param().num_output();
+  vector<int> shape(3);
+  shape[0] = T;
+  shape[1] = N;
+  shape[2] = 4 * num_output;
+  gates_.Reshape(shape);
+  shape[2] = num_output;
+  cell_.Reshape(shape);
+  tanh_cell_.Reshape(shape);
+  h_conted_.Reshape(shape);
+  shape.erase(shape.begin());
+  h_prev_diff_.Reshape(shape);
+  c_prev_diff_.Reshape(shape);
+}
+
+template <typename Dtype>
+void LSTMLayer<Dtype>::FusedForward_cpu(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top, const vector<Blob<Dtype>*>& state_in,
+    const vector<Blob<Dtype>*>& state_out) {
+  const int T = bottom[0]->shape(0);
+  const int N = bottom[0]->shape(1);
+  const int D = this->layer_param_.recurrent_param().num_output();
+  const int gate_dim = 4 * D;
+  Dtype* gates = gates_.mutable_cpu_data();
+  //     gate_input_t := W_xc * x_t + b_c [+ W_xc_static * x_static]
+  this->FusedInputForward(bottom, *this->unrolled_param("W_xc"),
+      *this->unrolled_param("b_c"), this->static_input_ ?
+      this->unrolled_param("W_xc_static") : NULL, gates);
+  const Dtype* W_hc = this->unrolled_param("W_hc")->cpu_data();
+  const Dtype* cont = bottom[1]->cpu_data();
+  const Dtype* h_prev = state_in[0]->cpu_data();
+  const Dtype* c_prev = state_in[1]->cpu_data();
+  Dtype* c = cell_.mutable_cpu_data();
+  Dtype* tanh_c = tanh_cell_.mutable_cpu_data();
+  Dtype* h_conted = h_conted_.mutable_cpu_data();
+  Dtype* h = top[0]->mutable_cpu_data();
+  for (int t = 0; t < T; ++t) {
+    //     gate_input_t += W_hc * (cont_t * h_{t-1})
+    for (int n = 0; n < N; ++n) {
+      caffe_cpu_scale(D, cont[n], h_prev + n * D, h_conted + n * D);
+    }
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, N, gate_dim, D, Dtype(1),
+        h_conted, W_hc, Dtype(1), gates);
+    // The LSTMUnit computation, keeping the gate activations for Backward.
+    for (int n = 0; n < N; ++n) {
+      Dtype* gate = gates + n * gate_dim;
+      caffe_cpu_vsigmoid(3 * D, gate, gate);
+      caffe_cpu_vtanh(D, gate + 3 * D, gate + 3 * D);
+      for (int d = 0; d < D; ++d) {
+        const Dtype f = (cont[n] == 0) ? 0 : (cont[n] * gate[D + d]);
+        gate[D + d] = f;
+        c[n * D + d] = f * c_prev[n * D + d] + gate[d] * gate[3 * D + d];
+      }
+    }
+    caffe_cpu_vtanh(N * D, c, tanh_c);
+    for (int n = 0; n < N; ++n) {
+      const Dtype* o = gates + n * gate_dim + 2 * D;
+      for (int d = 0; d < D; ++d) {
+        h[n * D + d] = o[d] * tanh_c[n * D + d];
+      }
+    }
+    h_prev = h;
+    c_prev = c;
+    cont += N;
+    gates += N * gate_dim;
+    c += N * D;
+    tanh_c += N * D;
+    h_conted += N * D;
+    h += N * D;
+  }
+  caffe_copy(N * D, h_prev, state_out[0]->mutable_cpu_data());
+  caffe_copy(N * D, c_prev, state_out[1]->mutable_cpu_data());
+}
+
+template <typename Dtype>
+void LSTMLayer<Dtype>::FusedBackward_cpu(const vector<Blob<Dtype>*>& top,
+    const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+  const int N = this->N_;
+  const int D = this->layer_param_.recurrent_param().num_output();
+  const int gate_dim = 4 * D;
+  Blob<Dtype>* W_hc = this->unrolled_param("W_hc");
+  // As in the unrolled net, no gradient flows into the state from the next
+  // batch or out to the initial state.
+  Dtype* h_prev_diff = h_prev_diff_.mutable_cpu_data();
+  Dtype* c_prev_diff = c_prev_diff_.mutable_cpu_data();
+  caffe_set(N * D, Dtype(0), h_prev_diff);
+  caffe_set(N * D, Dtype(0), c_prev_diff);
+  for (int t = this->T_ - 1; t >= 0; --t) {
+    const Dtype* cont = bottom[1]->cpu_data() + t * N;
+    const Dtype* gates = gates_.cpu_data() + t * N * gate_dim;
+    const Dtype* tanh_c = tanh_cell_.cpu_data() + t * N * D;
+    const Dtype* c_prev = (t == 0) ? this->recur_input_blobs_[1]->cpu_data() :
+        cell_.cpu_data() + (t - 1) * N * D;
+    const Dtype* h_diff = top[0]->cpu_diff() + t * N * D;
+    Dtype* gates_diff = gates_.mutable_cpu_diff() + t * N * gate_dim;
+    for (int n = 0; n < N; ++n) {
+      const Dtype* gate = gates + n * gate_dim;
+      Dtype* gate_diff = gates_diff + n * gate_dim;
+      for (int d = 0; d < D; ++d) {
+        const int index = n * D + d;
+        const Dtype i = gate[d];
+        const Dtype f = gate[D + d];
+        const Dtype o = gate[2 * D + d];
+        const Dtype g = gate[3 * D + d];
+        const Dtype dh = h_diff[index] + h_prev_diff[index];
+        const Dtype c_term_diff = c_prev_diff[index] +
+            dh * o * (1 - tanh_c[index] * tanh_c[index]);
+        c_prev_diff[index] = c_term_diff * f;
+        gate_diff[d] = c_term_diff * g * i * (1 - i);
+        gate_diff[D + d] = c_term_diff * c_prev[index] * f * (1 - f);
+        gate_diff[2 * D + d] = dh * tanh_c[index] * o * (1 - o);
+        gate_diff[3 * D + d] = c_term_diff * i * (1 - g * g);
+      }
+    }
+    if (t > 0) {
+      caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, N, D, gate_dim,
+          Dtype(1), gates_diff, W_hc->cpu_data(), Dtype(0), h_prev_diff);
+      for (int n = 0; n < N; ++n) {
+        caffe_scal(D, cont[n], h_prev_diff + n * D);
+      }
+    }
+  }
+  // The weight gradients of all timesteps at once.
+  caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, gate_dim, D,
+      this->T_ * N, Dtype(1), gates_.cpu_diff(), h_conted_.cpu_data(),
+      Dtype(1), W_hc->mutable_cpu_diff());
+  this->FusedInputBackward(propagate_down, bottom, gates_.cpu_diff(),
+      this->unrolled_param("W_xc"), this->unrolled_param("b_c"),
+      this->static_input_ ? this->unrolled_param("W_xc_static") : NULL);
+}
+
 INSTANTIATE_CLASS(LSTMLayer);
 REGISTER_LAYER_CLASS(LSTM);
 
@@ -1,3 +1,4 @@
+#include <cmath>
 #include <vector>
 
 #include "caffe/layers/mvn_layer.hpp"
@@ -38,35 +39,32 @@ void MVNLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   else
     num = bottom[0]->num() * bottom[0]->channels();
 
-  int dim = bottom[0]->count() / num;
-
-  // subtract mean
-  caffe_cpu_gemv<Dtype>(CblasNoTrans, num, dim, 1. / dim, bottom_data,
-      sum_multiplier_.cpu_data(), 0., mean_.mutable_cpu_data());  // EX
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, dim, 1, -1.,
-      mean_.cpu_data(), sum_multiplier_.cpu_data(), 0.,
-      temp_.mutable_cpu_data());
-  caffe_add(temp_.count(), bottom_data, temp_.cpu_data(), top_data);  // X-EX
-
-  if (this->layer_param_.mvn_param().normalize_variance()) {
-    // compute variance using var(X) = E((X-EX)^2)
-    caffe_powx(bottom[0]->count(), top_data, Dtype(2),
-        temp_.mutable_cpu_data());  // (X-EX)^2
-    caffe_cpu_gemv<Dtype>(CblasNoTrans, num, dim, 1. / dim, temp_.cpu_data(),
-        sum_multiplier_.cpu_data(), 0.,
-        variance_.mutable_cpu_data());  // E((X-EX)^2)
-
-    // normalize variance
-    caffe_powx(variance_.count(), variance_.cpu_data(), Dtype(0.5),
-          variance_.mutable_cpu_data());
-
-    caffe_add_scalar(variance_.count(), eps_, variance_.mutable_cpu_data());
-
-    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, dim, 1, 1.,
-          variance_.cpu_data(), sum_multiplier_.cpu_data(), 0.,
-          temp_.mutable_cpu_data());
-
-    caffe_div(temp_.count(), top_data, temp_.cpu_data(), top_data);
+  const int dim = bottom[0]->count() / num;
+  const bool normalize_variance =
+      this->layer_param_.mvn_param().normalize_variance();
+  Dtype* mean_data = mean_.mutable_cpu_data();
+  Dtype* variance_data = variance_.mutable_cpu_data();
+  // One read of each row for its mean and variance, and one pass to write
+  // (X-EX) / (sqrt(E((X-EX)^2)) + eps).
+#ifdef _OPENMP
+#pragma omp parallel for if (static_cast<int64_t>(bottom[0]->count()) > 32768)
+#endif
+  for (int i = 0; i < num; ++i) {
+    const Dtype* x = bottom_data + i * dim;
+    Dtype* y = top_data + i * dim;
+    int count = 0;
+    Dtype mean = 0;
+    Dtype m2 = 0;
+    caffe_cpu_mean_m2(dim, x, &count, &mean, &m2);
+    mean_data[i] = mean;
+    Dtype scale = 1;
+    if (normalize_variance) {
+      variance_data[i] = std::sqrt(m2 / dim) + eps_;
+      scale = 1 / variance_data[i];
+    }
+    for (int j = 0; j < dim; ++j) {
+      y[j] = (x[j] - mean) * scale;
+    }
   }
 }
 
@@ -76,7 +74,6 @@ void MVNLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<Blob<Dtype>*>& bottom) {
   const Dtype* top_diff = top[0]->cpu_diff();
   const Dtype* top_data = top[0]->cpu_data();
-  const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
 
   int num;
@@ -85,41 +82,37 @@ void MVNLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   else
     num = bottom[0]->num() * bottom[0]->channels();
 
-  int dim = bottom[0]->count() / num;
-
-  if (this->layer_param_.mvn_param().normalize_variance()) {
-    caffe_mul(temp_.count(), top_data, top_diff, bottom_diff);
-    caffe_cpu_gemv<Dtype>(CblasNoTrans, num, dim, 1., bottom_diff,
-          sum_multiplier_.cpu_data(), 0., mean_.mutable_cpu_data());
-    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, dim, 1, 1.,
-          mean_.cpu_data(), sum_multiplier_.cpu_data(), 0.,
-          bottom_diff);
-    caffe_mul(temp_.count(), top_data, bottom_diff, bottom_diff);
-
-    caffe_cpu_gemv<Dtype>(CblasNoTrans, num, dim, 1., top_diff,
-            sum_multiplier_.cpu_data(), 0., mean_.mutable_cpu_data());
-    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, dim, 1, 1.,
-            mean_.cpu_data(), sum_multiplier_.cpu_data(), 1.,
-            bottom_diff);
-
-    caffe_cpu_axpby(temp_.count(), Dtype(1), top_diff, Dtype(-1. / dim),
-        bottom_diff);
-
-    // put the squares of bottom into temp_
-    caffe_powx(temp_.count(), bottom_data, Dtype(2),
-        temp_.mutable_cpu_data());
-    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, dim, 1, 1.,
-        variance_.cpu_data(), sum_multiplier_.cpu_data(), 0.,
-        temp_.mutable_cpu_data());
-
-    caffe_div(temp_.count(), bottom_diff, temp_.cpu_data(), bottom_diff);
-  } else {
-    caffe_cpu_gemv<Dtype>(CblasNoTrans, num, dim, 1. / dim, top_diff,
-      sum_multiplier_.cpu_data(), 0., mean_.mutable_cpu_data());
-    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, dim, 1, -1.,
-      mean_.cpu_data(), sum_multiplier_.cpu_data(), 0.,
-      temp_.mutable_cpu_data());
-    caffe_add(temp_.count(), top_diff, temp_.cpu_data(), bottom_diff);
+  const int dim = bottom[0]->count() / num;
+  const bool normalize_variance =
+      this->layer_param_.mvn_param().normalize_variance();
+  const Dtype* variance_data = variance_.cpu_data();
+  // dE/dX = (dE/dY - mean(dE/dY) - mean(dE/dY \cdot Y) \cdot Y) ./ std with
+  // the variance normalized, and dE/dY - mean(dE/dY) without.
+#ifdef _OPENMP
+#pragma omp parallel for if (static_cast<int64_t>(bottom[0]->count()) > 32768)
+#endif
+  for (int i = 0; i < num; ++i) {
+    const Dtype* dy = top_diff + i * dim;
+    const Dtype* y = top_data + i * dim;
+    Dtype* dx = bottom_diff + i * dim;
+    Dtype sum_dy = 0;
+    Dtype sum_dy_y = 0;
+    if (normalize_variance) {
+      for (int j = 0; j < dim; ++j) {
+        sum_dy += dy[j];
+        sum_dy_y += dy[j] * y[j];
+      }
+    } else {
+      for (int j = 0; j < dim; ++j) {
+        sum_dy += dy[j];
+      }
+    }
+    const Dtype shift = sum_dy / dim;
+    const Dtype slope = sum_dy_y / dim;
+    const Dtype scale = normalize_variance ? 1 / variance_data[i] : Dtype(1);
+    for (int j = 0; j < dim; ++j) {
+      dx[j] = (dy[j] - shift - slope * y[j]) * scale;
+    }
   }
 }
 
@@ -10,6 +10,163 @@ namespace caffe {
 using std::min;
 using std::max;
 
+// The geometry of the pooling of one channel, for the CPU kernels below.
+struct PoolingShape {
+  int height, width;
+  int pooled_height, pooled_width;
+  int kernel_h, kernel_w;
+  int stride_h, stride_w;
+  int pad_h, pad_w;
+};
+
+// Max pooling of one channel that records the argmax of every window in
+// mask (of int or Dtype), as needed by Backward.
+template <typename Dtype, typename MaskT>
+static void max_pool_masked(const PoolingShape& s, const Dtype* bottom_data,
+    Dtype* top_data, MaskT* mask) {
+  for (int ph = 0; ph < s.pooled_height; ++ph) {
+    for (int pw = 0; pw < s.pooled_width; ++pw) {
+      int hstart = ph * s.stride_h - s.pad_h;
+      int wstart = pw * s.stride_w - s.pad_w;
+      const int hend = min(hstart + s.kernel_h, s.height);
+      const int wend = min(wstart + s.kernel_w, s.width);
+      hstart = max(hstart, 0);
+      wstart = max(wstart, 0);
+      const int pool_index = ph * s.pooled_width + pw;
+      Dtype value = -FLT_MAX;
+      int max_index = -1;
+      for (int h = hstart; h < hend; ++h) {
+        for (int w = wstart; w < wend; ++w) {
+          const int index = h * s.width + w;
+          if (bottom_data[index] > value) {
+            value = bottom_data[index];
+            max_index = index;
+          }
+        }
+      }
+      top_data[pool_index] = value;
+      mask[pool_index] = static_cast<MaskT>(max_index);
+    }
+  }
+}
+
+// The reductions of the mask-free kernels.
+struct PoolMaxOp {
+  template <typename Dtype>
+  static inline Dtype Apply(const Dtype a, const Dtype b) {
+    return a > b ? a : b;
+  }
+};
+
+struct PoolSumOp {
+  template <typename Dtype>
+  static inline Dtype Apply(const Dtype a, const Dtype b) { return a + b; }
+};
+
+// Reduces one input row into the row of outputs whose windows cover it.
+// Outputs whose windows lie inside the row run as a loop along the width
+// (specialized for 2-wide and 3-wide windows of stride 2) that the compiler
+// vectorizes; only the border outputs clip their windows.
+template <typename Dtype, typename Op>
+static void pool_row(const PoolingShape& s, const Dtype* row, Dtype* out) {
+  const int pw_begin = min((s.pad_w + s.stride_w - 1) / s.stride_w,
+      s.pooled_width);
+  int pw_end = pw_begin;
+  if (s.width + s.pad_w >= s.kernel_w) {
+    pw_end = max(pw_begin, min(s.pooled_width,
+        (s.width + s.pad_w - s.kernel_w) / s.stride_w + 1));
+  }
+  for (int pw = 0; pw < s.pooled_width; ++pw) {
+    if (pw == pw_begin) {
+      pw = pw_end;
+      if (pw == s.pooled_width) {
+        break;
+      }
+    }
+    const int wstart = max(pw * s.stride_w - s.pad_w, 0);
+    const int wend = min(pw * s.stride_w - s.pad_w + s.kernel_w, s.width);
+    for (int w = wstart; w < wend; ++w) {
+      out[pw] = Op::Apply(out[pw], row[w]);
+    }
+  }
+  if (pw_begin == pw_end) {
+    return;
+  }
+  const Dtype* x = row + pw_begin * s.stride_w - s.pad_w;
+  if (s.kernel_w == 2 && s.stride_w == 2) {
+    for (int pw = pw_begin; pw < pw_end; ++pw, x += 2) {
+      out[pw] = Op::Apply(out[pw], Op::Apply(x[0], x[1]));
+    }
+  } else if (s.kernel_w == 3 && s.stride_w == 2) {
+    for (int pw = pw_begin; pw < pw_end; ++pw, x += 2) {
+      out[pw] = Op::Apply(out[pw], Op::Apply(Op::Apply(x[0], x[1]), x[2]));
+    }
+  } else {
+    for (int kw = 0; kw < s.kernel_w; ++kw) {
+      const Dtype* xk = x + kw;
+      for (int pw = pw_begin; pw < pw_end; ++pw) {
+        out[pw] = Op::Apply(out[pw], xk[(pw - pw_begin) * s.stride_w]);
+      }
+    }
+  }
+}
+
+// Reduces every window of one channel, starting from init, row by row; a
+// window covering the whole channel (global pooling) is a single reduction.
+template <typename Dtype, typename Op>
+static void pool_plane(const PoolingShape& s, const Dtype* bottom_data,
+    Dtype* top_data, const Dtype init) {
+  if (s.pooled_height == 1 && s.pooled_width == 1 && s.pad_h == 0 &&
+      s.pad_w == 0 && s.kernel_h >= s.height && s.kernel_w >= s.width) {
+    // Independent partial reductions let the loop vectorize.
+    const int kLanes = 8;
+    const int count = s.height * s.width;
+    Dtype partial[kLanes];
+    std::fill(partial, partial + kLanes, init);
+    int i = 0;
+    for (; i + kLanes <= count; i += kLanes) {
+      for (int j = 0; j < kLanes; ++j) {
+        partial[j] = Op::Apply(partial[j], bottom_data[i + j]);
+      }
+    }
+    for (; i < count; ++i) {
+      partial[0] = Op::Apply(partial[0], bottom_data[i]);
+    }
+    Dtype value = init;
+    for (int j = 0; j < kLanes; ++j) {
+      value = Op::Apply(value, partial[j]);
+    }
+    top_data[0] = value;
+    return;
+  }
+  for (int ph = 0; ph < s.pooled_height; ++ph) {
+    const int hstart = max(ph * s.stride_h - s.pad_h, 0);
+    const int hend = min(ph * s.stride_h - s.pad_h + s.kernel_h, s.height);
+    Dtype* out = top_data + ph * s.pooled_width;
+    std::fill(out, out + s.pooled_width, init);
+    for (int h = hstart; h < hend; ++h) {
+      pool_row<Dtype, Op>(s, bottom_data + h * s.width, out);
+    }
+  }
+}
+
+// Average pooling of one channel; windows are divided by their size
+// including the padding, as before.
+template <typename Dtype>
+static void ave_pool_plane(const PoolingShape& s, const Dtype* bottom_data,
+    Dtype* top_data) {
+  pool_plane<Dtype, PoolSumOp>(s, bottom_data, top_data, Dtype(0));
+  for (int ph = 0; ph < s.pooled_height; ++ph) {
+    const int hstart = ph * s.stride_h - s.pad_h;
+    const int pool_h = min(hstart + s.kernel_h, s.height + s.pad_h) - hstart;
+    for (int pw = 0; pw < s.pooled_width; ++pw) {
+      const int wstart = pw * s.stride_w - s.pad_w;
+      const int pool_w = min(wstart + s.kernel_w, s.width + s.pad_w) - wstart;
+      top_data[ph * s.pooled_width + pw] /= pool_h * pool_w;
+    }
+  }
+}
+
 template <typename Dtype>
 void PoolingLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -122,107 +279,68 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
-// TODO(Yangqing): Is there a faster way to do pooling in the channel-first
-// case?
+template <typename Dtype>
+PoolingShape PoolingLayer<Dtype>::pooling_shape() const {
+  PoolingShape shape;
+  shape.height = height_;
+  shape.width = width_;
+  shape.pooled_height = pooled_height_;
+  shape.pooled_width = pooled_width_;
+  shape.kernel_h = kernel_h_;
+  shape.kernel_w = kernel_w_;
+  shape.stride_h = stride_h_;
+  shape.stride_w = stride_w_;
+  shape.pad_h = pad_h_;
+  shape.pad_w = pad_w_;
+  return shape;
+}
+
 template <typename Dtype>
 void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+  const PoolingParameter_PoolMethod pool =
+      this->layer_param_.pooling_param().pool();
+  if (pool == PoolingParameter_PoolMethod_STOCHASTIC) {
+    NOT_IMPLEMENTED;
+  }
+  CHECK(pool == PoolingParameter_PoolMethod_MAX ||
+      pool == PoolingParameter_PoolMethod_AVE) << "Unknown pooling method.";
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  const int top_count = top[0]->count();
-  // We'll output the mask to top[1] if it's of size >1.
-  const bool use_top_mask = top.size() > 1;
-  int* mask = NULL;  // suppress warnings about uninitalized variables
+  const int num_planes = bottom[0]->num() * channels_;
+  const int bottom_dim = height_ * width_;
+  const int top_dim = pooled_height_ * pooled_width_;
+  const PoolingShape shape = pooling_shape();
+  // We'll output the mask to top[1] if it's of size >1. Otherwise max
+  // pooling records it in max_idx_ for Backward, except at inference where
+  // it is skipped (and recomputed by Backward if that runs after all).
   Dtype* top_mask = NULL;
-  // Different pooling methods. We explicitly do the switch outside the for
-  // loop to save time, although this results in more code.
-  switch (this->layer_param_.pooling_param().pool()) {
-  case PoolingParameter_PoolMethod_MAX:
-    // Initialize
-    if (use_top_mask) {
+  int* mask = NULL;
+  if (pool == PoolingParameter_PoolMethod_MAX) {
+    if (top.size() > 1) {
       top_mask = top[1]->mutable_cpu_data();
-      caffe_set(top_count, Dtype(-1), top_mask);
-    } else {
+    } else if (this->phase_ == TRAIN) {
       mask = max_idx_.mutable_cpu_data();
-      caffe_set(top_count, -1, mask);
-    }
-    caffe_set(top_count, Dtype(-FLT_MAX), top_data);
-    // The main loop
-    for (int n = 0; n < bottom[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_);
-            int wend = min(wstart + kernel_w_, width_);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
-            const int pool_index = ph * pooled_width_ + pw;
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
-                const int index = h * width_ + w;
-                if (bottom_data[index] > top_data[pool_index]) {
-                  top_data[pool_index] = bottom_data[index];
-                  if (use_top_mask) {
-                    top_mask[pool_index] = static_cast<Dtype>(index);
-                  } else {
-                    mask[pool_index] = index;
-                  }
-                }
-              }
-            }
-          }
-        }
-        // compute offset
-        bottom_data += bottom[0]->offset(0, 1);
-        top_data += top[0]->offset(0, 1);
-        if (use_top_mask) {
-          top_mask += top[0]->offset(0, 1);
-        } else {
-          mask += top[0]->offset(0, 1);
-        }
-      }
     }
-    break;
-  case PoolingParameter_PoolMethod_AVE:
-    for (int i = 0; i < top_count; ++i) {
-      top_data[i] = 0;
-    }
-    // The main loop
-    for (int n = 0; n < bottom[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_ + pad_h_);
-            int wend = min(wstart + kernel_w_, width_ + pad_w_);
-            int pool_size = (hend - hstart) * (wend - wstart);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
-            hend = min(hend, height_);
-            wend = min(wend, width_);
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
-                top_data[ph * pooled_width_ + pw] +=
-                    bottom_data[h * width_ + w];
-              }
-            }
-            top_data[ph * pooled_width_ + pw] /= pool_size;
-          }
-        }
-        // compute offset
-        bottom_data += bottom[0]->offset(0, 1);
-        top_data += top[0]->offset(0, 1);
-      }
+    max_idx_stale_ = (mask == NULL);
+  }
+#ifdef _OPENMP
+#pragma omp parallel for if (static_cast<int64_t>(top[0]->count()) * \
+    kernel_h_ * kernel_w_ > 65536)
+#endif
+  for (int p = 0; p < num_planes; ++p) {
+    const Dtype* plane_data = bottom_data + p * bottom_dim;
+    Dtype* pooled_data = top_data + p * top_dim;
+    if (pool == PoolingParameter_PoolMethod_AVE) {
+      ave_pool_plane(shape, plane_data, pooled_data);
+    } else if (top_mask) {
+      max_pool_masked(shape, plane_data, pooled_data, top_mask + p * top_dim);
+    } else if (mask) {
+      max_pool_masked(shape, plane_data, pooled_data, mask + p * top_dim);
+    } else {
+      pool_plane<Dtype, PoolMaxOp>(shape, plane_data, pooled_data,
+          Dtype(-FLT_MAX));
     }
-    break;
-  case PoolingParameter_PoolMethod_STOCHASTIC:
-    NOT_IMPLEMENTED;
-    break;
-  default:
-    LOG(FATAL) << "Unknown pooling method.";
   }
 }
 
@@ -247,6 +365,18 @@ void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     if (use_top_mask) {
       top_mask = top[1]->cpu_data();
     } else {
+      if (max_idx_stale_) {
+        // The forward pass skipped the mask at inference; recompute it.
+        const PoolingShape shape = pooling_shape();
+        const int bottom_dim = height_ * width_;
+        const int top_dim = pooled_height_ * pooled_width_;
+        vector<Dtype> pooled(top_dim);
+        for (int p = 0; p < top[0]->num() * channels_; ++p) {
+          max_pool_masked(shape, bottom[0]->cpu_data() + p * bottom_dim,
+              &pooled[0], max_idx_.mutable_cpu_data() + p * top_dim);
+        }
+        max_idx_stale_ = false;
+      }
       mask = max_idx_.cpu_data();
     }
     for (int n = 0; n < top[0]->num(); ++n) {
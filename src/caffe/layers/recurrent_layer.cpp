@@ -1,3 +1,4 @@
+#include <map>
 #include <string>
 #include <vector>
 
@@ -29,6 +30,12 @@ void RecurrentLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   // the hidden state blobs at the first and last timesteps.
   expose_hidden_ = this->layer_param_.recurrent_param().expose_hidden();
 
+  const RecurrentParameter_Engine engine =
+      this->layer_param_.recurrent_param().engine();
+  CHECK(engine != RecurrentParameter_Engine_FUSED || HasFusedEngine())
+      << type() << " layers have no fused engine.";
+  fused_ = HasFusedEngine() && engine != RecurrentParameter_Engine_UNROLLED;
+
   // Get (recurrent) input/output names.
   vector<string> output_names;
   OutputBlobNames(&output_names);
@@ -231,6 +238,162 @@ void RecurrentLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       top[i]->ReshapeLike(*recur_output_blobs_[j]);
     }
   }
+  if (fused_) {
+    FusedReshape(T_, N_);
+  }
+}
+
+template <typename Dtype>
+void RecurrentLayer<Dtype>::FusedReshape(const int T, const int N) {
+  vector<int> bias_shape(1, T * N);
+  bias_multiplier_.Reshape(bias_shape);
+  caffe_set(T * N, Dtype(1), bias_multiplier_.mutable_cpu_data());
+}
+
+template <typename Dtype>
+Blob<Dtype>* RecurrentLayer<Dtype>::unrolled_param(const string& name) const {
+  const map<string, int>& index = unrolled_net_->param_names_index();
+  map<string, int>::const_iterator it = index.find(name);
+  CHECK(it != index.end()) << "Unknown unrolled net parameter " << name;
+  return unrolled_net_->params()[it->second].get();
+}
+
+template <typename Dtype>
+void RecurrentLayer<Dtype>::FusedInputForward(
+    const vector<Blob<Dtype>*>& bottom, const Blob<Dtype>& W,
+    const Blob<Dtype>& b, const Blob<Dtype>* W_static, Dtype* y) {
+  const int T = bottom[0]->shape(0);
+  const int N = bottom[0]->shape(1);
+  const int M = T * N;
+  const int num_gates = W.shape(0);
+  const int K = bottom[0]->count(2);
+  // y = x W^T + b, for all the timesteps at once
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M, num_gates, 1,
+      Dtype(1), bias_multiplier_.cpu_data(), b.cpu_data(), Dtype(0), y);
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, M, num_gates, K, Dtype(1),
+      bottom[0]->cpu_data(), W.cpu_data(), Dtype(1), y);
+  if (static_input_) {
+    vector<int> static_shape(2);
+    static_shape[0] = N;
+    static_shape[1] = num_gates;
+    static_transform_.Reshape(static_shape);
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, N, num_gates,
+        bottom[2]->count(1), Dtype(1), bottom[2]->cpu_data(),
+        W_static->cpu_data(), Dtype(0), static_transform_.mutable_cpu_data());
+    for (int t = 0; t < T; ++t) {
+      caffe_axpy(N * num_gates, Dtype(1), static_transform_.cpu_data(),
+          y + t * N * num_gates);
+    }
+  }
+}
+
+template <typename Dtype>
+void RecurrentLayer<Dtype>::FusedInputBackward(
+    const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom,
+    const Dtype* y_diff, Blob<Dtype>* W, Blob<Dtype>* b,
+    Blob<Dtype>* W_static) {
+  const int M = T_ * N_;
+  const int num_gates = W->shape(0);
+  const int K = bottom[0]->count(2);
+  caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, num_gates, K, M, Dtype(1),
+      y_diff, bottom[0]->cpu_data(), Dtype(1), W->mutable_cpu_diff());
+  caffe_cpu_gemv<Dtype>(CblasTrans, M, num_gates, Dtype(1), y_diff,
+      bias_multiplier_.cpu_data(), Dtype(1), b->mutable_cpu_diff());
+  if (propagate_down[0]) {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M, K, num_gates,
+        Dtype(1), y_diff, W->cpu_data(), Dtype(0),
+        bottom[0]->mutable_cpu_diff());
+  }
+  if (static_input_) {
+    // The static input is in every timestep: sum their gradients first.
+    Dtype* static_diff = static_transform_.mutable_cpu_diff();
+    caffe_cpu_gemv<Dtype>(CblasTrans, T_, N_ * num_gates, Dtype(1), y_diff,
+        bias_multiplier_.cpu_data(), Dtype(0), static_diff);
+    const int static_dim = bottom[2]->count(1);
+    caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, num_gates, static_dim,
+        N_, Dtype(1), static_diff, bottom[2]->cpu_data(), Dtype(1),
+        W_static->mutable_cpu_diff());
+    if (propagate_down[2]) {
+      caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, N_, static_dim,
+          num_gates, Dtype(1), static_diff, W_static->cpu_data(), Dtype(0),
+          bottom[2]->mutable_cpu_diff());
+    }
+  }
+}
+
+template <typename Dtype>
+void RecurrentLayer<Dtype>::InitState(RecurrentState<Dtype>* state) const {
+  vector<BlobShape> shapes;
+  RecurrentInputShapes(&shapes);
+  state->blobs().resize(shapes.size());
+  for (int i = 0; i < shapes.size(); ++i) {
+    // A single stream: (1 x 1 x ...)
+    shapes[i].set_dim(1, 1);
+    state->blobs()[i].reset(new Blob<Dtype>());
+    state->blobs()[i]->Reshape(shapes[i]);
+  }
+  state->Reset();
+}
+
+template <typename Dtype>
+void RecurrentLayer<Dtype>::Step(const vector<Blob<Dtype>*>& bottom,
+    const vector<RecurrentState<Dtype>*>& states,
+    const vector<Blob<Dtype>*>& top) {
+  CHECK(HasFusedEngine()) << type() << " layers have no fused engine.";
+  CHECK_EQ(bottom.size(), 1 + static_input_)
+      << "Step takes the input and, if the layer has one, the static input";
+  CHECK_EQ(1, bottom[0]->shape(0)) << "Step takes a single timestep";
+  const int N = bottom[0]->shape(1);
+  CHECK_EQ(N, states.size()) << "Step needs a state per stream";
+  if (static_input_) {
+    CHECK_EQ(N, bottom[1]->shape(0));
+  }
+  // Continue every stream: a new sequence starts from a reset state.
+  vector<int> cont_shape(2, 1);
+  cont_shape[1] = N;
+  step_cont_.Reshape(cont_shape);
+  caffe_set(N, Dtype(1), step_cont_.mutable_cpu_data());
+  vector<Blob<Dtype>*> step_bottom(1, bottom[0]);
+  step_bottom.push_back(&step_cont_);
+  if (static_input_) {
+    step_bottom.push_back(bottom[1]);
+  }
+  // Gather the states of the streams into a batch.
+  const int num_states = recur_input_blobs_.size();
+  step_state_.resize(num_states);
+  vector<Blob<Dtype>*> state(num_states);
+  for (int i = 0; i < num_states; ++i) {
+    if (!step_state_[i]) {
+      step_state_[i].reset(new Blob<Dtype>());
+    }
+    vector<int> state_shape = recur_input_blobs_[i]->shape();
+    state_shape[1] = N;
+    step_state_[i]->Reshape(state_shape);
+    state[i] = step_state_[i].get();
+    const int dim = step_state_[i]->count(2);
+    Dtype* state_data = step_state_[i]->mutable_cpu_data();
+    for (int n = 0; n < N; ++n) {
+      CHECK_EQ(num_states, states[n]->blobs().size())
+          << "state not set up by InitState";
+      CHECK_EQ(dim, states[n]->blobs()[i]->count());
+      caffe_copy(dim, states[n]->blobs()[i]->cpu_data(), state_data + n * dim);
+    }
+  }
+  vector<int> top_shape = output_blobs_[0]->shape();
+  top_shape[0] = 1;
+  top_shape[1] = N;
+  top[0]->Reshape(top_shape);
+  FusedReshape(1, N);
+  FusedForward_cpu(step_bottom, top, state, state);
+  // Scatter the updated states back to the streams.
+  for (int i = 0; i < num_states; ++i) {
+    const int dim = step_state_[i]->count(2);
+    const Dtype* state_data = step_state_[i]->cpu_data();
+    for (int n = 0; n < N; ++n) {
+      caffe_copy(dim, state_data + n * dim,
+          states[n]->blobs()[i]->mutable_cpu_data());
+    }
+  }
 }
 
 template <typename Dtype>
@@ -249,7 +412,7 @@ void RecurrentLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   // currently point to a stale owner blob that was dropped when Solver::Test
   // called test_net->ShareTrainedLayersWith(net_.get()).
   // TODO: somehow make this work non-hackily.
-  if (this->phase_ == TEST) {
+  if (this->phase_ == TEST && !fused_) {
     unrolled_net_->ShareWeights();
   }
 
@@ -264,7 +427,11 @@ void RecurrentLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     }
   }
 
-  unrolled_net_->ForwardTo(last_layer_index_);
+  if (fused_) {
+    FusedForward_cpu(bottom, top, recur_input_blobs_, recur_output_blobs_);
+  } else {
+    unrolled_net_->ForwardTo(last_layer_index_);
+  }
 
   if (expose_hidden_) {
     const int top_offset = output_blobs_.size();
@@ -278,6 +445,10 @@ template <typename Dtype>
 void RecurrentLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
   CHECK(!propagate_down[1]) << "Cannot backpropagate to sequence indicators.";
+  if (fused_ && Caffe::mode() == Caffe::CPU) {
+    FusedBackward_cpu(top, propagate_down, bottom);
+    return;
+  }
 
   // TODO: skip backpropagation to inputs and parameters inside the unrolled
   // net according to propagate_down[0] and propagate_down[2]. For now just
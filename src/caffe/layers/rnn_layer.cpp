@@ -7,6 +7,7 @@
 #include "caffe/layer.hpp"
 #include "caffe/layers/rnn_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/vector_math.hpp"
 
 namespace caffe {
 
@@ -230,6 +231,111 @@ void RNNLayer<Dtype>::FillUnrolledNet(NetParameter* net_param) const {
   net_param->add_layer()->CopyFrom(output_concat_layer);
 }
 
+template <typename Dtype>
+void RNNLayer<Dtype>::FusedReshape(const int T, const int N) {
+  RecurrentLayer<Dtype>::FusedReshape(T, N);
+  vector<int> shape(3);
+  shape[0] = T;
+  shape[1] = N;
+  shape[2] = this->layer_param_.recurrent_param().num_output();
+  hidden_.Reshape(shape);
+  h_conted_.Reshape(shape);
+  output_input_diff_.Reshape(shape);
+  shape.erase(shape.begin());
+  h_prev_diff_.Reshape(shape);
+}
+
+template <typename Dtype>
+void RNNLayer<Dtype>::FusedForward_cpu(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top, const vector<Blob<Dtype>*>& state_in,
+    const vector<Blob<Dtype>*>& state_out) {
+  const int T = bottom[0]->shape(0);
+  const int N = bottom[0]->shape(1);
+  const int D = this->layer_param_.recurrent_param().num_output();
+  const int M = T * N;
+  Dtype* h = hidden_.mutable_cpu_data();
+  //     h_neuron_input_t := W_xh * x_t + b_h [+ W_xh_static * x_static]
+  this->FusedInputForward(bottom, *this->unrolled_param("W_xh"),
+      *this->unrolled_param("b_h"), this->static_input_ ?
+      this->unrolled_param("W_xh_static") : NULL, h);
+  const Dtype* W_hh = this->unrolled_param("W_hh")->cpu_data();
+  const Dtype* cont = bottom[1]->cpu_data();
+  const Dtype* h_prev = state_in[0]->cpu_data();
+  Dtype* h_conted = h_conted_.mutable_cpu_data();
+  for (int t = 0; t < T; ++t) {
+    //     h_t := \tanh[ h_neuron_input_t + W_hh * (cont_t * h_{t-1}) ]
+    for (int n = 0; n < N; ++n) {
+      caffe_cpu_scale(D, cont[n], h_prev + n * D, h_conted + n * D);
+    }
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, N, D, D, Dtype(1),
+        h_conted, W_hh, Dtype(1), h);
+    caffe_cpu_vtanh(N * D, h, h);
+    h_prev = h;
+    cont += N;
+    h_conted += N * D;
+    h += N * D;
+  }
+  caffe_copy(N * D, h_prev, state_out[0]->mutable_cpu_data());
+  //     o_t := \tanh[ W_ho * h_t + b_o ], for all timesteps at once
+  Dtype* o = top[0]->mutable_cpu_data();
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M, D, 1, Dtype(1),
+      this->bias_multiplier_.cpu_data(),
+      this->unrolled_param("b_o")->cpu_data(), Dtype(0), o);
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, M, D, D, Dtype(1),
+      hidden_.cpu_data(), this->unrolled_param("W_ho")->cpu_data(), Dtype(1),
+      o);
+  caffe_cpu_vtanh(M * D, o, o);
+}
+
+template <typename Dtype>
+void RNNLayer<Dtype>::FusedBackward_cpu(const vector<Blob<Dtype>*>& top,
+    const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+  const int N = this->N_;
+  const int D = this->layer_param_.recurrent_param().num_output();
+  const int M = this->T_ * N;
+  Blob<Dtype>* W_hh = this->unrolled_param("W_hh");
+  Blob<Dtype>* W_ho = this->unrolled_param("W_ho");
+  // Through the output layer for all timesteps at once.
+  const Dtype* o = top[0]->cpu_data();
+  const Dtype* o_diff = top[0]->cpu_diff();
+  Dtype* o_input_diff = output_input_diff_.mutable_cpu_data();
+  for (int i = 0; i < M * D; ++i) {
+    o_input_diff[i] = o_diff[i] * (1 - o[i] * o[i]);
+  }
+  caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, D, D, M, Dtype(1),
+      o_input_diff, hidden_.cpu_data(), Dtype(1), W_ho->mutable_cpu_diff());
+  caffe_cpu_gemv<Dtype>(CblasTrans, M, D, Dtype(1), o_input_diff,
+      this->bias_multiplier_.cpu_data(), Dtype(1),
+      this->unrolled_param("b_o")->mutable_cpu_diff());
+  Dtype* h_diff = hidden_.mutable_cpu_diff();
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M, D, D, Dtype(1),
+      o_input_diff, W_ho->cpu_data(), Dtype(0), h_diff);
+  // Back through time; no gradient flows in from the next batch or out to
+  // the initial state, as in the unrolled net.
+  Dtype* h_prev_diff = h_prev_diff_.mutable_cpu_data();
+  caffe_set(N * D, Dtype(0), h_prev_diff);
+  for (int t = this->T_ - 1; t >= 0; --t) {
+    const Dtype* h = hidden_.cpu_data() + t * N * D;
+    Dtype* h_input_diff = h_diff + t * N * D;
+    for (int i = 0; i < N * D; ++i) {
+      h_input_diff[i] = (h_input_diff[i] + h_prev_diff[i]) * (1 - h[i] * h[i]);
+    }
+    if (t > 0) {
+      const Dtype* cont = bottom[1]->cpu_data() + t * N;
+      caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, N, D, D, Dtype(1),
+          h_input_diff, W_hh->cpu_data(), Dtype(0), h_prev_diff);
+      for (int n = 0; n < N; ++n) {
+        caffe_scal(D, cont[n], h_prev_diff + n * D);
+      }
+    }
+  }
+  caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, D, D, M, Dtype(1),
+      h_diff, h_conted_.cpu_data(), Dtype(1), W_hh->mutable_cpu_diff());
+  this->FusedInputBackward(propagate_down, bottom, h_diff,
+      this->unrolled_param("W_xh"), this->unrolled_param("b_h"),
+      this->static_input_ ? this->unrolled_param("W_xh_static") : NULL);
+}
+
 INSTANTIATE_CLASS(RNNLayer);
 REGISTER_LAYER_CLASS(RNN);
 
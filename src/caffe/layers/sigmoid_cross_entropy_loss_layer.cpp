@@ -3,9 +3,13 @@
 
 #include "caffe/layers/sigmoid_cross_entropy_loss_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/vector_math.hpp"
 
 namespace caffe {
 
+// Maximum length of the runs of the CPU passes.
+static const int kSigmoidCrossEntropyRunSize = 256;
+
 template <typename Dtype>
 void SigmoidCrossEntropyLossLayer<Dtype>::LayerSetUp(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
@@ -41,6 +45,9 @@ void SigmoidCrossEntropyLossLayer<Dtype>::Reshape(
   CHECK_EQ(bottom[0]->count(), bottom[1]->count()) <<
       "SIGMOID_CROSS_ENTROPY_LOSS layer inputs must have the same count.";
   sigmoid_layer_->Reshape(sigmoid_bottom_vec_, sigmoid_top_vec_);
+  if (this->per_sample_loss_) {
+    top[1]->Reshape(vector<int>(1, outer_num_));
+  }
 }
 
 // TODO(shelhamer) loss normalization should be pulled up into LossLayer,
@@ -78,26 +85,43 @@ Dtype SigmoidCrossEntropyLossLayer<Dtype>::get_normalizer(
 template <typename Dtype>
 void SigmoidCrossEntropyLossLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-  // The forward pass computes the sigmoid outputs.
-  sigmoid_bottom_vec_[0] = bottom[0];
-  sigmoid_layer_->Forward(sigmoid_bottom_vec_, sigmoid_top_vec_);
-  // Compute the loss (negative log likelihood)
-  // Stable version of loss computation from input data
+  // The loss of each input is log(1 + exp(x)) - x * target, computed in one
+  // vectorized pass over the runs of inputs whose target is not ignored;
+  // Backward computes the sigmoid itself.
   const Dtype* input_data = bottom[0]->cpu_data();
   const Dtype* target = bottom[1]->cpu_data();
-  int valid_count = 0;
-  Dtype loss = 0;
-  for (int i = 0; i < bottom[0]->count(); ++i) {
-    const int target_value = static_cast<int>(target[i]);
-    if (has_ignore_label_ && target_value == ignore_label_) {
-      continue;
+  valid_count_ = this->FindLabelRuns(target, bottom[0]->count(), inner_num_,
+      kSigmoidCrossEntropyRunSize, has_ignore_label_, ignore_label_,
+      &valid_runs_);
+  const int num_runs = valid_runs_.size() / 2;
+  run_loss_.resize(num_runs);
+#ifdef _OPENMP
+#pragma omp parallel for if (static_cast<int64_t>(bottom[0]->count()) > 32768)
+#endif
+  for (int r = 0; r < num_runs; ++r) {
+    const int begin = valid_runs_[2 * r];
+    const int len = valid_runs_[2 * r + 1] - begin;
+    Dtype softplus[kSigmoidCrossEntropyRunSize];
+    caffe_cpu_vsoftplus(len, input_data + begin, softplus);
+    Dtype loss = 0;
+    for (int k = 0; k < len; ++k) {
+      loss += softplus[k] - input_data[begin + k] * target[begin + k];
     }
-    loss -= input_data[i] * (target[i] - (input_data[i] >= 0)) -
-        log(1 + exp(input_data[i] - 2 * input_data[i] * (input_data[i] >= 0)));
-    ++valid_count;
+    run_loss_[r] = loss;
+  }
+  Dtype loss = 0;
+  for (int r = 0; r < num_runs; ++r) {
+    loss += run_loss_[r];
   }
-  normalizer_ = get_normalizer(normalization_, valid_count);
+  normalizer_ = get_normalizer(normalization_, valid_count_);
   top[0]->mutable_cpu_data()[0] = loss / normalizer_;
+  if (this->per_sample_loss_) {
+    Dtype* sample_loss = top[1]->mutable_cpu_data();
+    caffe_set(outer_num_, Dtype(0), sample_loss);
+    for (int r = 0; r < num_runs; ++r) {
+      sample_loss[valid_runs_[2 * r] / inner_num_] += run_loss_[r];
+    }
+  }
 }
 
 template <typename Dtype>
@@ -109,24 +133,29 @@ void SigmoidCrossEntropyLossLayer<Dtype>::Backward_cpu(
                << " Layer cannot backpropagate to label inputs.";
   }
   if (propagate_down[0]) {
-    // First, compute the diff
+    // The gradient is loss_weight * (sigmoid(x) - target), and 0 for the
+    // ignored targets.
     const int count = bottom[0]->count();
-    const Dtype* sigmoid_output_data = sigmoid_output_->cpu_data();
+    const Dtype* input_data = bottom[0]->cpu_data();
     const Dtype* target = bottom[1]->cpu_data();
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-    caffe_sub(count, sigmoid_output_data, target, bottom_diff);
-    // Zero out gradient of ignored targets.
-    if (has_ignore_label_) {
-      for (int i = 0; i < count; ++i) {
-        const int target_value = static_cast<int>(target[i]);
-        if (target_value == ignore_label_) {
-          bottom_diff[i] = 0;
-        }
+    const Dtype loss_weight = top[0]->cpu_diff()[0] / normalizer_;
+    if (valid_count_ < count) {
+      caffe_set(count, Dtype(0), bottom_diff);
+    }
+    const int num_runs = valid_runs_.size() / 2;
+#ifdef _OPENMP
+#pragma omp parallel for if (static_cast<int64_t>(count) > 32768)
+#endif
+    for (int r = 0; r < num_runs; ++r) {
+      const int begin = valid_runs_[2 * r];
+      const int len = valid_runs_[2 * r + 1] - begin;
+      Dtype* diff = bottom_diff + begin;
+      caffe_cpu_vsigmoid(len, input_data + begin, diff);
+      for (int k = 0; k < len; ++k) {
+        diff[k] = (diff[k] - target[begin + k]) * loss_weight;
       }
     }
-    // Scale down gradient
-    Dtype loss_weight = top[0]->cpu_diff()[0] / normalizer_;
-    caffe_scal(count, loss_weight, bottom_diff);
   }
 }
 
@@ -68,6 +68,13 @@ void SigmoidCrossEntropyLossLayer<Dtype>::Forward_gpu(
   caffe_gpu_asum(count, loss_data, &loss);
   normalizer_ = get_normalizer(normalization_, valid_count);
   top[0]->mutable_cpu_data()[0] = loss / normalizer_;
+  if (this->per_sample_loss_) {
+    // The losses are all negated here, so their absolute sums will do.
+    Dtype* sample_loss = top[1]->mutable_cpu_data();
+    for (int i = 0; i < outer_num_; ++i) {
+      caffe_gpu_asum(inner_num_, loss_data + i * inner_num_, sample_loss + i);
+    }
+  }
 
   // Clear scratch memory to prevent interfering with backward (see #6202).
   caffe_gpu_set(bottom[0]->count(), Dtype(0), bottom[0]->mutable_gpu_diff());
@@ -71,13 +71,28 @@ void SliceLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   if (top.size() == 1) {
     top[0]->ShareData(*bottom[0]);
     top[0]->ShareDiff(*bottom[0]);
+    return;
+  }
+  // When nothing precedes the slice axis each top is a single contiguous
+  // piece of the bottom, and the net may let the tops be views of it.
+  share_tops_ = slice_param.share_tops() && num_slices_ == 1;
+  int offset = 0;
+  for (int i = 0; i < top.size(); ++i) {
+    if (share_tops_) {
+      if (!top[i]->IsViewOf(*bottom[0], offset)) {
+        top[i]->ShareView(*bottom[0], offset);
+      }
+    } else if (top[i]->SharesDataWith(*bottom[0])) {
+      top[i]->ReleaseView();
+    }
+    offset += top[i]->count();
   }
 }
 
 template <typename Dtype>
 void SliceLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
-  if (top.size() == 1) { return; }
+  if (top.size() == 1 || share_tops_) { return; }
   int offset_slice_axis = 0;
   const Dtype* bottom_data = bottom[0]->cpu_data();
   const int bottom_slice_axis = bottom[0]->shape(slice_axis_);
@@ -98,7 +113,7 @@ void SliceLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void SliceLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
-  if (!propagate_down[0] || top.size() == 1) { return; }
+  if (!propagate_down[0] || top.size() == 1 || share_tops_) { return; }
   int offset_slice_axis = 0;
   Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
   const int bottom_slice_axis = bottom[0]->shape(slice_axis_);
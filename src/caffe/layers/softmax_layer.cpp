@@ -3,21 +3,23 @@
 
 #include "caffe/layers/softmax_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/vector_math.hpp"
 
 namespace caffe {
 
+// Positions per tile when the channels are not contiguous.
+static const int kSoftmaxTileSize = 256;
+
 template <typename Dtype>
 void SoftmaxLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   softmax_axis_ =
       bottom[0]->CanonicalAxisIndex(this->layer_param_.softmax_param().axis());
   top[0]->ReshapeLike(*bottom[0]);
-  vector<int> mult_dims(1, bottom[0]->shape(softmax_axis_));
-  sum_multiplier_.Reshape(mult_dims);
-  Dtype* multiplier_data = sum_multiplier_.mutable_cpu_data();
-  caffe_set(sum_multiplier_.count(), Dtype(1), multiplier_data);
   outer_num_ = bottom[0]->count(0, softmax_axis_);
   inner_num_ = bottom[0]->count(softmax_axis_ + 1);
+  // scale_ holds the per-position sums of the GPU path; the CPU path keeps
+  // them on the stack.
   vector<int> scale_dims = bottom[0]->shape();
   scale_dims[softmax_axis_] = 1;
   scale_.Reshape(scale_dims);
@@ -28,33 +30,69 @@ void SoftmaxLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  Dtype* scale_data = scale_.mutable_cpu_data();
-  int channels = bottom[0]->shape(softmax_axis_);
-  int dim = bottom[0]->count() / outer_num_;
-  caffe_copy(bottom[0]->count(), bottom_data, top_data);
-  // We need to subtract the max to avoid numerical issues, compute the exp,
-  // and then normalize.
-  for (int i = 0; i < outer_num_; ++i) {
-    // initialize scale_data to the first plane
-    caffe_copy(inner_num_, bottom_data + i * dim, scale_data);
-    for (int j = 0; j < channels; j++) {
-      for (int k = 0; k < inner_num_; k++) {
-        scale_data[k] = std::max(scale_data[k],
-            bottom_data[i * dim + j * inner_num_ + k]);
+  const int channels = bottom[0]->shape(softmax_axis_);
+  const int dim = channels * inner_num_;
+  if (inner_num_ == 1) {
+    // Each row is contiguous: find its max, then write exp(x - max) while
+    // summing it, and normalize the row while it is still in cache.
+#ifdef _OPENMP
+#pragma omp parallel for if (static_cast<int64_t>(bottom[0]->count()) > 32768)
+#endif
+    for (int i = 0; i < outer_num_; ++i) {
+      const Dtype* x = bottom_data + i * dim;
+      Dtype* y = top_data + i * dim;
+      Dtype max_val = x[0];
+      for (int c = 1; c < channels; ++c) {
+        max_val = std::max(max_val, x[c]);
+      }
+      const Dtype inv_sum =
+          Dtype(1) / caffe_cpu_vexp_sum(channels, x, max_val, y);
+      for (int c = 0; c < channels; ++c) {
+        y[c] *= inv_sum;
       }
     }
-    // subtraction
-    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels, inner_num_,
-        1, -1., sum_multiplier_.cpu_data(), scale_data, 1., top_data);
-    // exponentiation
-    caffe_exp<Dtype>(dim, top_data, top_data);
-    // sum after exp
-    caffe_cpu_gemv<Dtype>(CblasTrans, channels, inner_num_, 1.,
-        top_data, sum_multiplier_.cpu_data(), 0., scale_data);
-    // division
-    for (int j = 0; j < channels; j++) {
-      caffe_div(inner_num_, top_data, scale_data, top_data);
-      top_data += inner_num_;
+    return;
+  }
+  // Otherwise the channels of a position are inner_num_ apart: go over them
+  // for a tile of positions at a time, so that the loops run along the
+  // contiguous positions and the tile stays in cache between the passes.
+  const int num_tiles = (inner_num_ + kSoftmaxTileSize - 1) / kSoftmaxTileSize;
+#ifdef _OPENMP
+#pragma omp parallel for if (static_cast<int64_t>(bottom[0]->count()) > 32768)
+#endif
+  for (int t = 0; t < outer_num_ * num_tiles; ++t) {
+    const int begin = (t % num_tiles) * kSoftmaxTileSize;
+    const int len = std::min(kSoftmaxTileSize, inner_num_ - begin);
+    const Dtype* x = bottom_data + (t / num_tiles) * dim + begin;
+    Dtype* y = top_data + (t / num_tiles) * dim + begin;
+    Dtype max_val[kSoftmaxTileSize];
+    Dtype sum[kSoftmaxTileSize];
+    std::copy(x, x + len, max_val);
+    for (int c = 1; c < channels; ++c) {
+      for (int k = 0; k < len; ++k) {
+        max_val[k] = std::max(max_val[k], x[c * inner_num_ + k]);
+      }
+    }
+    std::fill(sum, sum + len, Dtype(0));
+    for (int c = 0; c < channels; ++c) {
+      const Dtype* x_c = x + c * inner_num_;
+      Dtype* y_c = y + c * inner_num_;
+      for (int k = 0; k < len; ++k) {
+        y_c[k] = x_c[k] - max_val[k];
+      }
+      caffe_cpu_vexp(len, y_c, y_c);
+      for (int k = 0; k < len; ++k) {
+        sum[k] += y_c[k];
+      }
+    }
+    for (int k = 0; k < len; ++k) {
+      sum[k] = Dtype(1) / sum[k];
+    }
+    for (int c = 0; c < channels; ++c) {
+      Dtype* y_c = y + c * inner_num_;
+      for (int k = 0; k < len; ++k) {
+        y_c[k] *= sum[k];
+      }
     }
   }
 }
@@ -66,26 +104,52 @@ void SoftmaxLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   const Dtype* top_diff = top[0]->cpu_diff();
   const Dtype* top_data = top[0]->cpu_data();
   Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-  Dtype* scale_data = scale_.mutable_cpu_data();
-  int channels = top[0]->shape(softmax_axis_);
-  int dim = top[0]->count() / outer_num_;
-  caffe_copy(top[0]->count(), top_diff, bottom_diff);
-  for (int i = 0; i < outer_num_; ++i) {
-    // compute dot(top_diff, top_data) and subtract them from the bottom diff
-    for (int k = 0; k < inner_num_; ++k) {
-      scale_data[k] = caffe_cpu_strided_dot<Dtype>(channels,
-          bottom_diff + i * dim + k, inner_num_,
-          top_data + i * dim + k, inner_num_);
+  const int channels = top[0]->shape(softmax_axis_);
+  const int dim = channels * inner_num_;
+  // bottom_diff = top_data * (top_diff - dot(top_diff, top_data)), where the
+  // dot product runs over the channels of each position.
+  if (inner_num_ == 1) {
+#ifdef _OPENMP
+#pragma omp parallel for if (static_cast<int64_t>(top[0]->count()) > 32768)
+#endif
+    for (int i = 0; i < outer_num_; ++i) {
+      const Dtype* dy = top_diff + i * dim;
+      const Dtype* y = top_data + i * dim;
+      Dtype* dx = bottom_diff + i * dim;
+      const Dtype dot = caffe_cpu_dot(channels, dy, y);
+      for (int c = 0; c < channels; ++c) {
+        dx[c] = y[c] * (dy[c] - dot);
+      }
+    }
+    return;
+  }
+  const int num_tiles = (inner_num_ + kSoftmaxTileSize - 1) / kSoftmaxTileSize;
+#ifdef _OPENMP
+#pragma omp parallel for if (static_cast<int64_t>(top[0]->count()) > 32768)
+#endif
+  for (int t = 0; t < outer_num_ * num_tiles; ++t) {
+    const int begin = (t % num_tiles) * kSoftmaxTileSize;
+    const int len = std::min(kSoftmaxTileSize, inner_num_ - begin);
+    const int offset = (t / num_tiles) * dim + begin;
+    const Dtype* dy = top_diff + offset;
+    const Dtype* y = top_data + offset;
+    Dtype* dx = bottom_diff + offset;
+    Dtype dot[kSoftmaxTileSize];
+    std::fill(dot, dot + len, Dtype(0));
+    for (int c = 0; c < channels; ++c) {
+      for (int k = 0; k < len; ++k) {
+        dot[k] += dy[c * inner_num_ + k] * y[c * inner_num_ + k];
+      }
+    }
+    for (int c = 0; c < channels; ++c) {
+      for (int k = 0; k < len; ++k) {
+        const int index = c * inner_num_ + k;
+        dx[index] = y[index] * (dy[index] - dot[k]);
+      }
     }
-    // subtraction
-    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels, inner_num_, 1,
-        -1., sum_multiplier_.cpu_data(), scale_data, 1., bottom_diff + i * dim);
   }
-  // elementwise multiplication
-  caffe_mul(top[0]->count(), bottom_diff, top_data, bottom_diff);
 }
 
-
 #ifdef CPU_ONLY
 STUB_GPU(SoftmaxLayer);
 #endif
@@ -1,18 +1,23 @@
 #include <algorithm>
-#include <cfloat>
+#include <cmath>
 #include <vector>
 
 #include "caffe/layers/softmax_loss_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/vector_math.hpp"
 
 namespace caffe {
 
+// Positions per run of the CPU passes when the channels are not contiguous.
+static const int kSoftmaxTileSize = 256;
+
 template <typename Dtype>
 void SoftmaxWithLossLayer<Dtype>::LayerSetUp(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
   LossLayer<Dtype>::LayerSetUp(bottom, top);
   LayerParameter softmax_param(this->layer_param_);
   softmax_param.set_type("Softmax");
+  softmax_param.clear_loss_weight();
   softmax_layer_ = LayerRegistry<Dtype>::CreateLayer(softmax_param);
   softmax_bottom_vec_.clear();
   softmax_bottom_vec_.push_back(bottom[0]);
@@ -49,10 +54,17 @@ void SoftmaxWithLossLayer<Dtype>::Reshape(
       << "e.g., if softmax axis == 1 and prediction shape is (N, C, H, W), "
       << "label count (number of labels) must be N*H*W, "
       << "with integer values in {0, 1, ..., C-1}.";
-  if (top.size() >= 2) {
+  if (top.size() >= 2 + this->per_sample_loss_) {
     // softmax output
     top[1]->ReshapeLike(*bottom[0]);
   }
+  if (this->per_sample_loss_) {
+    top.back()->Reshape(vector<int>(1, outer_num_));
+  }
+  vector<int> log_norm_shape(2);
+  log_norm_shape[0] = outer_num_;
+  log_norm_shape[1] = inner_num_;
+  log_norm_.Reshape(log_norm_shape);
 }
 
 template <typename Dtype>
@@ -88,29 +100,71 @@ Dtype SoftmaxWithLossLayer<Dtype>::get_normalizer(
 template <typename Dtype>
 void SoftmaxWithLossLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-  // The forward pass computes the softmax prob values.
-  softmax_layer_->Forward(softmax_bottom_vec_, softmax_top_vec_);
-  const Dtype* prob_data = prob_.cpu_data();
+  // The loss is log(sum_c exp(x_c)) - x_label, so only the normalizer of
+  // each position is computed, as max + log(sum_c exp(x_c - max)); the
+  // probabilities are written only for the optional second top. The positions
+  // with the ignore label are skipped, unless the probabilities are wanted.
+  const Dtype* bottom_data = bottom[0]->cpu_data();
   const Dtype* label = bottom[1]->cpu_data();
-  int dim = prob_.count() / outer_num_;
-  int count = 0;
-  Dtype loss = 0;
-  for (int i = 0; i < outer_num_; ++i) {
-    for (int j = 0; j < inner_num_; j++) {
-      const int label_value = static_cast<int>(label[i * inner_num_ + j]);
+  Dtype* log_norm = log_norm_.mutable_cpu_data();
+  Dtype* prob_data = top.size() >= 2 + this->per_sample_loss_ ?
+      top[1]->mutable_cpu_data() : NULL;
+  const int channels = bottom[0]->shape(softmax_axis_);
+  const int dim = channels * inner_num_;
+  const int num_positions = outer_num_ * inner_num_;
+  valid_count_ = this->FindLabelRuns(label, num_positions, inner_num_,
+      kSoftmaxTileSize, has_ignore_label_, ignore_label_, &valid_runs_);
+  vector<int> all_runs;
+  if (prob_data && valid_count_ < num_positions) {
+    this->FindLabelRuns(label, num_positions, inner_num_, kSoftmaxTileSize,
+        false, 0, &all_runs);
+  }
+  const vector<int>& runs = all_runs.empty() ? valid_runs_ : all_runs;
+  const int num_runs = runs.size() / 2;
+  run_loss_.resize(num_runs);
+#ifdef _OPENMP
+#pragma omp parallel for if (static_cast<int64_t>(bottom[0]->count()) > 32768)
+#endif
+  for (int r = 0; r < num_runs; ++r) {
+    const int begin = runs[2 * r];
+    const int len = runs[2 * r + 1] - begin;
+    const Dtype* x = bottom_data + (begin / inner_num_) * dim +
+        begin % inner_num_;
+    Dtype* norm = log_norm + begin;
+    caffe_cpu_log_sum_exp(channels, len, inner_num_, x, norm);
+    Dtype loss = 0;
+    for (int k = 0; k < len; ++k) {
+      const int label_value = static_cast<int>(label[begin + k]);
       if (has_ignore_label_ && label_value == ignore_label_) {
         continue;
       }
       DCHECK_GE(label_value, 0);
-      DCHECK_LT(label_value, prob_.shape(softmax_axis_));
-      loss -= log(std::max(prob_data[i * dim + label_value * inner_num_ + j],
-                           Dtype(FLT_MIN)));
-      ++count;
+      DCHECK_LT(label_value, channels);
+      loss += norm[k] - x[label_value * inner_num_ + k];
+    }
+    run_loss_[r] = loss;
+    if (prob_data) {
+      Dtype* prob = prob_data + (x - bottom_data);
+      for (int c = 0; c < channels; ++c) {
+        for (int k = 0; k < len; ++k) {
+          prob[c * inner_num_ + k] = x[c * inner_num_ + k] - norm[k];
+        }
+        caffe_cpu_vexp(len, prob + c * inner_num_, prob + c * inner_num_);
+      }
     }
   }
-  top[0]->mutable_cpu_data()[0] = loss / get_normalizer(normalization_, count);
-  if (top.size() == 2) {
-    top[1]->ShareData(prob_);
+  Dtype loss = 0;
+  for (int r = 0; r < num_runs; ++r) {
+    loss += run_loss_[r];
+  }
+  top[0]->mutable_cpu_data()[0] =
+      loss / get_normalizer(normalization_, valid_count_);
+  if (this->per_sample_loss_) {
+    Dtype* sample_loss = top.back()->mutable_cpu_data();
+    caffe_set(outer_num_, Dtype(0), sample_loss);
+    for (int r = 0; r < num_runs; ++r) {
+      sample_loss[runs[2 * r] / inner_num_] += run_loss_[r];
+    }
   }
 }
 
@@ -122,29 +176,51 @@ void SoftmaxWithLossLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
                << " Layer cannot backpropagate to label inputs.";
   }
   if (propagate_down[0]) {
+    const Dtype* bottom_data = bottom[0]->cpu_data();
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-    const Dtype* prob_data = prob_.cpu_data();
-    caffe_copy(prob_.count(), prob_data, bottom_diff);
     const Dtype* label = bottom[1]->cpu_data();
-    int dim = prob_.count() / outer_num_;
-    int count = 0;
-    for (int i = 0; i < outer_num_; ++i) {
-      for (int j = 0; j < inner_num_; ++j) {
-        const int label_value = static_cast<int>(label[i * inner_num_ + j]);
-        if (has_ignore_label_ && label_value == ignore_label_) {
-          for (int c = 0; c < bottom[0]->shape(softmax_axis_); ++c) {
-            bottom_diff[i * dim + c * inner_num_ + j] = 0;
+    const Dtype* log_norm = log_norm_.cpu_data();
+    const int channels = bottom[0]->shape(softmax_axis_);
+    const int dim = channels * inner_num_;
+    const Dtype loss_weight = top[0]->cpu_diff()[0] /
+                              get_normalizer(normalization_, valid_count_);
+    // The gradient is loss_weight * (prob - 1{c == label}), with the
+    // probabilities recomputed from the normalizers of the forward pass, and
+    // 0 at the ignored positions, which the runs of the forward pass skip.
+    if (valid_count_ < outer_num_ * inner_num_) {
+      caffe_set(bottom[0]->count(), Dtype(0), bottom_diff);
+    }
+    const int num_runs = valid_runs_.size() / 2;
+#ifdef _OPENMP
+#pragma omp parallel for if (static_cast<int64_t>(bottom[0]->count()) > 32768)
+#endif
+    for (int r = 0; r < num_runs; ++r) {
+      const int begin = valid_runs_[2 * r];
+      const int len = valid_runs_[2 * r + 1] - begin;
+      const int offset = (begin / inner_num_) * dim + begin % inner_num_;
+      const Dtype* x = bottom_data + offset;
+      Dtype* dx = bottom_diff + offset;
+      const Dtype* norm = log_norm + begin;
+      if (inner_num_ == 1) {
+        caffe_cpu_vexp_sum(channels, x, norm[0], dx);
+      } else {
+        for (int c = 0; c < channels; ++c) {
+          for (int k = 0; k < len; ++k) {
+            dx[c * inner_num_ + k] = x[c * inner_num_ + k] - norm[k];
           }
-        } else {
-          bottom_diff[i * dim + label_value * inner_num_ + j] -= 1;
-          ++count;
+          caffe_cpu_vexp(len, dx + c * inner_num_, dx + c * inner_num_);
+        }
+      }
+      for (int c = 0; c < channels; ++c) {
+        for (int k = 0; k < len; ++k) {
+          dx[c * inner_num_ + k] *= loss_weight;
         }
       }
+      for (int k = 0; k < len; ++k) {
+        const int label_value = static_cast<int>(label[begin + k]);
+        dx[label_value * inner_num_ + k] -= loss_weight;
+      }
     }
-    // Scale gradient
-    Dtype loss_weight = top[0]->cpu_diff()[0] /
-                        get_normalizer(normalization_, count);
-    caffe_scal(prob_.count(), loss_weight, bottom_diff);
   }
 }
 
@@ -57,9 +57,15 @@ void SoftmaxWithLossLayer<Dtype>::Forward_gpu(
   }
   top[0]->mutable_cpu_data()[0] = loss / get_normalizer(normalization_,
                                                         valid_count);
-  if (top.size() == 2) {
+  if (top.size() >= 2 + this->per_sample_loss_) {
     top[1]->ShareData(prob_);
   }
+  if (this->per_sample_loss_) {
+    Dtype* sample_loss = top.back()->mutable_cpu_data();
+    for (int i = 0; i < outer_num_; ++i) {
+      caffe_gpu_asum(inner_num_, loss_data + i * inner_num_, sample_loss + i);
+    }
+  }
 
   // Clear scratch memory to prevent interfering with backward (see #6202).
   caffe_gpu_set(bottom[0]->count(), Dtype(0), bottom[0]->mutable_gpu_diff());
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cfloat>
 #include <vector>
 
 #include "caffe/layer.hpp"
@@ -13,6 +14,17 @@ namespace caffe {
 using std::min;
 using std::max;
 
+// The number of windows of the given size and padding along an axis, with
+// stride equal to the size, as PoolingLayer counts them.
+static int spp_pooled_size(const int size, const int kernel, const int pad) {
+  int pooled = static_cast<int>(ceil(static_cast<float>(
+      size + 2 * pad - kernel) / kernel)) + 1;
+  if (pad && (pooled - 1) * kernel >= size + pad) {
+    --pooled;
+  }
+  return pooled;
+}
+
 template <typename Dtype>
 LayerParameter SPPLayer<Dtype>::GetPoolingParam(const int pyramid_level,
       const int bottom_h, const int bottom_w, const SPPParameter spp_param) {
@@ -75,6 +87,16 @@ void SPPLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   CHECK_GT(bottom_w_, 0) << "Input dimensions cannot be zero.";
 
   pyramid_height_ = spp_param.pyramid_height();
+  const bool stochastic =
+      spp_param.pool() == SPPParameter_PoolMethod_STOCHASTIC;
+  fused_ = spp_param.engine() == SPPParameter_Engine_FUSED ||
+      (spp_param.engine() == SPPParameter_Engine_DEFAULT &&
+       Caffe::mode() == Caffe::CPU && !stochastic);
+  CHECK(!fused_ || !stochastic)
+      << "The fused SPP engine does not do stochastic pooling.";
+  if (fused_) {
+    return;
+  }
   split_top_vec_.clear();
   pooling_bottom_vecs_.clear();
   pooling_layers_.clear();
@@ -147,6 +169,45 @@ void SPPLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   CHECK_EQ(4, bottom[0]->num_axes()) << "Input must have 4 axes, "
       << "corresponding to (num, channels, height, width)";
+  if (fused_) {
+    num_ = bottom[0]->num();
+    channels_ = bottom[0]->channels();
+    bottom_h_ = bottom[0]->height();
+    bottom_w_ = bottom[0]->width();
+    SPPParameter spp_param = this->layer_param_.spp_param();
+    levels_.resize(pyramid_height_);
+    int offset = 0;
+    for (int i = 0; i < pyramid_height_; ++i) {
+      const PoolingParameter pool_param = GetPoolingParam(
+          i, bottom_h_, bottom_w_, spp_param).pooling_param();
+      Level& level = levels_[i];
+      level.kernel_h = pool_param.kernel_h();
+      level.kernel_w = pool_param.kernel_w();
+      level.pad_h = pool_param.pad_h();
+      level.pad_w = pool_param.pad_w();
+      CHECK_LT(level.pad_h, level.kernel_h);
+      CHECK_LT(level.pad_w, level.kernel_w);
+      level.pooled_h = spp_pooled_size(bottom_h_, level.kernel_h, level.pad_h);
+      level.pooled_w = spp_pooled_size(bottom_w_, level.kernel_w, level.pad_w);
+      level.offset = offset;
+      offset += channels_ * level.pooled_h * level.pooled_w;
+    }
+    // The shape the internal layers give: the pooling output for a single
+    // level, else the concatenated flattened levels.
+    if (pyramid_height_ == 1) {
+      top[0]->Reshape(num_, channels_, levels_[0].pooled_h,
+          levels_[0].pooled_w);
+    } else {
+      vector<int> top_shape(2);
+      top_shape[0] = num_;
+      top_shape[1] = offset;
+      top[0]->Reshape(top_shape);
+    }
+    if (spp_param.pool() == SPPParameter_PoolMethod_MAX) {
+      max_idx_.Reshape(top[0]->shape());
+    }
+    return;
+  }
   // Do nothing if bottom shape is unchanged since last Reshape
   if (num_ == bottom[0]->num() && channels_ == bottom[0]->channels() &&
       bottom_h_ == bottom[0]->height() && bottom_w_ == bottom[0]->width() &&
@@ -187,6 +248,10 @@ void SPPLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void SPPLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+  if (fused_) {
+    FusedForward_cpu(bottom, top);
+    return;
+  }
   if (pyramid_height_ == 1) {
     pooling_layers_[0]->Forward(bottom, top);
     return;
@@ -207,6 +272,10 @@ void SPPLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   if (!propagate_down[0]) {
     return;
   }
+  if (fused_) {
+    FusedBackward_cpu(top, bottom);
+    return;
+  }
   if (pyramid_height_ == 1) {
     pooling_layers_[0]->Backward(top, propagate_down, bottom);
     return;
@@ -222,6 +291,123 @@ void SPPLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   split_layer_->Backward(split_top_vec_, propagate_down, bottom);
 }
 
+template <typename Dtype>
+void SPPLayer<Dtype>::FusedForward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  const bool max_pool = this->layer_param_.spp_param().pool() ==
+      SPPParameter_PoolMethod_MAX;
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  int* mask = max_pool ? max_idx_.mutable_cpu_data() : NULL;
+  const int top_dim = top[0]->count(1);
+  const int plane = bottom_h_ * bottom_w_;
+  // Every level of a channel while its plane is in cache, each bin written
+  // straight to its place in the concatenated output.
+#ifdef _OPENMP
+#pragma omp parallel for if (static_cast<int64_t>(bottom[0]->count()) > 32768)
+#endif
+  for (int nc = 0; nc < num_ * channels_; ++nc) {
+    const Dtype* x = bottom_data + nc * plane;
+    const int n = nc / channels_;
+    const int c = nc % channels_;
+    for (int l = 0; l < levels_.size(); ++l) {
+      const Level& level = levels_[l];
+      const int out = n * top_dim + level.offset +
+          c * level.pooled_h * level.pooled_w;
+      for (int ph = 0; ph < level.pooled_h; ++ph) {
+        for (int pw = 0; pw < level.pooled_w; ++pw) {
+          int hstart = ph * level.kernel_h - level.pad_h;
+          int wstart = pw * level.kernel_w - level.pad_w;
+          const int index = out + ph * level.pooled_w + pw;
+          if (max_pool) {
+            const int hend = min(hstart + level.kernel_h, bottom_h_);
+            const int wend = min(wstart + level.kernel_w, bottom_w_);
+            hstart = max(hstart, 0);
+            wstart = max(wstart, 0);
+            Dtype value = -FLT_MAX;
+            int max_index = -1;
+            for (int h = hstart; h < hend; ++h) {
+              for (int w = wstart; w < wend; ++w) {
+                if (x[h * bottom_w_ + w] > value) {
+                  value = x[h * bottom_w_ + w];
+                  max_index = h * bottom_w_ + w;
+                }
+              }
+            }
+            top_data[index] = value;
+            mask[index] = max_index;
+          } else {
+            int hend = min(hstart + level.kernel_h, bottom_h_ + level.pad_h);
+            int wend = min(wstart + level.kernel_w, bottom_w_ + level.pad_w);
+            const int pool_size = (hend - hstart) * (wend - wstart);
+            hstart = max(hstart, 0);
+            wstart = max(wstart, 0);
+            hend = min(hend, bottom_h_);
+            wend = min(wend, bottom_w_);
+            Dtype sum = 0;
+            for (int h = hstart; h < hend; ++h) {
+              for (int w = wstart; w < wend; ++w) {
+                sum += x[h * bottom_w_ + w];
+              }
+            }
+            top_data[index] = sum / pool_size;
+          }
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void SPPLayer<Dtype>::FusedBackward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<Blob<Dtype>*>& bottom) {
+  const bool max_pool = this->layer_param_.spp_param().pool() ==
+      SPPParameter_PoolMethod_MAX;
+  const Dtype* top_diff = top[0]->cpu_diff();
+  Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
+  const int* mask = max_pool ? max_idx_.cpu_data() : NULL;
+  const int top_dim = top[0]->count(1);
+  const int plane = bottom_h_ * bottom_w_;
+#ifdef _OPENMP
+#pragma omp parallel for if (static_cast<int64_t>(bottom[0]->count()) > 32768)
+#endif
+  for (int nc = 0; nc < num_ * channels_; ++nc) {
+    Dtype* dx = bottom_diff + nc * plane;
+    caffe_set(plane, Dtype(0), dx);
+    const int n = nc / channels_;
+    const int c = nc % channels_;
+    for (int l = 0; l < levels_.size(); ++l) {
+      const Level& level = levels_[l];
+      const int out = n * top_dim + level.offset +
+          c * level.pooled_h * level.pooled_w;
+      for (int ph = 0; ph < level.pooled_h; ++ph) {
+        for (int pw = 0; pw < level.pooled_w; ++pw) {
+          const int index = out + ph * level.pooled_w + pw;
+          if (max_pool) {
+            dx[mask[index]] += top_diff[index];
+            continue;
+          }
+          int hstart = ph * level.kernel_h - level.pad_h;
+          int wstart = pw * level.kernel_w - level.pad_w;
+          int hend = min(hstart + level.kernel_h, bottom_h_ + level.pad_h);
+          int wend = min(wstart + level.kernel_w, bottom_w_ + level.pad_w);
+          const int pool_size = (hend - hstart) * (wend - wstart);
+          hstart = max(hstart, 0);
+          wstart = max(wstart, 0);
+          hend = min(hend, bottom_h_);
+          wend = min(wend, bottom_w_);
+          const Dtype diff = top_diff[index] / pool_size;
+          for (int h = hstart; h < hend; ++h) {
+            for (int w = wstart; w < wend; ++w) {
+              dx[h * bottom_w_ + w] += diff;
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
 INSTANTIATE_CLASS(SPPLayer);
 REGISTER_LAYER_CLASS(SPP);
 
@@ -1,42 +1,31 @@
-#include <cmath>
 #include <vector>
 
 #include "caffe/layers/swish_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/vector_math.hpp"
 
 namespace caffe {
 
-template <typename Dtype>
-void SwishLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
-      const vector<Blob<Dtype>*>& top) {
-  NeuronLayer<Dtype>::LayerSetUp(bottom, top);
-  sigmoid_bottom_vec_.clear();
-  sigmoid_bottom_vec_.push_back(sigmoid_input_.get());
-  sigmoid_top_vec_.clear();
-  sigmoid_top_vec_.push_back(sigmoid_output_.get());
-  sigmoid_layer_->SetUp(sigmoid_bottom_vec_, sigmoid_top_vec_);
-}
-
 template <typename Dtype>
 void SwishLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   NeuronLayer<Dtype>::Reshape(bottom, top);
-  sigmoid_input_->ReshapeLike(*bottom[0]);
-  sigmoid_layer_->Reshape(sigmoid_bottom_vec_, sigmoid_top_vec_);
+  // In place, Backward has no inputs to recompute the sigmoid from.
+  keep_sigmoid_output_ = this->phase_ == TRAIN || bottom[0] == top[0];
+  if (keep_sigmoid_output_) {
+    sigmoid_output_.ReshapeLike(*bottom[0]);
+  }
 }
 
 template <typename Dtype>
 void SwishLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
-  Dtype* sigmoid_input_data = sigmoid_input_->mutable_cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
   Dtype beta = this->layer_param_.swish_param().beta();
-  caffe_copy(count, bottom_data, sigmoid_input_data);
-  caffe_scal(count, beta, sigmoid_input_data);
-  sigmoid_layer_->Forward(sigmoid_bottom_vec_, sigmoid_top_vec_);
-  caffe_mul(count, bottom_data, sigmoid_output_->cpu_data(), top_data);
+  caffe_cpu_vswish(count, bottom_data, beta, top_data, keep_sigmoid_output_ ?
+      sigmoid_output_.mutable_cpu_data() : NULL);
 }
 
 template <typename Dtype>
@@ -46,10 +35,19 @@ void SwishLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   if (propagate_down[0]) {
     const Dtype* top_data = top[0]->cpu_data();
     const Dtype* top_diff = top[0]->cpu_diff();
-    const Dtype* sigmoid_output_data = sigmoid_output_->cpu_data();
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
     const int count = bottom[0]->count();
     Dtype beta = this->layer_param_.swish_param().beta();
+    const Dtype* sigmoid_output_data;
+    if (keep_sigmoid_output_) {
+      sigmoid_output_data = sigmoid_output_.cpu_data();
+    } else {
+      // Recompute the sigmoid into bottom_diff, which the loop below reads
+      // element by element before overwriting.
+      caffe_cpu_scale(count, beta, bottom[0]->cpu_data(), bottom_diff);
+      caffe_cpu_vsigmoid(count, bottom_diff, bottom_diff);
+      sigmoid_output_data = bottom_diff;
+    }
     for (int i = 0; i < count; ++i) {
       const Dtype swish_x = top_data[i];
       bottom_diff[i] = top_diff[i] * (beta * swish_x + sigmoid_output_data[i]
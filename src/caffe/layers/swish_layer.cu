@@ -6,28 +6,44 @@
 
 namespace caffe {
 
+template <typename Dtype>
+__global__ void SwishForward(const int n, const Dtype* in, const Dtype beta,
+    Dtype* out, Dtype* sigmoid_out) {
+  CUDA_KERNEL_LOOP(index, n) {
+    const Dtype x = in[index];
+    const Dtype sigmoid_x = 0.5 * tanh(0.5 * beta * x) + 0.5;
+    if (sigmoid_out) {
+      sigmoid_out[index] = sigmoid_x;
+    }
+    out[index] = x * sigmoid_x;
+  }
+}
+
 template <typename Dtype>
 void SwishLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->gpu_data();
-  Dtype* sigmoid_input_data = sigmoid_input_->mutable_gpu_data();
   Dtype* top_data = top[0]->mutable_gpu_data();
   const int count = bottom[0]->count();
   Dtype beta = this->layer_param_.swish_param().beta();
-  caffe_copy(count, bottom_data, sigmoid_input_data);
-  caffe_gpu_scal(count, beta, sigmoid_input_data);
-  sigmoid_layer_->Forward(sigmoid_bottom_vec_, sigmoid_top_vec_);
-  caffe_gpu_mul(count, bottom_data, sigmoid_output_->gpu_data(), top_data);
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  SwishForward<Dtype><<<CAFFE_GET_BLOCKS(count), CAFFE_CUDA_NUM_THREADS>>>(
+      count, bottom_data, beta, top_data, keep_sigmoid_output_ ?
+      sigmoid_output_.mutable_gpu_data() : NULL);
+  CUDA_POST_KERNEL_CHECK;
 }
 
+// Without sigmoid_output_data the sigmoid is recomputed from in_data.
 template <typename Dtype>
 __global__ void SwishBackward(const int n, const Dtype* in_diff,
-    const Dtype* out_data, const Dtype* sigmoid_output_data, Dtype* out_diff,
-    const Dtype beta) {
+    const Dtype* out_data, const Dtype* sigmoid_output_data,
+    const Dtype* in_data, Dtype* out_diff, const Dtype beta) {
   CUDA_KERNEL_LOOP(index, n) {
     const Dtype swish_x = out_data[index];
+    const Dtype sigmoid_x = sigmoid_output_data ? sigmoid_output_data[index]
+        : Dtype(0.5 * tanh(0.5 * beta * in_data[index]) + 0.5);
     out_diff[index] = in_diff[index] * (beta * swish_x
-        + sigmoid_output_data[index] * (1 - beta * swish_x));
+        + sigmoid_x * (1 - beta * swish_x));
   }
 }
 
@@ -38,13 +54,15 @@ void SwishLayer<Dtype>::Backward_gpu(const vector<Blob<Dtype>*>& top,
   if (propagate_down[0]) {
     const Dtype* top_data = top[0]->gpu_data();
     const Dtype* top_diff = top[0]->gpu_diff();
-    const Dtype* sigmoid_output_data = sigmoid_output_->gpu_data();
+    const Dtype* sigmoid_output_data =
+        keep_sigmoid_output_ ? sigmoid_output_.gpu_data() : NULL;
     Dtype* bottom_diff = bottom[0]->mutable_gpu_diff();
     const int count = bottom[0]->count();
     Dtype beta = this->layer_param_.swish_param().beta();
     // NOLINT_NEXT_LINE(whitespace/operators)
     SwishBackward<Dtype><<<CAFFE_GET_BLOCKS(count), CAFFE_CUDA_NUM_THREADS>>>(
-        count, top_diff, top_data, sigmoid_output_data, bottom_diff, beta);
+        count, top_diff, top_data, sigmoid_output_data, bottom[0]->gpu_data(),
+        bottom_diff, beta);
     CUDA_POST_KERNEL_CHECK;
   }
 }
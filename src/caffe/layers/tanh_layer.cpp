@@ -4,6 +4,7 @@
 #include <vector>
 
 #include "caffe/layers/tanh_layer.hpp"
+#include "caffe/util/vector_math.hpp"
 
 namespace caffe {
 
@@ -13,9 +14,7 @@ void TanHLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
-  for (int i = 0; i < count; ++i) {
-    top_data[i] = tanh(bottom_data[i]);
-  }
+  caffe_cpu_vtanh(count, bottom_data, top_data);
 }
 
 template <typename Dtype>
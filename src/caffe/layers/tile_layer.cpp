@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <vector>
 
 #include "caffe/layers/tile_layer.hpp"
@@ -26,10 +27,14 @@ void TileLayer<Dtype>::Forward_cpu(
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   for (int i = 0; i < outer_dim_; ++i) {
-    for (int t = 0; t < tiles_; ++t) {
-      caffe_copy(inner_dim_, bottom_data, top_data);
-      top_data += inner_dim_;
+    // Copy the first tile, then double the tiles copied so far, so that few
+    // copies of growing size fill the top.
+    caffe_copy(inner_dim_, bottom_data, top_data);
+    for (unsigned int done = 1; done < tiles_; done *= 2) {
+      caffe_copy(std::min(done, tiles_ - done) * inner_dim_, top_data,
+          top_data + done * inner_dim_);
     }
+    top_data += tiles_ * inner_dim_;
     bottom_data += inner_dim_;
   }
 }
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cmath>
 #include <map>
 #include <set>
 #include <string>
@@ -12,6 +13,8 @@
 #include "caffe/net.hpp"
 #include "caffe/parallel.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/blob_views.hpp"
+#include "caffe/util/fuse_layers.hpp"
 #include "caffe/util/hdf5.hpp"
 #include "caffe/util/insert_splits.hpp"
 #include "caffe/util/math_functions.hpp"
@@ -48,12 +51,21 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   // the current NetState.
   NetParameter filtered_param;
   FilterNet(in_param, &filtered_param);
+  // Fold activations into the layers they follow for inference, if asked.
+  if (phase_ == TEST && in_param.fuse_layers()) {
+    NetParameter fused_param;
+    FuseLayers(filtered_param, &fused_param);
+    filtered_param.Swap(&fused_param);
+  }
   LOG_IF(INFO, Caffe::root_solver())
       << "Initializing net from parameters: " << std::endl
       << filtered_param.DebugString();
   // Create a copy of filtered_param with splits added where necessary.
+  NetParameter split_param;
+  InsertSplits(filtered_param, &split_param);
+  // Let Concat and Slice layers use views instead of copies where possible.
   NetParameter param;
-  InsertSplits(filtered_param, &param);
+  PlanBlobViews(split_param, &param);
   // Basically, build all the layers and set up their connections.
   name_ = param.name();
   map<string, int> blob_name_to_idx;
@@ -251,10 +263,183 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     layer_names_index_[layer_names_[layer_id]] = layer_id;
   }
   ShareWeights();
+  InitCheckpointing(param);
   debug_info_ = param.debug_info();
   LOG_IF(INFO, Caffe::root_solver()) << "Network initialization done.";
 }
 
+template <typename Dtype>
+void Net<Dtype>::InitCheckpointing(const NetParameter& param) {
+  layer_segment_.clear();
+  segment_start_.clear();
+  segment_end_.clear();
+  segment_blob_ids_.clear();
+  segment_freed_.clear();
+  layer_rng_.clear();
+  if (!param.gradient_checkpointing() || phase_ != TRAIN) { return; }
+  const int num_layers = layers_.size();
+  // A segment cannot end between the layer producing a blob and a layer
+  // computing it in place, which would be applied twice when the latter's
+  // segment is recomputed.
+  vector<int> producer(blobs_.size(), -1);
+  vector<bool> can_end(num_layers, true);
+  for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+    for (int top_id = 0; top_id < top_id_vecs_[layer_id].size(); ++top_id) {
+      const int blob_id = top_id_vecs_[layer_id][top_id];
+      if (producer[blob_id] < 0) {
+        producer[blob_id] = layer_id;
+      } else {
+        for (int i = producer[blob_id]; i < layer_id; ++i) {
+          can_end[i] = false;
+        }
+      }
+    }
+  }
+  bool marked = false;
+  for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+    marked |= layers_[layer_id]->layer_param().checkpoint();
+  }
+  const int interval = std::ceil(std::sqrt(static_cast<double>(num_layers)));
+  bool end = false;
+  segment_start_.push_back(0);
+  for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+    layer_segment_.push_back(segment_start_.size() - 1);
+    end |= marked ? layers_[layer_id]->layer_param().checkpoint() :
+        layer_id + 1 - segment_start_.back() >= interval;
+    // The layers that cannot run Forward again are kept apart from the
+    // others, in segments that are never freed.
+    end |= !layers_[layer_id]->CanRecomputeForward() ||
+        (layer_id + 1 < num_layers &&
+         !layers_[layer_id + 1]->CanRecomputeForward());
+    if (end && can_end[layer_id] && layer_id + 1 < num_layers) {
+      segment_end_.push_back(layer_id);
+      segment_start_.push_back(layer_id + 1);
+      end = false;
+    }
+  }
+  segment_end_.push_back(num_layers - 1);
+  const int num_segments = segment_start_.size();
+  vector<bool> recomputable(num_segments, true);
+  for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+    if (!layers_[layer_id]->CanRecomputeForward()) {
+      recomputable[layer_segment_[layer_id]] = false;
+    }
+  }
+  // The blobs used only inside a segment can be freed, except for the outputs
+  // of the net and of the layers without bottoms (such as data layers), which
+  // are not run again, and those whose loss is computed.
+  vector<int> blob_segment(blobs_.size(), -1);
+  vector<bool> keep(blobs_.size(), false);
+  for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+    const int seg = layer_segment_[layer_id];
+    for (int i = 0; i < bottom_id_vecs_[layer_id].size(); ++i) {
+      const int blob_id = bottom_id_vecs_[layer_id][i];
+      keep[blob_id] = keep[blob_id] ||
+          (blob_segment[blob_id] >= 0 && blob_segment[blob_id] != seg);
+      blob_segment[blob_id] = seg;
+    }
+    for (int i = 0; i < top_id_vecs_[layer_id].size(); ++i) {
+      const int blob_id = top_id_vecs_[layer_id][i];
+      keep[blob_id] = keep[blob_id] || bottom_vecs_[layer_id].empty() ||
+          blob_loss_weights_[blob_id] != 0 ||
+          (blob_segment[blob_id] >= 0 && blob_segment[blob_id] != seg);
+      blob_segment[blob_id] = seg;
+    }
+  }
+  for (int i = 0; i < net_input_blob_indices_.size(); ++i) {
+    keep[net_input_blob_indices_[i]] = true;
+  }
+  for (int i = 0; i < net_output_blob_indices_.size(); ++i) {
+    keep[net_output_blob_indices_[i]] = true;
+  }
+  segment_blob_ids_.resize(num_segments);
+  int num_freed = 0;
+  for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
+    // The last segment is the first one to run backward: no use freeing it.
+    if (!keep[blob_id] && blob_segment[blob_id] >= 0 &&
+        blob_segment[blob_id] + 1 < num_segments &&
+        recomputable[blob_segment[blob_id]]) {
+      segment_blob_ids_[blob_segment[blob_id]].push_back(blob_id);
+      ++num_freed;
+    }
+  }
+  segment_freed_.resize(num_segments, false);
+  layer_rng_.resize(num_layers);
+  LOG_IF(INFO, Caffe::root_solver())
+      << "Gradient checkpointing: " << num_segments << " segments, "
+      << "recomputing up to " << num_freed << " of " << blobs_.size()
+      << " blobs";
+}
+
+template <typename Dtype>
+void Net<Dtype>::FreeSegment(const int seg) {
+  // The segment could not be recomputed as it was: unlike the CPU ones, the
+  // random numbers drawn with cuRAND are not replayed.
+  for (int layer_id = segment_start_[seg]; layer_id <= segment_end_[seg];
+       ++layer_id) {
+    CHECK(Caffe::mode() == Caffe::CPU ||
+          !layers_[layer_id]->UsesGPURandomNumbers())
+        << "Layer " << layer_names_[layer_id] << " draws random numbers on "
+        << "the GPU, which gradient checkpointing cannot replay; train on "
+        << "the CPU or without gradient_checkpointing.";
+  }
+  // Blobs may share their memory (see Split, Reshape, Concat and Slice);
+  // only free the memory no blob outside the segment sees.
+  set<SyncedMemory*> memory;
+  for (int i = 0; i < segment_blob_ids_[seg].size(); ++i) {
+    memory.insert(blobs_[segment_blob_ids_[seg][i]]->data().get());
+  }
+  vector<bool> in_segment(blobs_.size(), false);
+  for (int i = 0; i < segment_blob_ids_[seg].size(); ++i) {
+    in_segment[segment_blob_ids_[seg][i]] = true;
+  }
+  for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
+    if (!in_segment[blob_id]) {
+      memory.erase(blobs_[blob_id]->data().get());
+    }
+  }
+  for (set<SyncedMemory*>::iterator it = memory.begin(); it != memory.end();
+       ++it) {
+    if (*it) { (*it)->Release(); }
+  }
+  segment_freed_[seg] = true;
+}
+
+template <typename Dtype>
+void Net<Dtype>::RecomputeSegment(const int seg) {
+  // Replay the random numbers of the original forward pass (e.g. for the
+  // CPU Dropout masks), and keep the parameters that Forward itself updates
+  // (those with lr_mult 0, such as the BatchNorm statistics) as they were.
+  rng_t rng(*caffe_rng());
+  vector<shared_ptr<Blob<Dtype> > > frozen_params;
+  vector<Blob<Dtype>*> frozen_param_owners;
+  for (int layer_id = segment_start_[seg]; layer_id <= segment_end_[seg];
+       ++layer_id) {
+    for (int i = 0; i < param_id_vecs_[layer_id].size(); ++i) {
+      const int learnable_id =
+          learnable_param_ids_[param_id_vecs_[layer_id][i]];
+      if (params_lr_[learnable_id] == 0) {
+        Blob<Dtype>* param = learnable_params_[learnable_id];
+        frozen_params.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+        frozen_params.back()->CopyFrom(*param, false, true);
+        frozen_param_owners.push_back(param);
+      }
+    }
+  }
+  for (int layer_id = segment_start_[seg]; layer_id <= segment_end_[seg];
+       ++layer_id) {
+    if (!bottom_vecs_[layer_id].empty()) {
+      *caffe_rng() = layer_rng_[layer_id];
+      layers_[layer_id]->Forward(bottom_vecs_[layer_id], top_vecs_[layer_id]);
+    }
+  }
+  for (int i = 0; i < frozen_params.size(); ++i) {
+    frozen_param_owners[i]->CopyFrom(*frozen_params[i]);
+  }
+  *caffe_rng() = rng;
+  segment_freed_[seg] = false;
+}
+
 template <typename Dtype>
 void Net<Dtype>::FilterNet(const NetParameter& param,
     NetParameter* param_filtered) {
@@ -450,6 +635,7 @@ void Net<Dtype>::AppendParam(const NetParameter& param, const int layer_id,
     const int learnable_param_id = learnable_params_.size();
     learnable_params_.push_back(params_[net_param_id].get());
     learnable_param_ids_.push_back(learnable_param_id);
+    learnable_param_layer_indices_.push_back(make_pair(layer_id, param_id));
     has_params_lr_.push_back(param_spec->has_lr_mult());
     has_params_decay_.push_back(param_spec->has_decay_mult());
     params_lr_.push_back(param_spec->lr_mult());
@@ -490,6 +676,9 @@ void Net<Dtype>::AppendParam(const NetParameter& param, const int layer_id,
     }
     const int learnable_param_id = learnable_param_ids_[owner_net_param_id];
     learnable_param_ids_.push_back(learnable_param_id);
+    // Layers sharing a param each write their own rows of the diff, so a
+    // shared param keeps a dense diff.
+    learnable_param_layer_indices_[learnable_param_id] = make_pair(-1, -1);
     if (param_spec->has_lr_mult()) {
       if (has_params_lr_[learnable_param_id]) {
         CHECK_EQ(param_spec->lr_mult(), params_lr_[learnable_param_id])
@@ -517,7 +706,15 @@ Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
   CHECK_GE(start, 0);
   CHECK_LT(end, layers_.size());
   Dtype loss = 0;
+  // Starting inside a freed segment needs its earlier layers' tops.
+  if (!layer_segment_.empty() && segment_freed_[layer_segment_[start]]) {
+    RecomputeSegment(layer_segment_[start]);
+  }
   for (int i = start; i <= end; ++i) {
+    const int seg = layer_segment_.empty() ? -1 : layer_segment_[i];
+    if (seg >= 0 && !segment_blob_ids_[seg].empty()) {
+      layer_rng_[i] = *caffe_rng();
+    }
     for (int c = 0; c < before_forward_.size(); ++c) {
       before_forward_[c]->run(i);
     }
@@ -527,6 +724,10 @@ Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
     for (int c = 0; c < after_forward_.size(); ++c) {
       after_forward_[c]->run(i);
     }
+    if (seg >= 0 && i == segment_end_[seg] && segment_start_[seg] >= start &&
+        !segment_blob_ids_[seg].empty()) {
+      FreeSegment(seg);
+    }
   }
   return loss;
 }
@@ -568,6 +769,9 @@ void Net<Dtype>::BackwardFromTo(int start, int end) {
   CHECK_GE(end, 0);
   CHECK_LT(start, layers_.size());
   for (int i = start; i >= end; --i) {
+    if (!layer_segment_.empty() && segment_freed_[layer_segment_[i]]) {
+      RecomputeSegment(layer_segment_[i]);
+    }
     for (int c = 0; c < before_backward_.size(); ++c) {
       before_backward_[c]->run(i);
     }
@@ -903,10 +1107,35 @@ void Net<Dtype>::ToHDF5(const string& filename, bool write_diff) const {
   H5Fclose(file_hid);
 }
 
+template <typename Dtype>
+const vector<int>* Net<Dtype>::learnable_param_diff_rows(
+    const int param_id) const {
+  const pair<int, int>& index = learnable_param_layer_indices_[param_id];
+  if (index.first < 0) { return NULL; }
+  return layers_[index.first]->param_diff_rows(index.second);
+}
+
 template <typename Dtype>
 void Net<Dtype>::Update() {
   for (int i = 0; i < learnable_params_.size(); ++i) {
-    learnable_params_[i]->Update();
+    Blob<Dtype>* blob = learnable_params_[i];
+    const vector<int>* rows = learnable_param_diff_rows(i);
+    if (!rows) {
+      blob->Update();
+      continue;
+    }
+    const int row_size = blob->count(1);
+    const int num_rows = rows->size();
+    const Dtype* diff = blob->cpu_diff();
+    Dtype* data = blob->mutable_cpu_data();
+#ifdef _OPENMP
+#pragma omp parallel for \
+    if (static_cast<int64_t>(num_rows) * row_size > 32768)
+#endif
+    for (int r = 0; r < num_rows; ++r) {
+      const int offset = (*rows)[r] * row_size;
+      caffe_axpy(row_size, Dtype(-1), diff + offset, data + offset);
+    }
   }
 }
 
@@ -914,10 +1143,20 @@ template <typename Dtype>
 void Net<Dtype>::ClearParamDiffs() {
   for (int i = 0; i < learnable_params_.size(); ++i) {
     Blob<Dtype>* blob = learnable_params_[i];
+    const vector<int>* rows = learnable_param_diff_rows(i);
     switch (Caffe::mode()) {
     case Caffe::CPU:
-      caffe_set(blob->count(), static_cast<Dtype>(0),
-                blob->mutable_cpu_diff());
+      if (rows) {
+        const int row_size = blob->count(1);
+        Dtype* diff = blob->mutable_cpu_diff();
+        for (int r = 0; r < rows->size(); ++r) {
+          caffe_set(row_size, static_cast<Dtype>(0),
+                    diff + (*rows)[r] * row_size);
+        }
+      } else {
+        caffe_set(blob->count(), static_cast<Dtype>(0),
+                  blob->mutable_cpu_diff());
+      }
       break;
     case Caffe::GPU:
 #ifndef CPU_ONLY
@@ -928,6 +1167,10 @@ void Net<Dtype>::ClearParamDiffs() {
 #endif
       break;
     }
+    const pair<int, int>& index = learnable_param_layer_indices_[i];
+    if (index.first >= 0) {
+      layers_[index.first]->ClearParamDiffRows(index.second);
+    }
   }
 }
 
@@ -44,6 +44,31 @@ void AdamSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
 
   switch (Caffe::mode()) {
     case Caffe::CPU: {
+    const vector<int>* rows =
+        this->net_->learnable_param_diff_rows(param_id);
+    if (rows) {
+      // Lazy Adam: the moments of the rows outside the gradient keep their
+      // values, and those rows are not updated.
+      const int row_size = net_params[param_id]->count(1);
+      const int num_rows = rows->size();
+      const Dtype corrected_rate = local_rate * correction;
+      Dtype* g = net_params[param_id]->mutable_cpu_diff();
+      Dtype* m = val_m->mutable_cpu_data();
+      Dtype* v = val_v->mutable_cpu_data();
+#ifdef _OPENMP
+#pragma omp parallel for \
+    if (static_cast<int64_t>(num_rows) * row_size > 32768)
+#endif
+      for (int r = 0; r < num_rows; ++r) {
+        const int offset = (*rows)[r] * row_size;
+        for (int j = offset; j < offset + row_size; ++j) {
+          m[j] = beta1 * m[j] + (Dtype(1) - beta1) * g[j];
+          v[j] = beta2 * v[j] + (Dtype(1) - beta2) * g[j] * g[j];
+          g[j] = corrected_rate * m[j] / (std::sqrt(v[j]) + eps_hat);
+        }
+      }
+      break;
+    }
     // update m <- \beta_1 m_{t-1} + (1-\beta_1)g_t
     caffe_cpu_axpby(N, Dtype(1)-beta1,
         net_params[param_id]->cpu_diff(), beta1,
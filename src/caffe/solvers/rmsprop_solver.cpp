@@ -12,6 +12,8 @@ void rmsprop_update_gpu(int N, Dtype* g, Dtype* h, Dtype rms_decay,
 
 template <typename Dtype>
 void RMSPropSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
+  CHECK(!this->net_->learnable_param_diff_rows(param_id))
+      << "RMSProp does not support sparse gradients; use SGD or Adam.";
   const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
   const vector<float>& net_params_lr = this->net_->params_lr();
 
@@ -91,7 +91,17 @@ void SGDSolver<Dtype>::ClipGradients() {
   const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
   Dtype sumsq_diff = 0;
   for (int i = 0; i < net_params.size(); ++i) {
-    sumsq_diff += net_params[i]->sumsq_diff();
+    const vector<int>* rows = this->net_->learnable_param_diff_rows(i);
+    if (!rows) {
+      sumsq_diff += net_params[i]->sumsq_diff();
+      continue;
+    }
+    const int row_size = net_params[i]->count(1);
+    const Dtype* diff = net_params[i]->cpu_diff();
+    for (int r = 0; r < rows->size(); ++r) {
+      const Dtype* row_diff = diff + (*rows)[r] * row_size;
+      sumsq_diff += caffe_cpu_dot(row_size, row_diff, row_diff);
+    }
   }
   const Dtype l2norm_diff = std::sqrt(sumsq_diff);
   if (l2norm_diff > clip_gradients) {
@@ -100,7 +110,16 @@ void SGDSolver<Dtype>::ClipGradients() {
         << l2norm_diff << " > " << clip_gradients << ") "
         << "by scale factor " << scale_factor;
     for (int i = 0; i < net_params.size(); ++i) {
-      net_params[i]->scale_diff(scale_factor);
+      const vector<int>* rows = this->net_->learnable_param_diff_rows(i);
+      if (!rows) {
+        net_params[i]->scale_diff(scale_factor);
+        continue;
+      }
+      const int row_size = net_params[i]->count(1);
+      Dtype* diff = net_params[i]->mutable_cpu_diff();
+      for (int r = 0; r < rows->size(); ++r) {
+        caffe_scal(row_size, scale_factor, diff + (*rows)[r] * row_size);
+      }
     }
   }
 }
@@ -134,6 +153,17 @@ void SGDSolver<Dtype>::Normalize(int param_id) {
   const Dtype accum_normalization = Dtype(1.) / this->param_.iter_size();
   switch (Caffe::mode()) {
   case Caffe::CPU: {
+    const vector<int>* rows =
+        this->net_->learnable_param_diff_rows(param_id);
+    if (rows) {
+      const int row_size = net_params[param_id]->count(1);
+      Dtype* diff = net_params[param_id]->mutable_cpu_diff();
+      for (int r = 0; r < rows->size(); ++r) {
+        caffe_scal(row_size, accum_normalization,
+            diff + (*rows)[r] * row_size);
+      }
+      break;
+    }
     caffe_scal(net_params[param_id]->count(), accum_normalization,
         net_params[param_id]->mutable_cpu_diff());
     break;
@@ -162,7 +192,28 @@ void SGDSolver<Dtype>::Regularize(int param_id) {
   Dtype local_decay = weight_decay * net_params_weight_decay[param_id];
   switch (Caffe::mode()) {
   case Caffe::CPU: {
-    if (local_decay) {
+    const vector<int>* rows =
+        this->net_->learnable_param_diff_rows(param_id);
+    if (local_decay && rows) {
+      // Lazy weight decay, for the rows in the gradient only.
+      if (regularization_type != "L2" && regularization_type != "L1") {
+        LOG(FATAL) << "Unknown regularization type: " << regularization_type;
+      }
+      const int row_size = net_params[param_id]->count(1);
+      const Dtype* data = net_params[param_id]->cpu_data();
+      Dtype* diff = net_params[param_id]->mutable_cpu_diff();
+      for (int r = 0; r < rows->size(); ++r) {
+        const int offset = (*rows)[r] * row_size;
+        if (regularization_type == "L2") {
+          caffe_axpy(row_size, local_decay, data + offset, diff + offset);
+        } else {
+          for (int j = 0; j < row_size; ++j) {
+            diff[offset + j] += local_decay *
+                caffe_sign(data[offset + j]);
+          }
+        }
+      }
+    } else if (local_decay) {
       if (regularization_type == "L2") {
         // add weight decay
         caffe_axpy(net_params[param_id]->count(),
@@ -229,6 +280,27 @@ void SGDSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   // Compute the update to history, then copy it to the parameter diff.
   switch (Caffe::mode()) {
   case Caffe::CPU: {
+    const vector<int>* rows =
+        this->net_->learnable_param_diff_rows(param_id);
+    if (rows) {
+      // Lazy momentum: the history of the other rows waits until their next
+      // gradient.
+      const int row_size = net_params[param_id]->count(1);
+      const int num_rows = rows->size();
+      Dtype* diff = net_params[param_id]->mutable_cpu_diff();
+      Dtype* history = history_[param_id]->mutable_cpu_data();
+#ifdef _OPENMP
+#pragma omp parallel for \
+    if (static_cast<int64_t>(num_rows) * row_size > 32768)
+#endif
+      for (int r = 0; r < num_rows; ++r) {
+        const int offset = (*rows)[r] * row_size;
+        caffe_cpu_axpby(row_size, local_rate, diff + offset, momentum,
+            history + offset);
+        caffe_copy(row_size, history + offset, diff + offset);
+      }
+      break;
+    }
     caffe_cpu_axpby(net_params[param_id]->count(), local_rate,
               net_params[param_id]->cpu_diff(), momentum,
               history_[param_id]->mutable_cpu_data());
@@ -5,7 +5,8 @@
 namespace caffe {
 SyncedMemory::SyncedMemory()
   : cpu_ptr_(NULL), gpu_ptr_(NULL), size_(0), head_(UNINITIALIZED),
-    own_cpu_data_(false), cpu_malloc_use_cuda_(false), own_gpu_data_(false) {
+    own_cpu_data_(false), cpu_malloc_use_cuda_(false), own_gpu_data_(false),
+    version_(0) {
 #ifndef CPU_ONLY
 #ifdef DEBUG
   CUDA_CHECK(cudaGetDevice(&device_));
@@ -15,7 +16,8 @@ SyncedMemory::SyncedMemory()
 
 SyncedMemory::SyncedMemory(size_t size)
   : cpu_ptr_(NULL), gpu_ptr_(NULL), size_(size), head_(UNINITIALIZED),
-    own_cpu_data_(false), cpu_malloc_use_cuda_(false), own_gpu_data_(false) {
+    own_cpu_data_(false), cpu_malloc_use_cuda_(false), own_gpu_data_(false),
+    version_(0) {
 #ifndef CPU_ONLY
 #ifdef DEBUG
   CUDA_CHECK(cudaGetDevice(&device_));
@@ -90,6 +92,27 @@ inline void SyncedMemory::to_gpu() {
 #endif
 }
 
+void SyncedMemory::Release() {
+  check_device();
+  if ((cpu_ptr_ && !own_cpu_data_) || (gpu_ptr_ && !own_gpu_data_)) {
+    return;
+  }
+  if (cpu_ptr_) {
+    CaffeFreeHost(cpu_ptr_, cpu_malloc_use_cuda_);
+    cpu_ptr_ = NULL;
+  }
+#ifndef CPU_ONLY
+  if (gpu_ptr_) {
+    CUDA_CHECK(cudaFree(gpu_ptr_));
+    gpu_ptr_ = NULL;
+  }
+#endif  // CPU_ONLY
+  own_cpu_data_ = false;
+  own_gpu_data_ = false;
+  head_ = UNINITIALIZED;
+  ++version_;
+}
+
 const void* SyncedMemory::cpu_data() {
   check_device();
   to_cpu();
@@ -105,6 +128,7 @@ void SyncedMemory::set_cpu_data(void* data) {
   cpu_ptr_ = data;
   head_ = HEAD_AT_CPU;
   own_cpu_data_ = false;
+  ++version_;
 }
 
 const void* SyncedMemory::gpu_data() {
@@ -128,6 +152,7 @@ void SyncedMemory::set_gpu_data(void* data) {
   gpu_ptr_ = data;
   head_ = HEAD_AT_GPU;
   own_gpu_data_ = false;
+  ++version_;
 #else
   NO_GPU;
 #endif
@@ -137,6 +162,7 @@ void* SyncedMemory::mutable_cpu_data() {
   check_device();
   to_cpu();
   head_ = HEAD_AT_CPU;
+  ++version_;
   return cpu_ptr_;
 }
 
@@ -145,6 +171,7 @@ void* SyncedMemory::mutable_gpu_data() {
 #ifndef CPU_ONLY
   to_gpu();
   head_ = HEAD_AT_GPU;
+  ++version_;
   return gpu_ptr_;
 #else
   NO_GPU;
@@ -8,6 +8,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/batch_norm_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -130,4 +131,68 @@ namespace caffe {
         this->blob_top_vec_);
   }
 
+  TYPED_TEST(BatchNormLayerTest, TestForwardGlobalStats) {
+    typedef typename TypeParam::Dtype Dtype;
+    LayerParameter layer_param;
+    layer_param.mutable_batch_norm_param()->set_use_global_stats(true);
+    const Dtype eps = layer_param.batch_norm_param().eps();
+
+    BatchNormLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    // Stored statistics with a moving average scale factor of 2.
+    const int channels = this->blob_bottom_->channels();
+    for (int c = 0; c < channels; ++c) {
+      layer.blobs()[0]->mutable_cpu_data()[c] = 2 * (c + 0.5);
+      layer.blobs()[1]->mutable_cpu_data()[c] = 2 * (c + 1);
+    }
+    layer.blobs()[2]->mutable_cpu_data()[0] = 2;
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+
+    for (int i = 0; i < this->blob_bottom_->num(); ++i) {
+      for (int c = 0; c < channels; ++c) {
+        for (int k = 0; k < this->blob_bottom_->height(); ++k) {
+          for (int l = 0; l < this->blob_bottom_->width(); ++l) {
+            const Dtype expected = (this->blob_bottom_->data_at(i, c, k, l) -
+                (c + 0.5)) / sqrt(c + 1 + eps);
+            EXPECT_NEAR(expected, this->blob_top_->data_at(i, c, k, l), 1e-5);
+          }
+        }
+      }
+    }
+  }
+
+  TYPED_TEST(BatchNormLayerTest, TestBackwardGlobalStats) {
+    typedef typename TypeParam::Dtype Dtype;
+    LayerParameter layer_param;
+    layer_param.mutable_batch_norm_param()->set_use_global_stats(true);
+    const Dtype eps = layer_param.batch_norm_param().eps();
+
+    BatchNormLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer.blobs()[1]->mutable_cpu_data()[0] = 3;
+    layer.blobs()[1]->mutable_cpu_data()[1] = 0.5;
+    layer.blobs()[2]->mutable_cpu_data()[0] = 1;
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    // With fixed statistics the layer is affine, so the gradient is the top
+    // diff over the standard deviation of the channel.
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_top_);
+    caffe_copy(this->blob_top_->count(), this->blob_top_->cpu_data(),
+        this->blob_top_->mutable_cpu_diff());
+    vector<bool> propagate_down(1, true);
+    layer.Backward(this->blob_top_vec_, propagate_down, this->blob_bottom_vec_);
+    for (int i = 0; i < this->blob_bottom_->num(); ++i) {
+      for (int c = 0; c < this->blob_bottom_->channels(); ++c) {
+        const Dtype std = sqrt(layer.blobs()[1]->cpu_data()[c] + eps);
+        for (int k = 0; k < this->blob_bottom_->height(); ++k) {
+          for (int l = 0; l < this->blob_bottom_->width(); ++l) {
+            EXPECT_NEAR(this->blob_top_->diff_at(i, c, k, l) / std,
+                this->blob_bottom_->diff_at(i, c, k, l), 1e-5);
+          }
+        }
+      }
+    }
+  }
+
 }  // namespace caffe
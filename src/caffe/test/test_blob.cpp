@@ -59,6 +59,38 @@ TYPED_TEST(BlobSimpleTest, TestReshapeZero) {
   EXPECT_EQ(this->blob_->count(), 0);
 }
 
+TYPED_TEST(BlobSimpleTest, TestShareView) {
+  typedef TypeParam Dtype;
+  Dtype* data = this->blob_preshaped_->mutable_cpu_data();
+  for (int i = 0; i < this->blob_preshaped_->count(); ++i) {
+    data[i] = i;
+  }
+  // A view of the second image, and a view of its third channel.
+  this->blob_->Reshape(1, 3, 4, 5);
+  this->blob_->ShareView(*this->blob_preshaped_, 60);
+  Blob<Dtype> channel(1, 1, 4, 5);
+  channel.ShareView(*this->blob_, 40);
+  EXPECT_TRUE(this->blob_->IsViewOf(*this->blob_preshaped_, 60));
+  EXPECT_TRUE(channel.IsViewOf(*this->blob_preshaped_, 100));
+  EXPECT_EQ(this->blob_preshaped_->cpu_data() + 60, this->blob_->cpu_data());
+  EXPECT_EQ(this->blob_preshaped_->cpu_diff() + 100, channel.cpu_diff());
+  EXPECT_EQ(100, channel.data_at(0, 0, 0, 0));
+  channel.mutable_cpu_diff()[1] = 7;
+  EXPECT_EQ(7, this->blob_preshaped_->cpu_diff()[101]);
+  // Reshaping within the count keeps the view; beyond it gives it up.
+  channel.Reshape(1, 1, 2, 5);
+  EXPECT_TRUE(channel.IsViewOf(*this->blob_preshaped_, 100));
+  channel.Reshape(1, 1, 6, 5);
+  EXPECT_FALSE(channel.IsViewOf(*this->blob_preshaped_, 100));
+  // Releasing the view keeps the data it saw.
+  this->blob_->ReleaseView();
+  EXPECT_FALSE(this->blob_->IsViewOf(*this->blob_preshaped_, 60));
+  EXPECT_NE(this->blob_preshaped_->cpu_data() + 60, this->blob_->cpu_data());
+  for (int i = 0; i < this->blob_->count(); ++i) {
+    EXPECT_EQ(60 + i, this->blob_->cpu_data()[i]);
+  }
+}
+
 TYPED_TEST(BlobSimpleTest, TestLegacyBlobProtoShapeEquals) {
   BlobProto blob_proto;
 
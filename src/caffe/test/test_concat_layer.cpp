@@ -166,6 +166,88 @@ TYPED_TEST(ConcatLayerTest, TestForwardChannels) {
   }
 }
 
+TYPED_TEST(ConcatLayerTest, TestForwardShareBottoms) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_concat_param()->set_axis(0);
+  layer_param.mutable_concat_param()->set_share_bottoms(true);
+  ConcatLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_1_, this->blob_top_vec_);
+  EXPECT_TRUE(this->blob_bottom_0_->IsViewOf(*this->blob_top_, 0));
+  EXPECT_TRUE(this->blob_bottom_2_->IsViewOf(*this->blob_top_,
+      this->blob_bottom_0_->count()));
+  // The bottoms keep their values, and what is written to them shows in the
+  // top.
+  layer.Forward(this->blob_bottom_vec_1_, this->blob_top_vec_);
+  const int count_0 = this->blob_bottom_0_->count();
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    EXPECT_EQ(i < count_0 ? 1 : 3, this->blob_top_->cpu_data()[i]);
+  }
+  this->blob_bottom_2_->mutable_cpu_data()[0] = 4;
+  layer.Forward(this->blob_bottom_vec_1_, this->blob_top_vec_);
+  EXPECT_EQ(4, this->blob_top_->cpu_data()[count_0]);
+  this->blob_top_->mutable_cpu_diff()[count_0] = 5;
+  EXPECT_EQ(5, this->blob_bottom_2_->cpu_diff()[0]);
+}
+
+TYPED_TEST(ConcatLayerTest, TestForwardShareBottomsShrinkBatch) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_concat_param()->set_axis(0);
+  layer_param.mutable_concat_param()->set_share_bottoms(true);
+  ConcatLayer<Dtype> layer(layer_param);
+  const int kNumBottoms = 3;
+  Blob<Dtype> bottoms[kNumBottoms];
+  vector<Blob<Dtype>*> bottom_vec;
+  for (int b = 0; b < kNumBottoms; ++b) {
+    bottoms[b].Reshape(10, 3, 1, 1);
+    bottom_vec.push_back(&bottoms[b]);
+  }
+  layer.SetUp(bottom_vec, this->blob_top_vec_);
+  layer.Forward(bottom_vec, this->blob_top_vec_);
+  // A final partial batch of 8: the producers reshape and write their
+  // bottoms, which are still views at the offsets of the batches of 10, so
+  // the new places overlap the old ones.
+  for (int b = 0; b < kNumBottoms; ++b) {
+    bottoms[b].Reshape(8, 3, 1, 1);
+    Dtype* data = bottoms[b].mutable_cpu_data();
+    for (int i = 0; i < bottoms[b].count(); ++i) {
+      data[i] = 100 * b + i;
+    }
+  }
+  layer.Forward(bottom_vec, this->blob_top_vec_);
+  ASSERT_EQ(kNumBottoms * 24, this->blob_top_->count());
+  for (int b = 0; b < kNumBottoms; ++b) {
+    EXPECT_TRUE(bottoms[b].IsViewOf(*this->blob_top_, 24 * b));
+    for (int i = 0; i < 24; ++i) {
+      EXPECT_EQ(100 * b + i, this->blob_top_->cpu_data()[24 * b + i]);
+      EXPECT_EQ(100 * b + i, bottoms[b].cpu_data()[i]);
+    }
+  }
+}
+
+TYPED_TEST(ConcatLayerTest, TestForwardShareBottomsFallback) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_concat_param()->set_axis(0);
+  layer_param.mutable_concat_param()->set_share_bottoms(true);
+  ConcatLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_1_, this->blob_top_vec_);
+  ASSERT_TRUE(this->blob_bottom_0_->IsViewOf(*this->blob_top_, 0));
+  // Concatenating channels of several images takes copies; the views are
+  // given up without losing the data.
+  layer_param.mutable_concat_param()->set_axis(1);
+  ConcatLayer<Dtype> channel_layer(layer_param);
+  channel_layer.SetUp(this->blob_bottom_vec_0_, this->blob_top_vec_);
+  EXPECT_FALSE(this->blob_bottom_0_->IsViewOf(*this->blob_top_, 0));
+  channel_layer.Forward(this->blob_bottom_vec_0_, this->blob_top_vec_);
+  for (int n = 0; n < this->blob_top_->num(); ++n) {
+    for (int c = 0; c < this->blob_top_->channels(); ++c) {
+      EXPECT_EQ(c < 3 ? 1 : 2, this->blob_top_->data_at(n, c, 0, 0));
+    }
+  }
+}
+
 TYPED_TEST(ConcatLayerTest, TestGradientTrivial) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -186,6 +268,17 @@ TYPED_TEST(ConcatLayerTest, TestGradientNum) {
     this->blob_top_vec_);
 }
 
+TYPED_TEST(ConcatLayerTest, TestGradientNumShareBottoms) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_concat_param()->set_axis(0);
+  layer_param.mutable_concat_param()->set_share_bottoms(true);
+  ConcatLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-2);
+  checker.CheckGradient(&layer, this->blob_bottom_vec_1_,
+    this->blob_top_vec_);
+}
+
 TYPED_TEST(ConcatLayerTest, TestGradientChannels) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -6,6 +9,9 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/conv_layer.hpp"
+#include "caffe/util/engine_tuner.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/quantize.hpp"
 
 #ifdef USE_CUDNN
 #include "caffe/layers/cudnn_conv_layer.hpp"
@@ -264,6 +270,89 @@ TYPED_TEST(ConvolutionLayerTest, TestSimpleConvolution) {
   }
 }
 
+TYPED_TEST(ConvolutionLayerTest, TestTunedConvolution) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->set_num_output(4);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("constant");
+  convolution_param->mutable_bias_filler()->set_value(0.1);
+  string filename;
+  MakeTempFilename(&filename);
+  EngineTuner::Open(filename);
+  ConvolutionLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // A second layer of the same geometry, after a restart, reuses the entry
+  // instead of adding another.
+  EngineTuner::Open(filename);
+  ConvolutionLayer<Dtype> tuned_layer(layer_param);
+  vector<Blob<Dtype>*> top_vec(1, this->blob_top_2_);
+  tuned_layer.SetUp(this->blob_bottom_vec_, top_vec);
+  EngineTuner::Open("");
+  int num_entries = 0;
+  std::ifstream file(filename.c_str());
+  for (string line; std::getline(file, line); ++num_entries) {
+    EXPECT_NE(string::npos, line.find("\tConvolution "));
+  }
+  EXPECT_EQ(1, num_entries);
+  caffe_conv(this->blob_bottom_, convolution_param, layer.blobs(),
+      this->MakeReferenceTop(this->blob_top_));
+  const Dtype* top_data = this->blob_top_->cpu_data();
+  const Dtype* ref_top_data = this->ref_blob_top_->cpu_data();
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    EXPECT_NEAR(top_data[i], ref_top_data[i], 1e-4);
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestTunedConvolutionInt8) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  LayerParameter layer_param;
+  layer_param.set_phase(TEST);
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->set_num_output(4);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  string filename;
+  MakeTempFilename(&filename);
+  EngineTuner::Open(filename);
+  // The int8 forward pass ignores the GEMM backend, so an INT8 layer
+  // records nothing and a float layer of the same geometry is tuned alone.
+  layer_param.mutable_quantization_param()->set_precision(
+      QuantizationParameter::INT8);
+  ConvolutionLayer<Dtype> int8_layer(layer_param);
+  int8_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  int8_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  int num_int8_entries = 0;
+  {
+    std::ifstream file(filename.c_str());
+    for (string line; std::getline(file, line); ++num_int8_entries) {}
+  }
+  layer_param.mutable_quantization_param()->set_precision(
+      QuantizationParameter::FP32);
+  ConvolutionLayer<Dtype> float_layer(layer_param);
+  float_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EngineTuner::Open("");
+  EXPECT_EQ(0, num_int8_entries);
+  int num_entries = 0;
+  std::ifstream file(filename.c_str());
+  for (string line; std::getline(file, line); ++num_entries) {
+    EXPECT_NE(string::npos, line.find(" TEST FP32 input "));
+  }
+  EXPECT_EQ(1, num_entries);
+}
+
 TYPED_TEST(ConvolutionLayerTest, TestDilatedConvolution) {
   typedef typename TypeParam::Dtype Dtype;
   vector<int> bottom_shape;
@@ -495,6 +584,85 @@ TYPED_TEST(ConvolutionLayerTest, TestSimpleConvolutionGroup) {
   }
 }
 
+TYPED_TEST(ConvolutionLayerTest, TestSimpleConvolutionSparse) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->set_num_output(6);
+  convolution_param->set_group(3);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("constant");
+  convolution_param->mutable_bias_filler()->set_value(0.1);
+  layer_param.set_phase(TEST);
+  shared_ptr<Layer<Dtype> > layer(
+      new ConvolutionLayer<Dtype>(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Prune the weights so that the sparse path is taken on the CPU.
+  Dtype* weights = layer->blobs()[0]->mutable_cpu_data();
+  for (int i = 0; i < layer->blobs()[0]->count(); ++i) {
+    if (i % 6 != 0) {
+      weights[i] = 0;
+    }
+  }
+  layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Check against reference convolution.
+  caffe_conv(this->blob_bottom_, convolution_param, layer->blobs(),
+      this->MakeReferenceTop(this->blob_top_));
+  const Dtype* top_data = this->blob_top_->cpu_data();
+  const Dtype* ref_top_data = this->ref_blob_top_->cpu_data();
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    EXPECT_NEAR(top_data[i], ref_top_data[i], 1e-4);
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestSimpleConvolutionInt8) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(6);
+  convolution_param->set_group(3);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("constant");
+  convolution_param->mutable_bias_filler()->set_value(0.1);
+  layer_param.set_phase(TEST);
+  const Dtype* bottom_data = this->blob_bottom_->cpu_data();
+  float input_scale;
+  int zero_point;
+  caffe_choose_u8_quantization(
+      *std::min_element(bottom_data, bottom_data + this->blob_bottom_->count()),
+      *std::max_element(bottom_data, bottom_data + this->blob_bottom_->count()),
+      &input_scale, &zero_point);
+  QuantizationParameter* quant_param = layer_param.mutable_quantization_param();
+  quant_param->set_precision(QuantizationParameter::INT8);
+  quant_param->set_input_scale(input_scale);
+  quant_param->set_input_zero_point(zero_point);
+  shared_ptr<Layer<Dtype> > layer(
+      new ConvolutionLayer<Dtype>(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Check against the fp32 reference convolution, within the quantization
+  // error.
+  caffe_conv(this->blob_bottom_, convolution_param, layer->blobs(),
+      this->MakeReferenceTop(this->blob_top_));
+  const Dtype* top_data = this->blob_top_->cpu_data();
+  const Dtype* ref_top_data = this->ref_blob_top_->cpu_data();
+  const Dtype tolerance = 0.1 * this->ref_blob_top_->asum_data() /
+      this->ref_blob_top_->count();
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    EXPECT_NEAR(top_data[i], ref_top_data[i], tolerance);
+  }
+}
+
 TYPED_TEST(ConvolutionLayerTest, TestSobelConvolution) {
   // Test separable convolution by computing the Sobel operator
   // as a single filter then comparing the result
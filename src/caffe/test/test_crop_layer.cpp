@@ -238,6 +238,43 @@ TYPED_TEST(CropLayerTest, TestCrop5D) {
   }
 }
 
+TYPED_TEST(CropLayerTest, TestCropShareTop) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_crop_param()->set_axis(0);
+  layer_param.mutable_crop_param()->add_offset(1);
+  for (int i = 1; i < 4; ++i) {
+    layer_param.mutable_crop_param()->add_offset(0);
+  }
+  layer_param.mutable_crop_param()->set_share_top(true);
+  // Cropping the second item is a view of it.
+  this->blob_bottom_1_->Reshape(1, 4, 5, 4);
+  CropLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_TRUE(this->blob_top_->IsViewOf(*this->blob_bottom_0_, 80));
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    EXPECT_EQ(this->blob_bottom_0_->cpu_data()[80 + i],
+        this->blob_top_->cpu_data()[i]);
+  }
+  // Cropping the second row of each channel is not.
+  layer_param.mutable_crop_param()->set_offset(0, 0);
+  layer_param.mutable_crop_param()->set_offset(2, 1);
+  this->blob_bottom_1_->Reshape(2, 4, 1, 4);
+  CropLayer<Dtype> row_layer(layer_param);
+  row_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_FALSE(this->blob_top_->SharesDataWith(*this->blob_bottom_0_));
+  row_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int n = 0; n < 2; ++n) {
+    for (int c = 0; c < 4; ++c) {
+      for (int w = 0; w < 4; ++w) {
+        EXPECT_EQ(this->blob_bottom_0_->data_at(n, c, 1, w),
+            this->blob_top_->data_at(n, c, 0, w));
+      }
+    }
+  }
+}
+
 TYPED_TEST(CropLayerTest, TestCropAllGradient) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -260,6 +297,22 @@ TYPED_TEST(CropLayerTest, TestCropHWGradient) {
       this->blob_top_vec_);
 }
 
+TYPED_TEST(CropLayerTest, TestCropShareTopGradient) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_crop_param()->set_axis(0);
+  layer_param.mutable_crop_param()->add_offset(1);
+  for (int i = 1; i < 4; ++i) {
+    layer_param.mutable_crop_param()->add_offset(0);
+  }
+  layer_param.mutable_crop_param()->set_share_top(true);
+  this->blob_bottom_1_->Reshape(1, 4, 5, 4);
+  CropLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_, 0);
+}
+
 TYPED_TEST(CropLayerTest, TestCrop5DGradient) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -7,6 +7,8 @@
 #include "caffe/filler.hpp"
 #include "caffe/layers/cudnn_deconv_layer.hpp"
 #include "caffe/layers/deconv_layer.hpp"
+#include "caffe/util/engine_tuner.hpp"
+#include "caffe/util/io.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -137,6 +139,35 @@ TYPED_TEST(DeconvolutionLayerTest, TestSimpleDeconvolution) {
   }
 }
 
+TYPED_TEST(DeconvolutionLayerTest, TestInt8PrecisionIgnored) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.set_phase(TEST);
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->set_num_output(4);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  DeconvolutionLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // The same layer with INT8 precision runs in floating point all the same.
+  layer_param.mutable_quantization_param()->set_precision(
+      QuantizationParameter::INT8);
+  vector<Blob<Dtype>*> top_vec(1, this->blob_top_2_);
+  DeconvolutionLayer<Dtype> int8_layer(layer_param);
+  int8_layer.SetUp(this->blob_bottom_vec_, top_vec);
+  for (int i = 0; i < layer.blobs().size(); ++i) {
+    int8_layer.blobs()[i]->CopyFrom(*layer.blobs()[i]);
+  }
+  int8_layer.Forward(this->blob_bottom_vec_, top_vec);
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    EXPECT_EQ(this->blob_top_->cpu_data()[i], this->blob_top_2_->cpu_data()[i]);
+  }
+}
+
 TYPED_TEST(DeconvolutionLayerTest, TestGradient) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -302,6 +333,135 @@ TYPED_TEST(DeconvolutionLayerTest, TestGradient3D) {
       this->blob_top_vec_);
 }
 
+TYPED_TEST(DeconvolutionLayerTest, TestDirectAgainstGEMM) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Stride 2 takes the direct CPU path, force_nd_im2col the GEMM and col2im
+  // one; both must agree over padding, groups and dilation.
+  const int kernels[] = {3, 4, 2};
+  const int pads[] = {1, 1, 0};
+  const int groups[] = {1, 3, 3};
+  const int dilations[] = {1, 1, 2};
+  for (int t = 0; t < 3; ++t) {
+    LayerParameter layer_param;
+    ConvolutionParameter* convolution_param =
+        layer_param.mutable_convolution_param();
+    convolution_param->add_kernel_size(kernels[t]);
+    convolution_param->add_stride(2);
+    convolution_param->add_pad(pads[t]);
+    convolution_param->add_dilation(dilations[t]);
+    convolution_param->set_num_output(6);
+    convolution_param->set_group(groups[t]);
+    convolution_param->mutable_weight_filler()->set_type("gaussian");
+    convolution_param->mutable_bias_filler()->set_type("gaussian");
+    DeconvolutionLayer<Dtype> direct_layer(layer_param);
+    direct_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    convolution_param->set_force_nd_im2col(true);
+    DeconvolutionLayer<Dtype> gemm_layer(layer_param);
+    vector<Blob<Dtype>*> gemm_top_vec(1, this->blob_top_2_);
+    gemm_layer.SetUp(this->blob_bottom_vec_, gemm_top_vec);
+    for (int i = 0; i < 2; ++i) {
+      gemm_layer.blobs()[i]->ShareData(*direct_layer.blobs()[i]);
+    }
+    direct_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    gemm_layer.Forward(this->blob_bottom_vec_, gemm_top_vec);
+    ASSERT_EQ(this->blob_top_2_->count(), this->blob_top_->count());
+    for (int i = 0; i < this->blob_top_->count(); ++i) {
+      EXPECT_NEAR(this->blob_top_2_->cpu_data()[i],
+          this->blob_top_->cpu_data()[i], 1e-4);
+    }
+  }
+}
+
+TYPED_TEST(DeconvolutionLayerTest, TestTunedEngines) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->set_num_output(4);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  DeconvolutionLayer<Dtype> reference_layer(layer_param);
+  reference_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  reference_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  const string key = string("Deconvolution ") +
+      (sizeof(Dtype) == sizeof(float) ? "float" : "double") +
+      " TRAIN FP32 input 2x3x6x4 output 4 group 1 kernel 3x3 stride 2x2 pad 0x0"
+      " dilation 1x1";
+  // Each engine recorded in the database must compute the same output; an
+  // empty database times the candidates and records the fastest.
+  const char* engines[] = {"gemm_blas", "gemm_blocked", "direct", ""};
+  vector<Blob<Dtype>*> top_vec(1, this->blob_top_2_);
+  for (int e = 0; e < 4; ++e) {
+    string filename;
+    MakeTempFilename(&filename);
+    EngineTuner::Open(filename);
+    if (engines[e][0]) {
+      EngineTuner::Record(key, engines[e]);
+    }
+    DeconvolutionLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, top_vec);
+    for (int i = 0; i < 2; ++i) {
+      layer.blobs()[i]->ShareData(*reference_layer.blobs()[i]);
+    }
+    layer.Forward(this->blob_bottom_vec_, top_vec);
+    const string recorded = EngineTuner::Lookup(key);
+    EngineTuner::Open("");
+    if (engines[e][0]) {
+      EXPECT_EQ(engines[e], recorded);
+    } else {
+      EXPECT_TRUE(recorded == "gemm_blas" || recorded == "gemm_blocked" ||
+          recorded == "direct") << recorded;
+    }
+    ASSERT_EQ(this->blob_top_->count(), this->blob_top_2_->count());
+    for (int i = 0; i < this->blob_top_->count(); ++i) {
+      EXPECT_NEAR(this->blob_top_->cpu_data()[i],
+          this->blob_top_2_->cpu_data()[i], 1e-4);
+    }
+  }
+}
+
+TYPED_TEST(DeconvolutionLayerTest, TestBilinearUpsampling) {
+  typedef typename TypeParam::Dtype Dtype;
+  // The channel-wise upsampling documented for BilinearFiller takes the
+  // separable CPU path while its weights stay bilinear.
+  for (int factor = 2; factor <= 3; ++factor) {
+    LayerParameter layer_param;
+    ConvolutionParameter* convolution_param =
+        layer_param.mutable_convolution_param();
+    convolution_param->add_kernel_size(2 * factor - factor % 2);
+    convolution_param->add_stride(factor);
+    convolution_param->add_pad(factor / 2);  // ceil((factor - 1) / 2.)
+    convolution_param->set_num_output(3);
+    convolution_param->set_group(3);
+    convolution_param->set_bias_term(false);
+    convolution_param->mutable_weight_filler()->set_type("bilinear");
+    DeconvolutionLayer<Dtype> bilinear_layer(layer_param);
+    bilinear_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    EXPECT_EQ(factor * 6, this->blob_top_->height());
+    EXPECT_EQ(factor * 4, this->blob_top_->width());
+    convolution_param->set_force_nd_im2col(true);
+    DeconvolutionLayer<Dtype> gemm_layer(layer_param);
+    vector<Blob<Dtype>*> gemm_top_vec(1, this->blob_top_2_);
+    gemm_layer.SetUp(this->blob_bottom_vec_, gemm_top_vec);
+    gemm_layer.blobs()[0]->ShareData(*bilinear_layer.blobs()[0]);
+    for (int iter = 0; iter < 2; ++iter) {
+      bilinear_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      gemm_layer.Forward(this->blob_bottom_vec_, gemm_top_vec);
+      for (int i = 0; i < this->blob_top_->count(); ++i) {
+        EXPECT_NEAR(this->blob_top_2_->cpu_data()[i],
+            this->blob_top_->cpu_data()[i], 1e-4);
+      }
+      // Weights that are no longer bilinear fall back to the general path.
+      bilinear_layer.blobs()[0]->mutable_cpu_data()[1] += 0.5;
+    }
+  }
+}
+
 #ifdef USE_CUDNN
 
 // Since ConvolutionLayerTest checks the shared conv/deconv code in detail,
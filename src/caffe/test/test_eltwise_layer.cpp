@@ -126,6 +126,50 @@ TYPED_TEST(EltwiseLayerTest, TestSumCoeff) {
   }
 }
 
+TYPED_TEST(EltwiseLayerTest, TestSumCoeffReLU) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  EltwiseParameter* eltwise_param = layer_param.mutable_eltwise_param();
+  eltwise_param->set_operation(EltwiseParameter_EltwiseOp_SUM);
+  eltwise_param->add_coeff(1);
+  eltwise_param->add_coeff(-0.5);
+  eltwise_param->add_coeff(-1);
+  eltwise_param->set_relu(true);
+  shared_ptr<EltwiseLayer<Dtype> > layer(
+      new EltwiseLayer<Dtype>(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  const Dtype* data = this->blob_top_->cpu_data();
+  const int count = this->blob_top_->count();
+  const Dtype* in_data_a = this->blob_bottom_a_->cpu_data();
+  const Dtype* in_data_b = this->blob_bottom_b_->cpu_data();
+  const Dtype* in_data_c = this->blob_bottom_c_->cpu_data();
+  for (int i = 0; i < count; ++i) {
+    EXPECT_NEAR(data[i], std::max(Dtype(0),
+        in_data_a[i] - Dtype(0.5) * in_data_b[i] - in_data_c[i]), 1e-4);
+  }
+}
+
+TYPED_TEST(EltwiseLayerTest, TestMaxInPlace) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  EltwiseParameter* eltwise_param = layer_param.mutable_eltwise_param();
+  eltwise_param->set_operation(EltwiseParameter_EltwiseOp_MAX);
+  vector<Dtype> expected(this->blob_bottom_a_->count());
+  for (int i = 0; i < expected.size(); ++i) {
+    expected[i] = std::max(this->blob_bottom_a_->cpu_data()[i],
+        std::max(this->blob_bottom_b_->cpu_data()[i],
+                 this->blob_bottom_c_->cpu_data()[i]));
+  }
+  this->blob_top_vec_[0] = this->blob_bottom_b_;
+  EltwiseLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(expected[i], this->blob_bottom_b_->cpu_data()[i]);
+  }
+}
+
 TYPED_TEST(EltwiseLayerTest, TestStableProdGradient) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -175,6 +219,35 @@ TYPED_TEST(EltwiseLayerTest, TestSumCoeffGradient) {
       this->blob_top_vec_);
 }
 
+TYPED_TEST(EltwiseLayerTest, TestSumCoeffReLUBackward) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  EltwiseParameter* eltwise_param = layer_param.mutable_eltwise_param();
+  eltwise_param->set_operation(EltwiseParameter_EltwiseOp_SUM);
+  eltwise_param->add_coeff(1);
+  eltwise_param->add_coeff(-0.5);
+  eltwise_param->add_coeff(-1);
+  eltwise_param->set_relu(true);
+  EltwiseLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  const int count = this->blob_top_->count();
+  caffe_rng_gaussian<Dtype>(count, Dtype(0), Dtype(1),
+      this->blob_top_->mutable_cpu_diff());
+  vector<Dtype> top_diff(this->blob_top_->cpu_diff(),
+      this->blob_top_->cpu_diff() + count);
+  vector<bool> propagate_down(3, true);
+  layer.Backward(this->blob_top_vec_, propagate_down, this->blob_bottom_vec_);
+  const Dtype coeffs[] = {1, -0.5, -1};
+  for (int i = 0; i < count; ++i) {
+    const Dtype dy = this->blob_top_->cpu_data()[i] > 0 ? top_diff[i] : 0;
+    for (int b = 0; b < 3; ++b) {
+      EXPECT_NEAR(coeffs[b] * dy, this->blob_bottom_vec_[b]->cpu_diff()[i],
+          1e-6);
+    }
+  }
+}
+
 TYPED_TEST(EltwiseLayerTest, TestMax) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -154,6 +154,37 @@ TYPED_TEST(EmbedLayerTest, TestGradient) {
       this->blob_top_vec_, -2);
 }
 
+TYPED_TEST(EmbedLayerTest, TestSparseGradient) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  EmbedParameter* embed_param = layer_param.mutable_embed_param();
+  embed_param->set_num_output(10);
+  embed_param->set_input_dim(5);
+  embed_param->set_bias_term(false);
+  embed_param->set_sparse_gradient(true);
+  EmbedLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  this->blob_bottom_->mutable_cpu_data()[0] = 4;
+  this->blob_bottom_->mutable_cpu_data()[1] = 2;
+  this->blob_bottom_->mutable_cpu_data()[2] = 2;
+  this->blob_bottom_->mutable_cpu_data()[3] = 3;
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_, -2);
+  const vector<int>* rows = layer.param_diff_rows(0);
+  if (Caffe::mode() != Caffe::CPU) {
+    EXPECT_TRUE(rows == NULL);
+    return;
+  }
+  // Each row of the batch is listed once, in the order first seen.
+  ASSERT_TRUE(rows != NULL);
+  ASSERT_EQ(3, rows->size());
+  EXPECT_EQ(4, (*rows)[0]);
+  EXPECT_EQ(2, (*rows)[1]);
+  EXPECT_EQ(3, (*rows)[2]);
+  layer.ClearParamDiffRows(0);
+  EXPECT_EQ(0, layer.param_diff_rows(0)->size());
+}
+
 TYPED_TEST(EmbedLayerTest, TestGradientWithBias) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -0,0 +1,51 @@
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/engine_tuner.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class EngineTunerTest : public ::testing::Test {
+ protected:
+  virtual void TearDown() {
+    // The tuner is process-wide; leave it disabled for the other tests.
+    EngineTuner::Open("");
+  }
+};
+
+TEST_F(EngineTunerTest, TestDisabled) {
+  EngineTuner::Open("");
+  EXPECT_FALSE(EngineTuner::enabled());
+  EXPECT_EQ("", EngineTuner::Lookup("Convolution a"));
+}
+
+TEST_F(EngineTunerTest, TestRecordAndReload) {
+  string filename;
+  MakeTempFilename(&filename);
+  EngineTuner::Open(filename);
+  EXPECT_TRUE(EngineTuner::enabled());
+  EXPECT_EQ("", EngineTuner::Lookup("Convolution a"));
+  EngineTuner::Record("Convolution a", "gemm_blas");
+  EngineTuner::Record("Convolution b", "direct");
+  EngineTuner::Record("Convolution a", "gemm_blocked");
+  EXPECT_EQ("gemm_blocked", EngineTuner::Lookup("Convolution a"));
+  {
+    // Entries of another machine are not used here.
+    std::ofstream file(filename.c_str(), std::ios::app);
+    file << "other CPU\tConvolution b\tgemm_blas\n";
+    file << "malformed line\n";
+  }
+  // The last entry for a key wins when the file is read back.
+  EngineTuner::Open(filename);
+  EXPECT_EQ("gemm_blocked", EngineTuner::Lookup("Convolution a"));
+  EXPECT_EQ("direct", EngineTuner::Lookup("Convolution b"));
+  EXPECT_EQ("", EngineTuner::Lookup("Convolution c"));
+}
+
+}  // namespace caffe
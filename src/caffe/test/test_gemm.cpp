@@ -0,0 +1,152 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/util/gemm.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class BlockedGemmTest : public CPUDeviceTest<Dtype> {
+ protected:
+  BlockedGemmTest() : A_(), B_(), C_(), C_expected_() {}
+
+  virtual void TearDown() {
+    Caffe::set_gemm_backend(Caffe::BLAS);
+  }
+
+  // Fills op(A) (M x K), op(B) (K x N) and C (M x N) with random data and
+  // computes the BLAS result into C_expected_.
+  void SetUpProblem(const CBLAS_TRANSPOSE TransA,
+      const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+      const Dtype alpha, const Dtype beta) {
+    A_.Reshape(1, 1, M, K);
+    B_.Reshape(1, 1, K, N);
+    C_.Reshape(1, 1, M, N);
+    C_expected_.Reshape(1, 1, M, N);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(&A_);
+    filler.Fill(&B_);
+    filler.Fill(&C_);
+    caffe_copy(C_.count(), C_.cpu_data(), C_expected_.mutable_cpu_data());
+    Caffe::set_gemm_backend(Caffe::BLAS);
+    caffe_cpu_gemm<Dtype>(TransA, TransB, M, N, K, alpha, A_.cpu_data(),
+        B_.cpu_data(), beta, C_expected_.mutable_cpu_data());
+  }
+
+  void CheckResult() {
+    for (int i = 0; i < C_.count(); ++i) {
+      EXPECT_NEAR(C_expected_.cpu_data()[i], C_.cpu_data()[i], 1e-4) << i;
+    }
+  }
+
+  void TestShape(const int M, const int N, const int K) {
+    const CBLAS_TRANSPOSE trans[] = {CblasNoTrans, CblasTrans};
+    for (int ta = 0; ta < 2; ++ta) {
+      for (int tb = 0; tb < 2; ++tb) {
+        SetUpProblem(trans[ta], trans[tb], M, N, K, 1.5, 0.5);
+        caffe_cpu_blocked_gemm<Dtype>(trans[ta], trans[tb], M, N, K, 1.5,
+            A_.cpu_data(), B_.cpu_data(), 0.5, C_.mutable_cpu_data());
+        CheckResult();
+      }
+    }
+  }
+
+  Blob<Dtype> A_;
+  Blob<Dtype> B_;
+  Blob<Dtype> C_;
+  Blob<Dtype> C_expected_;
+};
+
+TYPED_TEST_CASE(BlockedGemmTest, TestDtypes);
+
+TYPED_TEST(BlockedGemmTest, TestSmall) {
+  this->TestShape(2, 4, 3);
+  this->TestShape(1, 1, 1);
+}
+
+TYPED_TEST(BlockedGemmTest, TestRagged) {
+  // Sizes that are not multiples of the register block, with a depth
+  // spanning several packed blocks.
+  this->TestShape(7, 13, 300);
+  this->TestShape(33, 5, 517);
+}
+
+TYPED_TEST(BlockedGemmTest, TestBetaZeroIgnoresC) {
+  typedef TypeParam Dtype;
+  this->SetUpProblem(CblasNoTrans, CblasNoTrans, 5, 9, 11, 1., 0.);
+  caffe_set(this->C_.count(), Dtype(NAN), this->C_.mutable_cpu_data());
+  caffe_cpu_blocked_gemm<Dtype>(CblasNoTrans, CblasNoTrans, 5, 9, 11, 1.,
+      this->A_.cpu_data(), this->B_.cpu_data(), 0.,
+      this->C_.mutable_cpu_data());
+  this->CheckResult();
+}
+
+TYPED_TEST(BlockedGemmTest, TestBackendDispatch) {
+  typedef TypeParam Dtype;
+  this->SetUpProblem(CblasTrans, CblasNoTrans, 6, 10, 20, 1., 1.);
+  Caffe::set_gemm_backend(Caffe::BLOCKED);
+  caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, 6, 10, 20, 1.,
+      this->A_.cpu_data(), this->B_.cpu_data(), 1.,
+      this->C_.mutable_cpu_data());
+  this->CheckResult();
+}
+
+TYPED_TEST(BlockedGemmTest, TestPacked) {
+  typedef TypeParam Dtype;
+  const int M = 9, N = 11, K = 270;
+  const Caffe::GemmBackend backends[] = {Caffe::BLAS, Caffe::BLOCKED};
+  for (int i = 0; i < 2; ++i) {
+    this->SetUpProblem(CblasTrans, CblasNoTrans, M, N, K, 2., 0.);
+    Caffe::set_gemm_backend(backends[i]);
+    PackedGemmMatrix<Dtype> packed_a;
+    packed_a.PackA(CblasTrans, M, K, this->A_);
+    EXPECT_EQ(backends[i] == Caffe::BLOCKED, packed_a.blocked());
+    caffe_cpu_gemm_packed_a<Dtype>(packed_a, CblasNoTrans, N, 2.,
+        this->B_.cpu_data(), 0., this->C_.mutable_cpu_data());
+    this->CheckResult();
+
+    this->SetUpProblem(CblasNoTrans, CblasTrans, M, N, K, 1., 1.);
+    Caffe::set_gemm_backend(backends[i]);
+    PackedGemmMatrix<Dtype> packed_b;
+    packed_b.PackB(CblasTrans, K, N, this->B_);
+    caffe_cpu_gemm_packed_b<Dtype>(CblasNoTrans, M, 1., this->A_.cpu_data(),
+        packed_b, 1., this->C_.mutable_cpu_data());
+    this->CheckResult();
+  }
+}
+
+TYPED_TEST(BlockedGemmTest, TestPackedInvalidation) {
+  typedef TypeParam Dtype;
+  Caffe::set_gemm_backend(Caffe::BLOCKED);
+  Blob<Dtype> weights(1, 1, 4, 6);
+  Blob<Dtype> other(1, 1, 4, 6);
+  PackedGemmMatrix<Dtype> packed;
+  EXPECT_FALSE(packed.IsPackedFrom(weights));
+  packed.PackB(CblasNoTrans, 4, 6, weights);
+  EXPECT_TRUE(packed.IsPackedFrom(weights));
+  EXPECT_FALSE(packed.IsPackedFrom(other));
+  // Reading leaves the packed copy valid; any write invalidates it.
+  weights.cpu_data();
+  EXPECT_TRUE(packed.IsPackedFrom(weights));
+  weights.mutable_cpu_data();
+  EXPECT_FALSE(packed.IsPackedFrom(weights));
+  packed.PackB(CblasNoTrans, 4, 6, weights);
+  weights.Update();
+  EXPECT_FALSE(packed.IsPackedFrom(weights));
+  packed.PackB(CblasNoTrans, 4, 6, weights);
+  // Switching the backend calls for a different layout.
+  Caffe::set_gemm_backend(Caffe::BLAS);
+  EXPECT_FALSE(packed.IsPackedFrom(weights));
+  packed.Clear();
+  EXPECT_TRUE(packed.empty());
+}
+
+}  // namespace caffe
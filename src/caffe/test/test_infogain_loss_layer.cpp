@@ -119,8 +119,11 @@ TYPED_TEST(InfogainLossLayerTest, TestInfogainLoss) {
       }
     }
   }
+  // The layer takes log(p) as x - log(sum(exp(x))) rather than from the
+  // rounded probabilities, so allow for a few ulp of the loss.
   EXPECT_NEAR(this->blob_top_loss_->cpu_data()[0],
-    loss/(this->outer_*this->inner_), 1e-6);
+    loss/(this->outer_*this->inner_),
+    1e-6 * std::max(Dtype(1), loss/(this->outer_*this->inner_)));
 }
 
 TYPED_TEST(InfogainLossLayerTest, TestGradient) {
@@ -135,4 +138,18 @@ TYPED_TEST(InfogainLossLayerTest, TestGradient) {
       this->blob_top_vec_, 0);
 }
 
+TYPED_TEST(InfogainLossLayerTest, TestGradientIgnoreLabel) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_infogain_loss_param()->set_axis(2);
+  // labels are in {0, ..., 4}, so we'll ignore about a fifth of them
+  layer_param.mutable_loss_param()->set_ignore_label(0);
+  InfogainLossLayer<Dtype> layer(layer_param);
+  this->blob_top_vec_.clear();  // ignore prob top.
+  this->blob_top_vec_.push_back(this->blob_top_loss_);
+  GradientChecker<Dtype> checker(1e-4, 2e-2, 1701);  // no "kink"
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_, 0);
+}
+
 }  // namespace caffe
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -6,6 +8,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/inner_product_layer.hpp"
+#include "caffe/util/quantize.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -388,4 +391,191 @@ TYPED_TEST(InnerProductLayerTest, TestBackwardTranspose) {
   }
 }
 
+TYPED_TEST(InnerProductLayerTest, TestForwardPackedWeights) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  // A TEST phase layer with the blocked GEMM packs its weights once; its
+  // output must match a TRAIN phase layer and follow weight updates.
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  LayerParameter layer_param;
+  InnerProductParameter* inner_product_param =
+      layer_param.mutable_inner_product_param();
+  inner_product_param->set_num_output(10);
+  inner_product_param->mutable_weight_filler()->set_type("uniform");
+  inner_product_param->mutable_bias_filler()->set_type("uniform");
+  InnerProductLayer<Dtype> train_layer(layer_param);
+  train_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer_param.set_phase(TEST);
+  InnerProductLayer<Dtype> test_layer(layer_param);
+  vector<Blob<Dtype>*> test_top_vec(1, new Blob<Dtype>());
+  test_layer.SetUp(this->blob_bottom_vec_, test_top_vec);
+  for (int i = 0; i < 2; ++i) {
+    test_layer.blobs()[i]->ShareData(*train_layer.blobs()[i]);
+  }
+  Caffe::set_gemm_backend(Caffe::BLOCKED);
+  for (int iter = 0; iter < 2; ++iter) {
+    train_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    test_layer.Forward(this->blob_bottom_vec_, test_top_vec);
+    for (int i = 0; i < this->blob_top_->count(); ++i) {
+      EXPECT_NEAR(this->blob_top_->cpu_data()[i],
+          test_top_vec[0]->cpu_data()[i], 1e-5);
+    }
+    caffe_scal(train_layer.blobs()[0]->count(), Dtype(-2),
+        train_layer.blobs()[0]->mutable_cpu_data());
+  }
+  Caffe::set_gemm_backend(Caffe::BLAS);
+  delete test_top_vec[0];
+}
+
+TYPED_TEST(InnerProductLayerTest, TestForwardSparseWeights) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  // A TEST phase layer with mostly zero weights takes the sparse path; its
+  // output must match a TRAIN phase layer for both weight layouts.
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  for (int transpose = 0; transpose < 2; ++transpose) {
+    LayerParameter layer_param;
+    InnerProductParameter* inner_product_param =
+        layer_param.mutable_inner_product_param();
+    inner_product_param->set_num_output(10);
+    inner_product_param->set_transpose(transpose);
+    inner_product_param->mutable_weight_filler()->set_type("uniform");
+    inner_product_param->mutable_bias_filler()->set_type("uniform");
+    InnerProductLayer<Dtype> train_layer(layer_param);
+    train_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    Dtype* weights = train_layer.blobs()[0]->mutable_cpu_data();
+    for (int i = 0; i < train_layer.blobs()[0]->count(); ++i) {
+      if (i % 7 != 0) {
+        weights[i] = 0;
+      }
+    }
+    layer_param.set_phase(TEST);
+    InnerProductLayer<Dtype> test_layer(layer_param);
+    vector<Blob<Dtype>*> test_top_vec(1, new Blob<Dtype>());
+    test_layer.SetUp(this->blob_bottom_vec_, test_top_vec);
+    for (int i = 0; i < 2; ++i) {
+      test_layer.blobs()[i]->ShareData(*train_layer.blobs()[i]);
+    }
+    train_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    test_layer.Forward(this->blob_bottom_vec_, test_top_vec);
+    for (int i = 0; i < this->blob_top_->count(); ++i) {
+      EXPECT_NEAR(this->blob_top_->cpu_data()[i],
+          test_top_vec[0]->cpu_data()[i], 1e-5);
+    }
+    delete test_top_vec[0];
+  }
+}
+
+TYPED_TEST(InnerProductLayerTest, TestForwardInt8) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  // An int8 TEST phase layer must stay within the quantization error of the
+  // fp32 layer, for both weight layouts.
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  for (int transpose = 0; transpose < 2; ++transpose) {
+    LayerParameter layer_param;
+    InnerProductParameter* inner_product_param =
+        layer_param.mutable_inner_product_param();
+    inner_product_param->set_num_output(10);
+    inner_product_param->set_transpose(transpose);
+    inner_product_param->mutable_weight_filler()->set_type("gaussian");
+    inner_product_param->mutable_bias_filler()->set_type("uniform");
+    InnerProductLayer<Dtype> fp32_layer(layer_param);
+    fp32_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    fp32_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+
+    layer_param.set_phase(TEST);
+    float input_scale;
+    int zero_point;
+    caffe_choose_u8_quantization(0, 1, &input_scale, &zero_point);
+    QuantizationParameter* quant_param =
+        layer_param.mutable_quantization_param();
+    quant_param->set_precision(QuantizationParameter::INT8);
+    quant_param->set_input_scale(input_scale);
+    quant_param->set_input_zero_point(zero_point);
+    InnerProductLayer<Dtype> int8_layer(layer_param);
+    vector<Blob<Dtype>*> int8_top_vec(1, new Blob<Dtype>());
+    int8_layer.SetUp(this->blob_bottom_vec_, int8_top_vec);
+    for (int i = 0; i < 2; ++i) {
+      int8_layer.blobs()[i]->ShareData(*fp32_layer.blobs()[i]);
+    }
+    int8_layer.Forward(this->blob_bottom_vec_, int8_top_vec);
+    const Dtype max_abs = this->blob_top_->asum_data() /
+        this->blob_top_->count() * 4;
+    for (int i = 0; i < this->blob_top_->count(); ++i) {
+      EXPECT_NEAR(this->blob_top_->cpu_data()[i],
+          int8_top_vec[0]->cpu_data()[i], 0.02 * max_abs);
+    }
+    delete int8_top_vec[0];
+  }
+}
+
+TYPED_TEST(InnerProductLayerTest, TestForwardFusedActivation) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Check batch size 1, which takes the GEMV path, as well as a larger batch,
+  // with either weight layout and activation.
+  for (int batch = 0; batch < 2; ++batch) {
+    for (int transpose = 0; transpose < 2; ++transpose) {
+      for (int act = 1; act <= 2; ++act) {
+        this->blob_bottom_vec_.clear();
+        this->blob_bottom_vec_.push_back(batch ? this->blob_bottom_ :
+            this->blob_bottom_nobatch_);
+        UniformFiller<Dtype>(FillerParameter()).Fill(this->blob_bottom_vec_[0]);
+        LayerParameter layer_param;
+        InnerProductParameter* inner_product_param =
+            layer_param.mutable_inner_product_param();
+        inner_product_param->set_num_output(10);
+        inner_product_param->set_transpose(transpose);
+        inner_product_param->mutable_weight_filler()->set_type("gaussian");
+        inner_product_param->mutable_bias_filler()->set_type("gaussian");
+        InnerProductLayer<Dtype> layer(layer_param);
+        layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+        layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+        Blob<Dtype> expected;
+        expected.CopyFrom(*this->blob_top_, false, true);
+
+        const InnerProductParameter_Activation activation =
+            static_cast<InnerProductParameter_Activation>(act);
+        inner_product_param->set_activation(activation);
+        InnerProductLayer<Dtype> fused_layer(layer_param);
+        fused_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+        for (int i = 0; i < layer.blobs().size(); ++i) {
+          fused_layer.blobs()[i]->CopyFrom(*layer.blobs()[i]);
+        }
+        fused_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+        const Dtype* data = this->blob_top_->cpu_data();
+        for (int i = 0; i < expected.count(); ++i) {
+          const Dtype x = expected.cpu_data()[i];
+          const Dtype y = activation == InnerProductParameter_Activation_RELU ?
+              std::max(x, Dtype(0)) : Dtype(1. / (1. + exp(-x)));
+          EXPECT_NEAR(y, data[i], 1e-4);
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(InnerProductLayerTest, TestGradientFusedSigmoid) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->blob_bottom_vec_.push_back(this->blob_bottom_nobatch_);
+  UniformFiller<Dtype>(FillerParameter()).Fill(this->blob_bottom_nobatch_);
+  LayerParameter layer_param;
+  InnerProductParameter* inner_product_param =
+      layer_param.mutable_inner_product_param();
+  inner_product_param->set_num_output(10);
+  inner_product_param->set_activation(InnerProductParameter_Activation_SIGMOID);
+  inner_product_param->mutable_weight_filler()->set_type("gaussian");
+  inner_product_param->mutable_bias_filler()->set_type("gaussian");
+  InnerProductLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
 }  // namespace caffe
@@ -250,6 +250,71 @@ TYPED_TEST(LRNLayerTest, TestGradientWithinChannel) {
       this->blob_top_vec_);
 }
 
+TYPED_TEST(LRNLayerTest, TestForwardAcrossChannelsTiled) {
+  typedef typename TypeParam::Dtype Dtype;
+  // More positions than one spatial tile of the CPU kernel, with the default
+  // beta and another one.
+  this->blob_bottom_->Reshape(2, 7, 19, 17);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  for (int b = 0; b < 2; ++b) {
+    LayerParameter layer_param;
+    if (b == 1) {
+      layer_param.mutable_lrn_param()->set_beta(0.6);
+    }
+    LRNLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    Blob<Dtype> top_reference;
+    this->ReferenceLRNForward(*(this->blob_bottom_), layer_param,
+        &top_reference);
+    for (int i = 0; i < this->blob_bottom_->count(); ++i) {
+      EXPECT_NEAR(this->blob_top_->cpu_data()[i],
+          top_reference.cpu_data()[i], this->epsilon_);
+    }
+  }
+}
+
+TYPED_TEST(LRNLayerTest, TestForwardWithinChannelLargeRegion) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->blob_bottom_->Reshape(2, 3, 6, 8);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter layer_param;
+  layer_param.mutable_lrn_param()->set_norm_region(
+      LRNParameter_NormRegion_WITHIN_CHANNEL);
+  layer_param.mutable_lrn_param()->set_local_size(5);
+  layer_param.mutable_lrn_param()->set_beta(0.6);
+  LRNLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Blob<Dtype> top_reference;
+  this->ReferenceLRNForward(*(this->blob_bottom_), layer_param,
+      &top_reference);
+  for (int i = 0; i < this->blob_bottom_->count(); ++i) {
+    EXPECT_NEAR(this->blob_top_->cpu_data()[i], top_reference.cpu_data()[i],
+                this->epsilon_);
+  }
+}
+
+TYPED_TEST(LRNLayerTest, TestGradientWithinChannelLargeRegion) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->blob_bottom_->Reshape(2, 2, 6, 5);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter layer_param;
+  layer_param.mutable_lrn_param()->set_norm_region(
+      LRNParameter_NormRegion_WITHIN_CHANNEL);
+  layer_param.mutable_lrn_param()->set_local_size(5);
+  LRNLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-2);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
 #ifdef USE_CUDNN
 template <typename Dtype>
 class CuDNNLRNLayerTest : public GPUDeviceTest<Dtype> {
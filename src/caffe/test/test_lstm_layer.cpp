@@ -284,5 +284,152 @@ TYPED_TEST(LSTMLayerTest, TestGradientNonZeroContBufferSize2WithStaticInput) {
       this->blob_top_vec_, 2);
 }
 
+TYPED_TEST(LSTMLayerTest, TestFusedMatchesUnrolled) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  this->ReshapeBlobs(3, 2);
+  FillerParameter filler_param;
+  UniformFiller<Dtype> filler(filler_param);
+  filler.Fill(&this->blob_bottom_static_);
+  this->blob_bottom_vec_.push_back(&this->blob_bottom_static_);
+  // Stream 1 begins a new sequence at the second timestep.
+  const Dtype cont[] = {0, 0, 1, 0, 1, 1};
+  caffe_copy(6, cont, this->blob_bottom_cont_.mutable_cpu_data());
+  LayerParameter unrolled_param(this->layer_param_);
+  unrolled_param.mutable_recurrent_param()->set_engine(
+      RecurrentParameter_Engine_UNROLLED);
+  LayerParameter fused_param(this->layer_param_);
+  fused_param.mutable_recurrent_param()->set_engine(
+      RecurrentParameter_Engine_FUSED);
+  Blob<Dtype> top_fused;
+  vector<Blob<Dtype>*> top_fused_vec(1, &top_fused);
+  LSTMLayer<Dtype> unrolled(unrolled_param);
+  Caffe::set_random_seed(1701);
+  unrolled.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  LSTMLayer<Dtype> fused(fused_param);
+  Caffe::set_random_seed(1701);
+  fused.SetUp(this->blob_bottom_vec_, top_fused_vec);
+  const Dtype kEpsilon = 1e-5;
+  // The second pass starts from the hidden state the first one left.
+  for (int pass = 0; pass < 2; ++pass) {
+    unrolled.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    fused.Forward(this->blob_bottom_vec_, top_fused_vec);
+    ASSERT_EQ(this->blob_top_.count(), top_fused.count());
+    for (int i = 0; i < top_fused.count(); ++i) {
+      EXPECT_NEAR(this->blob_top_.cpu_data()[i], top_fused.cpu_data()[i],
+          kEpsilon) << "pass = " << pass << "; i = " << i;
+    }
+  }
+  caffe_rng_gaussian(top_fused.count(), Dtype(0), Dtype(1),
+      top_fused.mutable_cpu_diff());
+  caffe_copy(top_fused.count(), top_fused.cpu_diff(),
+      this->blob_top_.mutable_cpu_diff());
+  vector<bool> propagate_down(3, true);
+  propagate_down[1] = false;
+  unrolled.Backward(this->blob_top_vec_, propagate_down,
+      this->blob_bottom_vec_);
+  Blob<Dtype> x_diff, static_diff;
+  x_diff.CopyFrom(this->blob_bottom_, true, true);
+  static_diff.CopyFrom(this->blob_bottom_static_, true, true);
+  fused.Backward(top_fused_vec, propagate_down, this->blob_bottom_vec_);
+  for (int i = 0; i < x_diff.count(); ++i) {
+    EXPECT_NEAR(x_diff.cpu_diff()[i], this->blob_bottom_.cpu_diff()[i],
+        kEpsilon);
+  }
+  for (int i = 0; i < static_diff.count(); ++i) {
+    EXPECT_NEAR(static_diff.cpu_diff()[i],
+        this->blob_bottom_static_.cpu_diff()[i], kEpsilon);
+  }
+  ASSERT_EQ(unrolled.blobs().size(), fused.blobs().size());
+  for (int j = 0; j < fused.blobs().size(); ++j) {
+    const Blob<Dtype>& expected = *unrolled.blobs()[j];
+    const Blob<Dtype>& actual = *fused.blobs()[j];
+    for (int i = 0; i < actual.count(); ++i) {
+      EXPECT_NEAR(expected.cpu_diff()[i], actual.cpu_diff()[i], kEpsilon)
+          << "param " << j << "; i = " << i;
+    }
+  }
+}
+
+TYPED_TEST(LSTMLayerTest, TestStep) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  const int kNumTimesteps = 3;
+  const int kNumStreams = 2;
+  this->ReshapeBlobs(kNumTimesteps, kNumStreams);
+  FillerParameter filler_param;
+  UniformFiller<Dtype> filler(filler_param);
+  filler.Fill(&this->blob_bottom_static_);
+  this->blob_bottom_vec_.push_back(&this->blob_bottom_static_);
+  // Both streams begin a new sequence at the first timestep.
+  const Dtype cont[] = {0, 0, 1, 1, 1, 1};
+  caffe_copy(6, cont, this->blob_bottom_cont_.mutable_cpu_data());
+  LSTMLayer<Dtype> layer(this->layer_param_);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Step through the same sequences a timestep at a time: both streams in
+  // one batch (in the opposite order), except at the second timestep, where
+  // they take a step each.
+  RecurrentState<Dtype> state[kNumStreams];
+  for (int n = 0; n < kNumStreams; ++n) {
+    layer.InitState(&state[n]);
+  }
+  const int x_dim = this->blob_bottom_.count(2);
+  const int static_dim = this->blob_bottom_static_.count(1);
+  const int D = this->num_output_;
+  Blob<Dtype> x, x_static, y;
+  vector<Blob<Dtype>*> bottom_vec;
+  bottom_vec.push_back(&x);
+  bottom_vec.push_back(&x_static);
+  vector<Blob<Dtype>*> top_vec(1, &y);
+  for (int t = 0; t < kNumTimesteps; ++t) {
+    vector<vector<int> > batches;
+    if (t == 1) {
+      batches.push_back(vector<int>(1, 0));
+      batches.push_back(vector<int>(1, 1));
+    } else {
+      vector<int> streams;
+      streams.push_back(1);
+      streams.push_back(0);
+      batches.push_back(streams);
+    }
+    for (int b = 0; b < batches.size(); ++b) {
+      const vector<int>& streams = batches[b];
+      const int N = streams.size();
+      vector<int> shape = this->blob_bottom_.shape();
+      shape[0] = 1;
+      shape[1] = N;
+      x.Reshape(shape);
+      shape = this->blob_bottom_static_.shape();
+      shape[0] = N;
+      x_static.Reshape(shape);
+      vector<RecurrentState<Dtype>*> states;
+      for (int i = 0; i < N; ++i) {
+        const int n = streams[i];
+        caffe_copy(x_dim,
+            this->blob_bottom_.cpu_data() + (t * kNumStreams + n) * x_dim,
+            x.mutable_cpu_data() + i * x_dim);
+        caffe_copy(static_dim,
+            this->blob_bottom_static_.cpu_data() + n * static_dim,
+            x_static.mutable_cpu_data() + i * static_dim);
+        states.push_back(&state[n]);
+      }
+      layer.Step(bottom_vec, states, top_vec);
+      ASSERT_EQ(N * D, y.count());
+      for (int i = 0; i < N; ++i) {
+        const Dtype* expected = this->blob_top_.cpu_data() +
+            (t * kNumStreams + streams[i]) * D;
+        for (int d = 0; d < D; ++d) {
+          EXPECT_NEAR(expected[d], y.cpu_data()[i * D + d], 1e-5)
+              << "t = " << t << "; stream = " << streams[i] << "; d = " << d;
+        }
+      }
+    }
+  }
+}
 
 }  // namespace caffe
@@ -1,6 +1,7 @@
 #include <stdint.h>  // for uint32_t & uint64_t
 #include <time.h>
 #include <cmath>  // for std::fabs
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -119,6 +120,36 @@ TYPED_TEST(CPUMathFunctionsTest, TestCopy) {
   }
 }
 
+TYPED_TEST(CPUMathFunctionsTest, TestMeanM2) {
+  // An offset much larger than the spread, where E(X^2) - E(X)^2 cancels.
+  const int n = this->blob_bottom_->count();
+  vector<TypeParam> x(this->blob_bottom_->cpu_data(),
+      this->blob_bottom_->cpu_data() + n);
+  for (int i = 0; i < n; ++i) {
+    x[i] += 1000;
+  }
+  double mean = 0;
+  for (int i = 0; i < n; ++i) {
+    mean += x[i];
+  }
+  mean /= n;
+  double m2 = 0;
+  for (int i = 0; i < n; ++i) {
+    m2 += (x[i] - mean) * (x[i] - mean);
+  }
+  // Two calls, to merge running statistics too.
+  int count = 0;
+  TypeParam result_mean = 0;
+  TypeParam result_m2 = 0;
+  caffe_cpu_mean_m2<TypeParam>(n / 3, &x[0], &count, &result_mean,
+      &result_m2);
+  caffe_cpu_mean_m2<TypeParam>(n - n / 3, &x[n / 3], &count, &result_mean,
+      &result_m2);
+  EXPECT_EQ(n, count);
+  EXPECT_NEAR(mean, result_mean, 1e-6 * mean);
+  EXPECT_NEAR(m2, result_m2, 1e-4 * m2);
+}
+
 #ifndef CPU_ONLY
 
 template <typename Dtype>
@@ -114,6 +114,10 @@ TYPED_TEST(MaxPoolingDropoutTest, TestBackward) {
   dropout_layer.Forward(this->blob_top_vec_, this->blob_top_vec_);
   dropout_layer.Backward(this->blob_top_vec_, propagate_down,
                          this->blob_top_vec_);
+  Dtype sum_top_diff = 0.;
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    sum_top_diff += this->blob_top_->cpu_diff()[i];
+  }
   layer.Backward(this->blob_top_vec_, propagate_down,
                  this->blob_bottom_vec_);
   Dtype sum_with_dropout = 0.;
@@ -121,7 +125,9 @@ TYPED_TEST(MaxPoolingDropoutTest, TestBackward) {
   for (int i = 0; i < this->blob_bottom_->count(); ++i) {
     sum_with_dropout += bottom_diff[i];
   }
-  EXPECT_GE(sum_with_dropout, sum);
+  // Max pooling routes each (scaled or dropped) top diff to a single input.
+  EXPECT_EQ(sum_with_dropout, sum_top_diff);
+  EXPECT_GT(sum_with_dropout, 0);
 }
 
 }  // namespace caffe
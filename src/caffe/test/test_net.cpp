@@ -2601,4 +2601,487 @@ TYPED_TEST(NetTest, TestAllInOneNetDeploy) {
   ASSERT_TRUE(found_data);
 }
 
+TYPED_TEST(NetTest, TestFuseInnerProductActivation) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "layer { "
+      "  name: 'data' "
+      "  type: 'DummyData' "
+      "  dummy_data_param { "
+      "    shape { dim: 2 dim: 5 } "
+      "    data_filler { type: 'gaussian' std: 1 } "
+      "  } "
+      "  top: 'data' "
+      "} "
+      "layer { "
+      "  name: 'innerproduct' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { "
+      "    num_output: 4 "
+      "    weight_filler { type: 'gaussian' std: 1 } "
+      "    bias_filler { type: 'gaussian' std: 1 } "
+      "  } "
+      "  bottom: 'data' "
+      "  top: 'innerproduct' "
+      "} "
+      "layer { "
+      "  name: 'relu' "
+      "  type: 'ReLU' "
+      "  bottom: 'innerproduct' "
+      "  top: 'innerproduct' "
+      "} ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  // The TRAIN net keeps the ReLU layer; the TEST net folds it into the
+  // InnerProduct layer only with fuse_layers.
+  param.mutable_state()->set_phase(TRAIN);
+  param.set_fuse_layers(true);
+  Caffe::set_random_seed(this->seed_);
+  Net<Dtype> train_net(param);
+  EXPECT_EQ(3, train_net.layers().size());
+  train_net.Forward();
+  param.mutable_state()->set_phase(TEST);
+  param.set_fuse_layers(false);
+  Net<Dtype> unfused_net(param);
+  EXPECT_EQ(3, unfused_net.layers().size());
+  ASSERT_TRUE(unfused_net.has_layer("relu"));
+  EXPECT_EQ("ReLU", string(unfused_net.layer_by_name("relu")->type()));
+  EXPECT_EQ(InnerProductParameter_Activation_NONE,
+      unfused_net.layer_by_name("innerproduct")->layer_param()
+      .inner_product_param().activation());
+  param.set_fuse_layers(true);
+  Caffe::set_random_seed(this->seed_);
+  Net<Dtype> test_net(param);
+  ASSERT_EQ(2, test_net.layers().size());
+  EXPECT_FALSE(test_net.has_layer("relu"));
+  EXPECT_EQ(InnerProductParameter_Activation_RELU,
+      test_net.layer_by_name("innerproduct")->layer_param()
+      .inner_product_param().activation());
+  test_net.Forward();
+  const Blob<Dtype>& expected = *train_net.blob_by_name("innerproduct");
+  const Blob<Dtype>& actual = *test_net.blob_by_name("innerproduct");
+  ASSERT_EQ(expected.count(), actual.count());
+  for (int i = 0; i < expected.count(); ++i) {
+    EXPECT_NEAR(expected.cpu_data()[i], actual.cpu_data()[i], 1e-4);
+  }
+}
+
+TYPED_TEST(NetTest, TestFuseEltwiseReLU) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "layer { "
+      "  name: 'data' "
+      "  type: 'DummyData' "
+      "  dummy_data_param { "
+      "    shape { dim: 2 dim: 5 } "
+      "    shape { dim: 2 dim: 5 } "
+      "    data_filler { type: 'gaussian' std: 1 } "
+      "  } "
+      "  top: 'data' "
+      "  top: 'shortcut' "
+      "} "
+      "layer { "
+      "  name: 'sum' "
+      "  type: 'Eltwise' "
+      "  bottom: 'data' "
+      "  bottom: 'shortcut' "
+      "  top: 'sum' "
+      "} "
+      "layer { "
+      "  name: 'relu' "
+      "  type: 'ReLU' "
+      "  bottom: 'sum' "
+      "  top: 'sum' "
+      "} ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  param.mutable_state()->set_phase(TRAIN);
+  Caffe::set_random_seed(this->seed_);
+  Net<Dtype> train_net(param);
+  EXPECT_EQ(3, train_net.layers().size());
+  train_net.Forward();
+  param.mutable_state()->set_phase(TEST);
+  Net<Dtype> unfused_net(param);
+  EXPECT_EQ(3, unfused_net.layers().size());
+  ASSERT_TRUE(unfused_net.has_layer("relu"));
+  EXPECT_EQ("ReLU", string(unfused_net.layer_by_name("relu")->type()));
+  EXPECT_FALSE(unfused_net.layer_by_name("sum")->layer_param()
+      .eltwise_param().relu());
+  param.set_fuse_layers(true);
+  Caffe::set_random_seed(this->seed_);
+  Net<Dtype> test_net(param);
+  ASSERT_EQ(2, test_net.layers().size());
+  EXPECT_FALSE(test_net.has_layer("relu"));
+  EXPECT_TRUE(test_net.layer_by_name("sum")->layer_param()
+      .eltwise_param().relu());
+  test_net.Forward();
+  const Blob<Dtype>& expected = *train_net.blob_by_name("sum");
+  const Blob<Dtype>& actual = *test_net.blob_by_name("sum");
+  ASSERT_EQ(expected.count(), actual.count());
+  for (int i = 0; i < expected.count(); ++i) {
+    EXPECT_EQ(expected.cpu_data()[i], actual.cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(NetTest, TestPlanBlobViews) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  input_param { shape { dim: 1 dim: 2 dim: 3 dim: 3 } } "
+      "  top: 'data' "
+      "} "
+      "layer { "
+      "  name: 'conv1' "
+      "  type: 'Convolution' "
+      "  convolution_param { "
+      "    num_output: 2 "
+      "    kernel_size: 1 "
+      "    weight_filler { type: 'gaussian' std: 1 } "
+      "  } "
+      "  bottom: 'data' "
+      "  top: 'conv1' "
+      "} "
+      "layer { "
+      "  name: 'relu1' "
+      "  type: 'ReLU' "
+      "  bottom: 'conv1' "
+      "  top: 'conv1' "
+      "} "
+      "layer { "
+      "  name: 'conv2' "
+      "  type: 'Convolution' "
+      "  convolution_param { "
+      "    num_output: 3 "
+      "    kernel_size: 1 "
+      "    weight_filler { type: 'gaussian' std: 1 } "
+      "  } "
+      "  bottom: 'data' "
+      "  top: 'conv2' "
+      "} "
+      "layer { "
+      "  name: 'concat' "
+      "  type: 'Concat' "
+      "  bottom: 'conv1' "
+      "  bottom: 'conv2' "
+      "  top: 'concat' "
+      "} "
+      "layer { "
+      "  name: 'slice1' "
+      "  type: 'Slice' "
+      "  slice_param { slice_point: 2 } "
+      "  bottom: 'concat' "
+      "  top: 'slice1_a' "
+      "  top: 'slice1_b' "
+      "} "
+      "layer { "
+      "  name: 'slice2' "
+      "  type: 'Slice' "
+      "  bottom: 'data' "
+      "  top: 'slice2_a' "
+      "  top: 'slice2_b' "
+      "} "
+      "layer { "
+      "  name: 'relu2' "
+      "  type: 'ReLU' "
+      "  bottom: 'slice2_b' "
+      "  top: 'slice2_b' "
+      "} ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  Net<Dtype> net(param);
+  EXPECT_TRUE(net.layer_by_name("concat")->layer_param().concat_param()
+      .share_bottoms());
+  EXPECT_TRUE(net.layer_by_name("slice1")->layer_param().slice_param()
+      .share_tops());
+  // relu2 writing slice2_b in place would change the data blob.
+  EXPECT_FALSE(net.layer_by_name("slice2")->layer_param().slice_param()
+      .share_tops());
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(net.input_blobs()[0]);
+  net.Forward();
+  const Blob<Dtype>& concat = *net.blob_by_name("concat");
+  const Blob<Dtype>& conv2 = *net.blob_by_name("conv2");
+  EXPECT_TRUE(net.blob_by_name("conv1")->IsViewOf(concat, 0));
+  EXPECT_TRUE(conv2.IsViewOf(concat, 18));
+  EXPECT_TRUE(net.blob_by_name("slice1_b")->IsViewOf(concat, 18));
+  EXPECT_FALSE(net.blob_by_name("slice2_b")->IsViewOf(
+      *net.blob_by_name("data"), 9));
+  // conv2 computes 1x1 convolutions of the data.
+  const Dtype* weights = net.layer_by_name("conv2")->blobs()[0]->cpu_data();
+  const Dtype* bias = net.layer_by_name("conv2")->blobs()[1]->cpu_data();
+  const Dtype* data = net.blob_by_name("data")->cpu_data();
+  for (int c = 0; c < 3; ++c) {
+    for (int i = 0; i < 9; ++i) {
+      const Dtype expected = weights[c * 2] * data[i] +
+          weights[c * 2 + 1] * data[9 + i] + bias[c];
+      EXPECT_NEAR(expected, concat.cpu_data()[18 + c * 9 + i], 1e-4);
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestGradientCheckpointing) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "layer { "
+      "  name: 'data' "
+      "  type: 'DummyData' "
+      "  dummy_data_param { "
+      "    shape { dim: 4 dim: 6 } "
+      "    shape { dim: 4 } "
+      "    data_filler { type: 'gaussian' std: 1 } "
+      "    data_filler { type: 'constant' value: 1 } "
+      "  } "
+      "  top: 'data' "
+      "  top: 'label' "
+      "} "
+      "layer { "
+      "  name: 'ip1' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { "
+      "    num_output: 8 "
+      "    weight_filler { type: 'gaussian' std: 1 } "
+      "  } "
+      "  bottom: 'data' "
+      "  top: 'ip1' "
+      "} "
+      "layer { "
+      "  name: 'relu' "
+      "  type: 'ReLU' "
+      "  bottom: 'ip1' "
+      "  top: 'ip1' "
+      "} "
+      "layer { "
+      "  name: 'drop' "
+      "  type: 'Dropout' "
+      "  bottom: 'ip1' "
+      "  top: 'drop' "
+      "} "
+      "layer { "
+      "  name: 'ip2' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { "
+      "    num_output: 8 "
+      "    weight_filler { type: 'gaussian' std: 1 } "
+      "  } "
+      "  bottom: 'drop' "
+      "  top: 'ip2' "
+      "} "
+      "layer { "
+      "  name: 'bn' "
+      "  type: 'BatchNorm' "
+      "  bottom: 'ip2' "
+      "  top: 'bn' "
+      "} "
+      "layer { "
+      "  name: 'sigmoid' "
+      "  type: 'Sigmoid' "
+      "  bottom: 'bn' "
+      "  top: 'sigmoid' "
+      "} "
+      "layer { "
+      "  name: 'ip3' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { "
+      "    num_output: 3 "
+      "    weight_filler { type: 'gaussian' std: 1 } "
+      "  } "
+      "  bottom: 'sigmoid' "
+      "  top: 'ip3' "
+      "} "
+      "layer { "
+      "  name: 'loss' "
+      "  type: 'SoftmaxWithLoss' "
+      "  bottom: 'ip3' "
+      "  bottom: 'label' "
+      "  top: 'loss' "
+      "} ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  param.mutable_state()->set_phase(TRAIN);
+  // The cuRAND draws of the GPU Dropout cannot be replayed, so freeing its
+  // segment is an error; test the rest with an identity in its place.
+  if (Caffe::mode() == Caffe::GPU) {
+    param.mutable_layer(3)->set_type("Power");
+  }
+  // Every sqrt(9) layers, where the segments are {data, ip1, relu},
+  // {drop, ip2, bn} and {sigmoid, ip3, loss}; then a segment ending at bn,
+  // which holds ip1 too.
+  for (int marked = 0; marked < 2; ++marked) {
+    param.mutable_layer(5)->set_checkpoint(marked);
+    param.set_gradient_checkpointing(false);
+    Caffe::set_random_seed(this->seed_);
+    Net<Dtype> expected_net(param);
+    param.set_gradient_checkpointing(true);
+    Caffe::set_random_seed(this->seed_);
+    Net<Dtype> net(param);
+    for (int iter = 0; iter < 2; ++iter) {
+      Caffe::set_random_seed(this->seed_ + iter);
+      Dtype expected_loss;
+      expected_net.ClearParamDiffs();
+      expected_net.Forward(&expected_loss);
+      expected_net.Backward();
+      Caffe::set_random_seed(this->seed_ + iter);
+      Dtype loss;
+      net.ClearParamDiffs();
+      net.Forward(&loss);
+      EXPECT_EQ(expected_loss, loss);
+      EXPECT_EQ(SyncedMemory::UNINITIALIZED,
+          net.blob_by_name("drop")->data()->head());
+      EXPECT_EQ(SyncedMemory::UNINITIALIZED,
+          net.blob_by_name("ip2")->data()->head());
+      if (marked) {
+        EXPECT_EQ(SyncedMemory::UNINITIALIZED,
+            net.blob_by_name("ip1")->data()->head());
+      } else {
+        EXPECT_NE(SyncedMemory::UNINITIALIZED,
+            net.blob_by_name("ip1")->data()->head());
+      }
+      EXPECT_NE(SyncedMemory::UNINITIALIZED,
+          net.blob_by_name("bn")->data()->head());
+      net.Backward();
+      const Blob<Dtype>& expected_drop = *expected_net.blob_by_name("drop");
+      const Blob<Dtype>& drop = *net.blob_by_name("drop");
+      for (int i = 0; i < drop.count(); ++i) {
+        EXPECT_EQ(expected_drop.cpu_data()[i], drop.cpu_data()[i]);
+      }
+      // The gradients, and the BatchNorm statistics, which Forward updates.
+      for (int layer_id = 0; layer_id < net.layers().size(); ++layer_id) {
+        const vector<shared_ptr<Blob<Dtype> > >& expected_params =
+            expected_net.layers()[layer_id]->blobs();
+        const vector<shared_ptr<Blob<Dtype> > >& params =
+            net.layers()[layer_id]->blobs();
+        ASSERT_EQ(expected_params.size(), params.size());
+        for (int j = 0; j < params.size(); ++j) {
+          for (int i = 0; i < params[j]->count(); ++i) {
+            EXPECT_EQ(expected_params[j]->cpu_data()[i],
+                params[j]->cpu_data()[i]);
+            EXPECT_EQ(expected_params[j]->cpu_diff()[i],
+                params[j]->cpu_diff()[i]);
+          }
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestGradientCheckpointingRecurrentState) {
+  typedef typename TypeParam::Dtype Dtype;
+  // The LSTM carries its state over from one iteration to the next (cont is
+  // 1 at the first timestep too), so it is kept out of the freed segments.
+  const string& proto =
+      "layer { "
+      "  name: 'data' "
+      "  type: 'DummyData' "
+      "  dummy_data_param { "
+      "    shape { dim: 3 dim: 2 dim: 4 } "
+      "    shape { dim: 3 dim: 2 } "
+      "    data_filler { type: 'gaussian' std: 1 } "
+      "    data_filler { type: 'constant' value: 1 } "
+      "  } "
+      "  top: 'data' "
+      "  top: 'cont' "
+      "} "
+      "layer { "
+      "  name: 'ip0' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { "
+      "    num_output: 4 "
+      "    axis: 2 "
+      "    weight_filler { type: 'gaussian' std: 1 } "
+      "  } "
+      "  bottom: 'data' "
+      "  top: 'ip0' "
+      "} "
+      "layer { "
+      "  name: 'lstm' "
+      "  type: 'LSTM' "
+      "  recurrent_param { "
+      "    num_output: 5 "
+      "    weight_filler { type: 'gaussian' std: 0.5 } "
+      "  } "
+      "  bottom: 'ip0' "
+      "  bottom: 'cont' "
+      "  top: 'lstm' "
+      "} "
+      "layer { "
+      "  name: 'ip1' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { "
+      "    num_output: 4 "
+      "    axis: 2 "
+      "    weight_filler { type: 'gaussian' std: 1 } "
+      "  } "
+      "  bottom: 'lstm' "
+      "  top: 'ip1' "
+      "} "
+      "layer { "
+      "  name: 'tanh' "
+      "  type: 'TanH' "
+      "  bottom: 'ip1' "
+      "  top: 'tanh' "
+      "} "
+      "layer { "
+      "  name: 'ip2' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { "
+      "    num_output: 2 "
+      "    axis: 2 "
+      "    weight_filler { type: 'gaussian' std: 1 } "
+      "  } "
+      "  bottom: 'tanh' "
+      "  top: 'ip2' "
+      "} "
+      "layer { "
+      "  name: 'loss' "
+      "  type: 'Reduction' "
+      "  reduction_param { operation: SUMSQ } "
+      "  bottom: 'ip2' "
+      "  top: 'loss' "
+      "  loss_weight: 1 "
+      "} ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  param.mutable_state()->set_phase(TRAIN);
+  param.set_gradient_checkpointing(false);
+  Caffe::set_random_seed(this->seed_);
+  Net<Dtype> expected_net(param);
+  param.set_gradient_checkpointing(true);
+  Caffe::set_random_seed(this->seed_);
+  Net<Dtype> net(param);
+  for (int iter = 0; iter < 2; ++iter) {
+    Caffe::set_random_seed(this->seed_ + iter);
+    Dtype expected_loss;
+    expected_net.ClearParamDiffs();
+    expected_net.Forward(&expected_loss);
+    expected_net.Backward();
+    Caffe::set_random_seed(this->seed_ + iter);
+    Dtype loss;
+    net.ClearParamDiffs();
+    net.Forward(&loss);
+    EXPECT_EQ(expected_loss, loss);
+    // The segments are {data, ip0}, {lstm}, {ip1, tanh, ip2} and {loss}.
+    EXPECT_NE(SyncedMemory::UNINITIALIZED,
+        net.blob_by_name("lstm")->data()->head());
+    EXPECT_EQ(SyncedMemory::UNINITIALIZED,
+        net.blob_by_name("tanh")->data()->head());
+    net.Backward();
+    for (int layer_id = 0; layer_id < net.layers().size(); ++layer_id) {
+      const vector<shared_ptr<Blob<Dtype> > >& expected_params =
+          expected_net.layers()[layer_id]->blobs();
+      const vector<shared_ptr<Blob<Dtype> > >& params =
+          net.layers()[layer_id]->blobs();
+      ASSERT_EQ(expected_params.size(), params.size());
+      for (int j = 0; j < params.size(); ++j) {
+        for (int i = 0; i < params[j]->count(); ++i) {
+          EXPECT_EQ(expected_params[j]->cpu_diff()[i],
+              params[j]->cpu_diff()[i]);
+        }
+      }
+    }
+  }
+}
+
 }  // namespace caffe
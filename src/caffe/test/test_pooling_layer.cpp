@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cfloat>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -6,6 +8,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/pooling_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 #ifdef USE_CUDNN
 #include "caffe/layers/cudnn_pooling_layer.hpp"
@@ -609,6 +612,104 @@ TYPED_TEST(PoolingLayerTest, TestGradientAvePadded) {
   }
 }
 
+// Checks the CPU kernels for the common geometries (including global
+// pooling, 2x2 and 3x3 windows of stride 2, and the generic path) against a
+// plain loop over the windows, at inference, and that Backward after a
+// mask-free forward pass matches a training one.
+TYPED_TEST(PoolingLayerTest, TestForwardGeometries) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->blob_bottom_->Reshape(2, 3, 13, 11);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  const int kGeometries = 6;
+  // kernel_h, kernel_w, stride_h, stride_w, pad, global
+  const int geometries[kGeometries][6] = {
+    {2, 2, 2, 2, 0, 0}, {3, 3, 2, 2, 0, 0}, {3, 3, 2, 2, 1, 0},
+    {3, 3, 1, 1, 1, 0}, {2, 4, 1, 3, 1, 0}, {0, 0, 1, 1, 0, 1},
+  };
+  for (int g = 0; g < kGeometries; ++g) {
+    for (int method = 0; method < 2; ++method) {
+      const int* geometry = geometries[g];
+      LayerParameter layer_param;
+      layer_param.set_phase(TEST);
+      PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+      if (geometry[5]) {
+        pooling_param->set_global_pooling(true);
+      } else {
+        pooling_param->set_kernel_h(geometry[0]);
+        pooling_param->set_kernel_w(geometry[1]);
+        pooling_param->set_stride_h(geometry[2]);
+        pooling_param->set_stride_w(geometry[3]);
+        pooling_param->set_pad(geometry[4]);
+      }
+      pooling_param->set_pool(method == 0 ? PoolingParameter_PoolMethod_MAX :
+          PoolingParameter_PoolMethod_AVE);
+      PoolingLayer<Dtype> layer(layer_param);
+      layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      const int height = this->blob_bottom_->height();
+      const int width = this->blob_bottom_->width();
+      const int kernel_h = geometry[5] ? height : geometry[0];
+      const int kernel_w = geometry[5] ? width : geometry[1];
+      const int pad = geometry[4];
+      for (int n = 0; n < this->blob_top_->num(); ++n) {
+        for (int c = 0; c < this->blob_top_->channels(); ++c) {
+          for (int ph = 0; ph < this->blob_top_->height(); ++ph) {
+            for (int pw = 0; pw < this->blob_top_->width(); ++pw) {
+              const int hstart = ph * geometry[2] - pad;
+              const int wstart = pw * geometry[3] - pad;
+              const int pool_size =
+                  (std::min(hstart + kernel_h, height + pad) - hstart) *
+                  (std::min(wstart + kernel_w, width + pad) - wstart);
+              Dtype max_value = -FLT_MAX;
+              Dtype sum = 0;
+              for (int h = std::max(hstart, 0);
+                   h < std::min(hstart + kernel_h, height); ++h) {
+                for (int w = std::max(wstart, 0);
+                     w < std::min(wstart + kernel_w, width); ++w) {
+                  const Dtype value = this->blob_bottom_->data_at(n, c, h, w);
+                  max_value = std::max(max_value, value);
+                  sum += value;
+                }
+              }
+              const Dtype expected = method == 0 ? max_value : sum / pool_size;
+              EXPECT_NEAR(expected, this->blob_top_->data_at(n, c, ph, pw),
+                  1e-5) << "geometry " << g << " method " << method;
+            }
+          }
+        }
+      }
+      if (method == 0) {
+        FillerParameter diff_filler_param;
+        GaussianFiller<Dtype> diff_filler(diff_filler_param);
+        Blob<Dtype> top_diff;
+        top_diff.ReshapeLike(*this->blob_top_);
+        diff_filler.Fill(&top_diff);
+        caffe_copy(top_diff.count(), top_diff.cpu_data(),
+            this->blob_top_->mutable_cpu_diff());
+        vector<bool> propagate_down(1, true);
+        layer.Backward(this->blob_top_vec_, propagate_down,
+            this->blob_bottom_vec_);
+        Blob<Dtype> bottom_diff;
+        bottom_diff.CopyFrom(*this->blob_bottom_, true, true);
+        layer_param.set_phase(TRAIN);
+        PoolingLayer<Dtype> train_layer(layer_param);
+        train_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+        train_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+        caffe_copy(top_diff.count(), top_diff.cpu_data(),
+            this->blob_top_->mutable_cpu_diff());
+        train_layer.Backward(this->blob_top_vec_, propagate_down,
+            this->blob_bottom_vec_);
+        for (int i = 0; i < bottom_diff.count(); ++i) {
+          EXPECT_EQ(this->blob_bottom_->cpu_diff()[i],
+              bottom_diff.cpu_diff()[i]);
+        }
+      }
+    }
+  }
+}
+
 #ifdef USE_CUDNN
 template <typename Dtype>
 class CuDNNPoolingLayerTest : public GPUDeviceTest<Dtype> {
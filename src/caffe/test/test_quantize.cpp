@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/util/quantize.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class QuantizeTest : public CPUDeviceTest<Dtype> {};
+
+TYPED_TEST_CASE(QuantizeTest, TestDtypes);
+
+TYPED_TEST(QuantizeTest, TestChooseQuantization) {
+  float scale;
+  int zero_point;
+  caffe_choose_u8_quantization(-1, 3, &scale, &zero_point);
+  EXPECT_FLOAT_EQ(4.f / 255, scale);
+  EXPECT_EQ(64, zero_point);
+  // The range always contains zero, so zero quantizes exactly.
+  caffe_choose_u8_quantization(2, 5.1, &scale, &zero_point);
+  EXPECT_FLOAT_EQ(0.02f, scale);
+  EXPECT_EQ(0, zero_point);
+  caffe_choose_u8_quantization(0, 0, &scale, &zero_point);
+  EXPECT_EQ(1, scale);
+  EXPECT_EQ(0, zero_point);
+}
+
+TYPED_TEST(QuantizeTest, TestQuantizeU8) {
+  typedef TypeParam Dtype;
+  const Dtype x[] = {-1, -0.5, 0, 0.26, 3, 10};
+  uint8_t q[6];
+  caffe_cpu_quantize_u8(6, x, 0.5, 2, q);
+  EXPECT_EQ(0, q[0]);
+  EXPECT_EQ(1, q[1]);
+  EXPECT_EQ(2, q[2]);
+  EXPECT_EQ(3, q[3]);
+  EXPECT_EQ(8, q[4]);
+  EXPECT_EQ(22, q[5]);
+}
+
+TYPED_TEST(QuantizeTest, TestGemmS8U8S32) {
+  const int M = 5, N = 19, K = 37;
+  vector<int8_t> A(M * K);
+  vector<uint8_t> B(K * N);
+  for (int i = 0; i < M * K; ++i) {
+    A[i] = static_cast<int8_t>((i * 37) % 255 - 127);
+  }
+  for (int i = 0; i < K * N; ++i) {
+    B[i] = static_cast<uint8_t>((i * 91) % 256);
+  }
+  vector<int32_t> C(M * N);
+  caffe_cpu_gemm_s8u8s32(M, N, K, &A[0], &B[0], &C[0]);
+  for (int i = 0; i < M; ++i) {
+    for (int j = 0; j < N; ++j) {
+      int32_t expected = 0;
+      for (int k = 0; k < K; ++k) {
+        expected += A[i * K + k] * B[k * N + j];
+      }
+      EXPECT_EQ(expected, C[i * N + j]);
+    }
+  }
+}
+
+TYPED_TEST(QuantizeTest, TestInt8WeightMatrix) {
+  typedef TypeParam Dtype;
+  Blob<Dtype> weights(1, 1, 3, 4);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(&weights);
+  Int8WeightMatrix<Dtype> int8_weights;
+  EXPECT_FALSE(int8_weights.IsQuantizedFrom(weights));
+  for (int transpose = 0; transpose < 2; ++transpose) {
+    const int rows = transpose ? 4 : 3;
+    const int cols = transpose ? 3 : 4;
+    int8_weights.Quantize(weights, transpose, rows, cols, vector<float>());
+    EXPECT_TRUE(int8_weights.IsQuantizedFrom(weights));
+    for (int i = 0; i < rows; ++i) {
+      int32_t row_sum = 0;
+      int max_abs = 0;
+      for (int j = 0; j < cols; ++j) {
+        const int q = int8_weights.data()[i * cols + j];
+        const Dtype w = transpose ? weights.cpu_data()[j * rows + i] :
+            weights.cpu_data()[i * cols + j];
+        EXPECT_NEAR(w, q * int8_weights.scales()[i],
+            int8_weights.scales()[i] / 2 + 1e-6);
+        row_sum += q;
+        max_abs = std::max(max_abs, std::abs(q));
+      }
+      EXPECT_EQ(row_sum, int8_weights.row_sums()[i]);
+      EXPECT_EQ(127, max_abs);
+    }
+  }
+  // Writing the weights invalidates the quantized copy.
+  weights.mutable_cpu_data();
+  EXPECT_FALSE(int8_weights.IsQuantizedFrom(weights));
+}
+
+}  // namespace caffe
@@ -5,6 +5,7 @@
 #include "caffe/common.hpp"
 #include "caffe/syncedmem.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/rng.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 
@@ -395,6 +396,79 @@ TYPED_TEST(RandomNumberGeneratorTest, TestRngBernoulliTimesBernoulli) {
   EXPECT_NEAR(true_mean, sample_p, bound);
 }
 
+TYPED_TEST(RandomNumberGeneratorTest, TestPhiloxKnownAnswers) {
+  // The known-answer tests of the Random123 library for Philox4x32-10.
+  const uint32_t counters[3][4] = {
+      {0, 0, 0, 0},
+      {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+      {0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}};
+  const uint32_t keys[3][2] = {
+      {0, 0}, {0xffffffff, 0xffffffff}, {0xa4093822, 0x299f31d0}};
+  const uint32_t expected[3][4] = {
+      {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8},
+      {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd},
+      {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}};
+  for (int i = 0; i < 3; ++i) {
+    uint32_t r[4];
+    PhiloxStream::Philox(counters[i], keys[i], r);
+    for (int j = 0; j < 4; ++j) {
+      EXPECT_EQ(expected[i][j], r[j]) << "i = " << i << "; j = " << j;
+    }
+  }
+}
+
+
+TYPED_TEST(RandomNumberGeneratorTest, TestPhiloxDistributions) {
+  const PhiloxStream stream(caffe_rng_seed(), 3);
+  TypeParam* data = static_cast<TypeParam*>(this->data_->mutable_cpu_data());
+  stream.Gaussian<TypeParam>(this->sample_size_, 0, -2, 3, data);
+  this->RngGaussianChecks(-2, 3, data);
+  stream.Uniform<TypeParam>(this->sample_size_, 0, -7.3, -2.3, data);
+  this->RngUniformChecks(-7.3, -2.3, data);
+  int* int_data = static_cast<int*>(this->int_data_->mutable_cpu_data());
+  stream.Bernoulli<TypeParam>(this->sample_size_, 0, 0.3, int_data);
+  this->RngBernoulliChecks(0.3, int_data);
+}
+
+
+TYPED_TEST(RandomNumberGeneratorTest, TestPhiloxOffsets) {
+  // Any range of a stream can be drawn on its own, with the same values.
+  const int n = this->sample_size_;
+  const uint64_t seed = caffe_rng_seed();
+  const PhiloxStream stream(seed, 0);
+  TypeParam* data = static_cast<TypeParam*>(this->data_->mutable_cpu_data());
+  TypeParam* data_2 =
+      static_cast<TypeParam*>(this->data_2_->mutable_cpu_data());
+  const int splits[] = {0, 1, 6, 1001, n};
+  for (int dist = 0; dist < 2; ++dist) {
+    if (dist == 0) {
+      stream.Uniform<TypeParam>(n, 0, 0, 1, data);
+    } else {
+      stream.Gaussian<TypeParam>(n, 0, 0, 1, data);
+    }
+    for (int i = 0; i + 1 < sizeof(splits) / sizeof(splits[0]); ++i) {
+      const int begin = splits[i];
+      const int count = splits[i + 1] - begin;
+      if (dist == 0) {
+        stream.Uniform<TypeParam>(count, begin, 0, 1, data_2 + begin);
+      } else {
+        stream.Gaussian<TypeParam>(count, begin, 0, 1, data_2 + begin);
+      }
+    }
+    for (int i = 0; i < n; ++i) {
+      EXPECT_EQ(data[i], data_2[i]) << "dist = " << dist << "; i = " << i;
+    }
+  }
+  // Other streams of the seed differ.
+  stream.Uniform<TypeParam>(n, 0, 0, 1, data);
+  PhiloxStream(seed, 1).Uniform<TypeParam>(n, 0, 0, 1, data_2);
+  int num_equal = 0;
+  for (int i = 0; i < n; ++i) {
+    num_equal += (data[i] == data_2[i]);
+  }
+  EXPECT_LT(num_equal, 10);
+}
+
 #ifndef CPU_ONLY
 
 TYPED_TEST(RandomNumberGeneratorTest, TestRngGaussianGPU) {
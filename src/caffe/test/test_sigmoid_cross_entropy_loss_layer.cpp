@@ -116,6 +116,43 @@ TYPED_TEST(SigmoidCrossEntropyLossLayerTest, TestGradient) {
       this->blob_top_vec_, 0);
 }
 
+TYPED_TEST(SigmoidCrossEntropyLossLayerTest, TestForwardPerSampleLoss) {
+  typedef typename TypeParam::Dtype Dtype;
+  Blob<Dtype> sample_loss;
+  this->blob_top_vec_.push_back(&sample_loss);
+  LayerParameter layer_param;
+  LossParameter* loss_param = layer_param.mutable_loss_param();
+  loss_param->set_ignore_label(-1);
+  loss_param->set_normalization(LossParameter_NormalizationMode_NONE);
+  loss_param->set_per_sample_loss(true);
+  // Ignore every third target, across the samples.
+  Dtype* target = this->blob_bottom_targets_->mutable_cpu_data();
+  const int count = this->blob_bottom_targets_->count();
+  for (int i = 0; i < count; i += 3) {
+    target[i] = -1;
+  }
+  SigmoidCrossEntropyLossLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  const int num = this->blob_bottom_data_->num();
+  const int dim = count / num;
+  ASSERT_EQ(num, sample_loss.count());
+  const Dtype* input = this->blob_bottom_data_->cpu_data();
+  Dtype expected_loss = 0;
+  for (int n = 0; n < num; ++n) {
+    Dtype expected_sample_loss = 0;
+    for (int i = n * dim; i < (n + 1) * dim; ++i) {
+      if (target[i] != -1) {
+        expected_sample_loss += this->SigmoidCrossEntropyLossReference(1, 1,
+            input + i, target + i);
+      }
+    }
+    EXPECT_NEAR(expected_sample_loss, sample_loss.cpu_data()[n], 1e-4);
+    expected_loss += expected_sample_loss;
+  }
+  EXPECT_NEAR(expected_loss, this->blob_top_loss_->cpu_data()[0], 1e-4);
+}
+
 TYPED_TEST(SigmoidCrossEntropyLossLayerTest, TestIgnoreGradient) {
   typedef typename TypeParam::Dtype Dtype;
   FillerParameter data_filler_param;
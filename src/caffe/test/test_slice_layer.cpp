@@ -132,6 +132,36 @@ TYPED_TEST(SliceLayerTest, TestSliceAcrossNum) {
   }
 }
 
+TYPED_TEST(SliceLayerTest, TestSliceAcrossNumShareTops) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_slice_param()->set_axis(0);
+  layer_param.mutable_slice_param()->set_share_tops(true);
+  SliceLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_1_);
+  const int top_count = this->blob_top_0_->count();
+  EXPECT_TRUE(this->blob_top_0_->IsViewOf(*this->blob_bottom_, 0));
+  EXPECT_TRUE(this->blob_top_1_->IsViewOf(*this->blob_bottom_, top_count));
+  EXPECT_TRUE(this->blob_top_2_->IsViewOf(*this->blob_bottom_,
+      2 * top_count));
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_1_);
+  for (int i = 0; i < top_count; ++i) {
+    EXPECT_EQ(this->blob_bottom_->cpu_data()[i],
+              this->blob_top_0_->cpu_data()[i]);
+    EXPECT_EQ(this->blob_bottom_->cpu_data()[i + 2 * top_count],
+              this->blob_top_2_->cpu_data()[i]);
+  }
+  // Slicing channels of several images takes copies.
+  this->blob_top_vec_1_.resize(2);
+  layer_param.mutable_slice_param()->set_axis(1);
+  SliceLayer<Dtype> channel_layer(layer_param);
+  channel_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_1_);
+  EXPECT_FALSE(this->blob_top_0_->IsViewOf(*this->blob_bottom_, 0));
+  channel_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_1_);
+  EXPECT_EQ(this->blob_bottom_->data_at(1, 6, 0, 0),
+            this->blob_top_1_->data_at(1, 0, 0, 0));
+}
+
 TYPED_TEST(SliceLayerTest, TestSliceAcrossChannels) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -199,6 +229,19 @@ TYPED_TEST(SliceLayerTest, TestGradientAcrossNum) {
     this->blob_top_vec_0_);
 }
 
+TYPED_TEST(SliceLayerTest, TestGradientAcrossNumShareTops) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Gradient checks are slow; reduce blob size.
+  this->ReduceBottomBlobSize();
+  LayerParameter layer_param;
+  layer_param.mutable_slice_param()->set_axis(0);
+  layer_param.mutable_slice_param()->set_share_tops(true);
+  SliceLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+    this->blob_top_vec_0_);
+}
+
 TYPED_TEST(SliceLayerTest, TestGradientAcrossChannels) {
   typedef typename TypeParam::Dtype Dtype;
   // Gradient checks are slow; reduce blob size.
@@ -7,6 +7,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/softmax_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 #ifdef USE_CUDNN
 #include "caffe/layers/cudnn_softmax_layer.hpp"
@@ -83,6 +84,61 @@ TYPED_TEST(SoftmaxLayerTest, TestGradient) {
       this->blob_top_vec_);
 }
 
+TYPED_TEST(SoftmaxLayerTest, TestForwardLastAxis) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_softmax_param()->set_axis(-1);
+  SoftmaxLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  const int dim = this->blob_bottom_->shape(-1);
+  const Dtype* bottom_data = this->blob_bottom_->cpu_data();
+  const Dtype* top_data = this->blob_top_->cpu_data();
+  for (int i = 0; i < this->blob_bottom_->count(); i += dim) {
+    Dtype scale = 0;
+    for (int j = 0; j < dim; ++j) {
+      scale += exp(bottom_data[i + j]);
+    }
+    for (int j = 0; j < dim; ++j) {
+      EXPECT_NEAR(top_data[i + j], exp(bottom_data[i + j]) / scale, 1e-4);
+    }
+  }
+}
+
+TYPED_TEST(SoftmaxLayerTest, TestForwardLargeInputs) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Inputs whose exp overflows must not produce inf or NaN.
+  caffe_scal(this->blob_bottom_->count(), Dtype(1000),
+      this->blob_bottom_->mutable_cpu_data());
+  for (int axis = 1; axis <= 3; axis += 2) {
+    LayerParameter layer_param;
+    layer_param.mutable_softmax_param()->set_axis(axis);
+    SoftmaxLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    const Dtype* top_data = this->blob_top_->cpu_data();
+    Dtype sum = 0;
+    for (int i = 0; i < this->blob_top_->count(); ++i) {
+      EXPECT_GE(top_data[i], 0);
+      EXPECT_LE(top_data[i], 1);
+      sum += top_data[i];
+    }
+    const int num_positions =
+        this->blob_top_->count() / this->blob_top_->shape(axis);
+    EXPECT_NEAR(num_positions, sum, 1e-3);
+  }
+}
+
+TYPED_TEST(SoftmaxLayerTest, TestGradientLastAxis) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_softmax_param()->set_axis(-1);
+  SoftmaxLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
 #ifdef USE_CUDNN
 template <typename Dtype>
 class CuDNNSoftmaxLayerTest : public GPUDeviceTest<Dtype> {
@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <cmath>
+#include <limits>
 #include <vector>
 
 #include "boost/scoped_ptr.hpp"
@@ -8,6 +10,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/softmax_loss_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -105,4 +108,131 @@ TYPED_TEST(SoftmaxWithLossLayerTest, TestGradientUnnormalized) {
       this->blob_top_vec_, 0);
 }
 
+TYPED_TEST(SoftmaxWithLossLayerTest, TestForwardProb) {
+  typedef typename TypeParam::Dtype Dtype;
+  Blob<Dtype> prob;
+  this->blob_top_vec_.push_back(&prob);
+  LayerParameter layer_param;
+  layer_param.add_loss_weight(1);
+  layer_param.add_loss_weight(0);
+  layer_param.mutable_loss_param()->set_normalization(
+      LossParameter_NormalizationMode_NONE);
+  SoftmaxWithLossLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Dtype expected_loss = 0;
+  for (int n = 0; n < this->blob_bottom_data_->num(); ++n) {
+    for (int h = 0; h < this->blob_bottom_data_->height(); ++h) {
+      for (int w = 0; w < this->blob_bottom_data_->width(); ++w) {
+        Dtype max_val = this->blob_bottom_data_->data_at(n, 0, h, w);
+        for (int c = 1; c < this->blob_bottom_data_->channels(); ++c) {
+          max_val = std::max(max_val,
+              this->blob_bottom_data_->data_at(n, c, h, w));
+        }
+        Dtype sum = 0;
+        for (int c = 0; c < this->blob_bottom_data_->channels(); ++c) {
+          sum += exp(this->blob_bottom_data_->data_at(n, c, h, w) - max_val);
+        }
+        for (int c = 0; c < this->blob_bottom_data_->channels(); ++c) {
+          EXPECT_NEAR(exp(this->blob_bottom_data_->data_at(n, c, h, w) -
+              max_val) / sum, prob.data_at(n, c, h, w), 1e-4);
+        }
+        const int label = this->blob_bottom_label_->data_at(n, 0, h, w);
+        expected_loss += max_val + log(sum) -
+            this->blob_bottom_data_->data_at(n, label, h, w);
+      }
+    }
+  }
+  EXPECT_NEAR(expected_loss, this->blob_top_loss_->cpu_data()[0],
+      1e-4 * expected_loss);
+}
+
+TYPED_TEST(SoftmaxWithLossLayerTest, TestForwardPerSampleLoss) {
+  typedef typename TypeParam::Dtype Dtype;
+  Blob<Dtype> prob;
+  Blob<Dtype> sample_loss;
+  this->blob_top_vec_.push_back(&prob);
+  this->blob_top_vec_.push_back(&sample_loss);
+  LayerParameter layer_param;
+  layer_param.add_loss_weight(1);
+  layer_param.add_loss_weight(0);
+  layer_param.add_loss_weight(0);
+  layer_param.mutable_loss_param()->set_ignore_label(0);
+  layer_param.mutable_loss_param()->set_per_sample_loss(true);
+  SoftmaxWithLossLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  const Blob<Dtype>& data = *this->blob_bottom_data_;
+  ASSERT_EQ(1, sample_loss.num_axes());
+  ASSERT_EQ(data.num(), sample_loss.count());
+  Dtype expected_loss = 0;
+  int count = 0;
+  for (int n = 0; n < data.num(); ++n) {
+    Dtype expected_sample_loss = 0;
+    for (int h = 0; h < data.height(); ++h) {
+      for (int w = 0; w < data.width(); ++w) {
+        Dtype max_val = data.data_at(n, 0, h, w);
+        for (int c = 1; c < data.channels(); ++c) {
+          max_val = std::max(max_val, data.data_at(n, c, h, w));
+        }
+        Dtype sum = 0;
+        for (int c = 0; c < data.channels(); ++c) {
+          sum += exp(data.data_at(n, c, h, w) - max_val);
+        }
+        // The probabilities cover the ignored positions too.
+        for (int c = 0; c < data.channels(); ++c) {
+          EXPECT_NEAR(exp(data.data_at(n, c, h, w) - max_val) / sum,
+              prob.data_at(n, c, h, w), 1e-4);
+        }
+        const int label = this->blob_bottom_label_->data_at(n, 0, h, w);
+        if (label != 0) {
+          expected_sample_loss += max_val + log(sum) -
+              data.data_at(n, label, h, w);
+          ++count;
+        }
+      }
+    }
+    EXPECT_NEAR(expected_sample_loss, sample_loss.cpu_data()[n],
+        1e-4 * std::max(expected_sample_loss, Dtype(1)));
+    expected_loss += expected_sample_loss;
+  }
+  EXPECT_NEAR(expected_loss / count, this->blob_top_loss_->cpu_data()[0],
+      1e-4 * expected_loss / count);
+}
+
+TYPED_TEST(SoftmaxWithLossLayerTest, TestForwardLargeLogits) {
+  typedef typename TypeParam::Dtype Dtype;
+  // A confidently wrong prediction has a large but finite loss.
+  caffe_scal(this->blob_bottom_data_->count(), Dtype(1000),
+      this->blob_bottom_data_->mutable_cpu_data());
+  LayerParameter layer_param;
+  SoftmaxWithLossLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  const Dtype loss = this->blob_top_loss_->cpu_data()[0];
+  EXPECT_EQ(loss, loss);
+  EXPECT_GT(loss, 100);
+  EXPECT_LT(loss, std::numeric_limits<Dtype>::infinity());
+}
+
+TYPED_TEST(SoftmaxWithLossLayerTest, TestGradientLastAxis) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.add_loss_weight(3);
+  layer_param.mutable_softmax_param()->set_axis(1);
+  vector<int> label_shape(1, this->blob_bottom_data_->num());
+  this->blob_bottom_label_->Reshape(label_shape);
+  vector<int> data_shape(2, this->blob_bottom_data_->num());
+  data_shape[1] = this->blob_bottom_data_->count(1);
+  this->blob_bottom_data_->Reshape(data_shape);
+  for (int i = 0; i < this->blob_bottom_label_->count(); ++i) {
+    this->blob_bottom_label_->mutable_cpu_data()[i] =
+        caffe_rng_rand() % data_shape[1];
+  }
+  SoftmaxWithLossLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-2, 1701);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_, 0);
+}
+
 }  // namespace caffe
@@ -106,4 +106,98 @@ TYPED_TEST(SolverTest, TestInitTrainTestNets) {
   EXPECT_TRUE(this->solver_->test_nets()[1]->has_layer("accuracy"));
 }
 
+template <typename Dtype>
+class CPUSolverTest : public SolverTest<CPUDevice<Dtype> > {
+ protected:
+  // Trains an embedding that sees only index 3 for a few iterations and
+  // returns its weights.
+  void TrainEmbed(const string& type, const bool sparse_gradient,
+      vector<Dtype>* weights) {
+    ostringstream proto;
+    proto <<
+       "type: '" << type << "' "
+       "base_lr: 0.1 "
+       "lr_policy: 'fixed' "
+       "momentum: 0.9 "
+       "weight_decay: 0.1 "
+       "random_seed: 1701 "
+       "solver_mode: CPU "
+       "net_param { "
+       "  layer { "
+       "    name: 'data' "
+       "    type: 'DummyData' "
+       "    dummy_data_param { "
+       "      shape { dim: 3 } "
+       "      shape { dim: 3 dim: 4 } "
+       "      data_filler { type: 'constant' value: 3 } "
+       "      data_filler { type: 'gaussian' std: 1 } "
+       "    } "
+       "    top: 'index' "
+       "    top: 'target' "
+       "  } "
+       "  layer { "
+       "    name: 'embed' "
+       "    type: 'Embed' "
+       "    embed_param { "
+       "      num_output: 4 "
+       "      input_dim: 6 "
+       "      bias_term: false "
+       "      sparse_gradient: " << (sparse_gradient ? "true" : "false") <<
+       "      weight_filler { type: 'gaussian' std: 1 } "
+       "    } "
+       "    bottom: 'index' "
+       "    top: 'embed' "
+       "  } "
+       "  layer { "
+       "    name: 'loss' "
+       "    type: 'EuclideanLoss' "
+       "    bottom: 'embed' "
+       "    bottom: 'target' "
+       "  } "
+       "} ";
+    SolverParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto.str(), &param));
+    if (type == "Adam") {
+      param.set_momentum2(0.999);
+      param.set_delta(1e-8);
+      this->solver_.reset(new AdamSolver<Dtype>(param));
+    } else {
+      this->solver_.reset(new SGDSolver<Dtype>(param));
+    }
+    const Blob<Dtype>& weight =
+        *this->solver_->net()->layer_by_name("embed")->blobs()[0];
+    vector<Dtype> initial(weight.cpu_data(),
+        weight.cpu_data() + weight.count());
+    this->solver_->Step(3);
+    weights->assign(weight.cpu_data(), weight.cpu_data() + weight.count());
+    if (sparse_gradient) {
+      // Lazy updates leave the rows outside the gradient alone.
+      for (int i = 0; i < weight.count(); ++i) {
+        if (i / 4 != 3) {
+          EXPECT_EQ(initial[i], (*weights)[i]);
+        }
+      }
+    }
+  }
+};
+
+TYPED_TEST_CASE(CPUSolverTest, TestDtypes);
+
+TYPED_TEST(CPUSolverTest, TestSparseGradientUpdates) {
+  typedef TypeParam Dtype;
+  const char* types[] = {"SGD", "Adam"};
+  for (int t = 0; t < 2; ++t) {
+    vector<Dtype> dense, sparse;
+    this->TrainEmbed(types[t], false, &dense);
+    this->TrainEmbed(types[t], true, &sparse);
+    ASSERT_EQ(dense.size(), sparse.size());
+    // The dense weight decay moves every row.
+    EXPECT_NE(dense[0], sparse[0]);
+    // Row 3 is in every gradient, so its lazy updates are the dense ones.
+    for (int i = 3 * 4; i < 4 * 4; ++i) {
+      EXPECT_NEAR(dense[i], sparse[i], 1e-5) << types[t];
+    }
+  }
+}
+
 }  // namespace caffe
@@ -0,0 +1,121 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/sparse.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class SparseWeightMatrixTest : public CPUDeviceTest<Dtype> {
+ protected:
+  SparseWeightMatrixTest() : weights_(1, 1, 6, 10) {}
+
+  // Fills weights_ with Gaussian noise and zeros every entry but those whose
+  // index is a multiple of keep_every.
+  void FillSparse(const int keep_every) {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(&weights_);
+    Dtype* data = weights_.mutable_cpu_data();
+    for (int i = 0; i < weights_.count(); ++i) {
+      if (i % keep_every != 0) {
+        data[i] = 0;
+      }
+    }
+  }
+
+  Blob<Dtype> weights_;
+};
+
+TYPED_TEST_CASE(SparseWeightMatrixTest, TestDtypes);
+
+TYPED_TEST(SparseWeightMatrixTest, TestConvert) {
+  typedef TypeParam Dtype;
+  this->FillSparse(4);
+  SparseWeightMatrix<Dtype> sparse;
+  EXPECT_FALSE(sparse.IsConvertedFrom(this->weights_));
+  // Too dense: the conversion is declined but remembered.
+  sparse.Convert(this->weights_, false, 6, 10, 0.8);
+  EXPECT_TRUE(sparse.IsConvertedFrom(this->weights_));
+  EXPECT_FALSE(sparse.is_sparse());
+  sparse.Convert(this->weights_, false, 6, 10, 0.7);
+  EXPECT_TRUE(sparse.is_sparse());
+  EXPECT_EQ(15, sparse.nnz());
+  const Dtype* W = this->weights_.cpu_data();
+  for (int transpose = 0; transpose < 2; ++transpose) {
+    const int rows = transpose ? 10 : 6;
+    const int cols = transpose ? 6 : 10;
+    sparse.Convert(this->weights_, transpose, rows, cols, 0.7);
+    vector<Dtype> dense(rows * cols, Dtype(0));
+    for (int i = 0; i < rows; ++i) {
+      for (int p = sparse.row_ptr()[i]; p < sparse.row_ptr()[i + 1]; ++p) {
+        dense[i * cols + sparse.col_idx()[p]] = sparse.values()[p];
+      }
+    }
+    for (int i = 0; i < rows; ++i) {
+      for (int j = 0; j < cols; ++j) {
+        EXPECT_EQ(transpose ? W[j * rows + i] : W[i * cols + j],
+            dense[i * cols + j]);
+      }
+    }
+  }
+  // Writing the weights calls for a new conversion.
+  this->weights_.mutable_cpu_data();
+  EXPECT_FALSE(sparse.IsConvertedFrom(this->weights_));
+}
+
+TYPED_TEST(SparseWeightMatrixTest, TestCsrmm) {
+  typedef TypeParam Dtype;
+  this->FillSparse(3);
+  SparseWeightMatrix<Dtype> sparse;
+  sparse.Convert(this->weights_, false, 6, 10, 0.5);
+  ASSERT_TRUE(sparse.is_sparse());
+  const int N = 7;
+  Blob<Dtype> B(1, 1, 10, N);
+  Blob<Dtype> C(1, 1, 6, N);
+  Blob<Dtype> C_expected(1, 1, 6, N);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(&B);
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, 6, N, 10, 1.,
+      this->weights_.cpu_data(), B.cpu_data(), 0.,
+      C_expected.mutable_cpu_data());
+  // Two row ranges, as for a convolution with two groups.
+  caffe_cpu_csrmm(sparse, 0, 3, N, B.cpu_data(), C.mutable_cpu_data());
+  caffe_cpu_csrmm(sparse, 3, 6, N, B.cpu_data(),
+      C.mutable_cpu_data() + 3 * N);
+  for (int i = 0; i < C.count(); ++i) {
+    EXPECT_NEAR(C_expected.cpu_data()[i], C.cpu_data()[i], 1e-5);
+  }
+}
+
+TYPED_TEST(SparseWeightMatrixTest, TestGemmCsrT) {
+  typedef TypeParam Dtype;
+  this->FillSparse(3);
+  SparseWeightMatrix<Dtype> sparse;
+  sparse.Convert(this->weights_, false, 6, 10, 0.5);
+  ASSERT_TRUE(sparse.is_sparse());
+  const int M = 4;
+  Blob<Dtype> A(1, 1, M, 10);
+  Blob<Dtype> C(1, 1, M, 6);
+  Blob<Dtype> C_expected(1, 1, M, 6);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(&A);
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, M, 6, 10, 1.,
+      A.cpu_data(), this->weights_.cpu_data(), 0.,
+      C_expected.mutable_cpu_data());
+  caffe_cpu_gemm_csr_t(M, A.cpu_data(), sparse, C.mutable_cpu_data());
+  for (int i = 0; i < C.count(); ++i) {
+    EXPECT_NEAR(C_expected.cpu_data()[i], C.cpu_data()[i], 1e-5);
+  }
+}
+
+}  // namespace caffe
@@ -130,5 +130,61 @@ TYPED_TEST(SPPLayerTest, TestGradient) {
       this->blob_top_vec_);
 }
 
+TYPED_TEST(SPPLayerTest, TestFusedMatchesLayers) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_3_);
+  const SPPParameter_PoolMethod pools[] = {SPPParameter_PoolMethod_MAX,
+      SPPParameter_PoolMethod_AVE};
+  const int heights[] = {1, 3};
+  for (int p = 0; p < 2; ++p) {
+    for (int k = 0; k < 2; ++k) {
+      for (int b = 0; b < 2; ++b) {
+        vector<Blob<Dtype>*>& bottom_vec =
+            b ? this->blob_bottom_vec_3_ : this->blob_bottom_vec_;
+        LayerParameter layer_param;
+        layer_param.mutable_spp_param()->set_pyramid_height(heights[k]);
+        layer_param.mutable_spp_param()->set_pool(pools[p]);
+        layer_param.mutable_spp_param()->set_engine(
+            SPPParameter_Engine_CAFFE);
+        SPPLayer<Dtype> layers(layer_param);
+        layers.SetUp(bottom_vec, this->blob_top_vec_);
+        layers.Forward(bottom_vec, this->blob_top_vec_);
+        caffe_rng_gaussian(this->blob_top_->count(), Dtype(0), Dtype(1),
+            this->blob_top_->mutable_cpu_diff());
+        vector<bool> propagate_down(1, true);
+        layers.Backward(this->blob_top_vec_, propagate_down, bottom_vec);
+        Blob<Dtype> expected_top, expected_bottom;
+        expected_top.CopyFrom(*this->blob_top_, false, true);
+        expected_top.CopyFrom(*this->blob_top_, true);
+        expected_bottom.CopyFrom(*bottom_vec[0], true, true);
+        layer_param.mutable_spp_param()->set_engine(
+            SPPParameter_Engine_FUSED);
+        SPPLayer<Dtype> fused(layer_param);
+        Blob<Dtype> top;
+        vector<Blob<Dtype>*> top_vec(1, &top);
+        fused.SetUp(bottom_vec, top_vec);
+        ASSERT_TRUE(top.shape() == expected_top.shape());
+        fused.Forward(bottom_vec, top_vec);
+        caffe_copy(top.count(), expected_top.cpu_diff(),
+            top.mutable_cpu_diff());
+        fused.Backward(top_vec, propagate_down, bottom_vec);
+        for (int i = 0; i < top.count(); ++i) {
+          EXPECT_NEAR(expected_top.cpu_data()[i], top.cpu_data()[i], 1e-6)
+              << "p = " << p << "; k = " << k << "; b = " << b;
+        }
+        for (int i = 0; i < expected_bottom.count(); ++i) {
+          EXPECT_NEAR(expected_bottom.cpu_diff()[i],
+              bottom_vec[0]->cpu_diff()[i], 1e-5)
+              << "p = " << p << "; k = " << k << "; b = " << b;
+        }
+      }
+    }
+  }
+}
 
 }  // namespace caffe
@@ -67,6 +67,25 @@ TEST_F(SyncedMemoryTest, TestCPUWrite) {
   }
 }
 
+TEST_F(SyncedMemoryTest, TestRelease) {
+  SyncedMemory mem(10);
+  caffe_memset(mem.size(), 1, mem.mutable_cpu_data());
+  const int version = mem.version();
+  mem.Release();
+  EXPECT_EQ(mem.head(), SyncedMemory::UNINITIALIZED);
+  EXPECT_GT(mem.version(), version);
+  const char* cpu_data = static_cast<const char*>(mem.cpu_data());
+  for (int i = 0; i < mem.size(); ++i) {
+    EXPECT_EQ(cpu_data[i], 0);
+  }
+  // Memory that is not owned stays.
+  char data[10];
+  mem.set_cpu_data(data);
+  mem.Release();
+  EXPECT_EQ(mem.head(), SyncedMemory::HEAD_AT_CPU);
+  EXPECT_EQ(mem.cpu_data(), data);
+}
+
 #ifndef CPU_ONLY  // GPU test
 
 TEST_F(SyncedMemoryTest, TestGPURead) {
@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/top_k.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class TopKTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    Caffe::set_random_seed(1701);
+  }
+
+  // Checks caffe_cpu_top_k against std::partial_sort of (value, index) pairs
+  // for every k in ks.
+  void CheckTopK(const vector<Dtype>& x, const int stride,
+      const vector<int>& ks) {
+    const int n = (x.size() + stride - 1) / stride;
+    vector<std::pair<Dtype, int> > pairs(n);
+    for (int i = 0; i < n; ++i) {
+      pairs[i] = std::make_pair(x[i * stride], i);
+    }
+    std::sort(pairs.begin(), pairs.end(),
+        std::greater<std::pair<Dtype, int> >());
+    for (int t = 0; t < ks.size(); ++t) {
+      const int k = ks[t];
+      vector<int> indices(k);
+      vector<Dtype> values(k);
+      caffe_cpu_top_k(n, &x[0], stride, k, &indices[0], &values[0]);
+      for (int j = 0; j < k; ++j) {
+        EXPECT_EQ(pairs[j].second, indices[j]) << "k = " << k << ", j = " << j;
+        EXPECT_EQ(pairs[j].first, values[j]) << "k = " << k << ", j = " << j;
+      }
+    }
+  }
+};
+
+TYPED_TEST_CASE(TopKTest, TestDtypes);
+
+TYPED_TEST(TopKTest, TestRandom) {
+  vector<TypeParam> x(1001);
+  caffe_rng_gaussian<TypeParam>(x.size(), 0, 1, &x[0]);
+  vector<int> ks;
+  ks.push_back(1);
+  ks.push_back(2);
+  ks.push_back(5);
+  ks.push_back(17);
+  ks.push_back(1001);
+  this->CheckTopK(x, 1, ks);
+}
+
+TYPED_TEST(TopKTest, TestAscending) {
+  // Every value is a new maximum, so the heap is updated at each step.
+  vector<TypeParam> x(300);
+  for (int i = 0; i < x.size(); ++i) {
+    x[i] = i;
+  }
+  vector<int> ks(1, 1);
+  ks.push_back(10);
+  this->CheckTopK(x, 1, ks);
+}
+
+TYPED_TEST(TopKTest, TestTies) {
+  vector<TypeParam> x(200);
+  for (int i = 0; i < x.size(); ++i) {
+    x[i] = i % 7;
+  }
+  vector<int> ks(1, 1);
+  ks.push_back(3);
+  ks.push_back(40);
+  this->CheckTopK(x, 1, ks);
+}
+
+TYPED_TEST(TopKTest, TestStrided) {
+  vector<TypeParam> x(3 * 97);
+  caffe_rng_uniform<TypeParam>(x.size(), -1, 1, &x[0]);
+  vector<int> ks(1, 1);
+  ks.push_back(4);
+  this->CheckTopK(x, 3, ks);
+}
+
+}  // namespace caffe
@@ -0,0 +1,326 @@
+#include <boost/math/special_functions/log1p.hpp>
+#include <boost/math/special_functions/next.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/vector_math.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+// The reference results are computed in a wider type.
+template <typename Dtype> struct WiderType { typedef double type; };
+template <> struct WiderType<double> { typedef long double type; };
+
+template <typename T> T RefExp(T x) { return std::exp(x); }
+template <typename T> T RefLog(T x) { return std::log(x); }
+template <typename T> T RefTanh(T x) { return std::tanh(x); }
+template <typename T> T RefSigmoid(T x) {
+  return x < 0 ? std::exp(x) / (1 + std::exp(x)) : 1 / (1 + std::exp(-x));
+}
+template <typename T> T RefSoftplus(T x) {
+  return x > 0 ? x + boost::math::log1p(std::exp(-x)) :
+      boost::math::log1p(std::exp(x));
+}
+
+template <typename Dtype>
+class VectorMathTest : public ::testing::Test {
+ protected:
+  typedef typename WiderType<Dtype>::type Ref;
+
+  VectorMathTest() : num_(100003) {}
+
+  virtual void SetUp() {
+    Caffe::set_random_seed(1701);
+  }
+
+  // Uniform on [a, b].
+  vector<Dtype> Uniform(const Dtype a, const Dtype b) {
+    vector<Dtype> x(num_);
+    caffe_rng_uniform(num_, a, b, &x[0]);
+    return x;
+  }
+
+  // Log-uniform on [a, b] for 0 < a < b.
+  vector<Dtype> LogUniform(const Dtype a, const Dtype b) {
+    vector<Dtype> x = Uniform(std::log(a), std::log(b));
+    for (int i = 0; i < num_; ++i) {
+      x[i] = std::exp(x[i]);
+    }
+    return x;
+  }
+
+  // The error of y in units in the last place of the correctly rounded
+  // result; 0 for matching infinities or NaNs.
+  double UlpError(const Dtype y, const Ref ref) {
+    if (ref != ref) {
+      return y != y ? 0 : std::numeric_limits<double>::infinity();
+    }
+    const Dtype rounded = static_cast<Dtype>(ref);
+    if (y == rounded) {
+      return 0;
+    }
+    const Dtype magnitude = std::fabs(rounded);
+    if (y != y || magnitude == std::numeric_limits<Dtype>::infinity()) {
+      return std::numeric_limits<double>::infinity();
+    }
+    const Dtype ulp = magnitude == std::numeric_limits<Dtype>::max() ?
+        magnitude - boost::math::float_prior(magnitude) :
+        boost::math::float_next(magnitude) - magnitude;
+    return static_cast<double>(std::fabs(y - ref) / ulp);
+  }
+
+  void ExpectUlp(const string& name, void (*func)(int, const Dtype*, Dtype*),
+      Ref (*ref)(Ref), const vector<Dtype>& x, const double max_ulp) {
+    vector<Dtype> y(x.size());
+    func(x.size(), &x[0], &y[0]);
+    double worst = 0;
+    Dtype worst_x = 0;
+    for (int i = 0; i < x.size(); ++i) {
+      const double error = UlpError(y[i], ref(x[i]));
+      if (error > worst) {
+        worst = error;
+        worst_x = x[i];
+      }
+    }
+    EXPECT_LE(worst, max_ulp) << name << "(" << worst_x << ")";
+  }
+
+  const int num_;
+};
+
+TYPED_TEST_CASE(VectorMathTest, TestDtypes);
+
+TYPED_TEST(VectorMathTest, TestExpAccuracy) {
+  typedef typename TestFixture::Ref Ref;
+  this->ExpectUlp("exp", caffe_cpu_vexp<TypeParam>, RefExp<Ref>,
+      this->Uniform(-10, 10), 2);
+  // Including overflow to inf and denormal results, handled by the C library.
+  this->ExpectUlp("exp", caffe_cpu_vexp<TypeParam>, RefExp<Ref>,
+      this->Uniform(-760, 760), 2);
+}
+
+TYPED_TEST(VectorMathTest, TestExpSum) {
+  const vector<TypeParam> x = this->Uniform(-10, 10);
+  const TypeParam shift = 3;
+  // An odd length covers the padded tail block.
+  const int n = x.size() - 1;
+  vector<TypeParam> y(n);
+  const TypeParam sum = caffe_cpu_vexp_sum<TypeParam>(n, &x[0], shift, &y[0]);
+  double expected = 0;
+  for (int i = 0; i < n; ++i) {
+    const TypeParam shifted = x[i] - shift;
+    const double e = std::exp(static_cast<double>(shifted));
+    EXPECT_NEAR(e, y[i], 4 * e * std::numeric_limits<TypeParam>::epsilon());
+    expected += e;
+  }
+  EXPECT_NEAR(expected, sum, 1e-5 * expected);
+  EXPECT_EQ(sum, caffe_cpu_vexp_sum<TypeParam>(n, &x[0], shift,
+      static_cast<TypeParam*>(NULL)));
+}
+
+TYPED_TEST(VectorMathTest, TestLogSumExp) {
+  // 300 positions of 7 channels, one tile and a partial one, with large
+  // values that exp alone would overflow, and a single position.
+  const int channels = 7;
+  const int n = 300;
+  vector<TypeParam> x = this->Uniform(-80, 80);
+  vector<TypeParam> y(n + 1);
+  caffe_cpu_log_sum_exp<TypeParam>(channels, n, n, &x[0], &y[0]);
+  caffe_cpu_log_sum_exp<TypeParam>(channels, 1, 1, &x[0], &y[n]);
+  for (int i = 0; i <= n; ++i) {
+    const int stride = i < n ? n : 1;
+    const int offset = i < n ? i : 0;
+    double max_val = x[offset];
+    for (int c = 1; c < channels; ++c) {
+      max_val = std::max<double>(max_val, x[offset + c * stride]);
+    }
+    double sum = 0;
+    for (int c = 0; c < channels; ++c) {
+      sum += std::exp(x[offset + c * stride] - max_val);
+    }
+    const double expected = max_val + std::log(sum);
+    EXPECT_NEAR(expected, y[i],
+        8 * (std::fabs(expected) + 1) *
+        std::numeric_limits<TypeParam>::epsilon());
+  }
+}
+
+TYPED_TEST(VectorMathTest, TestLogAccuracy) {
+  typedef typename TestFixture::Ref Ref;
+  this->ExpectUlp("log", caffe_cpu_vlog<TypeParam>, RefLog<Ref>,
+      this->Uniform(0.5, 2), 2);
+  this->ExpectUlp("log", caffe_cpu_vlog<TypeParam>, RefLog<Ref>,
+      this->LogUniform(1e-30, 1e30), 2);
+}
+
+TYPED_TEST(VectorMathTest, TestPowxAccuracy) {
+  const vector<TypeParam> x = this->LogUniform(1e-6, 1e6);
+  const TypeParam exponents[] = {0.75, -2.5, 1.37, 0.5, 2, -1, 1, 0};
+  vector<TypeParam> y(x.size());
+  for (int e = 0; e < sizeof(exponents) / sizeof(exponents[0]); ++e) {
+    const TypeParam b = exponents[e];
+    caffe_cpu_vpowx<TypeParam>(x.size(), &x[0], b, &y[0]);
+    double worst = 0;
+    for (int i = 0; i < x.size(); ++i) {
+      worst = std::max(worst, this->UlpError(y[i],
+          std::pow(typename TestFixture::Ref(x[i]),
+              typename TestFixture::Ref(b))));
+    }
+    EXPECT_LE(worst, 2) << "powx(x, " << b << ")";
+  }
+}
+
+TYPED_TEST(VectorMathTest, TestTanhAccuracy) {
+  typedef typename TestFixture::Ref Ref;
+  this->ExpectUlp("tanh", caffe_cpu_vtanh<TypeParam>, RefTanh<Ref>,
+      this->Uniform(-1, 1), 3);
+  this->ExpectUlp("tanh", caffe_cpu_vtanh<TypeParam>, RefTanh<Ref>,
+      this->Uniform(-30, 30), 3);
+}
+
+TYPED_TEST(VectorMathTest, TestSigmoidAccuracy) {
+  typedef typename TestFixture::Ref Ref;
+  this->ExpectUlp("sigmoid", caffe_cpu_vsigmoid<TypeParam>,
+      RefSigmoid<Ref>, this->Uniform(-8, 8), 3);
+  this->ExpectUlp("sigmoid", caffe_cpu_vsigmoid<TypeParam>,
+      RefSigmoid<Ref>, this->Uniform(-760, 760), 3);
+}
+
+TYPED_TEST(VectorMathTest, TestSoftplusAccuracy) {
+  typedef typename TestFixture::Ref Ref;
+  this->ExpectUlp("softplus", caffe_cpu_vsoftplus<TypeParam>,
+      RefSoftplus<Ref>, this->Uniform(-8, 8), 4);
+  this->ExpectUlp("softplus", caffe_cpu_vsoftplus<TypeParam>,
+      RefSoftplus<Ref>, this->Uniform(-760, 760), 4);
+}
+
+TYPED_TEST(VectorMathTest, TestSwish) {
+  typedef typename TestFixture::Ref Ref;
+  // Not as far as denormal sigmoids, whose rounding x would magnify.
+  const vector<TypeParam> x = this->Uniform(-50, 50);
+  const TypeParam beta = 1.5;
+  vector<TypeParam> y(x.size());
+  vector<TypeParam> sigmoid(x.size());
+  caffe_cpu_vswish<TypeParam>(x.size(), &x[0], beta, &y[0], &sigmoid[0]);
+  double worst_y = 0;
+  double worst_sigmoid = 0;
+  for (int i = 0; i < x.size(); ++i) {
+    const Ref ref = RefSigmoid(Ref(beta * x[i]));
+    worst_sigmoid = std::max(worst_sigmoid, this->UlpError(sigmoid[i], ref));
+    worst_y = std::max(worst_y, this->UlpError(y[i], Ref(x[i]) * ref));
+  }
+  EXPECT_LE(worst_sigmoid, 3);
+  EXPECT_LE(worst_y, 4);
+}
+
+TYPED_TEST(VectorMathTest, TestELU) {
+  const vector<TypeParam> x = this->Uniform(-100, 10);
+  const TypeParam alpha = 0.7;
+  vector<TypeParam> y(x.size());
+  caffe_cpu_velu<TypeParam>(x.size(), &x[0], alpha, &y[0]);
+  for (int i = 0; i < x.size(); ++i) {
+    const TypeParam expected = x[i] > 0 ? x[i] : alpha * (std::exp(x[i]) - 1);
+    EXPECT_NEAR(expected, y[i], 4 * std::numeric_limits<TypeParam>::epsilon())
+        << "x = " << x[i];
+  }
+}
+
+TYPED_TEST(VectorMathTest, TestSpecialValues) {
+  const TypeParam inf = std::numeric_limits<TypeParam>::infinity();
+  const TypeParam nan = std::numeric_limits<TypeParam>::quiet_NaN();
+  const TypeParam x[] = {nan, inf, -inf, 0};
+  TypeParam y[4];
+  caffe_cpu_vexp<TypeParam>(4, x, y);
+  EXPECT_NE(y[0], y[0]);
+  EXPECT_EQ(inf, y[1]);
+  EXPECT_EQ(0, y[2]);
+  EXPECT_EQ(1, y[3]);
+  caffe_cpu_vlog<TypeParam>(4, x, y);
+  EXPECT_NE(y[0], y[0]);
+  EXPECT_EQ(inf, y[1]);
+  EXPECT_NE(y[2], y[2]);
+  EXPECT_EQ(-inf, y[3]);
+  caffe_cpu_vtanh<TypeParam>(4, x, y);
+  EXPECT_NE(y[0], y[0]);
+  EXPECT_EQ(1, y[1]);
+  EXPECT_EQ(-1, y[2]);
+  EXPECT_EQ(0, y[3]);
+  caffe_cpu_vsigmoid<TypeParam>(4, x, y);
+  EXPECT_NE(y[0], y[0]);
+  EXPECT_EQ(1, y[1]);
+  EXPECT_EQ(0, y[2]);
+  EXPECT_EQ(0.5, y[3]);
+  caffe_cpu_vsoftplus<TypeParam>(4, x, y);
+  EXPECT_NE(y[0], y[0]);
+  EXPECT_EQ(inf, y[1]);
+  EXPECT_EQ(0, y[2]);
+  EXPECT_NEAR(std::log(2.), y[3], 1e-6);
+  caffe_cpu_velu<TypeParam>(4, x, TypeParam(1), y);
+  EXPECT_NE(y[0], y[0]);
+  EXPECT_EQ(inf, y[1]);
+  EXPECT_EQ(-1, y[2]);
+  EXPECT_EQ(0, y[3]);
+}
+
+TYPED_TEST(VectorMathTest, TestInPlace) {
+  // An odd length to also go through the padded last block.
+  const int n = 37;
+  const vector<TypeParam> x = this->Uniform(-5, 5);
+  vector<TypeParam> out_of_place(n);
+  vector<TypeParam> in_place(x.begin(), x.begin() + n);
+  caffe_cpu_vtanh<TypeParam>(n, &x[0], &out_of_place[0]);
+  caffe_cpu_vtanh<TypeParam>(n, &in_place[0], &in_place[0]);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_EQ(out_of_place[i], in_place[i]);
+  }
+}
+
+// Reports the speedup over the scalar loops of the C library the layers used
+// before; the results must agree but the timings are informational only.
+TYPED_TEST(VectorMathTest, TestThroughput) {
+  const int n = 1 << 20;
+  vector<TypeParam> x(n);
+  caffe_rng_uniform<TypeParam>(n, -10, 10, &x[0]);
+  vector<TypeParam> vector_y(n);
+  vector<TypeParam> scalar_y(n);
+  CPUTimer timer;
+  timer.Start();
+  caffe_cpu_vexp<TypeParam>(n, &x[0], &vector_y[0]);
+  const float vector_exp = timer.MilliSeconds();
+  timer.Start();
+  for (int i = 0; i < n; ++i) {
+    scalar_y[i] = std::exp(x[i]);
+  }
+  const float scalar_exp = timer.MilliSeconds();
+  for (int i = 0; i < n; ++i) {
+    EXPECT_NEAR(scalar_y[i], vector_y[i], 1e-5 * scalar_y[i]);
+  }
+  timer.Start();
+  caffe_cpu_vtanh<TypeParam>(n, &x[0], &vector_y[0]);
+  const float vector_tanh = timer.MilliSeconds();
+  timer.Start();
+  for (int i = 0; i < n; ++i) {
+    scalar_y[i] = std::tanh(x[i]);
+  }
+  const float scalar_tanh = timer.MilliSeconds();
+  for (int i = 0; i < n; ++i) {
+    EXPECT_NEAR(scalar_y[i], vector_y[i], 1e-6);
+  }
+  LOG(INFO) << "exp of " << n << " values: " << vector_exp << " ms vectorized, "
+            << scalar_exp << " ms scalar";
+  LOG(INFO) << "tanh of " << n << " values: " << vector_tanh
+            << " ms vectorized, " << scalar_tanh << " ms scalar";
+}
+
+}  // namespace caffe
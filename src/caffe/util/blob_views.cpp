@@ -0,0 +1,133 @@
+#include <set>
+#include <string>
+
+#include "caffe/common.hpp"
+#include "caffe/util/blob_views.hpp"
+
+namespace caffe {
+
+static bool HasBlob(const google::protobuf::RepeatedPtrField<string>& blobs,
+    const string& blob_name) {
+  for (int i = 0; i < blobs.size(); ++i) {
+    if (blobs.Get(i) == blob_name) { return true; }
+  }
+  return false;
+}
+
+// Returns whether layer_param computes all of its tops in Forward into their
+// own memory (also in place), so that they can be views of a Concat top.
+static bool WritesOwnTops(const LayerParameter& layer_param) {
+  static const char* const kTypes[] = {
+    "AbsVal", "BatchNorm", "Bias", "BNLL", "Convolution", "Deconvolution",
+    "Dropout", "ELU", "Eltwise", "Exp", "InnerProduct", "Log", "LRN",
+    "Pooling", "Power", "PReLU", "ReLU", "Scale", "Sigmoid", "Softmax",
+    "Swish", "TanH"
+  };
+  // The net sets the diff of tops with a loss weight once, at setup.
+  if (layer_param.loss_weight_size() > 0) { return false; }
+  for (int i = 0; i < sizeof(kTypes) / sizeof(kTypes[0]); ++i) {
+    if (layer_param.type() == kTypes[i]) { return true; }
+  }
+  return layer_param.type() == "Concat" && layer_param.bottom_size() > 1;
+}
+
+// Returns whether the tops of layer_param may share memory with its bottoms.
+static bool SharesMemory(const LayerParameter& layer_param) {
+  return layer_param.type() == "Split" || layer_param.type() == "Flatten" ||
+      layer_param.type() == "Reshape" || layer_param.type() == "Concat" ||
+      layer_param.type() == "Slice" || layer_param.type() == "Crop";
+}
+
+// Returns whether a layer other than layer_id writes blob_name, or a blob
+// that later layers make share memory with it.
+static bool IsWrittenElsewhere(const NetParameter& param, const int layer_id,
+    const string& blob_name) {
+  for (int i = 0; i < param.layer_size(); ++i) {
+    if (i == layer_id) { continue; }
+    const LayerParameter& layer_param = param.layer(i);
+    if (HasBlob(layer_param.top(), blob_name)) { return true; }
+    if (i > layer_id && SharesMemory(layer_param) &&
+        HasBlob(layer_param.bottom(), blob_name)) {
+      for (int j = 0; j < layer_param.top_size(); ++j) {
+        if (IsWrittenElsewhere(param, i, layer_param.top(j))) { return true; }
+      }
+    }
+  }
+  return false;
+}
+
+// The bottoms of a Concat layer can be views of its top if each is only
+// written, before the Concat layer, by layers writing their own tops, and is
+// not used otherwise; and if nothing writes the top afterwards, which would
+// change the bottoms behind the back of their producers.
+static bool CanShareBottoms(const NetParameter& param, const int layer_id) {
+  const LayerParameter& concat_param = param.layer(layer_id);
+  if (concat_param.bottom_size() < 2 || concat_param.top_size() != 1 ||
+      concat_param.loss_weight_size() > 0) {
+    return false;
+  }
+  set<string> bottoms;
+  for (int j = 0; j < concat_param.bottom_size(); ++j) {
+    const string& blob_name = concat_param.bottom(j);
+    if (blob_name == concat_param.top(0) || !bottoms.insert(blob_name).second) {
+      return false;
+    }
+    bool has_producer = false;
+    for (int i = 0; i < param.layer_size(); ++i) {
+      if (i == layer_id) { continue; }
+      const LayerParameter& layer_param = param.layer(i);
+      const bool is_top = HasBlob(layer_param.top(), blob_name);
+      if (!is_top && !HasBlob(layer_param.bottom(), blob_name)) { continue; }
+      if (!is_top || i > layer_id || !WritesOwnTops(layer_param)) {
+        return false;
+      }
+      has_producer = true;
+    }
+    if (!has_producer) { return false; }
+  }
+  return !IsWrittenElsewhere(param, layer_id, concat_param.top(0));
+}
+
+// The tops of a layer can be views of its bottom bottom_id if nothing writes
+// the tops or, afterwards, the bottom.
+static bool CanShareTops(const NetParameter& param, const int layer_id,
+    const int bottom_id) {
+  const LayerParameter& layer_param = param.layer(layer_id);
+  const string& bottom_name = layer_param.bottom(bottom_id);
+  if (layer_param.loss_weight_size() > 0) { return false; }
+  set<string> tops;
+  for (int j = 0; j < layer_param.top_size(); ++j) {
+    const string& blob_name = layer_param.top(j);
+    if (HasBlob(layer_param.bottom(), blob_name) ||
+        !tops.insert(blob_name).second ||
+        IsWrittenElsewhere(param, layer_id, blob_name)) {
+      return false;
+    }
+  }
+  for (int i = layer_id + 1; i < param.layer_size(); ++i) {
+    if (HasBlob(param.layer(i).top(), bottom_name)) { return false; }
+  }
+  return true;
+}
+
+void PlanBlobViews(const NetParameter& param, NetParameter* param_planned) {
+  param_planned->CopyFrom(param);
+  for (int i = 0; i < param.layer_size(); ++i) {
+    const LayerParameter& layer_param = param.layer(i);
+    if (layer_param.type() == "Concat" && CanShareBottoms(param, i)) {
+      param_planned->mutable_layer(i)->mutable_concat_param()->
+          set_share_bottoms(true);
+    } else if (layer_param.type() == "Slice" &&
+        layer_param.bottom_size() == 1 && layer_param.top_size() > 1 &&
+        CanShareTops(param, i, 0)) {
+      param_planned->mutable_layer(i)->mutable_slice_param()->
+          set_share_tops(true);
+    } else if (layer_param.type() == "Crop" && layer_param.top_size() == 1 &&
+        CanShareTops(param, i, 0)) {
+      param_planned->mutable_layer(i)->mutable_crop_param()->
+          set_share_top(true);
+    }
+  }
+}
+
+}  // namespace caffe
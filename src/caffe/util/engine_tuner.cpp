@@ -0,0 +1,98 @@
+#include <boost/thread.hpp>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <fstream>  // NOLINT(readability/streams)
+#include <map>
+#include <sstream>
+#include <string>
+
+#include "caffe/util/engine_tuner.hpp"
+
+namespace caffe {
+
+// The database is shared by every thread (and so every solver) of the
+// process, unlike the thread-local Caffe context.
+static boost::mutex tuner_mutex;
+static string tuner_path;
+static std::map<string, string> tuner_entries;
+
+// The processor model from /proc/cpuinfo, or "unknown CPU" where that is not
+// available.
+static string cpu_model() {
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  string line;
+  while (std::getline(cpuinfo, line)) {
+    if (line.compare(0, 10, "model name") == 0) {
+      const size_t colon = line.find(':');
+      if (colon != string::npos && colon + 2 <= line.size()) {
+        return line.substr(colon + 2);
+      }
+    }
+  }
+  return "unknown CPU";
+}
+
+void EngineTuner::Open(const string& path) {
+  boost::mutex::scoped_lock lock(tuner_mutex);
+  tuner_path = path;
+  tuner_entries.clear();
+  if (path.empty()) {
+    return;
+  }
+  std::ifstream file(path.c_str());
+  string line;
+  int num_entries = 0;
+  while (std::getline(file, line)) {
+    const size_t first = line.find('\t');
+    const size_t last = line.rfind('\t');
+    if (first == string::npos || first == last) {
+      LOG(WARNING) << "Skipping malformed line in tuning database " << path
+          << ": " << line;
+      continue;
+    }
+    // Entries of other machines are kept too, and simply never match.
+    tuner_entries[line.substr(0, last)] = line.substr(last + 1);
+    ++num_entries;
+  }
+  LOG(INFO) << "Tuning CPU engines with " << path << " (" << num_entries
+      << " entries)";
+}
+
+bool EngineTuner::enabled() {
+  boost::mutex::scoped_lock lock(tuner_mutex);
+  return !tuner_path.empty();
+}
+
+string EngineTuner::Lookup(const string& key) {
+  const string entry_key = machine() + '\t' + key;
+  boost::mutex::scoped_lock lock(tuner_mutex);
+  std::map<string, string>::const_iterator it =
+      tuner_entries.find(entry_key);
+  return it == tuner_entries.end() ? string() : it->second;
+}
+
+void EngineTuner::Record(const string& key, const string& engine) {
+  const string entry_key = machine() + '\t' + key;
+  boost::mutex::scoped_lock lock(tuner_mutex);
+  CHECK(!tuner_path.empty()) << "Engine tuning is not enabled.";
+  tuner_entries[entry_key] = engine;
+  std::ofstream file(tuner_path.c_str(), std::ios::app);
+  file << entry_key << '\t' << engine << '\n';
+  if (!file) {
+    LOG(WARNING) << "Cannot write to tuning database " << tuner_path;
+  }
+}
+
+string EngineTuner::machine() {
+  static const string model = cpu_model();
+  std::ostringstream machine;
+  machine << model;
+#ifdef _OPENMP
+  machine << ", " << omp_get_max_threads() << " threads";
+#endif
+  return machine.str();
+}
+
+}  // namespace caffe
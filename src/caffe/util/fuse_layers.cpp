@@ -0,0 +1,61 @@
+#include <string>
+
+#include "caffe/common.hpp"
+#include "caffe/util/fuse_layers.hpp"
+
+namespace caffe {
+
+// Returns whether layer_param is a ReLU or Sigmoid layer computing in place on
+// blob_name that InnerProductParameter::Activation can stand in for.
+static bool IsFusableActivation(const LayerParameter& layer_param,
+    const string& blob_name, InnerProductParameter_Activation* activation) {
+  if (layer_param.bottom_size() != 1 || layer_param.top_size() != 1 ||
+      layer_param.bottom(0) != blob_name || layer_param.top(0) != blob_name ||
+      layer_param.loss_weight_size() > 0) {
+    return false;
+  }
+  if (layer_param.type() == "ReLU" &&
+      layer_param.relu_param().negative_slope() == 0) {
+    *activation = InnerProductParameter_Activation_RELU;
+    return true;
+  }
+  if (layer_param.type() == "Sigmoid") {
+    *activation = InnerProductParameter_Activation_SIGMOID;
+    return true;
+  }
+  return false;
+}
+
+void FuseLayers(const NetParameter& param, NetParameter* param_fused) {
+  param_fused->CopyFrom(param);
+  param_fused->clear_layer();
+  for (int i = 0; i < param.layer_size(); ++i) {
+    LayerParameter* layer_param = param_fused->add_layer();
+    layer_param->CopyFrom(param.layer(i));
+    InnerProductParameter_Activation activation;
+    if (layer_param->type() == "InnerProduct" &&
+        layer_param->top_size() == 1 &&
+        layer_param->inner_product_param().activation() ==
+        InnerProductParameter_Activation_NONE &&
+        i + 1 < param.layer_size() &&
+        IsFusableActivation(param.layer(i + 1), layer_param->top(0),
+            &activation)) {
+      LOG_IF(INFO, Caffe::root_solver()) << "Fusing "
+          << param.layer(i + 1).name() << " into " << layer_param->name();
+      layer_param->mutable_inner_product_param()->set_activation(activation);
+      ++i;
+    } else if (layer_param->type() == "Eltwise" &&
+        !layer_param->eltwise_param().relu() &&
+        i + 1 < param.layer_size() &&
+        IsFusableActivation(param.layer(i + 1), layer_param->top(0),
+            &activation) &&
+        activation == InnerProductParameter_Activation_RELU) {
+      LOG_IF(INFO, Caffe::root_solver()) << "Fusing "
+          << param.layer(i + 1).name() << " into " << layer_param->name();
+      layer_param->mutable_eltwise_param()->set_relu(true);
+      ++i;
+    }
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,315 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/util/gemm.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+// Register block of the micro-kernel and depth of a packed panel. A packed
+// left-hand operand is stored as kGemmMR-row panels, a right-hand operand as
+// kGemmNR-column panels, both split into kGemmKC-deep blocks so that one
+// panel pair stays in L1 while the micro-kernel runs.
+const int kGemmMR = 4;
+const int kGemmNR = 8;
+const int kGemmKC = 256;
+
+inline int round_up(const int x, const int multiple) {
+  return (x + multiple - 1) / multiple * multiple;
+}
+
+// Packs rows [0, M) x depth [pc, pc + kc) of op(A) into kGemmMR-row panels:
+// dst[ir * kc + k * kGemmMR + i] = op(A)(ir + i, pc + k), zero-padded.
+template <typename Dtype>
+void pack_a_block(const CBLAS_TRANSPOSE TransA, const Dtype* A, const int M,
+    const int K, const int pc, const int kc, Dtype* dst) {
+  for (int ir = 0; ir < M; ir += kGemmMR) {
+    const int mr = std::min(kGemmMR, M - ir);
+    for (int k = 0; k < kc; ++k) {
+      for (int i = 0; i < mr; ++i) {
+        dst[k * kGemmMR + i] = (TransA == CblasNoTrans) ?
+            A[(ir + i) * K + pc + k] : A[(pc + k) * M + ir + i];
+      }
+      for (int i = mr; i < kGemmMR; ++i) {
+        dst[k * kGemmMR + i] = 0;
+      }
+    }
+    dst += kGemmMR * kc;
+  }
+}
+
+// Packs depth [pc, pc + kc) x columns [0, N) of op(B) into kGemmNR-column
+// panels: dst[jr * kc + k * kGemmNR + j] = op(B)(pc + k, jr + j).
+template <typename Dtype>
+void pack_b_block(const CBLAS_TRANSPOSE TransB, const Dtype* B, const int K,
+    const int N, const int pc, const int kc, Dtype* dst) {
+  for (int jr = 0; jr < N; jr += kGemmNR) {
+    const int nr = std::min(kGemmNR, N - jr);
+    for (int k = 0; k < kc; ++k) {
+      for (int j = 0; j < nr; ++j) {
+        dst[k * kGemmNR + j] = (TransB == CblasNoTrans) ?
+            B[(pc + k) * N + jr + j] : B[(jr + j) * K + pc + k];
+      }
+      for (int j = nr; j < kGemmNR; ++j) {
+        dst[k * kGemmNR + j] = 0;
+      }
+    }
+    dst += kGemmNR * kc;
+  }
+}
+
+// C[0:m, 0:n] = alpha * a_panel * b_panel + beta * C. The accumulation runs
+// over the full register block so the inner loops have constant trip counts
+// and vectorize; only the write-back is clipped to the valid m x n corner.
+template <typename Dtype>
+inline void gemm_micro_kernel(const int kc, const Dtype* a, const Dtype* b,
+    const Dtype alpha, const Dtype beta, Dtype* C, const int ldc,
+    const int m, const int n) {
+  Dtype acc[kGemmMR][kGemmNR];
+  for (int i = 0; i < kGemmMR; ++i) {
+    for (int j = 0; j < kGemmNR; ++j) {
+      acc[i][j] = 0;
+    }
+  }
+  for (int k = 0; k < kc; ++k) {
+    for (int i = 0; i < kGemmMR; ++i) {
+      const Dtype a_ik = a[i];
+      for (int j = 0; j < kGemmNR; ++j) {
+        acc[i][j] += a_ik * b[j];
+      }
+    }
+    a += kGemmMR;
+    b += kGemmNR;
+  }
+  for (int i = 0; i < m; ++i) {
+    Dtype* c_row = C + i * ldc;
+    if (beta == 0) {
+      for (int j = 0; j < n; ++j) {
+        c_row[j] = alpha * acc[i][j];
+      }
+    } else {
+      for (int j = 0; j < n; ++j) {
+        c_row[j] = alpha * acc[i][j] + beta * c_row[j];
+      }
+    }
+  }
+}
+
+// Shared driver: either operand is read from its prepacked panels when
+// packed_A / packed_B is given, and packed one depth block at a time
+// otherwise.
+template <typename Dtype>
+void blocked_gemm(const CBLAS_TRANSPOSE TransA, const CBLAS_TRANSPOSE TransB,
+    const int M, const int N, const int K, const Dtype alpha,
+    const Dtype* A, const Dtype* packed_A, const Dtype* B,
+    const Dtype* packed_B, const Dtype beta, Dtype* C) {
+  if (M == 0 || N == 0) {
+    return;
+  }
+  if (K == 0 || alpha == 0) {
+    if (beta == 0) {
+      caffe_set(M * N, Dtype(0), C);
+    } else if (beta != 1) {
+      caffe_scal(M * N, beta, C);
+    }
+    return;
+  }
+  const int M_padded = round_up(M, kGemmMR);
+  const int N_padded = round_up(N, kGemmNR);
+  const int kc_max = std::min(K, kGemmKC);
+  vector<Dtype> a_buffer(packed_A ? 0 : M_padded * kc_max);
+  vector<Dtype> b_buffer(packed_B ? 0 : N_padded * kc_max);
+  const int m_panels = M_padded / kGemmMR;
+  const int n_panels = N_padded / kGemmNR;
+  for (int pc = 0; pc < K; pc += kGemmKC) {
+    const int kc = std::min(kGemmKC, K - pc);
+    const Dtype* a_block;
+    if (packed_A) {
+      a_block = packed_A + pc * M_padded;
+    } else {
+      pack_a_block(TransA, A, M, K, pc, kc, &a_buffer[0]);
+      a_block = &a_buffer[0];
+    }
+    const Dtype* b_block;
+    if (packed_B) {
+      b_block = packed_B + pc * N_padded;
+    } else {
+      pack_b_block(TransB, B, K, N, pc, kc, &b_buffer[0]);
+      b_block = &b_buffer[0];
+    }
+    // Only the first depth block applies beta; the rest accumulate.
+    const Dtype block_beta = (pc == 0) ? beta : Dtype(1);
+    // Each column panel owns a disjoint stripe of C.
+#ifdef _OPENMP
+    #pragma omp parallel for if (n_panels > 1 && \
+        static_cast<int64_t>(M) * N * kc > 65536)
+#endif
+    for (int jp = 0; jp < n_panels; ++jp) {
+      const int jr = jp * kGemmNR;
+      const int nr = std::min(kGemmNR, N - jr);
+      for (int ip = 0; ip < m_panels; ++ip) {
+        const int ir = ip * kGemmMR;
+        gemm_micro_kernel(kc, a_block + ir * kc, b_block + jr * kc, alpha,
+            block_beta, C + ir * N + jr, N, std::min(kGemmMR, M - ir), nr);
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void caffe_cpu_blocked_gemm(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const Dtype alpha, const Dtype* A, const Dtype* B, const Dtype beta,
+    Dtype* C) {
+  blocked_gemm<Dtype>(TransA, TransB, M, N, K, alpha, A, NULL, B, NULL, beta,
+      C);
+}
+
+template void caffe_cpu_blocked_gemm<float>(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const float alpha, const float* A, const float* B, const float beta,
+    float* C);
+template void caffe_cpu_blocked_gemm<double>(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const double alpha, const double* A, const double* B, const double beta,
+    double* C);
+
+template <typename Dtype>
+PackedGemmMatrix<Dtype>::PackedGemmMatrix()
+    : is_a_(false), rows_(0), cols_(0), trans_(CblasNoTrans), source_(NULL),
+      packed_(), source_memory_(NULL), source_offset_(0),
+      source_version_(-1) {}
+
+template <typename Dtype>
+void PackedGemmMatrix<Dtype>::Pack(const bool is_a,
+    const CBLAS_TRANSPOSE trans, const int rows, const int cols,
+    const Dtype* data) {
+  is_a_ = is_a;
+  rows_ = rows;
+  cols_ = cols;
+  trans_ = trans;
+  source_ = data;
+  source_memory_ = NULL;
+  source_version_ = -1;
+  packed_.clear();
+  if (Caffe::gemm_backend() != Caffe::BLOCKED) {
+    return;
+  }
+  // Pack every depth block in the layout blocked_gemm walks: block pc
+  // starts at pc * (padded rows of A or padded columns of B).
+  if (is_a) {
+    const int M_padded = round_up(rows, kGemmMR);
+    packed_.resize(M_padded * cols);
+    for (int pc = 0; pc < cols; pc += kGemmKC) {
+      pack_a_block(trans, data, rows, cols, pc,
+          std::min(kGemmKC, cols - pc), &packed_[pc * M_padded]);
+    }
+  } else {
+    const int N_padded = round_up(cols, kGemmNR);
+    packed_.resize(N_padded * rows);
+    for (int pc = 0; pc < rows; pc += kGemmKC) {
+      pack_b_block(trans, data, rows, cols, pc,
+          std::min(kGemmKC, rows - pc), &packed_[pc * N_padded]);
+    }
+  }
+}
+
+template <typename Dtype>
+void PackedGemmMatrix<Dtype>::PackA(const CBLAS_TRANSPOSE TransA, const int M,
+    const int K, const Dtype* A) {
+  Pack(true, TransA, M, K, A);
+}
+
+template <typename Dtype>
+void PackedGemmMatrix<Dtype>::PackA(const CBLAS_TRANSPOSE TransA, const int M,
+    const int K, const Blob<Dtype>& A, const int offset) {
+  CHECK_LE(offset + M * K, A.count());
+  Pack(true, TransA, M, K, A.cpu_data() + offset);
+  source_memory_ = A.data().get();
+  source_offset_ = offset;
+  source_version_ = A.data()->version();
+}
+
+template <typename Dtype>
+void PackedGemmMatrix<Dtype>::PackB(const CBLAS_TRANSPOSE TransB, const int K,
+    const int N, const Dtype* B) {
+  Pack(false, TransB, K, N, B);
+}
+
+template <typename Dtype>
+void PackedGemmMatrix<Dtype>::PackB(const CBLAS_TRANSPOSE TransB, const int K,
+    const int N, const Blob<Dtype>& B, const int offset) {
+  CHECK_LE(offset + K * N, B.count());
+  Pack(false, TransB, K, N, B.cpu_data() + offset);
+  source_memory_ = B.data().get();
+  source_offset_ = offset;
+  source_version_ = B.data()->version();
+}
+
+template <typename Dtype>
+void PackedGemmMatrix<Dtype>::Clear() {
+  rows_ = 0;
+  cols_ = 0;
+  source_ = NULL;
+  packed_.clear();
+  source_memory_ = NULL;
+  source_version_ = -1;
+}
+
+template <typename Dtype>
+bool PackedGemmMatrix<Dtype>::IsPackedFrom(const Blob<Dtype>& blob) const {
+  // A backend switch also calls for repacking into the new layout.
+  const bool want_blocked = (Caffe::gemm_backend() == Caffe::BLOCKED);
+  return !empty() && blocked() == want_blocked &&
+      source_memory_ == blob.data().get() &&
+      source_version_ == blob.data()->version() &&
+      source_offset_ + rows_ * cols_ <= blob.count();
+}
+
+INSTANTIATE_CLASS(PackedGemmMatrix);
+
+template <typename Dtype>
+void caffe_cpu_gemm_packed_a(const PackedGemmMatrix<Dtype>& A,
+    const CBLAS_TRANSPOSE TransB, const int N, const Dtype alpha,
+    const Dtype* B, const Dtype beta, Dtype* C) {
+  CHECK(A.is_a()) << "Operand was packed as a right-hand side.";
+  if (A.blocked()) {
+    blocked_gemm<Dtype>(A.trans(), TransB, A.rows(), N, A.cols(), alpha, NULL,
+        A.packed_data(), B, NULL, beta, C);
+  } else {
+    caffe_cpu_gemm<Dtype>(A.trans(), TransB, A.rows(), N, A.cols(), alpha,
+        A.source(), B, beta, C);
+  }
+}
+
+template void caffe_cpu_gemm_packed_a<float>(
+    const PackedGemmMatrix<float>& A, const CBLAS_TRANSPOSE TransB,
+    const int N, const float alpha, const float* B, const float beta,
+    float* C);
+template void caffe_cpu_gemm_packed_a<double>(
+    const PackedGemmMatrix<double>& A, const CBLAS_TRANSPOSE TransB,
+    const int N, const double alpha, const double* B, const double beta,
+    double* C);
+
+template <typename Dtype>
+void caffe_cpu_gemm_packed_b(const CBLAS_TRANSPOSE TransA, const int M,
+    const Dtype alpha, const Dtype* A, const PackedGemmMatrix<Dtype>& B,
+    const Dtype beta, Dtype* C) {
+  CHECK(!B.is_a()) << "Operand was packed as a left-hand side.";
+  if (B.blocked()) {
+    blocked_gemm<Dtype>(TransA, B.trans(), M, B.cols(), B.rows(), alpha, A,
+        NULL, NULL, B.packed_data(), beta, C);
+  } else {
+    caffe_cpu_gemm<Dtype>(TransA, B.trans(), M, B.cols(), B.rows(), alpha, A,
+        B.source(), beta, C);
+  }
+}
+
+template void caffe_cpu_gemm_packed_b<float>(const CBLAS_TRANSPOSE TransA,
+    const int M, const float alpha, const float* A,
+    const PackedGemmMatrix<float>& B, const float beta, float* C);
+template void caffe_cpu_gemm_packed_b<double>(const CBLAS_TRANSPOSE TransA,
+    const int M, const double alpha, const double* A,
+    const PackedGemmMatrix<double>& B, const double beta, double* C);
+
+}  // namespace caffe
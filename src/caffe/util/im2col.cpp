@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cstring>
 #include <vector>
 
 #include "caffe/util/im2col.hpp"
@@ -15,6 +17,62 @@ inline bool is_a_ge_zero_and_a_lt_b(int a, int b) {
   return static_cast<unsigned>(a) < static_cast<unsigned>(b);
 }
 
+// Computes the half-open range [*out_lo, *out_hi) of output positions o in
+// [0, out_size) whose input coordinate offset + o * stride falls inside
+// [0, in_size). Positions outside the range read (or scatter into) padding,
+// so splitting a row this way leaves a branch-free interior loop.
+inline void valid_output_range(const int offset, const int stride,
+    const int in_size, const int out_size, int* out_lo, int* out_hi) {
+  int lo = offset >= 0 ? 0 : (-offset + stride - 1) / stride;
+  int hi = in_size - offset <= 0 ? 0 :
+      (in_size - offset + stride - 1) / stride;
+  lo = std::min(lo, out_size);
+  hi = std::max(lo, std::min(hi, out_size));
+  *out_lo = lo;
+  *out_hi = hi;
+}
+
+// Copies one output row of the column buffer: zeros for the left and right
+// padding and either a memcpy (stride 1) or a strided gather for the rest.
+// Output position i reads data_im_row[offset + i * stride_w].
+template <typename Dtype>
+inline void im2col_row_cpu(const Dtype* data_im_row, const int offset,
+    const int lo, const int hi, const int output_w, const int stride_w,
+    Dtype* data_col) {
+  for (int i = 0; i < lo; ++i) {
+    data_col[i] = 0;
+  }
+  if (stride_w == 1) {
+    memcpy(data_col + lo, data_im_row + offset + lo,  // NOLINT(caffe/alt_fn)
+        sizeof(Dtype) * (hi - lo));
+  } else {
+    const Dtype* src = data_im_row + offset;
+    for (int i = lo; i < hi; ++i) {
+      data_col[i] = src[i * stride_w];
+    }
+  }
+  for (int i = hi; i < output_w; ++i) {
+    data_col[i] = 0;
+  }
+}
+
+// Accumulates the in-bounds part of one column buffer row into the image.
+template <typename Dtype>
+inline void col2im_row_cpu(const Dtype* data_col, const int offset,
+    const int lo, const int hi, const int stride_w, Dtype* data_im_row) {
+  if (stride_w == 1) {
+    Dtype* dst = data_im_row + offset + lo;
+    const Dtype* src = data_col + lo;
+    for (int i = 0; i < hi - lo; ++i) {
+      dst[i] += src[i];
+    }
+  } else {
+    for (int i = lo; i < hi; ++i) {
+      data_im_row[offset + i * stride_w] += data_col[i];
+    }
+  }
+}
+
 template <typename Dtype>
 void im2col_cpu(const Dtype* data_im, const int channels,
     const int height, const int width, const int kernel_h, const int kernel_w,
@@ -27,26 +85,30 @@ void im2col_cpu(const Dtype* data_im, const int channels,
   const int output_w = (width + 2 * pad_w -
     (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
   const int channel_size = height * width;
-  for (int channel = channels; channel--; data_im += channel_size) {
+  const int output_size = output_h * output_w;
+  const int col_channel_size = kernel_h * kernel_w * output_size;
+  // Every channel fills its own kernel_h * kernel_w block of column rows, so
+  // channels can be processed independently.
+#ifdef _OPENMP
+  #pragma omp parallel for if (channels > 1 && col_channel_size > 4096)
+#endif
+  for (int channel = 0; channel < channels; ++channel) {
+    const Dtype* im = data_im + channel * channel_size;
+    Dtype* col = data_col + channel * col_channel_size;
     for (int kernel_row = 0; kernel_row < kernel_h; kernel_row++) {
       for (int kernel_col = 0; kernel_col < kernel_w; kernel_col++) {
+        const int col_offset = -pad_w + kernel_col * dilation_w;
+        int lo, hi;
+        valid_output_range(col_offset, stride_w, width, output_w, &lo, &hi);
         int input_row = -pad_h + kernel_row * dilation_h;
-        for (int output_rows = output_h; output_rows; output_rows--) {
+        for (int output_row = 0; output_row < output_h; ++output_row) {
           if (!is_a_ge_zero_and_a_lt_b(input_row, height)) {
-            for (int output_cols = output_w; output_cols; output_cols--) {
-              *(data_col++) = 0;
-            }
+            caffe_set(output_w, Dtype(0), col);
           } else {
-            int input_col = -pad_w + kernel_col * dilation_w;
-            for (int output_col = output_w; output_col; output_col--) {
-              if (is_a_ge_zero_and_a_lt_b(input_col, width)) {
-                *(data_col++) = data_im[input_row * width + input_col];
-              } else {
-                *(data_col++) = 0;
-              }
-              input_col += stride_w;
-            }
+            im2col_row_cpu(im + input_row * width, col_offset, lo, hi,
+                output_w, stride_w, col);
           }
+          col += output_w;
           input_row += stride_h;
         }
       }
@@ -71,70 +133,82 @@ inline void im2col_nd_core_cpu(const Dtype* data_input, const bool im2col,
     const int num_spatial_axes, const int* im_shape, const int* col_shape,
     const int* kernel_shape, const int* pad, const int* stride,
     const int* dilation, Dtype* data_output) {
-  if (!im2col) {
-    int im_size = im_shape[0];
-    for (int i = 0; i < num_spatial_axes; ++i) {
-      im_size *= im_shape[1 + i];
-    }
-    caffe_set(im_size, Dtype(0), data_output);
-  }
+  int im_spatial_size = 1;
+  int col_spatial_size = 1;
   int kernel_size = 1;
   for (int i = 0; i < num_spatial_axes; ++i) {
+    im_spatial_size *= im_shape[1 + i];
+    col_spatial_size *= col_shape[1 + i];
     kernel_size *= kernel_shape[i];
   }
-  const int channels_col = col_shape[0];
-  vector<int> d_offset(num_spatial_axes, 0);
-  vector<int> d_iter(num_spatial_axes, 0);
-  for (int c_col = 0; c_col < channels_col; ++c_col) {
-    // Loop over spatial axes in reverse order to compute a per-axis offset.
-    int offset = c_col;
-    for (int d_i = num_spatial_axes - 1; d_i >= 0; --d_i) {
-      if (d_i < num_spatial_axes - 1) {
-        offset /= kernel_shape[d_i + 1];
+  if (!im2col) {
+    caffe_set(im_shape[0] * im_spatial_size, Dtype(0), data_output);
+  }
+  // The last spatial axis is contiguous in both the image and the column
+  // buffer, so it is handled a whole row at a time like the 2-D case; only
+  // the leading axes are walked with the generic counter.
+  const int last = num_spatial_axes - 1;
+  const int output_w = col_shape[last + 1];
+  const int width = im_shape[last + 1];
+  const int num_rows = col_spatial_size / output_w;
+  const int channels = col_shape[0] / kernel_size;
+  // All column rows of one image channel touch only that channel, so both
+  // directions can run channels in parallel.
+#ifdef _OPENMP
+  #pragma omp parallel for if (channels > 1 && \
+      kernel_size * col_spatial_size > 4096)
+#endif
+  for (int c = 0; c < channels; ++c) {
+    vector<int> d_offset(num_spatial_axes, 0);
+    vector<int> d_iter(num_spatial_axes, 0);
+    const int im_offset = c * im_spatial_size;
+    for (int k = 0; k < kernel_size; ++k) {
+      const int c_col = c * kernel_size + k;
+      // Loop over spatial axes in reverse order to compute a per-axis offset.
+      int offset = k;
+      for (int d_i = last; d_i >= 0; --d_i) {
+        d_offset[d_i] = offset % kernel_shape[d_i];
+        offset /= kernel_shape[d_i];
       }
-      d_offset[d_i] = offset % kernel_shape[d_i];
-    }
-    for (bool incremented = true; incremented; ) {
-      // Loop over spatial axes in forward order to compute the indices in the
-      // image and column, and whether the index lies in the padding.
-      int index_col = c_col;
-      int index_im = c_col / kernel_size;
-      bool is_padding = false;
-      for (int d_i = 0; d_i < num_spatial_axes; ++d_i) {
-        const int d = d_iter[d_i];
-        const int d_im = d * stride[d_i] - pad[d_i] +
-            d_offset[d_i] * dilation[d_i];
-        is_padding |= d_im < 0 || d_im >= im_shape[d_i + 1];
-        index_col *= col_shape[d_i + 1];
-        index_col += d;
-        index_im *= im_shape[d_i + 1];
-        index_im += d_im;
+      const int col_offset = d_offset[last] * dilation[last] - pad[last];
+      int lo, hi;
+      valid_output_range(col_offset, stride[last], width, output_w, &lo, &hi);
+      for (int d_i = 0; d_i < last; ++d_i) {
+        d_iter[d_i] = 0;
       }
-      if (im2col) {
-        if (is_padding) {
-          data_output[index_col] = 0;
-        } else {
-          data_output[index_col] = data_input[index_im];
+      for (int row = 0; row < num_rows; ++row) {
+        // Compute the image row and whether it lies in the padding.
+        int index_im = 0;
+        bool is_padding = false;
+        for (int d_i = 0; d_i < last; ++d_i) {
+          const int d_im = d_iter[d_i] * stride[d_i] - pad[d_i] +
+              d_offset[d_i] * dilation[d_i];
+          is_padding |= !is_a_ge_zero_and_a_lt_b(d_im, im_shape[d_i + 1]);
+          index_im = index_im * im_shape[d_i + 1] + d_im;
         }
-      } else if (!is_padding) {  // col2im
-        data_output[index_im] += data_input[index_col];
-      }
-      // Loop over spatial axes in reverse order to choose an index,
-      // like counting.
-      incremented = false;
-      for (int d_i = num_spatial_axes - 1; d_i >= 0; --d_i) {
-        const int d_max = col_shape[d_i + 1];
-        DCHECK_LT(d_iter[d_i], d_max);
-        if (d_iter[d_i] == d_max - 1) {
+        const int index_col = c_col * col_spatial_size + row * output_w;
+        if (im2col) {
+          if (is_padding) {
+            caffe_set(output_w, Dtype(0), data_output + index_col);
+          } else {
+            im2col_row_cpu(data_input + im_offset + index_im * width,
+                col_offset, lo, hi, output_w, stride[last],
+                data_output + index_col);
+          }
+        } else if (!is_padding) {  // col2im
+          col2im_row_cpu(data_input + index_col, col_offset, lo, hi,
+              stride[last], data_output + im_offset + index_im * width);
+        }
+        // Advance the leading axes like counting.
+        for (int d_i = last - 1; d_i >= 0; --d_i) {
+          if (++d_iter[d_i] < col_shape[d_i + 1]) {
+            break;
+          }
           d_iter[d_i] = 0;
-        } else {  // d_iter[d_i] < d_max - 1
-          ++d_iter[d_i];
-          incremented = true;
-          break;
         }
       }
-    }  // while(incremented) {
-  }  // for (int c = 0; c < channels_col; ++c) {
+    }
+  }
 }
 
 template <typename Dtype>
@@ -172,23 +246,27 @@ void col2im_cpu(const Dtype* data_col, const int channels,
   const int output_w = (width + 2 * pad_w -
     (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
   const int channel_size = height * width;
-  for (int channel = channels; channel--; data_im += channel_size) {
+  const int output_size = output_h * output_w;
+  const int col_channel_size = kernel_h * kernel_w * output_size;
+  // Column rows of one channel only scatter into that channel's image plane.
+#ifdef _OPENMP
+  #pragma omp parallel for if (channels > 1 && col_channel_size > 4096)
+#endif
+  for (int channel = 0; channel < channels; ++channel) {
+    Dtype* im = data_im + channel * channel_size;
+    const Dtype* col = data_col + channel * col_channel_size;
     for (int kernel_row = 0; kernel_row < kernel_h; kernel_row++) {
       for (int kernel_col = 0; kernel_col < kernel_w; kernel_col++) {
+        const int col_offset = -pad_w + kernel_col * dilation_w;
+        int lo, hi;
+        valid_output_range(col_offset, stride_w, width, output_w, &lo, &hi);
         int input_row = -pad_h + kernel_row * dilation_h;
-        for (int output_rows = output_h; output_rows; output_rows--) {
-          if (!is_a_ge_zero_and_a_lt_b(input_row, height)) {
-            data_col += output_w;
-          } else {
-            int input_col = -pad_w + kernel_col * dilation_w;
-            for (int output_col = output_w; output_col; output_col--) {
-              if (is_a_ge_zero_and_a_lt_b(input_col, width)) {
-                data_im[input_row * width + input_col] += *data_col;
-              }
-              data_col++;
-              input_col += stride_w;
-            }
+        for (int output_row = 0; output_row < output_h; ++output_row) {
+          if (is_a_ge_zero_and_a_lt_b(input_row, height)) {
+            col2im_row_cpu(col, col_offset, lo, hi, stride_w,
+                im + input_row * width);
           }
+          col += output_w;
           input_row += stride_h;
         }
       }
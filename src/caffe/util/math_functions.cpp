@@ -1,11 +1,14 @@
 #include <boost/math/special_functions/next.hpp>
 #include <boost/random.hpp>
 
+#include <algorithm>
 #include <limits>
 
 #include "caffe/common.hpp"
+#include "caffe/util/gemm.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
+#include "caffe/util/vector_math.hpp"
 
 namespace caffe {
 
@@ -14,6 +17,10 @@ void caffe_cpu_gemm<float>(const CBLAS_TRANSPOSE TransA,
     const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
     const float alpha, const float* A, const float* B, const float beta,
     float* C) {
+  if (Caffe::gemm_backend() == Caffe::BLOCKED) {
+    caffe_cpu_blocked_gemm(TransA, TransB, M, N, K, alpha, A, B, beta, C);
+    return;
+  }
   int lda = (TransA == CblasNoTrans) ? K : M;
   int ldb = (TransB == CblasNoTrans) ? N : K;
   cblas_sgemm(CblasRowMajor, TransA, TransB, M, N, K, alpha, A, lda, B,
@@ -25,6 +32,10 @@ void caffe_cpu_gemm<double>(const CBLAS_TRANSPOSE TransA,
     const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
     const double alpha, const double* A, const double* B, const double beta,
     double* C) {
+  if (Caffe::gemm_backend() == Caffe::BLOCKED) {
+    caffe_cpu_blocked_gemm(TransA, TransB, M, N, K, alpha, A, B, beta, C);
+    return;
+  }
   int lda = (TransA == CblasNoTrans) ? K : M;
   int ldb = (TransB == CblasNoTrans) ? N : K;
   cblas_dgemm(CblasRowMajor, TransA, TransB, M, N, K, alpha, A, lda, B,
@@ -177,13 +188,21 @@ void caffe_div<double>(const int n, const double* a, const double* b,
 template <>
 void caffe_powx<float>(const int n, const float* a, const float b,
     float* y) {
+#ifdef USE_MKL
   vsPowx(n, a, b, y);
+#else
+  caffe_cpu_vpowx(n, a, b, y);
+#endif
 }
 
 template <>
 void caffe_powx<double>(const int n, const double* a, const double b,
     double* y) {
+#ifdef USE_MKL
   vdPowx(n, a, b, y);
+#else
+  caffe_cpu_vpowx(n, a, b, y);
+#endif
 }
 
 template <>
@@ -208,22 +227,38 @@ void caffe_sqrt<double>(const int n, const double* a, double* y) {
 
 template <>
 void caffe_exp<float>(const int n, const float* a, float* y) {
+#ifdef USE_MKL
   vsExp(n, a, y);
+#else
+  caffe_cpu_vexp(n, a, y);
+#endif
 }
 
 template <>
 void caffe_exp<double>(const int n, const double* a, double* y) {
+#ifdef USE_MKL
   vdExp(n, a, y);
+#else
+  caffe_cpu_vexp(n, a, y);
+#endif
 }
 
 template <>
 void caffe_log<float>(const int n, const float* a, float* y) {
+#ifdef USE_MKL
   vsLn(n, a, y);
+#else
+  caffe_cpu_vlog(n, a, y);
+#endif
 }
 
 template <>
 void caffe_log<double>(const int n, const double* a, double* y) {
+#ifdef USE_MKL
   vdLn(n, a, y);
+#else
+  caffe_cpu_vlog(n, a, y);
+#endif
 }
 
 template <>
@@ -382,4 +417,59 @@ void caffe_cpu_scale<double>(const int n, const double alpha, const double *x,
   cblas_dscal(n, alpha, y, 1);
 }
 
+// Values per chunk of caffe_cpu_mean_m2, and the independent partial sums that
+// let the compiler vectorize its loops.
+static const int kMeanM2Chunk = 512;
+static const int kMeanM2Lanes = 8;
+
+template <typename Dtype>
+void caffe_cpu_mean_m2(const int n, const Dtype* x, int* count, Dtype* mean,
+    Dtype* m2) {
+  for (int begin = 0; begin < n; begin += kMeanM2Chunk) {
+    const int len = std::min(kMeanM2Chunk, n - begin);
+    const Dtype* chunk = x + begin;
+    // The chunk is still in cache for its second pass.
+    Dtype lanes[kMeanM2Lanes] = {0};
+    int i = 0;
+    for (; i + kMeanM2Lanes <= len; i += kMeanM2Lanes) {
+      for (int j = 0; j < kMeanM2Lanes; ++j) {
+        lanes[j] += chunk[i + j];
+      }
+    }
+    for (; i < len; ++i) {
+      lanes[0] += chunk[i];
+    }
+    Dtype sum = 0;
+    for (int j = 0; j < kMeanM2Lanes; ++j) {
+      sum += lanes[j];
+      lanes[j] = 0;
+    }
+    const Dtype chunk_mean = sum / len;
+    for (i = 0; i + kMeanM2Lanes <= len; i += kMeanM2Lanes) {
+      for (int j = 0; j < kMeanM2Lanes; ++j) {
+        const Dtype d = chunk[i + j] - chunk_mean;
+        lanes[j] += d * d;
+      }
+    }
+    for (; i < len; ++i) {
+      const Dtype d = chunk[i] - chunk_mean;
+      lanes[0] += d * d;
+    }
+    Dtype chunk_m2 = 0;
+    for (int j = 0; j < kMeanM2Lanes; ++j) {
+      chunk_m2 += lanes[j];
+    }
+    const int total = *count + len;
+    const Dtype delta = chunk_mean - *mean;
+    *mean += delta * len / total;
+    *m2 += chunk_m2 + delta * delta * (Dtype(*count) * len / total);
+    *count = total;
+  }
+}
+
+template void caffe_cpu_mean_m2<float>(const int n, const float* x,
+    int* count, float* mean, float* m2);
+template void caffe_cpu_mean_m2<double>(const int n, const double* x,
+    int* count, double* mean, double* m2);
+
 }  // namespace caffe
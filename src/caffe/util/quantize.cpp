@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "caffe/util/quantize.hpp"
+
+namespace caffe {
+
+namespace {
+
+inline int round_to_int(const float x) {
+  return static_cast<int>(std::floor(x + 0.5f));
+}
+
+inline int clamp(const int x, const int lo, const int hi) {
+  return x < lo ? lo : (x > hi ? hi : x);
+}
+
+}  // namespace
+
+template <typename Dtype>
+void caffe_cpu_quantize_u8(const int n, const Dtype* x, const float scale,
+    const int zero_point, uint8_t* q) {
+  const float inv_scale = 1.f / scale;
+#ifdef _OPENMP
+#pragma omp parallel for if (n > 65536)
+#endif
+  for (int i = 0; i < n; ++i) {
+    q[i] = static_cast<uint8_t>(clamp(
+        round_to_int(static_cast<float>(x[i]) * inv_scale) + zero_point,
+        0, 255));
+  }
+}
+
+template void caffe_cpu_quantize_u8<float>(const int n, const float* x,
+    const float scale, const int zero_point, uint8_t* q);
+template void caffe_cpu_quantize_u8<double>(const int n, const double* x,
+    const float scale, const int zero_point, uint8_t* q);
+
+void caffe_choose_u8_quantization(float min_value, float max_value,
+    float* scale, int* zero_point) {
+  CHECK_LE(min_value, max_value);
+  min_value = std::min(min_value, 0.f);
+  max_value = std::max(max_value, 0.f);
+  *scale = (max_value - min_value) / 255.f;
+  if (*scale == 0) {
+    *scale = 1;
+  }
+  *zero_point = clamp(round_to_int(-min_value / *scale), 0, 255);
+}
+
+template <typename Dtype>
+void caffe_cpu_int8_row_scales(const int rows, const int cols,
+    const Dtype* W, const bool transpose, float* scales) {
+  const int row_stride = transpose ? 1 : cols;
+  const int col_stride = transpose ? rows : 1;
+  for (int i = 0; i < rows; ++i) {
+    float max_abs = 0;
+    for (int j = 0; j < cols; ++j) {
+      max_abs = std::max(max_abs,
+          static_cast<float>(std::fabs(W[i * row_stride + j * col_stride])));
+    }
+    scales[i] = max_abs > 0 ? max_abs / 127.f : 1.f;
+  }
+}
+
+template void caffe_cpu_int8_row_scales<float>(const int rows,
+    const int cols, const float* W, const bool transpose, float* scales);
+template void caffe_cpu_int8_row_scales<double>(const int rows,
+    const int cols, const double* W, const bool transpose, float* scales);
+
+void caffe_cpu_gemm_s8u8s32(const int M, const int N, const int K,
+    const int8_t* A, const uint8_t* B, int32_t* C) {
+  // Rows of C are independent; each is accumulated from the rows of B
+  // weighted by one row of A, which keeps the inner loop a widening
+  // multiply-add over contiguous memory that the compiler vectorizes.
+#ifdef _OPENMP
+#pragma omp parallel for if (static_cast<int64_t>(M) * N * K > 65536)
+#endif
+  for (int i = 0; i < M; ++i) {
+    int32_t* c = C + static_cast<int64_t>(i) * N;
+    std::fill(c, c + N, 0);
+    const int8_t* a = A + static_cast<int64_t>(i) * K;
+    for (int k = 0; k < K; ++k) {
+      const int32_t a_ik = a[k];
+      if (a_ik == 0) {
+        continue;
+      }
+      const uint8_t* b = B + static_cast<int64_t>(k) * N;
+      for (int j = 0; j < N; ++j) {
+        c[j] += a_ik * static_cast<int32_t>(b[j]);
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+Int8WeightMatrix<Dtype>::Int8WeightMatrix()
+    : rows_(0), cols_(0), data_(), row_sums_(), scales_(),
+      source_memory_(NULL), source_version_(-1) {}
+
+template <typename Dtype>
+void Int8WeightMatrix<Dtype>::Quantize(const Blob<Dtype>& weights,
+    const bool transpose, const int rows, const int cols,
+    const vector<float>& scales) {
+  CHECK_EQ(rows * cols, weights.count());
+  rows_ = rows;
+  cols_ = cols;
+  const Dtype* W = weights.cpu_data();
+  if (scales.empty()) {
+    scales_.resize(rows);
+    caffe_cpu_int8_row_scales(rows, cols, W, transpose, &scales_[0]);
+  } else {
+    CHECK_EQ(static_cast<int>(scales.size()), rows)
+        << "Expected one weight scale per output channel.";
+    scales_ = scales;
+  }
+  data_.resize(rows * cols);
+  row_sums_.resize(rows);
+  const int row_stride = transpose ? 1 : cols;
+  const int col_stride = transpose ? rows : 1;
+  for (int i = 0; i < rows; ++i) {
+    const float inv_scale = 1.f / scales_[i];
+    int32_t sum = 0;
+    for (int j = 0; j < cols; ++j) {
+      const int q = clamp(round_to_int(
+          static_cast<float>(W[i * row_stride + j * col_stride]) * inv_scale),
+          -127, 127);
+      data_[i * cols + j] = static_cast<int8_t>(q);
+      sum += q;
+    }
+    row_sums_[i] = sum;
+  }
+  source_memory_ = weights.data().get();
+  source_version_ = weights.data()->version();
+}
+
+template <typename Dtype>
+bool Int8WeightMatrix<Dtype>::IsQuantizedFrom(const Blob<Dtype>& weights)
+    const {
+  return source_memory_ != NULL && source_memory_ == weights.data().get() &&
+      source_version_ == weights.data()->version() &&
+      rows_ * cols_ == weights.count();
+}
+
+INSTANTIATE_CLASS(Int8WeightMatrix);
+
+}  // namespace caffe
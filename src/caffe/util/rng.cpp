@@ -0,0 +1,129 @@
+#include <stdint.h>
+
+#include <cmath>
+
+#include "caffe/util/rng.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Calls op(k, r) for each 32-bit number r = number k of the stream, for
+// offset <= k < offset + n, a block of 4 at a time and the blocks split
+// among threads.
+template <typename Op>
+void ForEachNumber(const PhiloxStream& stream, const int n,
+    const uint64_t offset, Op op) {
+  if (n <= 0) { return; }
+  const uint64_t end = offset + n;
+  const int64_t first_block = offset / 4;
+  const int64_t num_blocks = (end + 3) / 4 - first_block;
+#ifdef _OPENMP
+#pragma omp parallel for if (static_cast<int64_t>(n) > 32768)
+#endif
+  for (int64_t b = 0; b < num_blocks; ++b) {
+    const uint64_t block = first_block + b;
+    uint32_t r[4];
+    stream.Block(block, r);
+    for (int j = 0; j < 4; ++j) {
+      const uint64_t k = 4 * block + j;
+      if (k >= offset && k < end) {
+        op(static_cast<int>(k - offset), r[j]);
+      }
+    }
+  }
+}
+
+struct BitsOp {
+  explicit BitsOp(uint32_t* r) : r_(r) {}
+  inline void operator()(const int i, const uint32_t x) const { r_[i] = x; }
+  uint32_t* r_;
+};
+
+template <typename Dtype>
+struct UniformOp {
+  UniformOp(const Dtype a, const Dtype b, Dtype* r) : a_(a), b_(b), r_(r) {}
+  inline void operator()(const int i, const uint32_t x) const {
+    // The top 24 bits, so that the value stays below 1 in float too.
+    const Dtype u = static_cast<Dtype>(x >> 8) * Dtype(1. / (1 << 24));
+    r_[i] = a_ + (b_ - a_) * u;
+  }
+  Dtype a_, b_;
+  Dtype* r_;
+};
+
+template <typename Dtype>
+struct BernoulliOp {
+  BernoulliOp(const Dtype p, int* r)
+      : threshold_(static_cast<uint64_t>(std::ldexp(double(p), 32))),
+        r_(r) {}
+  inline void operator()(const int i, const uint32_t x) const {
+    r_[i] = x < threshold_;
+  }
+  uint64_t threshold_;
+  int* r_;
+};
+
+}  // namespace
+
+void PhiloxStream::Bits(const int n, const uint64_t offset, uint32_t* r) const {
+  CHECK_GE(n, 0);
+  ForEachNumber(*this, n, offset, BitsOp(r));
+}
+
+template <typename Dtype>
+void PhiloxStream::Uniform(const int n, const uint64_t offset, const Dtype a,
+    const Dtype b, Dtype* r) const {
+  CHECK_GE(n, 0);
+  CHECK_LE(a, b);
+  ForEachNumber(*this, n, offset, UniformOp<Dtype>(a, b, r));
+}
+
+template <typename Dtype>
+void PhiloxStream::Gaussian(const int n, const uint64_t offset, const Dtype mu,
+    const Dtype sigma, Dtype* r) const {
+  CHECK_GE(n, 0);
+  CHECK_GT(sigma, 0);
+  // Box-Muller, two 32-bit numbers (half a block) per value.
+  const double kTwoPi = 6.283185307179586;
+  const int64_t first = offset;
+#ifdef _OPENMP
+#pragma omp parallel for if (static_cast<int64_t>(n) > 16384)
+#endif
+  for (int64_t k = first - first % 2; k < first + n; k += 2) {
+    uint32_t x[4];
+    Block(k / 2, x);
+    for (int j = 0; j < 2; ++j) {
+      if (k + j < first || k + j >= first + n) { continue; }
+      const double u1 = (x[2 * j] + 1.) * (1. / 4294967296.);
+      const double u2 = x[2 * j + 1] * (1. / 4294967296.);
+      r[k + j - first] = mu + sigma * static_cast<Dtype>(
+          std::sqrt(-2 * std::log(u1)) * std::cos(kTwoPi * u2));
+    }
+  }
+}
+
+template <typename Dtype>
+void PhiloxStream::Bernoulli(const int n, const uint64_t offset,
+    const Dtype p, int* r) const {
+  CHECK_GE(n, 0);
+  CHECK_GE(p, 0);
+  CHECK_LE(p, 1);
+  ForEachNumber(*this, n, offset, BernoulliOp<Dtype>(p, r));
+}
+
+template void PhiloxStream::Uniform<float>(const int n, const uint64_t offset,
+    const float a, const float b, float* r) const;
+template void PhiloxStream::Uniform<double>(const int n, const uint64_t offset,
+    const double a, const double b, double* r) const;
+template void PhiloxStream::Gaussian<float>(const int n,
+    const uint64_t offset, const float mu, const float sigma, float* r) const;
+template void PhiloxStream::Gaussian<double>(const int n,
+    const uint64_t offset, const double mu, const double sigma,
+    double* r) const;
+template void PhiloxStream::Bernoulli<float>(const int n,
+    const uint64_t offset, const float p, int* r) const;
+template void PhiloxStream::Bernoulli<double>(const int n,
+    const uint64_t offset, const double p, int* r) const;
+
+}  // namespace caffe
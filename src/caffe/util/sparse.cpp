@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/util/sparse.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+SparseWeightMatrix<Dtype>::SparseWeightMatrix()
+    : is_sparse_(false), rows_(0), cols_(0), row_ptr_(), col_idx_(),
+      values_(), source_memory_(NULL), source_offset_(0),
+      source_version_(-1) {}
+
+template <typename Dtype>
+void SparseWeightMatrix<Dtype>::Convert(const Blob<Dtype>& weights,
+    const bool transpose, const int rows, const int cols,
+    const float min_sparsity, const int offset) {
+  CHECK_LE(offset + rows * cols, weights.count());
+  Clear();
+  const Dtype* W = weights.cpu_data() + offset;
+  source_memory_ = weights.data().get();
+  source_offset_ = offset;
+  source_version_ = weights.data()->version();
+  if (caffe_cpu_sparsity(rows * cols, W) < min_sparsity) {
+    return;
+  }
+  is_sparse_ = true;
+  rows_ = rows;
+  cols_ = cols;
+  const int row_stride = transpose ? 1 : cols;
+  const int col_stride = transpose ? rows : 1;
+  row_ptr_.resize(rows + 1);
+  row_ptr_[0] = 0;
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      const Dtype w = W[i * row_stride + j * col_stride];
+      if (w != 0) {
+        col_idx_.push_back(j);
+        values_.push_back(w);
+      }
+    }
+    row_ptr_[i + 1] = values_.size();
+  }
+}
+
+template <typename Dtype>
+bool SparseWeightMatrix<Dtype>::IsConvertedFrom(const Blob<Dtype>& weights)
+    const {
+  return source_memory_ != NULL && source_memory_ == weights.data().get() &&
+      source_version_ == weights.data()->version() &&
+      source_offset_ + rows_ * cols_ <= weights.count();
+}
+
+template <typename Dtype>
+void SparseWeightMatrix<Dtype>::Clear() {
+  is_sparse_ = false;
+  rows_ = 0;
+  cols_ = 0;
+  vector<int>().swap(row_ptr_);
+  vector<int>().swap(col_idx_);
+  vector<Dtype>().swap(values_);
+  source_memory_ = NULL;
+  source_offset_ = 0;
+  source_version_ = -1;
+}
+
+INSTANTIATE_CLASS(SparseWeightMatrix);
+
+template <typename Dtype>
+float caffe_cpu_sparsity(const int n, const Dtype* x) {
+  if (n == 0) {
+    return 0;
+  }
+  int zeros = 0;
+  for (int i = 0; i < n; ++i) {
+    zeros += (x[i] == 0);
+  }
+  return static_cast<float>(zeros) / n;
+}
+
+template float caffe_cpu_sparsity<float>(const int n, const float* x);
+template float caffe_cpu_sparsity<double>(const int n, const double* x);
+
+template <typename Dtype>
+void caffe_cpu_csrmm(const SparseWeightMatrix<Dtype>& A, const int row_begin,
+    const int row_end, const int N, const Dtype* B, Dtype* C) {
+  CHECK(A.is_sparse());
+  CHECK_GE(row_begin, 0);
+  CHECK_LE(row_end, A.rows());
+  const int* row_ptr = A.row_ptr();
+  const int* col_idx = A.col_idx();
+  const Dtype* values = A.values();
+  // Each row of C is the sum of the rows of B selected by the nonzeros of
+  // the matching row of A.
+#ifdef _OPENMP
+#pragma omp parallel for if (static_cast<int64_t>(A.nnz()) * N > 65536)
+#endif
+  for (int i = row_begin; i < row_end; ++i) {
+    Dtype* c = C + static_cast<int64_t>(i - row_begin) * N;
+    std::fill(c, c + N, Dtype(0));
+    for (int p = row_ptr[i]; p < row_ptr[i + 1]; ++p) {
+      const Dtype a = values[p];
+      const Dtype* b = B + static_cast<int64_t>(col_idx[p]) * N;
+      for (int j = 0; j < N; ++j) {
+        c[j] += a * b[j];
+      }
+    }
+  }
+}
+
+template void caffe_cpu_csrmm<float>(const SparseWeightMatrix<float>& A,
+    const int row_begin, const int row_end, const int N, const float* B,
+    float* C);
+template void caffe_cpu_csrmm<double>(const SparseWeightMatrix<double>& A,
+    const int row_begin, const int row_end, const int N, const double* B,
+    double* C);
+
+template <typename Dtype>
+void caffe_cpu_gemm_csr_t(const int M, const Dtype* A,
+    const SparseWeightMatrix<Dtype>& B, Dtype* C) {
+  CHECK(B.is_sparse());
+  const int K = B.cols();
+  const int N = B.rows();
+  const int* row_ptr = B.row_ptr();
+  const int* col_idx = B.col_idx();
+  const Dtype* values = B.values();
+  // Every output is a sparse dot product of a row of B with a row of A.
+#ifdef _OPENMP
+#pragma omp parallel for if (static_cast<int64_t>(M) * B.nnz() > 65536)
+#endif
+  for (int m = 0; m < M; ++m) {
+    const Dtype* a = A + static_cast<int64_t>(m) * K;
+    Dtype* c = C + static_cast<int64_t>(m) * N;
+    for (int n = 0; n < N; ++n) {
+      Dtype sum = 0;
+      for (int p = row_ptr[n]; p < row_ptr[n + 1]; ++p) {
+        sum += values[p] * a[col_idx[p]];
+      }
+      c[n] = sum;
+    }
+  }
+}
+
+template void caffe_cpu_gemm_csr_t<float>(const int M, const float* A,
+    const SparseWeightMatrix<float>& B, float* C);
+template void caffe_cpu_gemm_csr_t<double>(const int M, const double* A,
+    const SparseWeightMatrix<double>& B, double* C);
+
+}  // namespace caffe
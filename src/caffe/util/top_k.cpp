@@ -0,0 +1,99 @@
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "caffe/util/top_k.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Values tested against the threshold of the heap at a time.
+const int kTopKBlock = 16;
+
+// The order of the selection: a is better than b if it is larger, or equal
+// with a larger index. As a heap comparator this keeps the worst candidate at
+// the front.
+template <typename Dtype>
+struct TopKBetter {
+  inline bool operator()(const std::pair<Dtype, int>& a,
+      const std::pair<Dtype, int>& b) const {
+    return a.first > b.first || (a.first == b.first && a.second > b.second);
+  }
+};
+
+// Whether any of the kTopKBlock values at x (stride apart) is at least
+// threshold. Indices only grow along the scan, so a value equal to the
+// threshold still beats the worst candidate. The fixed trip count and the
+// unit stride case let the compiler vectorize the common contiguous scan.
+template <typename Dtype>
+inline bool block_reaches(const Dtype* x, const int stride,
+    const Dtype threshold) {
+  int reaches = 0;
+  if (stride == 1) {
+    for (int i = 0; i < kTopKBlock; ++i) {
+      reaches |= (x[i] >= threshold);
+    }
+  } else {
+    for (int i = 0; i < kTopKBlock; ++i) {
+      reaches |= (x[i * stride] >= threshold);
+    }
+  }
+  return reaches;
+}
+
+}  // namespace
+
+template <typename Dtype>
+void caffe_cpu_top_k(const int n, const Dtype* x, const int stride,
+    const int k, int* indices, Dtype* values) {
+  if (k == 1) {
+    int best = 0;
+    for (int i = 1; i < n; ++i) {
+      if (x[i * stride] >= x[best * stride]) {
+        best = i;
+      }
+    }
+    indices[0] = best;
+    if (values) {
+      values[0] = x[best * stride];
+    }
+    return;
+  }
+  const TopKBetter<Dtype> better;
+  std::vector<std::pair<Dtype, int> > heap;
+  heap.reserve(k);
+  for (int i = 0; i < k; ++i) {
+    heap.push_back(std::make_pair(x[i * stride], i));
+  }
+  std::make_heap(heap.begin(), heap.end(), better);
+  for (int begin = k; begin < n; begin += kTopKBlock) {
+    const int len = std::min(kTopKBlock, n - begin);
+    if (len == kTopKBlock &&
+        !block_reaches(x + begin * stride, stride, heap.front().first)) {
+      continue;
+    }
+    for (int i = begin; i < begin + len; ++i) {
+      const Dtype value = x[i * stride];
+      if (value >= heap.front().first) {
+        std::pop_heap(heap.begin(), heap.end(), better);
+        heap.back() = std::make_pair(value, i);
+        std::push_heap(heap.begin(), heap.end(), better);
+      }
+    }
+  }
+  std::sort_heap(heap.begin(), heap.end(), better);
+  for (int i = 0; i < k; ++i) {
+    indices[i] = heap[i].second;
+    if (values) {
+      values[i] = heap[i].first;
+    }
+  }
+}
+
+template void caffe_cpu_top_k<float>(const int n, const float* x,
+    const int stride, const int k, int* indices, float* values);
+template void caffe_cpu_top_k<double>(const int n, const double* x,
+    const int stride, const int k, int* indices, double* values);
+
+}  // namespace caffe
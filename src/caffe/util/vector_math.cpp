@@ -0,0 +1,642 @@
+#include <stdint.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "caffe/util/vector_math.hpp"
+
+namespace caffe {
+
+// The kernels are plain loops that the compiler vectorizes. With GCC on
+// x86-64 Linux every kernel is also compiled for x86-64-v3 (AVX2 + FMA) and
+// x86-64-v4 (AVX-512), and the dynamic loader resolves each one to the best
+// version the CPU supports.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 12 && \
+    defined(__x86_64__) && defined(__linux__)
+#define CAFFE_VECTOR_MATH_CLONES __attribute__((target_clones( \
+    "arch=x86-64-v4", "arch=x86-64-v3", "default")))
+#else
+#define CAFFE_VECTOR_MATH_CLONES
+#endif
+
+// The approximations have to be inlined into the loops to vectorize.
+#ifdef __GNUC__
+#define CAFFE_VECTOR_MATH_INLINE inline __attribute__((always_inline))
+#else
+#define CAFFE_VECTOR_MATH_INLINE inline
+#endif
+
+namespace {
+
+union FloatBits {
+  float f;
+  int32_t i;
+};
+
+union DoubleBits {
+  double f;
+  int64_t i;
+};
+
+// c ? a : b with both a and b evaluated, as a bitwise blend. A conditional
+// expression lets the compiler move the computation of a or b into a branch,
+// which then keeps the loop from vectorizing.
+CAFFE_VECTOR_MATH_INLINE float select(const bool c, const float a,
+    const float b) {
+  FloatBits a_bits, b_bits;
+  a_bits.f = a;
+  b_bits.f = b;
+  const int32_t mask = -static_cast<int32_t>(c);
+  a_bits.i = (a_bits.i & mask) | (b_bits.i & ~mask);
+  return a_bits.f;
+}
+
+CAFFE_VECTOR_MATH_INLINE double select(const bool c, const double a,
+    const double b) {
+  DoubleBits a_bits, b_bits;
+  a_bits.f = a;
+  b_bits.f = b;
+  const int64_t mask = -static_cast<int64_t>(c);
+  a_bits.i = (a_bits.i & mask) | (b_bits.i & ~mask);
+  return a_bits.f;
+}
+
+// The range of exp_core: the power of two it scales by stays normal.
+template <typename Dtype> struct ExpRange;
+template <> struct ExpRange<float> {
+  static float min() { return -87.f; }
+  static float max() { return 88.f; }
+};
+template <> struct ExpRange<double> {
+  static double min() { return -708.; }
+  static double max() { return 709.; }
+};
+
+// |magnitude| with the sign bit of sign.
+CAFFE_VECTOR_MATH_INLINE float copy_sign(const float magnitude,
+    const float sign) {
+  FloatBits m_bits, s_bits;
+  m_bits.f = magnitude;
+  s_bits.f = sign;
+  m_bits.i = (m_bits.i & 0x7fffffff) | (s_bits.i & ~0x7fffffff);
+  return m_bits.f;
+}
+
+CAFFE_VECTOR_MATH_INLINE double copy_sign(const double magnitude,
+    const double sign) {
+  DoubleBits m_bits, s_bits;
+  m_bits.f = magnitude;
+  s_bits.f = sign;
+  m_bits.i = (m_bits.i & 0x7fffffffffffffffLL) |
+      (s_bits.i & ~0x7fffffffffffffffLL);
+  return m_bits.f;
+}
+
+// min and max by select too: the branches of std::min and std::max get
+// threaded through the rest of the loop body.
+template <typename Dtype>
+CAFFE_VECTOR_MATH_INLINE Dtype minimum(const Dtype a, const Dtype b) {
+  return select(b < a, b, a);
+}
+
+template <typename Dtype>
+CAFFE_VECTOR_MATH_INLINE Dtype maximum(const Dtype a, const Dtype b) {
+  return select(a < b, b, a);
+}
+
+template <typename Dtype>
+CAFFE_VECTOR_MATH_INLINE Dtype clamp(const Dtype x, const Dtype lo,
+    const Dtype hi) {
+  return minimum(maximum(x, lo), hi);
+}
+
+// exp(x) for x in ExpRange: x = n ln(2) + r with |r| <= ln(2) / 2, so that
+// exp(x) = 2^n exp(r). Adding 1.5 * 2^23 (2^52) rounds x / ln(2) to the
+// integer n, which is then read back from the low bits without a conversion.
+// The approximations of exp(r) are those of the Cephes library.
+CAFFE_VECTOR_MATH_INLINE float exp_core(const float x) {
+  const float kRound = 12582912.f;
+  const float t = x * 1.44269504088896341f + kRound;
+  const float n = t - kRound;
+  float r = x - n * 0.693359375f;
+  r = r + n * 2.12194440e-4f;
+  float p = 1.9875691500e-4f;
+  p = p * r + 1.3981999507e-3f;
+  p = p * r + 8.3334519073e-3f;
+  p = p * r + 4.1665795894e-2f;
+  p = p * r + 1.6666665459e-1f;
+  p = p * r + 5.0000001201e-1f;
+  p = p * r * r + r + 1.f;
+  FloatBits round_bits, scale;
+  round_bits.f = t;
+  scale.i = (round_bits.i - 0x4b400000 + 127) << 23;
+  return p * scale.f;
+}
+
+CAFFE_VECTOR_MATH_INLINE double exp_core(const double x) {
+  const double kRound = 6755399441055744.;
+  const double t = x * 1.4426950408889634073599 + kRound;
+  const double n = t - kRound;
+  double r = x - n * 6.93145751953125e-1;
+  r = r - n * 1.42860682030941723212e-6;
+  const double rr = r * r;
+  const double p = r * ((1.26177193074810590878e-4 * rr +
+      3.02994407707441961300e-2) * rr + 9.99999999999999999910e-1);
+  const double q = ((3.00198505138664455042e-6 * rr +
+      2.52448340349684104739e-3) * rr + 2.27265548208155028766e-1) * rr +
+      2.00000000000000000009e0;
+  DoubleBits round_bits, scale;
+  round_bits.f = t;
+  scale.i = (round_bits.i - 0x4338000000000000LL + 1023) << 52;
+  return (1. + 2. * p / (q - p)) * scale.f;
+}
+
+// log(x) for positive normal x: x = m 2^e with m in [sqrt(1/2), sqrt(2)),
+// split from the bits, so that log(x) = log(m) + e ln(2). The float
+// polynomial for log(m) is that of Cephes.
+CAFFE_VECTOR_MATH_INLINE float log_core(const float x) {
+  FloatBits bits;
+  bits.f = x;
+  const float e = static_cast<float>(((bits.i >> 23) & 0xff) - 126);
+  bits.i = (bits.i & 0x807fffff) | 0x3f000000;
+  const bool below = bits.f < 0.707106781186547524f;
+  const float fe = select(below, e - 1.f, e);
+  const float z = select(below, bits.f + bits.f - 1.f, bits.f - 1.f);
+  const float zz = z * z;
+  float y = 7.0376836292e-2f;
+  y = y * z - 1.1514610310e-1f;
+  y = y * z + 1.1676998740e-1f;
+  y = y * z - 1.2420140846e-1f;
+  y = y * z + 1.4249322787e-1f;
+  y = y * z - 1.6668057665e-1f;
+  y = y * z + 2.0000714765e-1f;
+  y = y * z - 2.4999993993e-1f;
+  y = y * z + 3.3333331174e-1f;
+  y = y * z * zz;
+  y = y - 2.12194440e-4f * fe;
+  y = y - 0.5f * zz;
+  return z + y + 0.693359375f * fe;
+}
+
+// The double version evaluates log(1 + f) as in fdlibm, from s = f / (2 + f).
+CAFFE_VECTOR_MATH_INLINE double log_core(const double x) {
+  DoubleBits bits, exponent;
+  bits.f = x;
+  // The exponent as a double, also without an integer conversion.
+  exponent.i = 0x4330000000000000LL | ((bits.i >> 52) & 0x7ff);
+  const double e = exponent.f - 4503599627370496. - 1022.;
+  bits.i = (bits.i & 0x800fffffffffffffLL) | 0x3fe0000000000000LL;
+  const bool below = bits.f < 0.70710678118654752440;
+  const double fe = select(below, e - 1., e);
+  const double f = select(below, bits.f + bits.f - 1., bits.f - 1.);
+  const double hfsq = 0.5 * f * f;
+  const double s = f / (2. + f);
+  const double z = s * s;
+  const double w = z * z;
+  const double r = z * (6.666666666666735130e-01 + w *
+      (2.857142874366239149e-01 + w * (1.818357216161805012e-01 + w *
+      1.479819860511658591e-01))) + w * (3.999999999940941908e-01 + w *
+      (2.222219843214978396e-01 + w * 1.531383769920937332e-01));
+  return fe * 6.93147180369123816490e-01 -
+      ((hfsq - (s * (hfsq + r) + fe * 1.90821492927058770002e-10)) - f);
+}
+
+// tanh(x) for |x| < 0.625, where 1 - 2 / (exp(2x) + 1) would cancel.
+CAFFE_VECTOR_MATH_INLINE float tanh_small(const float x) {
+  const float z = x * x;
+  float p = -5.70498872745e-3f;
+  p = p * z + 2.06390887954e-2f;
+  p = p * z - 5.37397155531e-2f;
+  p = p * z + 1.33314422036e-1f;
+  p = p * z - 3.33332819422e-1f;
+  return p * z * x + x;
+}
+
+CAFFE_VECTOR_MATH_INLINE double tanh_small(const double x) {
+  const double z = x * x;
+  const double p = (-9.64399179425052238628e-1 * z -
+      9.92877231001918586564e1) * z - 1.61468768441708447952e3;
+  const double q = ((z + 1.12811678491632931402e2) * z +
+      2.23548839060100448583e3) * z + 4.84406305325125486048e3;
+  return x + x * z * p / q;
+}
+
+template <typename Dtype>
+CAFFE_VECTOR_MATH_INLINE bool is_positive_normal(const Dtype x);
+
+template <>
+CAFFE_VECTOR_MATH_INLINE bool is_positive_normal(const float x) {
+  return (x >= FLT_MIN) & (x <= FLT_MAX);
+}
+
+template <>
+CAFFE_VECTOR_MATH_INLINE bool is_positive_normal(const double x) {
+  return (x >= DBL_MIN) & (x <= DBL_MAX);
+}
+
+// Each operation has a branch-free Core, valid for the inputs accepted by
+// InRange, and an Exact scalar version for all other inputs.
+
+template <typename Dtype>
+struct ExpOp {
+  CAFFE_VECTOR_MATH_INLINE Dtype Core(const Dtype x) const {
+    return exp_core(clamp(x, ExpRange<Dtype>::min(), ExpRange<Dtype>::max()));
+  }
+  CAFFE_VECTOR_MATH_INLINE bool InRange(const Dtype x) const {
+    return (x >= ExpRange<Dtype>::min()) & (x <= ExpRange<Dtype>::max());
+  }
+  inline Dtype Exact(const Dtype x) const { return std::exp(x); }
+};
+
+template <typename Dtype>
+struct LogOp {
+  CAFFE_VECTOR_MATH_INLINE Dtype Core(const Dtype x) const {
+    return log_core(x);
+  }
+  CAFFE_VECTOR_MATH_INLINE bool InRange(const Dtype x) const {
+    return is_positive_normal(x);
+  }
+  inline Dtype Exact(const Dtype x) const { return std::log(x); }
+};
+
+// pow(x, b) for float, as exp(b log(x)) evaluated in double precision.
+struct PowFloatOp {
+  explicit PowFloatOp(const float b) : b_(b) {}
+  CAFFE_VECTOR_MATH_INLINE float Core(const float x) const {
+    const double t = b_ * log_core(static_cast<double>(x));
+    return static_cast<float>(exp_core(clamp(t, ExpRange<double>::min(),
+        ExpRange<double>::max())));
+  }
+  CAFFE_VECTOR_MATH_INLINE bool InRange(const float x) const {
+    return is_positive_normal(x);
+  }
+  inline float Exact(const float x) const {
+    return std::pow(x, static_cast<float>(b_));
+  }
+  double b_;
+};
+
+template <typename Dtype>
+struct TanhOp {
+  CAFFE_VECTOR_MATH_INLINE Dtype Core(const Dtype x) const {
+    const Dtype ax = std::fabs(x);
+    const Dtype e = exp_core(minimum(ax + ax, ExpRange<Dtype>::max()));
+    const Dtype large = 1 - 2 / (e + 1);
+    return copy_sign(select(ax < Dtype(0.625), tanh_small(ax), large), x);
+  }
+  CAFFE_VECTOR_MATH_INLINE bool InRange(const Dtype x) const {
+    return x == x;
+  }
+  inline Dtype Exact(const Dtype x) const { return std::tanh(x); }
+};
+
+// sigmoid(scale * x)
+template <typename Dtype>
+struct SigmoidOp {
+  explicit SigmoidOp(const Dtype scale) : scale_(scale) {}
+  CAFFE_VECTOR_MATH_INLINE Dtype Core(const Dtype x) const {
+    return 1 / (1 + exp_core(clamp(-scale_ * x, ExpRange<Dtype>::min(),
+        ExpRange<Dtype>::max())));
+  }
+  CAFFE_VECTOR_MATH_INLINE bool InRange(const Dtype x) const {
+    return scale_ * x >= -ExpRange<Dtype>::max();
+  }
+  inline Dtype Exact(const Dtype x) const {
+    const Dtype t = scale_ * x;
+    if (t < 0) {
+      const Dtype e = std::exp(t);
+      return e / (1 + e);
+    }
+    return 1 / (1 + std::exp(-t));
+  }
+  Dtype scale_;
+};
+
+// log(1 + exp(x)) = max(x, 0) + log1p(exp(-|x|)), with log1p(t) evaluated
+// as log(u) * t / (u - 1) for u = 1 + t (exact up to the error of log).
+template <typename Dtype>
+struct SoftplusOp {
+  CAFFE_VECTOR_MATH_INLINE Dtype Core(const Dtype x) const {
+    const Dtype t = exp_core(maximum(-std::fabs(x), ExpRange<Dtype>::min()));
+    const Dtype u = 1 + t;
+    const Dtype log1p = select(u == 1, t, log_core(u) * t / (u - 1));
+    return maximum(x, Dtype(0)) + log1p;
+  }
+  CAFFE_VECTOR_MATH_INLINE bool InRange(const Dtype x) const {
+    return std::fabs(x) <= -ExpRange<Dtype>::min();
+  }
+  // Beyond the range log1p(exp(-|x|)) rounds to exp(-|x|).
+  inline Dtype Exact(const Dtype x) const {
+    return x > 0 ? x : std::exp(x);
+  }
+};
+
+template <typename Dtype>
+struct ELUOp {
+  explicit ELUOp(const Dtype alpha) : alpha_(alpha) {}
+  CAFFE_VECTOR_MATH_INLINE Dtype Core(const Dtype x) const {
+    const Dtype e = exp_core(clamp(x, ExpRange<Dtype>::min(), Dtype(0)));
+    return select(x > 0, x, alpha_ * (e - 1));
+  }
+  CAFFE_VECTOR_MATH_INLINE bool InRange(const Dtype x) const {
+    return x >= ExpRange<Dtype>::min();
+  }
+  inline Dtype Exact(const Dtype x) const {
+    return x > 0 ? x : alpha_ * (std::exp(x) - 1);
+  }
+  Dtype alpha_;
+};
+
+// Evaluates op on a block of kVectorBlock elements: a pass over the block
+// evaluates Core on every element, then the elements outside the range of
+// Core (rare in practice) are redone with Exact. The fixed trip count lets
+// the compiler vectorize the loops even with its cheapest cost model (-O2).
+const int kVectorBlock = 16;
+
+template <typename Dtype, typename Op>
+CAFFE_VECTOR_MATH_INLINE void apply_block(const Op& op, const Dtype* x,
+    Dtype* result) {
+  int outside = 0;
+  for (int i = 0; i < kVectorBlock; ++i) {
+    result[i] = op.Core(x[i]);
+    outside |= !op.InRange(x[i]);
+  }
+  if (outside) {
+    for (int i = 0; i < kVectorBlock; ++i) {
+      if (!op.InRange(x[i])) {
+        result[i] = op.Exact(x[i]);
+      }
+    }
+  }
+}
+
+// y = op(x), where x and y may be the same. The remaining n % kVectorBlock
+// elements go through a block padded with 1, which is in the range of every
+// op (the Exact fallback covers a scaled sigmoid too).
+template <typename Dtype, typename Op>
+CAFFE_VECTOR_MATH_CLONES void apply_op(const Op& op, const int n,
+    const Dtype* x, Dtype* y) {
+  Dtype result[kVectorBlock];
+  int i = 0;
+  for (; i + kVectorBlock <= n; i += kVectorBlock) {
+    apply_block(op, x + i, result);
+    for (int j = 0; j < kVectorBlock; ++j) {
+      y[i + j] = result[j];
+    }
+  }
+  if (i < n) {
+    Dtype tail[kVectorBlock];
+    std::fill(tail, tail + kVectorBlock, Dtype(1));
+    std::copy(x + i, x + n, tail);
+    apply_block(op, tail, result);
+    std::copy(result, result + n - i, y + i);
+  }
+}
+
+// y = x * sigmoid(beta * x) and, if sigmoid is not NULL, the sigmoid itself.
+template <typename Dtype>
+CAFFE_VECTOR_MATH_CLONES void apply_swish(const SigmoidOp<Dtype>& op,
+    const int n, const Dtype* x, Dtype* y, Dtype* sigmoid) {
+  Dtype result[kVectorBlock];
+  int i = 0;
+  for (; i + kVectorBlock <= n; i += kVectorBlock) {
+    apply_block(op, x + i, result);
+    if (sigmoid) {
+      for (int j = 0; j < kVectorBlock; ++j) {
+        sigmoid[i + j] = result[j];
+      }
+    }
+    for (int j = 0; j < kVectorBlock; ++j) {
+      y[i + j] = x[i + j] * result[j];
+    }
+  }
+  if (i < n) {
+    Dtype tail[kVectorBlock];
+    std::fill(tail, tail + kVectorBlock, Dtype(1));
+    std::copy(x + i, x + n, tail);
+    apply_block(op, tail, result);
+    for (int j = 0; j < n - i; ++j) {
+      if (sigmoid) {
+        sigmoid[i + j] = result[j];
+      }
+      y[i + j] = tail[j] * result[j];
+    }
+  }
+}
+
+// y = exp(x - shift), if y is not NULL, returning the sum of exp(x - shift).
+// The sum is kept in kVectorBlock lanes, which vectorize, and added up last.
+template <typename Dtype>
+CAFFE_VECTOR_MATH_CLONES Dtype apply_exp_sum(const int n, const Dtype* x,
+    const Dtype shift, Dtype* y) {
+  Dtype shifted[kVectorBlock];
+  Dtype result[kVectorBlock];
+  Dtype lanes[kVectorBlock];
+  std::fill(lanes, lanes + kVectorBlock, Dtype(0));
+  int i = 0;
+  for (; i + kVectorBlock <= n; i += kVectorBlock) {
+    for (int j = 0; j < kVectorBlock; ++j) {
+      shifted[j] = x[i + j] - shift;
+    }
+    apply_block(ExpOp<Dtype>(), shifted, result);
+    if (y) {
+      for (int j = 0; j < kVectorBlock; ++j) {
+        y[i + j] = result[j];
+      }
+    }
+    for (int j = 0; j < kVectorBlock; ++j) {
+      lanes[j] += result[j];
+    }
+  }
+  if (i < n) {
+    std::fill(shifted, shifted + kVectorBlock, Dtype(0));
+    for (int j = 0; j < n - i; ++j) {
+      shifted[j] = x[i + j] - shift;
+    }
+    apply_block(ExpOp<Dtype>(), shifted, result);
+    for (int j = 0; j < n - i; ++j) {
+      if (y) {
+        y[i + j] = result[j];
+      }
+      lanes[j] += result[j];
+    }
+  }
+  Dtype sum = 0;
+  for (int j = 0; j < kVectorBlock; ++j) {
+    sum += lanes[j];
+  }
+  return sum;
+}
+
+// The exponents pow needs no exp or log for, all exact. Returns false for
+// other b.
+template <typename Dtype>
+bool powx_special(const int n, const Dtype* x, const Dtype b, Dtype* y) {
+  if (b == Dtype(1)) {
+    std::copy(x, x + n, y);
+  } else if (b == Dtype(2)) {
+    for (int i = 0; i < n; ++i) {
+      y[i] = x[i] * x[i];
+    }
+  } else if (b == Dtype(-1)) {
+    for (int i = 0; i < n; ++i) {
+      y[i] = 1 / x[i];
+    }
+  } else if (b == Dtype(0.5)) {
+    // + 0 turns the sqrt(-0) = -0 into the +0 of pow.
+    for (int i = 0; i < n; ++i) {
+      y[i] = std::sqrt(x[i]) + Dtype(0);
+    }
+  } else if (b == Dtype(0)) {
+    std::fill(y, y + n, Dtype(1));
+  } else {
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+template <typename Dtype>
+void caffe_cpu_vexp(const int n, const Dtype* x, Dtype* y) {
+  apply_op(ExpOp<Dtype>(), n, x, y);
+}
+
+template void caffe_cpu_vexp<float>(const int n, const float* x, float* y);
+template void caffe_cpu_vexp<double>(const int n, const double* x, double* y);
+
+template <typename Dtype>
+Dtype caffe_cpu_vexp_sum(const int n, const Dtype* x, const Dtype shift,
+    Dtype* y) {
+  return apply_exp_sum(n, x, shift, y);
+}
+
+template float caffe_cpu_vexp_sum<float>(const int n, const float* x,
+    const float shift, float* y);
+template double caffe_cpu_vexp_sum<double>(const int n, const double* x,
+    const double shift, double* y);
+
+template <typename Dtype>
+void caffe_cpu_vlog(const int n, const Dtype* x, Dtype* y) {
+  apply_op(LogOp<Dtype>(), n, x, y);
+}
+
+template void caffe_cpu_vlog<float>(const int n, const float* x, float* y);
+template void caffe_cpu_vlog<double>(const int n, const double* x, double* y);
+
+template <>
+void caffe_cpu_vpowx<float>(const int n, const float* x, const float b,
+    float* y) {
+  if (!powx_special(n, x, b, y)) {
+    apply_op(PowFloatOp(b), n, x, y);
+  }
+}
+
+template <>
+void caffe_cpu_vpowx<double>(const int n, const double* x, const double b,
+    double* y) {
+  if (!powx_special(n, x, b, y)) {
+    for (int i = 0; i < n; ++i) {
+      y[i] = std::pow(x[i], b);
+    }
+  }
+}
+
+template <typename Dtype>
+void caffe_cpu_vtanh(const int n, const Dtype* x, Dtype* y) {
+  apply_op(TanhOp<Dtype>(), n, x, y);
+}
+
+template void caffe_cpu_vtanh<float>(const int n, const float* x, float* y);
+template void caffe_cpu_vtanh<double>(const int n, const double* x,
+    double* y);
+
+template <typename Dtype>
+void caffe_cpu_vsigmoid(const int n, const Dtype* x, Dtype* y) {
+  apply_op(SigmoidOp<Dtype>(1), n, x, y);
+}
+
+template void caffe_cpu_vsigmoid<float>(const int n, const float* x,
+    float* y);
+template void caffe_cpu_vsigmoid<double>(const int n, const double* x,
+    double* y);
+
+template <typename Dtype>
+void caffe_cpu_vswish(const int n, const Dtype* x, const Dtype beta, Dtype* y,
+    Dtype* sigmoid) {
+  apply_swish(SigmoidOp<Dtype>(beta), n, x, y, sigmoid);
+}
+
+template void caffe_cpu_vswish<float>(const int n, const float* x,
+    const float beta, float* y, float* sigmoid);
+template void caffe_cpu_vswish<double>(const int n, const double* x,
+    const double beta, double* y, double* sigmoid);
+
+template <typename Dtype>
+void caffe_cpu_vsoftplus(const int n, const Dtype* x, Dtype* y) {
+  apply_op(SoftplusOp<Dtype>(), n, x, y);
+}
+
+template void caffe_cpu_vsoftplus<float>(const int n, const float* x,
+    float* y);
+template void caffe_cpu_vsoftplus<double>(const int n, const double* x,
+    double* y);
+
+template <typename Dtype>
+void caffe_cpu_velu(const int n, const Dtype* x, const Dtype alpha,
+    Dtype* y) {
+  apply_op(ELUOp<Dtype>(alpha), n, x, y);
+}
+
+template void caffe_cpu_velu<float>(const int n, const float* x,
+    const float alpha, float* y);
+template void caffe_cpu_velu<double>(const int n, const double* x,
+    const double alpha, double* y);
+
+template <typename Dtype>
+void caffe_cpu_log_sum_exp(const int channels, const int n, const int stride,
+    const Dtype* x, Dtype* y) {
+  if (stride == 1) {
+    // One position, whose channels are contiguous.
+    const Dtype max_val = *std::max_element(x, x + channels);
+    y[0] = max_val + std::log(caffe_cpu_vexp_sum<Dtype>(channels, x, max_val,
+        NULL));
+    return;
+  }
+  // Otherwise the positions go along the rows, in tiles.
+  const int kTileSize = 256;
+  Dtype max_val[kTileSize];
+  Dtype sum[kTileSize];
+  Dtype e[kTileSize];
+  for (int begin = 0; begin < n; begin += kTileSize) {
+    const int len = std::min(kTileSize, n - begin);
+    const Dtype* x_tile = x + begin;
+    std::copy(x_tile, x_tile + len, max_val);
+    for (int c = 1; c < channels; ++c) {
+      for (int i = 0; i < len; ++i) {
+        max_val[i] = std::max(max_val[i], x_tile[c * stride + i]);
+      }
+    }
+    std::fill(sum, sum + len, Dtype(0));
+    for (int c = 0; c < channels; ++c) {
+      for (int i = 0; i < len; ++i) {
+        e[i] = x_tile[c * stride + i] - max_val[i];
+      }
+      apply_op(ExpOp<Dtype>(), len, e, e);
+      for (int i = 0; i < len; ++i) {
+        sum[i] += e[i];
+      }
+    }
+    for (int i = 0; i < len; ++i) {
+      y[begin + i] = max_val[i] + std::log(sum[i]);
+    }
+  }
+}
+
+template void caffe_cpu_log_sum_exp<float>(const int channels, const int n,
+    const int stride, const float* x, float* y);
+template void caffe_cpu_log_sum_exp<double>(const int channels, const int n,
+    const int stride, const double* x, double* y);
+
+}  // namespace caffe
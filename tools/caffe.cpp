@@ -13,6 +13,7 @@ namespace bp = boost::python;
 
 #include "boost/algorithm/string.hpp"
 #include "caffe/caffe.hpp"
+#include "caffe/util/engine_tuner.hpp"
 #include "caffe/util/signal_handler.h"
 
 using caffe::Blob;
@@ -48,6 +49,12 @@ DEFINE_string(weights, "",
     "separated by ','. Cannot be set simultaneously with snapshot.");
 DEFINE_int32(iterations, 50,
     "The number of iterations to run.");
+DEFINE_string(gemm, "blas",
+    "Optional; the CPU matrix multiply engine: blas (the linked BLAS "
+    "library) or blocked (Caffe's built-in GEMM with prepacked weights).");
+DEFINE_string(tuning_db, "",
+    "Optional; a file of the fastest CPU engine per layer geometry. Layers "
+    "time their engines for shapes not in it yet and add the winners.");
 DEFINE_string(sigint_effect, "stop",
              "Optional; action to take when a SIGINT signal is received: "
               "snapshot, stop or none.");
@@ -120,6 +127,16 @@ caffe::Phase get_phase_from_flags(caffe::Phase default_value) {
   return caffe::TRAIN;  // Avoid warning
 }
 
+// Parse the CPU GEMM engine from flags
+caffe::Caffe::GemmBackend get_gemm_backend_from_flags() {
+  if (FLAGS_gemm == "blas")
+    return caffe::Caffe::BLAS;
+  if (FLAGS_gemm == "blocked")
+    return caffe::Caffe::BLOCKED;
+  LOG(FATAL) << "gemm must be \"blas\" or \"blocked\"";
+  return caffe::Caffe::BLAS;  // Avoid warning
+}
+
 // Parse stages from flags
 vector<string> get_stages_from_flags() {
   vector<string> stages;
@@ -432,6 +449,8 @@ int main(int argc, char** argv) {
       "  time            benchmark model execution time");
   // Run tool or show usage.
   caffe::GlobalInit(&argc, &argv);
+  Caffe::set_gemm_backend(get_gemm_backend_from_flags());
+  caffe::EngineTuner::Open(FLAGS_tuning_db);
   if (argc == 2) {
 #ifdef WITH_PYTHON_LAYER
     try {
@@ -0,0 +1,198 @@
+// This program calibrates the int8 quantization of the Convolution and
+// InnerProduct layers of a trained net, writes a copy of the net definition
+// with the resulting quantization_param set, and reports the outputs of the
+// int8 net against the fp32 net.
+// Usage:
+//    calibrate_int8 -model net.prototxt -weights net.caffemodel
+//        -output_model net_int8.prototxt [-calibration_iterations 10]
+//        [-iterations 50]
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/quantize.hpp"
+
+using caffe::Blob;
+using caffe::Caffe;
+using caffe::LayerParameter;
+using caffe::Net;
+using caffe::NetParameter;
+using caffe::QuantizationParameter;
+using caffe::string;
+using caffe::vector;
+using std::map;
+
+DEFINE_string(model, "",
+    "The model definition protocol buffer text file.");
+DEFINE_string(weights, "",
+    "The pretrained weights of the model.");
+DEFINE_string(output_model, "",
+    "The model definition to write with the int8 quantization set.");
+DEFINE_int32(calibration_iterations, 10,
+    "The number of forward passes used to collect the input ranges.");
+DEFINE_int32(iterations, 50,
+    "The number of forward passes used to compare int8 against fp32.");
+DEFINE_int32(seed, 1701,
+    "The random seed of the int8 against fp32 comparison.");
+
+namespace {
+
+bool IsQuantizable(const string& type) {
+  return type == "Convolution" || type == "InnerProduct";
+}
+
+// Runs the net layer by layer, recording the range of the input of every
+// quantizable layer.
+void CollectInputRanges(Net<float>* net, const int iterations,
+    map<string, std::pair<float, float> >* ranges) {
+  const int num_layers = net->layers().size();
+  for (int iter = 0; iter < iterations; ++iter) {
+    for (int i = 0; i < num_layers; ++i) {
+      const string& type = net->layers()[i]->type();
+      if (IsQuantizable(type)) {
+        const Blob<float>* input = net->bottom_vecs()[i][0];
+        const float* data = input->cpu_data();
+        const string& name = net->layer_names()[i];
+        if (ranges->count(name) == 0) {
+          (*ranges)[name] = std::make_pair(data[0], data[0]);
+        }
+        std::pair<float, float>& range = (*ranges)[name];
+        for (int j = 0; j < input->count(); ++j) {
+          range.first = std::min(range.first, data[j]);
+          range.second = std::max(range.second, data[j]);
+        }
+      }
+      net->ForwardFromTo(i, i);
+    }
+  }
+}
+
+// Returns the mean over iterations of every output of the net.
+vector<float> ScoreNet(Net<float>* net, const int iterations,
+    vector<string>* output_names) {
+  vector<float> scores;
+  output_names->clear();
+  for (int iter = 0; iter < iterations; ++iter) {
+    const vector<Blob<float>*>& result = net->Forward();
+    int idx = 0;
+    for (int j = 0; j < result.size(); ++j) {
+      const float* result_vec = result[j]->cpu_data();
+      for (int k = 0; k < result[j]->count(); ++k, ++idx) {
+        if (iter == 0) {
+          scores.push_back(result_vec[k]);
+          output_names->push_back(
+              net->blob_names()[net->output_blob_indices()[j]]);
+        } else {
+          scores[idx] += result_vec[k];
+        }
+      }
+    }
+  }
+  for (int i = 0; i < scores.size(); ++i) {
+    scores[i] /= iterations;
+  }
+  return scores;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;
+  gflags::SetUsageMessage("Calibrates the int8 quantization of a net.\n"
+      "Usage:\n"
+      "    calibrate_int8 -model net.prototxt -weights net.caffemodel \\\n"
+      "        -output_model net_int8.prototxt");
+  caffe::GlobalInit(&argc, &argv);
+  CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition to calibrate.";
+  CHECK_GT(FLAGS_weights.size(), 0) << "Need model weights to calibrate.";
+  CHECK_GT(FLAGS_output_model.size(), 0) << "Need an output model file.";
+  CHECK_GT(FLAGS_calibration_iterations, 0);
+  // The int8 path is a CPU kernel.
+  Caffe::set_mode(Caffe::CPU);
+
+  LOG(INFO) << "Calibrating over " << FLAGS_calibration_iterations
+            << " iterations.";
+  map<string, std::pair<float, float> > ranges;
+  {
+    Net<float> net(FLAGS_model, caffe::TEST);
+    net.CopyTrainedLayersFrom(FLAGS_weights);
+    CollectInputRanges(&net, FLAGS_calibration_iterations, &ranges);
+
+    NetParameter param;
+    caffe::ReadNetParamsFromTextFileOrDie(FLAGS_model, &param);
+    for (int i = 0; i < param.layer_size(); ++i) {
+      LayerParameter* layer_param = param.mutable_layer(i);
+      if (!IsQuantizable(layer_param->type()) ||
+          ranges.count(layer_param->name()) == 0) {
+        continue;
+      }
+      const std::pair<float, float>& range = ranges[layer_param->name()];
+      float input_scale;
+      int zero_point;
+      caffe::caffe_choose_u8_quantization(range.first, range.second,
+          &input_scale, &zero_point);
+      // The weights are N x K, or K x N for a transposed InnerProduct.
+      const Blob<float>& weights =
+          *net.layer_by_name(layer_param->name())->blobs()[0];
+      const bool transpose = layer_param->type() == "InnerProduct" &&
+          layer_param->inner_product_param().transpose();
+      const int rows = transpose ? weights.shape(1) : weights.shape(0);
+      const int cols = weights.count() / rows;
+      vector<float> weight_scale(rows);
+      caffe::caffe_cpu_int8_row_scales(rows, cols, weights.cpu_data(),
+          transpose, &weight_scale[0]);
+
+      QuantizationParameter* quant_param =
+          layer_param->mutable_quantization_param();
+      quant_param->set_precision(QuantizationParameter::INT8);
+      quant_param->set_input_scale(input_scale);
+      quant_param->set_input_zero_point(zero_point);
+      quant_param->clear_weight_scale();
+      for (int j = 0; j < rows; ++j) {
+        quant_param->add_weight_scale(weight_scale[j]);
+      }
+      LOG(INFO) << layer_param->name() << ": input range [" << range.first
+                << ", " << range.second << "], scale " << input_scale
+                << ", zero point " << zero_point;
+    }
+    caffe::WriteProtoToTextFile(param, FLAGS_output_model);
+    LOG(INFO) << "Wrote " << FLAGS_output_model;
+  }
+
+  if (FLAGS_iterations <= 0) {
+    return 0;
+  }
+  LOG(INFO) << "Comparing int8 against fp32 over " << FLAGS_iterations
+            << " iterations.";
+  vector<string> output_names;
+  vector<float> fp32_scores;
+  vector<float> int8_scores;
+  // Seed both runs alike so that random data layers feed them the same input.
+  {
+    Caffe::set_random_seed(FLAGS_seed);
+    Net<float> net(FLAGS_model, caffe::TEST);
+    net.CopyTrainedLayersFrom(FLAGS_weights);
+    fp32_scores = ScoreNet(&net, FLAGS_iterations, &output_names);
+  }
+  {
+    Caffe::set_random_seed(FLAGS_seed);
+    Net<float> net(FLAGS_output_model, caffe::TEST);
+    net.CopyTrainedLayersFrom(FLAGS_weights);
+    int8_scores = ScoreNet(&net, FLAGS_iterations, &output_names);
+  }
+  CHECK_EQ(fp32_scores.size(), int8_scores.size());
+  for (int i = 0; i < fp32_scores.size(); ++i) {
+    LOG(INFO) << output_names[i] << ": fp32 = " << fp32_scores[i]
+              << ", int8 = " << int8_scores[i] << ", difference = "
+              << int8_scores[i] - fp32_scores[i];
+  }
+  return 0;
+}
@@ -0,0 +1,120 @@
+// This program prunes the weights of the Convolution and InnerProduct layers
+// of a trained net by magnitude: the given fraction of the smallest weights of
+// each layer is set to zero. The pruned model keeps the regular caffemodel
+// format; at inference the layers store weights this sparse in CSR format
+// (see sparsity_threshold in ConvolutionParameter and InnerProductParameter).
+// Usage:
+//    prune_net -weights net.caffemodel -output net_pruned.caffemodel
+//        [-sparsity 0.9] [-layers conv1,fc6]
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "boost/algorithm/string.hpp"
+#include "caffe/caffe.hpp"
+#include "caffe/util/io.hpp"
+
+using caffe::BlobProto;
+using caffe::LayerParameter;
+using caffe::NetParameter;
+using caffe::string;
+using caffe::vector;
+
+DEFINE_string(weights, "",
+    "The trained weights to prune.");
+DEFINE_string(output, "",
+    "The file to write the pruned weights to.");
+DEFINE_double(sparsity, 0.9,
+    "The fraction of the weights of each layer to set to zero.");
+DEFINE_string(layers, "",
+    "Optional; the names of the layers to prune separated by ','. "
+    "All Convolution and InnerProduct layers are pruned by default.");
+
+namespace {
+
+// Zeros the round(sparsity * n) smallest magnitudes of data and returns the
+// resulting number of zeros.
+template <typename Dtype>
+int PruneByMagnitude(const double sparsity, const int n, Dtype* data) {
+  const int num_pruned = static_cast<int>(sparsity * n + 0.5);
+  if (num_pruned == 0) {
+    return std::count(data, data + n, Dtype(0));
+  }
+  vector<Dtype> magnitudes(n);
+  for (int i = 0; i < n; ++i) {
+    magnitudes[i] = std::fabs(data[i]);
+  }
+  std::nth_element(magnitudes.begin(), magnitudes.begin() + num_pruned - 1,
+      magnitudes.end());
+  const Dtype threshold = magnitudes[num_pruned - 1];
+  // Zero everything below the threshold, then ties up to the target count.
+  int zeros = 0;
+  for (int i = 0; i < n; ++i) {
+    if (std::fabs(data[i]) < threshold) {
+      data[i] = 0;
+      ++zeros;
+    }
+  }
+  for (int i = 0; i < n && zeros < num_pruned; ++i) {
+    if (data[i] != 0 && std::fabs(data[i]) == threshold) {
+      data[i] = 0;
+      ++zeros;
+    }
+  }
+  return std::count(data, data + n, Dtype(0));
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;
+  gflags::SetUsageMessage("Prunes the weights of a net by magnitude.\n"
+      "Usage:\n"
+      "    prune_net -weights net.caffemodel -output net_pruned.caffemodel");
+  caffe::GlobalInit(&argc, &argv);
+  CHECK_GT(FLAGS_weights.size(), 0) << "Need model weights to prune.";
+  CHECK_GT(FLAGS_output.size(), 0) << "Need an output weights file.";
+  CHECK_GE(FLAGS_sparsity, 0);
+  CHECK_LE(FLAGS_sparsity, 1);
+  vector<string> layer_names;
+  if (FLAGS_layers.size()) {
+    boost::split(layer_names, FLAGS_layers, boost::is_any_of(","));
+  }
+  const std::set<string> layers(layer_names.begin(), layer_names.end());
+
+  NetParameter param;
+  caffe::ReadNetParamsFromBinaryFileOrDie(FLAGS_weights, &param);
+  for (int i = 0; i < param.layer_size(); ++i) {
+    LayerParameter* layer_param = param.mutable_layer(i);
+    if ((layer_param->type() != "Convolution" &&
+         layer_param->type() != "InnerProduct") ||
+        layer_param->blobs_size() == 0 ||
+        (layers.size() && layers.count(layer_param->name()) == 0)) {
+      continue;
+    }
+    BlobProto* weights = layer_param->mutable_blobs(0);
+    int count;
+    int zeros;
+    if (weights->double_data_size() > 0) {
+      count = weights->double_data_size();
+      zeros = PruneByMagnitude(FLAGS_sparsity, count,
+          weights->mutable_double_data()->mutable_data());
+    } else {
+      count = weights->data_size();
+      zeros = PruneByMagnitude(FLAGS_sparsity, count,
+          weights->mutable_data()->mutable_data());
+    }
+    LOG(INFO) << layer_param->name() << ": " << zeros << " of " << count
+              << " weights are zero (sparsity "
+              << static_cast<float>(zeros) / count << ")";
+  }
+  caffe::WriteProtoToBinaryFile(param, FLAGS_output);
+  LOG(INFO) << "Wrote " << FLAGS_output;
+  return 0;
+}